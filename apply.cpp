@@ -0,0 +1,680 @@
+#include "apply.h"
+#include "batch.h"
+#include "console.h"
+#include "create_service.h"
+#include "delete.h"
+#include "option_schema.h"
+#include "scm_buffers.h"
+#include "scm_handles.h"
+#include "service_graph.h"
+#include "task_pool.h"
+
+#include "win32_compat.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+
+void printApplyHelp()
+{
+    ScOut() << R"(DESCRIPTION:
+        Makes the services on a server match a manifest. Each service is
+        compared with the manifest first; only the services that differ are
+        created, reconfigured or deleted, in parallel, each one after the
+        manifest services it depends on.
+USAGE:
+        sc <server> apply manifest= <file | -> [parallel= <n>] [dryrun= <yes|no>]
+
+        Each manifest line names a service and the settings it should have,
+        with the options of create, config and failure, plus description=
+        and ensure= <present|absent>, for example:
+            MyService binpath= "C:\My\svc.exe" start= auto reset= 86400 actions= restart/5000
+            OldService ensure= absent
+        Settings left out keep their current values. Blank lines and lines
+        starting with # are ignored. dryrun= yes prints the plan only.
+)";
+}
+
+// ParseApplyOptions: key= value pairs; manifest= is required.
+void ParseApplyOptions(const std::vector<std::string> &args, ApplyOptions &opts)
+{
+    size_t i = 0;
+    while (i < args.size())
+    {
+        std::string token = args[i];
+        if (token.size() < 2 || token.back() != '=')
+        {
+            throw std::invalid_argument("Error: Invalid option format '" + token + "'. Expected key= followed by a value.");
+        }
+        std::string key = token.substr(0, token.size() - 1);
+        i++;
+        if (i >= args.size())
+        {
+            throw std::invalid_argument("Error: Missing value for option '" + key + "='.");
+        }
+        std::string value = args[i];
+        i++;
+
+        if (key == "manifest")
+        {
+            opts.manifest = value;
+        }
+        else if (key == "parallel")
+        {
+            unsigned long parallel = 0;
+            try
+            {
+                parallel = std::stoul(value);
+            }
+            catch (...)
+            {
+                throw std::invalid_argument("Error: parallel must be a positive integer.");
+            }
+            if (parallel == 0)
+            {
+                throw std::invalid_argument("Error: parallel must be a positive integer.");
+            }
+            opts.parallel = parallel;
+        }
+        else if (key == "dryrun")
+        {
+            if (value != "yes" && value != "no")
+            {
+                throw std::invalid_argument("Error: Invalid dryrun value. Allowed: yes, no.");
+            }
+            opts.dryRun = (value == "yes");
+        }
+        else
+        {
+            throw std::invalid_argument("Error: Unknown option '" + key + "='.");
+        }
+    }
+    if (opts.manifest.empty())
+    {
+        printApplyHelp();
+        throw std::invalid_argument("Error: apply requires manifest= <file>.");
+    }
+}
+
+namespace
+{
+    enum class ApplyAction
+    {
+        None,
+        Create,
+        Config,
+        Delete
+    };
+
+    const char *ActionName(ApplyAction action)
+    {
+        switch (action)
+        {
+        case ApplyAction::Create:
+            return "CREATE";
+        case ApplyAction::Config:
+            return "CONFIG";
+        case ApplyAction::Delete:
+            return "DELETE";
+        default:
+            return "NONE";
+        }
+    }
+
+    // Manifest keys apply handles itself; every other key goes to the create/config parser.
+    enum class ManifestOption
+    {
+        Ensure,
+        Description,
+        Failure
+    };
+
+    constexpr auto MANIFEST_OPTIONS = MakeKeywordTable<ManifestOption>({
+        {"ensure", ManifestOption::Ensure},
+        {"description", ManifestOption::Description},
+        {"reset", ManifestOption::Failure},
+        {"reboot", ManifestOption::Failure},
+        {"command", ManifestOption::Failure},
+        {"actions", ManifestOption::Failure},
+    });
+    static_assert(MANIFEST_OPTIONS.Valid(), "no perfect hash for the manifest options");
+
+    // ensure= values: whether the service should be absent.
+    constexpr auto ENSURE_VALUES = MakeKeywordTable<bool>({
+        {"present", false},
+        {"absent", true},
+    });
+    static_assert(ENSURE_VALUES.Valid(), "no perfect hash for the ensure values");
+
+    // What reading a manifest service from the server found.
+    struct EntryState
+    {
+        bool exists = false;
+        std::vector<std::string> dependencies; // Current dependencies of an existing service.
+        std::vector<const char *> changed;     // Settings that differ from the manifest.
+        bool configChanged = false;
+        bool failureChanged = false;
+        bool descriptionChanged = false;
+    };
+
+    std::string ToLower(std::string text)
+    {
+        std::transform(text.begin(), text.end(), text.begin(),
+                       [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+        return text;
+    }
+
+    // Drops the "Error: " the option parsers start their messages with.
+    std::string WithoutErrorPrefix(const char *message)
+    {
+        return std::strncmp(message, "Error: ", 7) == 0 ? message + 7 : message;
+    }
+
+    std::vector<std::string> SplitMultiString(const char *list)
+    {
+        std::vector<std::string> names;
+        for (const char *p = list; p && *p; p += std::strlen(p) + 1)
+            names.emplace_back(p);
+        return names;
+    }
+
+    std::vector<std::string> SplitDependencies(const std::string &depend)
+    {
+        std::vector<std::string> names;
+        size_t start = 0;
+        while (start <= depend.size())
+        {
+            size_t end = depend.find('/', start);
+            if (end == std::string::npos)
+                end = depend.size();
+            if (end > start)
+                names.push_back(depend.substr(start, end - start));
+            start = end + 1;
+        }
+        return names;
+    }
+
+    ManifestEntry ParseManifestLine(const std::vector<std::string> &tokens, int line, const std::string &serverName)
+    {
+        ManifestEntry entry;
+        entry.line = line;
+        entry.serviceName = tokens[0];
+        if (entry.serviceName.find('=') != std::string::npos)
+        {
+            throw std::invalid_argument("Error: A service name is required first.");
+        }
+        entry.serviceArgs.push_back(entry.serviceName);
+        std::vector<std::string> failureArgs = {entry.serviceName};
+
+        size_t i = 1;
+        while (i < tokens.size())
+        {
+            const std::string &token = tokens[i];
+            if (token.size() < 2 || token.back() != '=')
+            {
+                throw std::invalid_argument("Error: Invalid option format '" + token + "'. Expected key= followed by a value.");
+            }
+            std::string_view key(token.data(), token.size() - 1);
+            if (i + 1 >= tokens.size())
+            {
+                throw std::invalid_argument("Error: Missing value for option '" + token + "'.");
+            }
+            const std::string &value = tokens[i + 1];
+            i += 2;
+
+            const ManifestOption *option = MANIFEST_OPTIONS.Find(key);
+            if (!option)
+            {
+                entry.serviceArgs.push_back(token);
+                entry.serviceArgs.push_back(value);
+            }
+            else if (*option == ManifestOption::Ensure)
+            {
+                const bool *absent = ENSURE_VALUES.Find(value);
+                if (!absent)
+                {
+                    throw std::invalid_argument("Error: Invalid ensure value. Allowed: " + ENSURE_VALUES.Names() + ".");
+                }
+                entry.absent = *absent;
+            }
+            else if (*option == ManifestOption::Description)
+            {
+                entry.description = value;
+                entry.hasDescription = true;
+            }
+            else
+            {
+                failureArgs.push_back(token);
+                failureArgs.push_back(value);
+                entry.hasFailure = true;
+            }
+        }
+        if (entry.absent && (entry.serviceArgs.size() > 1 || entry.hasFailure || entry.hasDescription))
+        {
+            throw std::invalid_argument("Error: ensure= absent takes no other options.");
+        }
+
+        entry.config.serverName = serverName;
+        ParseConfigOptions(entry.serviceArgs, entry.config);
+        if (entry.hasFailure)
+        {
+            entry.failure.serverName = serverName;
+            ParseFailureOptions(failureArgs, entry.failure);
+        }
+        return entry;
+    }
+
+    // Reads the service behind entry and compares it with the manifest. Returns false,
+    // having printed why, if it cannot be read.
+    bool ReadEntryState(const ManifestEntry &entry, EntryState &state)
+    {
+        ScHandle hSCManager = OpenSCManagerShared(entry.config.serverName, SC_MANAGER_CONNECT);
+        if (!hSCManager)
+        {
+            ScErr() << "OpenSCManager failed, error: " << GetLastError() << "\n";
+            return false;
+        }
+        ScHandle hService = OpenServiceShared(hSCManager, entry.serviceName, SERVICE_QUERY_CONFIG);
+        if (!hService)
+        {
+            DWORD error = GetLastError();
+            if (error == ERROR_SERVICE_DOES_NOT_EXIST)
+                return true;
+            ScErr() << "OpenService failed, error: " << error << "\n";
+            return false;
+        }
+        state.exists = true;
+        if (entry.absent)
+            return true;
+
+        bool delayed = false;
+        if (entry.config.delayedAutoStart && !QueryDelayedAutoStart(hService, delayed))
+        {
+            ScErr() << "QueryServiceConfig2 failed, error: " << GetLastError() << "\n";
+            return false;
+        }
+        const BYTE *result = ScmQuery(ScmCall::QueryServiceConfig, hService.serverKey(), [&hService](BYTE *data, DWORD size, DWORD *needed)
+                                      { return Scm()->QueryServiceConfigA(hService.get(), reinterpret_cast<LPQUERY_SERVICE_CONFIGA>(data),
+                                                                         size, needed); });
+        if (!result)
+        {
+            ScErr() << "QueryServiceConfig failed, error: " << GetLastError() << "\n";
+            return false;
+        }
+        const QUERY_SERVICE_CONFIGA &current = *reinterpret_cast<const QUERY_SERVICE_CONFIGA *>(result);
+        state.dependencies = SplitMultiString(current.lpDependencies);
+        std::vector<const char *> unchanged;
+        DiffServiceConfig(entry.config, current, delayed, state.changed, unchanged);
+        state.configChanged = !state.changed.empty();
+
+        if (entry.hasFailure)
+        {
+            const BYTE *info = ScmQuery(ScmCall::QueryFailureActions, hService.serverKey(), [&hService](BYTE *data, DWORD size, DWORD *needed)
+                                        { return Scm()->QueryServiceConfig2A(hService.get(), SERVICE_CONFIG_FAILURE_ACTIONS, data, size, needed); });
+            if (!info)
+            {
+                ScErr() << "QueryServiceConfig2 failed, error: " << GetLastError() << "\n";
+                return false;
+            }
+            size_t before = state.changed.size();
+            DiffFailureActions(entry.failure, *reinterpret_cast<const SERVICE_FAILURE_ACTIONSA *>(info), state.changed, unchanged);
+            state.failureChanged = state.changed.size() > before;
+        }
+        if (entry.hasDescription)
+        {
+            const BYTE *info = ScmQuery(ScmCall::QueryDescription, hService.serverKey(), [&hService](BYTE *data, DWORD size, DWORD *needed)
+                                        { return Scm()->QueryServiceConfig2A(hService.get(), SERVICE_CONFIG_DESCRIPTION, data, size, needed); });
+            if (!info)
+            {
+                ScErr() << "QueryServiceConfig2 failed, error: " << GetLastError() << "\n";
+                return false;
+            }
+            const char *description = reinterpret_cast<const SERVICE_DESCRIPTIONA *>(info)->lpDescription;
+            state.descriptionChanged = entry.description != (description ? description : "");
+            if (state.descriptionChanged)
+                state.changed.push_back("DESCRIPTION");
+        }
+        return true;
+    }
+
+    bool SetDescription(const ManifestEntry &entry)
+    {
+        ScHandle hSCManager = OpenSCManagerShared(entry.config.serverName, SC_MANAGER_CONNECT);
+        if (!hSCManager)
+        {
+            ScErr() << "OpenSCManager failed, error: " << GetLastError() << "\n";
+            return false;
+        }
+        ScHandle hService = OpenServiceShared(hSCManager, entry.serviceName, SERVICE_CHANGE_CONFIG);
+        if (!hService)
+        {
+            ScErr() << "OpenService failed, error: " << GetLastError() << "\n";
+            return false;
+        }
+        SERVICE_DESCRIPTIONA info;
+        info.lpDescription = const_cast<LPSTR>(entry.description.c_str());
+        if (!Scm()->ChangeServiceConfig2A(hService.get(), SERVICE_CONFIG_DESCRIPTION, &info))
+        {
+            ScErr() << "ChangeServiceConfig2A (description) failed, error: " << GetLastError() << "\n";
+            return false;
+        }
+        NoteConfigWrite(true);
+        ScOut() << "[SC] ChangeServiceConfig2 SUCCESS (description)\n";
+        return true;
+    }
+
+    // Makes the change the plan chose for entry, through the same functions as the create,
+    // config, failure and delete commands.
+    bool ApplyEntry(const ManifestEntry &entry, ApplyAction action, const EntryState &state)
+    {
+        switch (action)
+        {
+        case ApplyAction::Create:
+        {
+            CreateOptions createOpts;
+            createOpts.serverName = entry.config.serverName;
+            ParseCreateOptions(entry.serviceArgs, createOpts);
+            if (!createService(createOpts))
+                return false;
+            if (entry.hasFailure && !failure(entry.failure))
+                return false;
+            return !entry.hasDescription || entry.description.empty() || SetDescription(entry);
+        }
+        case ApplyAction::Config:
+            if (state.configChanged && !config(entry.config))
+                return false;
+            if (state.failureChanged && !failure(entry.failure))
+                return false;
+            return !state.descriptionChanged || SetDescription(entry);
+        case ApplyAction::Delete:
+        {
+            DeleteOptions deleteOpts;
+            deleteOpts.serverName = entry.config.serverName;
+            deleteOpts.serviceName = entry.serviceName;
+            return deleteService(deleteOpts);
+        }
+        default:
+            return true;
+        }
+    }
+
+    // Pools SCM and service handles for the duration of an apply, unless a batch already does.
+    class HandleSharingScope
+    {
+    public:
+        HandleSharingScope() : owned(!SharedScmHandlePool())
+        {
+            if (owned)
+                SetScmHandleSharing(true);
+        }
+        ~HandleSharingScope()
+        {
+            if (owned)
+                SetScmHandleSharing(false);
+        }
+        HandleSharingScope(const HandleSharingScope &) = delete;
+        HandleSharingScope &operator=(const HandleSharingScope &) = delete;
+
+    private:
+        bool owned;
+    };
+
+    long long MillisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+} // end anonymous namespace
+
+std::vector<ManifestEntry> LoadManifest(const std::string &path, const std::string &serverName)
+{
+    std::ifstream file;
+    if (path != "-")
+    {
+        file.open(path);
+        if (!file)
+        {
+            throw std::invalid_argument("Error: Unable to open manifest '" + path + "'.");
+        }
+    }
+    std::istream &in = path == "-" ? std::cin : file;
+
+    std::vector<ManifestEntry> entries;
+    std::unordered_map<std::string, int> lineByName;
+    std::string text;
+    for (int line = 1; std::getline(in, text); ++line)
+    {
+        std::vector<std::string> tokens = TokenizeCommandLine(text);
+        if (tokens.empty() || tokens[0][0] == '#')
+            continue;
+        try
+        {
+            entries.push_back(ParseManifestLine(tokens, line, serverName));
+        }
+        catch (const std::invalid_argument &e)
+        {
+            throw std::invalid_argument("Error: manifest line " + std::to_string(line) + ": " + WithoutErrorPrefix(e.what()));
+        }
+        auto inserted = lineByName.emplace(ToLower(entries.back().serviceName), line);
+        if (!inserted.second)
+        {
+            throw std::invalid_argument("Error: manifest line " + std::to_string(line) + ": " + entries.back().serviceName +
+                                        " is already listed on line " + std::to_string(inserted.first->second) + ".");
+        }
+    }
+    return entries;
+}
+
+bool apply(const ApplyOptions &opts)
+{
+    auto began = std::chrono::steady_clock::now();
+    // Timed-out tasks are abandoned, not joined, so the entries and states they use are shared.
+    auto entries = std::make_shared<const std::vector<ManifestEntry>>(LoadManifest(opts.manifest, opts.serverName));
+    auto states = std::make_shared<std::vector<EntryState>>(entries->size());
+    HandleSharingScope sharing;
+
+    // Read every service the manifest lists.
+    auto readStart = std::chrono::steady_clock::now();
+    std::vector<BoundedTask> reads;
+    reads.reserve(entries->size());
+    for (size_t i = 0; i < entries->size(); i++)
+        reads.push_back([entries, states, i]()
+                        { return ReadEntryState((*entries)[i], (*states)[i]); });
+    size_t readFailures = 0;
+    RunBoundedTasks(reads, opts.parallel, DEFAULT_APPLY_TIMEOUT,
+                    [&](const TaskOutcome &outcome)
+                    {
+                        if (outcome.ok)
+                            return;
+                        ++readFailures;
+                        std::ostream &err = ScErr();
+                        err << "[SC] READ " << (*entries)[outcome.index].serviceName << ": "
+                            << (outcome.timedOut ? "TIMEOUT" : "FAILED") << "\n"
+                            << outcome.output;
+                        if (!outcome.output.empty() && outcome.output.back() != '\n')
+                            err << "\n";
+                    });
+    long long readMs = MillisecondsSince(readStart);
+    if (readFailures)
+    {
+        ScErr() << "[SC] APPLY stopped: " << readFailures << " service(s) could not be read.\n";
+        return false;
+    }
+
+    // Choose each service's change.
+    const std::vector<ManifestEntry> &manifest = *entries;
+    const std::vector<EntryState> &live = *states;
+    std::vector<ApplyAction> actions(manifest.size(), ApplyAction::None);
+    std::unordered_map<std::string, size_t> indexByName;
+    size_t planErrors = 0;
+    for (size_t i = 0; i < manifest.size(); i++)
+    {
+        indexByName.emplace(ToLower(manifest[i].serviceName), i);
+        if (manifest[i].absent)
+            actions[i] = live[i].exists ? ApplyAction::Delete : ApplyAction::None;
+        else if (!live[i].exists)
+            actions[i] = ApplyAction::Create;
+        else if (!live[i].changed.empty())
+            actions[i] = ApplyAction::Config;
+
+        if (actions[i] == ApplyAction::Create)
+        {
+            CreateOptions createOpts;
+            try
+            {
+                ParseCreateOptions(manifest[i].serviceArgs, createOpts);
+            }
+            catch (const std::invalid_argument &e)
+            {
+                ScErr() << "Error: manifest line " << manifest[i].line << ": " << manifest[i].serviceName
+                        << " does not exist and cannot be created: " << WithoutErrorPrefix(e.what()) << "\n";
+                ++planErrors;
+            }
+        }
+    }
+
+    // Order the changes: a service is created or reconfigured after the manifest services it
+    // will depend on, and a service is deleted after those that stop depending on it.
+    ServiceGraph graph;
+    std::vector<size_t> nodeByEntry(manifest.size(), 0);
+    std::vector<size_t> entryByNode;
+    for (size_t i = 0; i < manifest.size(); i++)
+    {
+        if (actions[i] != ApplyAction::None)
+        {
+            nodeByEntry[i] = graph.Add(manifest[i].serviceName);
+            entryByNode.push_back(i);
+        }
+    }
+    for (size_t i = 0; i < manifest.size(); i++)
+    {
+        if (manifest[i].absent)
+            continue;
+        std::vector<std::string> wanted = manifest[i].config.depend.empty() ? live[i].dependencies
+                                                                            : SplitDependencies(manifest[i].config.depend);
+        std::vector<std::string> wantedLower;
+        for (const std::string &name : wanted)
+        {
+            wantedLower.push_back(ToLower(name));
+            auto found = indexByName.find(wantedLower.back());
+            if (name[0] == '+' || found == indexByName.end())
+                continue;
+            size_t dependency = found->second;
+            if (actions[dependency] == ApplyAction::Delete)
+            {
+                ScErr() << "Error: manifest line " << manifest[i].line << ": " << manifest[i].serviceName << " depends on "
+                        << manifest[dependency].serviceName << ", which the manifest deletes.\n";
+                ++planErrors;
+            }
+            else if (actions[i] != ApplyAction::None && actions[dependency] != ApplyAction::None)
+            {
+                graph.AddDependency(nodeByEntry[i], nodeByEntry[dependency]);
+            }
+        }
+        if (actions[i] != ApplyAction::Config)
+            continue;
+        for (const std::string &name : live[i].dependencies)
+        {
+            auto found = indexByName.find(ToLower(name));
+            if (found != indexByName.end() && actions[found->second] == ApplyAction::Delete &&
+                std::find(wantedLower.begin(), wantedLower.end(), ToLower(name)) == wantedLower.end())
+                graph.AddDependency(nodeByEntry[found->second], nodeByEntry[i]);
+        }
+    }
+    std::vector<std::string> cycle;
+    if (graph.FindCycle(cycle))
+    {
+        ScErr() << "Error: Circular dependency: ";
+        for (size_t i = 0; i < cycle.size(); i++)
+            ScErr() << (i ? " -> " : "") << cycle[i];
+        ScErr() << " (error " << ERROR_CIRCULAR_DEPENDENCY << ")\n";
+        ++planErrors;
+    }
+
+    // Print the plan.
+    size_t counts[4] = {};
+    for (ApplyAction action : actions)
+        ++counts[static_cast<size_t>(action)];
+    std::ostream &out = ScOut();
+    out << "[SC] APPLY plan for " << opts.manifest << ": " << counts[static_cast<size_t>(ApplyAction::Create)]
+        << " to create, " << counts[static_cast<size_t>(ApplyAction::Config)] << " to change, "
+        << counts[static_cast<size_t>(ApplyAction::Delete)] << " to delete, "
+        << counts[static_cast<size_t>(ApplyAction::None)] << " unchanged\n";
+    for (size_t i = 0; i < manifest.size(); i++)
+    {
+        if (actions[i] == ApplyAction::None)
+            continue;
+        out << "        " << ActionName(actions[i]) << "  " << manifest[i].serviceName;
+        for (size_t k = 0; k < live[i].changed.size(); k++)
+            out << (k ? ", " : ": ") << live[i].changed[k];
+        out << "\n";
+    }
+    if (planErrors)
+    {
+        ScErr() << "[SC] APPLY stopped: " << planErrors << " error(s) in the plan.\n";
+        return false;
+    }
+    if (opts.dryRun || entryByNode.empty())
+    {
+        out << "[SC] APPLY timing: read " << readMs << " ms, total " << MillisecondsSince(began) << " ms\n";
+        return true;
+    }
+
+    // Make the changes.
+    const std::vector<ServiceGraphNode> &nodes = graph.Nodes();
+    std::vector<BoundedTask> tasks;
+    std::vector<std::vector<size_t>> prerequisites;
+    for (size_t node = 0; node < nodes.size(); node++)
+    {
+        size_t i = entryByNode[node];
+        ApplyAction action = actions[i];
+        tasks.push_back([entries, states, i, action]()
+                        { return ApplyEntry((*entries)[i], action, (*states)[i]); });
+        prerequisites.push_back(nodes[node].dependsOn);
+    }
+
+    auto applyStart = std::chrono::steady_clock::now();
+    size_t succeeded = 0, failed = 0, skipped = 0, timedOut = 0;
+    unsigned long taskMs[4] = {};
+    RunDependentTasks(tasks, prerequisites, opts.parallel, DEFAULT_APPLY_TIMEOUT,
+                      [&](const TaskOutcome &outcome)
+                      {
+                          ApplyAction action = actions[entryByNode[outcome.index]];
+                          const char *status = outcome.timedOut ? "TIMEOUT"
+                                               : outcome.skipped ? "SKIPPED"
+                                               : outcome.ok      ? "SUCCESS"
+                                                                 : "FAILED";
+                          if (outcome.timedOut)
+                              ++timedOut;
+                          else if (outcome.skipped)
+                              ++skipped;
+                          else if (outcome.ok)
+                              ++succeeded;
+                          else
+                              ++failed;
+                          taskMs[static_cast<size_t>(action)] += outcome.elapsedMs;
+
+                          out << "[SC] " << ActionName(action) << " " << nodes[outcome.index].name << ": " << status;
+                          if (!outcome.skipped)
+                              out << " (" << outcome.elapsedMs << " ms)";
+                          out << "\n" << outcome.output;
+                          if (!outcome.output.empty() && outcome.output.back() != '\n')
+                              out << "\n";
+                          out.flush();
+                      });
+
+    long long applyMs = MillisecondsSince(applyStart);
+    out << "[SC] APPLY " << nodes.size() << " change(s), " << succeeded << " succeeded, " << failed << " failed, "
+        << skipped << " skipped, " << timedOut << " timed out\n";
+    out << "[SC] APPLY timing: read " << readMs << " ms, apply " << applyMs << " ms (create "
+        << taskMs[static_cast<size_t>(ApplyAction::Create)] << " ms, config "
+        << taskMs[static_cast<size_t>(ApplyAction::Config)] << " ms, delete "
+        << taskMs[static_cast<size_t>(ApplyAction::Delete)] << " ms of task time), total " << MillisecondsSince(began)
+        << " ms\n";
+    return failed == 0 && skipped == 0 && timedOut == 0;
+}
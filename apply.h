@@ -0,0 +1,58 @@
+#ifndef APPLY_H
+#define APPLY_H
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "failure.h"
+
+// Workers and per-service time limit for the changes apply makes.
+constexpr size_t DEFAULT_APPLY_PARALLELISM = 8;
+constexpr std::chrono::milliseconds DEFAULT_APPLY_TIMEOUT{60000};
+
+// Structure for the "apply" subcommand options.
+// Command-line syntax:
+//   sc.exe [<servername>] apply manifest= <file> [parallel= <n>] [dryrun= {yes | no}]
+struct ApplyOptions
+{
+    std::string serverName;                        // Optional server name; if empty or "\\local", assume local.
+    std::string manifest;                          // Manifest path, or "-" to read it from standard input.
+    size_t parallel = DEFAULT_APPLY_PARALLELISM;   // Maximum number of services changed at once.
+    bool dryRun = false;                           // Print the plan without changing anything.
+};
+
+// One service in a manifest. Each line names a service and gives its settings with the
+// create, config and failure options, plus description= and ensure= {present | absent}:
+//   MyService binpath= "C:\My\svc.exe" start= auto depend= Tcpip description= "My service" reset= 86400 actions= restart/5000
+//   OldService ensure= absent
+// Blank lines and lines starting with # are ignored.
+struct ManifestEntry
+{
+    int line = 0;
+    std::string serviceName;
+    bool absent = false;                  // ensure= absent: delete the service if it exists.
+    std::vector<std::string> serviceArgs; // Service name and create/config options, for ParseCreateOptions.
+    ConfigOptions config;
+    FailureOptions failure;
+    bool hasFailure = false;
+    std::string description;
+    bool hasDescription = false;
+};
+
+// Parse function for "apply" options. Throws std::invalid_argument if the manifest is missing
+// or an option is invalid.
+void ParseApplyOptions(const std::vector<std::string> &args, ApplyOptions &opts);
+
+// Reads a manifest. Throws std::invalid_argument naming the line of the first error.
+std::vector<ManifestEntry> LoadManifest(const std::string &path, const std::string &serverName);
+
+// apply function: compares every manifest entry with the service on the server, prints the
+// creates, configs and deletes needed to match it, and runs them in parallel, each service
+// after the manifest services it depends on (deletes after the services that stop depending
+// on them). Returns true if every change succeeded.
+bool apply(const ApplyOptions &opts);
+
+#endif // APPLY_H
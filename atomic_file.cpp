@@ -0,0 +1,111 @@
+#include "atomic_file.h"
+
+#include <cstdio>
+#include <fstream>
+
+#ifdef _WIN32
+#include "win32_compat.h"
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+struct FileLock::Impl
+{
+    HANDLE file = INVALID_HANDLE_VALUE;
+};
+
+FileLock::FileLock(const std::string &path) : impl(new Impl())
+{
+    impl->file = CreateFileA((path + ".lock").c_str(), GENERIC_READ | GENERIC_WRITE,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS,
+                             FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (impl->file == INVALID_HANDLE_VALUE)
+        return;
+    OVERLAPPED whole = {};
+    if (!LockFileEx(impl->file, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &whole))
+    {
+        CloseHandle(impl->file);
+        impl->file = INVALID_HANDLE_VALUE;
+    }
+}
+
+FileLock::~FileLock()
+{
+    // Closing the handle releases the lock.
+    if (impl->file != INVALID_HANDLE_VALUE)
+        CloseHandle(impl->file);
+}
+
+bool FileLock::Locked() const
+{
+    return impl->file != INVALID_HANDLE_VALUE;
+}
+
+#else
+
+struct FileLock::Impl
+{
+    int fd = -1;
+};
+
+FileLock::FileLock(const std::string &path) : impl(new Impl())
+{
+    impl->fd = open((path + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (impl->fd < 0)
+        return;
+    int result;
+    while ((result = flock(impl->fd, LOCK_EX)) != 0 && errno == EINTR)
+    {
+    }
+    if (result != 0)
+    {
+        close(impl->fd);
+        impl->fd = -1;
+    }
+}
+
+FileLock::~FileLock()
+{
+    // Closing the descriptor releases the lock.
+    if (impl->fd >= 0)
+        close(impl->fd);
+}
+
+bool FileLock::Locked() const
+{
+    return impl->fd >= 0;
+}
+
+#endif
+
+bool ReplaceFileContents(const std::string &path, const std::string &contents)
+{
+    // The process ID keeps writers that hold no lock from sharing a temporary file.
+#ifdef _WIN32
+    std::string temporary = path + ".tmp" + std::to_string(GetCurrentProcessId());
+#else
+    std::string temporary = path + ".tmp" + std::to_string(getpid());
+#endif
+    {
+        std::ofstream file(temporary, std::ios::trunc);
+        if (!(file << contents) || !file.flush())
+        {
+            file.close();
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+#ifdef _WIN32
+    bool renamed = MoveFileExA(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    bool renamed = std::rename(temporary.c_str(), path.c_str()) == 0;
+#endif
+    if (!renamed)
+        std::remove(temporary.c_str());
+    return renamed;
+}
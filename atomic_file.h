@@ -0,0 +1,33 @@
+#ifndef ATOMIC_FILE_H
+#define ATOMIC_FILE_H
+
+#include <memory>
+#include <string>
+
+// Updating the files that every sc run reads and rewrites (the size hints, the metrics)
+// while other sc processes do the same.
+
+// Holds an exclusive lock on <path>.lock while it lives, so that read-merge-write cycles on
+// path in different processes take turns. The lock file is left in place. If it cannot be
+// opened (a read-only directory, say), Locked() is false and the caller runs unlocked.
+class FileLock
+{
+public:
+    explicit FileLock(const std::string &path);
+    ~FileLock();
+    FileLock(const FileLock &) = delete;
+    FileLock &operator=(const FileLock &) = delete;
+
+    bool Locked() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+// Writes contents to a temporary file beside path, then renames it over path. Readers see
+// the old file or the new one, never a partly written one. Returns false if the file
+// cannot be written, leaving path as it was.
+bool ReplaceFileContents(const std::string &path, const std::string &contents);
+
+#endif // ATOMIC_FILE_H
@@ -0,0 +1,195 @@
+#include "batch.h"
+#include "console.h"
+#include "commands.h"
+#include "config.h"
+#include "process_index.h"
+#include "scm_buffers.h"
+#include "scm_handles.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+void printBatchHelp()
+{
+    ScOut() << R"(DESCRIPTION:
+        Runs many sc commands in one process, one command per line.
+        Handles to the Service Control Manager and to services are
+        opened once and reused by every line of the script.
+USAGE:
+        sc batch <file | -> [stoponerror= <yes|no>]
+
+        Each line holds the arguments that would follow "sc", for example:
+            \\ServerName query eventlog
+            stop MyService
+            config MyService start= auto
+        Blank lines and lines starting with # are ignored. A leading "sc" or
+        "sc.exe" token is skipped. Use "-" to read the script from standard input.
+)";
+}
+
+// ParseBatchOptions: The first token is the script source, followed by key= value pairs.
+void ParseBatchOptions(const std::vector<std::string> &args, BatchOptions &opts)
+{
+    if (args.empty())
+    {
+        printBatchHelp();
+        throw std::invalid_argument("Error: batch requires a script file or '-'.");
+    }
+    opts.source = args[0];
+
+    size_t i = 1;
+    while (i < args.size())
+    {
+        std::string token = args[i];
+        if (token.size() < 2 || token.back() != '=')
+        {
+            throw std::invalid_argument("Error: Invalid option format '" + token + "'. Expected key= followed by a value.");
+        }
+        std::string key = token.substr(0, token.size() - 1);
+        i++;
+        if (i >= args.size())
+        {
+            throw std::invalid_argument("Error: Missing value for option '" + key + "='.");
+        }
+        std::string value = args[i];
+        i++;
+
+        if (key == "stoponerror")
+        {
+            if (value != "yes" && value != "no")
+            {
+                throw std::invalid_argument("Error: Invalid stoponerror value. Allowed: yes, no.");
+            }
+            opts.stopOnError = (value == "yes");
+        }
+        else
+        {
+            throw std::invalid_argument("Error: Unknown option '" + key + "='.");
+        }
+    }
+}
+
+namespace
+{
+    // Commands that leave every service where it was, so a process index built by an
+    // earlier line stays valid after them.
+    bool KeepsProcessTables(const std::vector<std::string> &tokens)
+    {
+        static const char *const readOnly[] = {"query", "queryex", "qc", "qdescription", "bypid", "snapshot", "diff"};
+        size_t i = !tokens.empty() && tokens[0].compare(0, 2, "\\\\") == 0 ? 1 : 0;
+        return i < tokens.size() &&
+               std::find(std::begin(readOnly), std::end(readOnly), tokens[i]) != std::end(readOnly);
+    }
+}
+
+std::vector<std::string> TokenizeCommandLine(const std::string &line)
+{
+    std::vector<std::string> tokens;
+    std::string current;
+    bool inToken = false;
+    bool inQuotes = false;
+
+    for (char c : line)
+    {
+        if (c == '"')
+        {
+            inQuotes = !inQuotes;
+            inToken = true;
+        }
+        else if (!inQuotes && (c == ' ' || c == '\t' || c == '\r'))
+        {
+            if (inToken)
+            {
+                tokens.push_back(current);
+                current.clear();
+                inToken = false;
+            }
+        }
+        else
+        {
+            current.push_back(c);
+            inToken = true;
+        }
+    }
+    if (inToken)
+        tokens.push_back(current);
+    return tokens;
+}
+
+int runBatchStream(std::istream &in, std::ostream &out, bool stopOnError)
+{
+    SetScmHandleSharing(true);
+    SetProcessIndexSharing(true);
+
+    auto batchStart = std::chrono::steady_clock::now();
+    ScmBufferStats buffersBefore = GetScmBufferStats();
+    ConfigWriteStats writesBefore = GetConfigWriteStats();
+    int commands = 0;
+    int failures = 0;
+    std::string line;
+    for (int lineNumber = 1; std::getline(in, line); ++lineNumber)
+    {
+        std::vector<std::string> tokens = TokenizeCommandLine(line);
+        if (tokens.empty() || tokens[0][0] == '#')
+            continue;
+        if (tokens[0] == "sc" || tokens[0] == "sc.exe")
+            tokens.erase(tokens.begin());
+        if (!tokens.empty() && tokens[0] == "batch")
+        {
+            ScErr() << "Error: batch cannot be nested.\n";
+            tokens.clear();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        bool ok = !tokens.empty() && RunCommand(tokens);
+        if (!KeepsProcessTables(tokens))
+            InvalidateSharedProcessTables();
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+        ++commands;
+        if (!ok)
+            ++failures;
+        out << "[SC] BATCH line " << lineNumber << ": " << (ok ? "SUCCESS" : "FAILED")
+            << " (" << elapsed.count() << " ms)\n";
+        out.flush();
+
+        if (!ok && stopOnError)
+            break;
+    }
+
+    auto total = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - batchStart);
+    ScmPoolStats pool = SharedScmHandlePool()->Stats();
+    out << "[SC] BATCH " << commands << " command(s), " << failures << " failed, "
+        << total.count() << " ms\n";
+    out << "[SC] BATCH handle cache: " << pool.hits << " hit(s), " << pool.misses << " miss(es), "
+        << pool.widenings << " widening(s), " << pool.evictions << " eviction(s)\n";
+    ScmBufferStats buffers = GetScmBufferStats();
+    out << "[SC] BATCH size hints: " << buffers.hintHits - buffersBefore.hintHits << " hit(s), "
+        << buffers.hintMisses - buffersBefore.hintMisses << " miss(es)\n";
+    ConfigWriteStats writes = GetConfigWriteStats();
+    out << "[SC] BATCH config writes: " << writes.written - writesBefore.written << " written, "
+        << writes.skipped - writesBefore.skipped << " skipped (unchanged)\n";
+
+    SetProcessIndexSharing(false);
+    SetScmHandleSharing(false);
+    return failures;
+}
+
+bool batch(const BatchOptions &opts)
+{
+    if (opts.source == "-")
+    {
+        return runBatchStream(std::cin, ScOut(), opts.stopOnError) == 0;
+    }
+
+    std::ifstream file(opts.source);
+    if (!file)
+    {
+        ScErr() << "Error: Unable to open batch file '" << opts.source << "'.\n";
+        return false;
+    }
+    return runBatchStream(file, ScOut(), opts.stopOnError) == 0;
+}
@@ -0,0 +1,33 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// Structure for the "batch" subcommand options.
+// Command-line syntax:
+//   sc.exe batch <file | -> [stoponerror= {yes | no}]
+struct BatchOptions
+{
+    std::string source;       // Script path, or "-" to read from standard input.
+    bool stopOnError = false; // Stop at the first failing line.
+};
+
+// Parse function for "batch" options. Throws std::invalid_argument if the source is missing
+// or an option is invalid.
+void ParseBatchOptions(const std::vector<std::string> &args, BatchOptions &opts);
+
+// Splits one script line into tokens the way the command shell would: whitespace separates
+// tokens and double quotes group them ("" yields an empty token).
+std::vector<std::string> TokenizeCommandLine(const std::string &line);
+
+// Runs every command read from 'in' through RunCommand and writes one result line per
+// command to 'out'. SCM and service handles are pooled for the duration of the batch.
+// Returns the number of failed commands.
+int runBatchStream(std::istream &in, std::ostream &out, bool stopOnError);
+
+// batch function: runs the script named by opts.source. Returns true if every command succeeded.
+bool batch(const BatchOptions &opts);
+
+#endif // BATCH_H
@@ -0,0 +1,61 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+// Settings shared by every benchmark, taken from the sc_bench command line.
+struct BenchConfig
+{
+    size_t samples = 50;             // Timed samples per benchmark.
+    size_t services = 100000;        // Services held by the emulator in the macro benchmarks.
+    size_t targets = 200;            // Services started and stopped per start/stop sample.
+    unsigned int latencyUs = 0;      // Emulated latency of every SCM call.
+    unsigned int transitionMs = 0;   // Emulated START_PENDING/STOP_PENDING time.
+    size_t parallel = 8;             // Worker threads for the parallel start/stop benchmark.
+    std::string filter;              // Only run benchmarks whose name contains this.
+};
+
+// One benchmark. A sample times opsPerSample calls of run(); results are reported per call.
+struct Benchmark
+{
+    std::string name{};
+    size_t opsPerSample = 1;
+    std::function<void()> run{};
+    std::function<void()> setup{};    // Optional; called once before the first sample.
+    std::function<void()> teardown{}; // Optional; called once after the last sample.
+};
+
+// Registration hooks implemented by the benchmark files.
+void AddFormatBenchmarks(const BenchConfig &config, std::vector<Benchmark> &out);
+void AddMicroBenchmarks(const BenchConfig &config, std::vector<Benchmark> &out);
+void AddMacroBenchmarks(const BenchConfig &config, std::vector<Benchmark> &out);
+
+// Heap allocations made by the process so far (counted by sc_bench's operator new).
+uint64_t BenchAllocations();
+
+// Discards everything written to it, so timings measure formatting rather than the console.
+class NullBuffer : public std::streambuf
+{
+protected:
+    int overflow(int c) override { return traits_type::not_eof(c); }
+    std::streamsize xsputn(const char *, std::streamsize n) override { return n; }
+};
+
+// Keeps the compiler from optimizing away a result.
+template <typename T>
+inline void DoNotOptimize(const T &value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void *sink;
+    sink = &value;
+#endif
+}
+
+#endif // BENCH_H
@@ -0,0 +1,151 @@
+// Output formatter benchmarks for sc_bench.
+//
+// Compares the previous iostream-based PrintServiceStatus (kept here verbatim as the
+// baseline) with ServiceStatusFormatter. Before anything is timed, both must produce
+// identical bytes for every record.
+
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "../status_format.h"
+
+namespace
+{
+    // Baseline: the formatter as it was before ServiceStatusFormatter.
+    void LegacyPrintServiceStatus(std::ostream &out, const std::string &serviceName, const std::string &displayName,
+                                  const SERVICE_STATUS_PROCESS &ssp, bool showDisplayName)
+    {
+        out << "\n";
+        out << "SERVICE_NAME: " << serviceName << "\n";
+        if (showDisplayName)
+        {
+            out << "DISPLAY_NAME: " << displayName << "\n";
+        }
+
+        std::ostringstream hexStream;
+        hexStream << std::hex << std::nouppercase << ssp.dwServiceType;
+        std::string typeHex = hexStream.str();
+
+        std::string typeDesc = DecodeServiceType(ssp.dwServiceType);
+        out << "        TYPE               : " << typeHex << "   " << typeDesc << "\n";
+
+        std::string stateStr = StateToString(ssp.dwCurrentState);
+        out << "        STATE              : " << ssp.dwCurrentState << "  " << stateStr << "\n";
+
+        if (ssp.dwCurrentState != SERVICE_STOPPED)
+        {
+            std::vector<std::string> controls;
+            if (ssp.dwControlsAccepted & SERVICE_ACCEPT_STOP)
+                controls.push_back("STOPPABLE");
+            else
+                controls.push_back("NOT_STOPPABLE");
+            if (ssp.dwControlsAccepted & SERVICE_ACCEPT_PAUSE_CONTINUE)
+                controls.push_back("PAUSABLE");
+            else
+                controls.push_back("NOT_PAUSABLE");
+            if (ssp.dwControlsAccepted & SERVICE_ACCEPT_PRESHUTDOWN)
+                controls.push_back("ACCEPTS_PRESHUTDOWN");
+            else if (ssp.dwControlsAccepted & SERVICE_ACCEPT_SHUTDOWN)
+                controls.push_back("ACCEPTS_SHUTDOWN");
+            else
+                controls.push_back("IGNORES_SHUTDOWN");
+
+            out << "                                (";
+            for (size_t i = 0; i < controls.size(); ++i)
+            {
+                out << controls[i];
+                if (i != controls.size() - 1)
+                    out << ", ";
+            }
+            out << ")\n";
+        }
+
+        out << "        WIN32_EXIT_CODE    : " << ssp.dwWin32ExitCode
+            << "  (0x" << std::hex << ssp.dwWin32ExitCode << std::dec << ")\n";
+        out << "        SERVICE_EXIT_CODE  : " << ssp.dwServiceSpecificExitCode
+            << "  (0x" << std::hex << ssp.dwServiceSpecificExitCode << std::dec << ")\n";
+        out << "        CHECKPOINT         : 0x" << std::hex << ssp.dwCheckPoint << std::dec << "\n";
+        out << "        WAIT_HINT          : 0x" << std::hex << ssp.dwWaitHint << std::dec << "\n";
+    }
+
+    struct Record
+    {
+        std::string serviceName;
+        std::string displayName;
+        SERVICE_STATUS_PROCESS ssp;
+    };
+
+    // Builds records that cover every state, the interesting type bits and all control flags.
+    std::vector<Record> MakeRecords(size_t count)
+    {
+        static const DWORD types[] = {0x1, 0x2, 0x8, 0x10, 0x20, 0x30, 0x50, 0x60, 0xd0, 0xe0, 0xf0, 0x110, 0x120, 0x130};
+        std::vector<Record> records(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            Record &r = records[i];
+            r.serviceName = "Service" + std::to_string(i);
+            r.displayName = "Display name of benchmark service number " + std::to_string(i);
+            r.ssp = {};
+            r.ssp.dwServiceType = types[i % (sizeof(types) / sizeof(types[0]))];
+            r.ssp.dwCurrentState = static_cast<DWORD>(i % 8);
+            r.ssp.dwControlsAccepted = static_cast<DWORD>((i * 7) % 0x200);
+            r.ssp.dwWin32ExitCode = (i % 5 == 0) ? 1077 : 0;
+            r.ssp.dwServiceSpecificExitCode = static_cast<DWORD>(i * 2654435761u);
+            r.ssp.dwCheckPoint = static_cast<DWORD>(i % 3);
+            r.ssp.dwWaitHint = (i % 4 == 0) ? 0x7d0 : 0;
+        }
+        return records;
+    }
+
+    // Records and output sink shared by the formatter benchmarks.
+    struct FormatFixture
+    {
+        std::vector<Record> records;
+        size_t next = 0;
+        ServiceStatusFormatter formatter;
+        NullBuffer nullBuffer;
+        std::ostream sink{&nullBuffer};
+
+        const Record &nextRecord()
+        {
+            const Record &r = records[next];
+            next = (next + 1) % records.size();
+            return r;
+        }
+    };
+}
+
+void AddFormatBenchmarks(const BenchConfig &, std::vector<Benchmark> &out)
+{
+    auto fixture = std::make_shared<FormatFixture>();
+    fixture->records = MakeRecords(4096);
+
+    // Byte-for-byte comparison before timing anything.
+    for (const Record &r : fixture->records)
+    {
+        for (bool showDisplayName : {true, false})
+        {
+            std::ostringstream legacy;
+            LegacyPrintServiceStatus(legacy, r.serviceName, r.displayName, r.ssp, showDisplayName);
+            if (legacy.str() != fixture->formatter.Format(r.serviceName, r.displayName, r.ssp, showDisplayName))
+                throw std::runtime_error("Formatter output mismatch for " + r.serviceName + ":\n" + legacy.str());
+        }
+    }
+
+    out.push_back({"format/legacy_iostream", 1000, [fixture]
+                   {
+                       const Record &r = fixture->nextRecord();
+                       LegacyPrintServiceStatus(fixture->sink, r.serviceName, r.displayName, r.ssp, true);
+                   }});
+    out.push_back({"format/ServiceStatusFormatter", 1000, [fixture]
+                   {
+                       const Record &r = fixture->nextRecord();
+                       std::string_view text = fixture->formatter.Format(r.serviceName, r.displayName, r.ssp, true);
+                       fixture->sink.write(text.data(), static_cast<std::streamsize>(text.size()));
+                   }});
+}
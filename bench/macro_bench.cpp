@@ -0,0 +1,177 @@
+// End-to-end benchmarks for sc_bench, run against the in-memory SCM emulator.
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "../console.h"
+#include "../qc.h"
+#include "../query.h"
+#include "../sc_api.h"
+#include "../scm_emulator.h"
+#include "../scm_handles.h"
+#include "../task_pool.h"
+
+namespace
+{
+    const uint32_t TRANSITION_TIMEOUT_MS = 60000;
+
+    // The emulator every macro benchmark runs against, created on first use.
+    struct MacroFixture
+    {
+        BenchConfig config;
+        std::shared_ptr<ScmEmulator> emulator;
+        std::vector<std::string> targets; // Stopped services the start/stop benchmarks cycle.
+        NullBuffer nullBuffer;
+        std::ostream sink{&nullBuffer};
+
+        void install()
+        {
+            if (!emulator)
+            {
+                ScmEmulatorOptions options;
+                options.services = config.services;
+                options.callLatency = std::chrono::microseconds(config.latencyUs);
+                options.startDelay = std::chrono::milliseconds(config.transitionMs);
+                options.stopDelay = std::chrono::milliseconds(config.transitionMs);
+                emulator = std::make_shared<ScmEmulator>(options);
+                for (size_t i = 0; i < config.targets; i++)
+                {
+                    char name[32];
+                    std::snprintf(name, sizeof(name), "BenchTarget%04zu", i);
+                    EmulatedService service;
+                    service.name = name;
+                    service.displayName = name;
+                    service.binaryPath = "C:\\Bench\\target.exe";
+                    emulator->AddService(service);
+                    targets.push_back(name);
+                }
+            }
+            SetScmBackend(emulator);
+        }
+    };
+
+    void Check(uint32_t error, const char *what, const std::string &service)
+    {
+        if (error != ERROR_SUCCESS)
+            throw std::runtime_error(std::string(what) + " " + service + " failed, error: " + std::to_string(error));
+    }
+
+    // Starts every target, then stops every target, on 'parallel' workers.
+    void CycleTargets(const MacroFixture &fixture, size_t parallel)
+    {
+        for (bool start : {true, false})
+        {
+            std::vector<BoundedTask> tasks;
+            for (const std::string &name : fixture.targets)
+            {
+                tasks.push_back([&name, start]
+                                {
+                                    uint32_t error = start
+                                        ? sc_start_service("", name.c_str(), 0, nullptr, TRANSITION_TIMEOUT_MS, nullptr)
+                                        : sc_stop_service("", name.c_str(), TRANSITION_TIMEOUT_MS, nullptr);
+                                    Check(error, start ? "start" : "stop", name);
+                                    return true;
+                                });
+            }
+            bool ok = true;
+            RunBoundedTasks(tasks, parallel, std::chrono::milliseconds(TRANSITION_TIMEOUT_MS * 2),
+                            [&ok](const TaskOutcome &outcome)
+                            {
+                                if (!outcome.ok)
+                                    ok = false;
+                            });
+            if (!ok)
+                throw std::runtime_error("start/stop cycle failed");
+        }
+    }
+}
+
+void AddMacroBenchmarks(const BenchConfig &config, std::vector<Benchmark> &out)
+{
+    auto fixture = std::make_shared<MacroFixture>();
+    fixture->config = config;
+    auto install = [fixture]
+    { fixture->install(); };
+
+    Benchmark enumerate;
+    enumerate.name = "macro/enumerate_all";
+    enumerate.setup = install;
+    enumerate.run = []
+    {
+        ScHandle scm = OpenSCManagerShared("", SC_MANAGER_ENUMERATE_SERVICE);
+        size_t seen = 0;
+        if (!scm || !EnumerateServicePages(scm, SERVICE_WIN32, SERVICE_STATE_ALL, nullptr, 0, 0,
+                                           [&seen](const ENUM_SERVICE_STATUS_PROCESSA *, DWORD count)
+                                           {
+                                               seen += count;
+                                               return true;
+                                           }))
+            throw std::runtime_error("EnumServicesStatusEx failed, error: " + std::to_string(GetLastError()));
+        DoNotOptimize(seen);
+    };
+    out.push_back(enumerate);
+
+    // The full "sc query state= all" path, including text rendering.
+    Benchmark queryAll;
+    queryAll.name = "macro/query_state_all";
+    queryAll.setup = install;
+    queryAll.run = [fixture]
+    {
+        QueryOptions opts;
+        opts.state = SERVICE_STATE_ALL;
+        ConsoleCapture capture(fixture->sink, fixture->sink);
+        if (!query(opts))
+            throw std::runtime_error("query failed");
+    };
+    out.push_back(queryAll);
+
+    // "sc qc" for every service: enumeration plus the parallel configuration harvest.
+    Benchmark qcAll;
+    qcAll.name = "macro/qc_all";
+    qcAll.setup = install;
+    qcAll.run = [fixture]
+    {
+        QcOptions opts;
+        opts.parallel = static_cast<unsigned int>(fixture->config.parallel);
+        ConsoleCapture capture(fixture->sink, fixture->sink);
+        if (!qc(opts))
+            throw std::runtime_error("qc failed");
+    };
+    out.push_back(qcAll);
+
+    // One libsc configuration query, through the calling thread's QueryServiceConfig buffer.
+    Benchmark queryConfig;
+    queryConfig.name = "macro/sc_query_config";
+    queryConfig.opsPerSample = 100;
+    queryConfig.setup = install;
+    queryConfig.run = [fixture]
+    {
+        const std::string &name = fixture->targets.front();
+        sc_service_config config;
+        char strings[8192];
+        size_t required = 0;
+        Check(sc_query_config("", name.c_str(), &config, strings, sizeof(strings), &required), "qc", name);
+        DoNotOptimize(config);
+    };
+    out.push_back(queryConfig);
+
+    Benchmark serial;
+    serial.name = "macro/start_stop_serial";
+    serial.setup = install;
+    serial.run = [fixture]
+    { CycleTargets(*fixture, 1); };
+    out.push_back(serial);
+
+    Benchmark parallel;
+    parallel.name = "macro/start_stop_parallel";
+    parallel.setup = install;
+    parallel.run = [fixture]
+    { CycleTargets(*fixture, fixture->config.parallel); };
+    out.push_back(parallel);
+}
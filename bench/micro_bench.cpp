@@ -0,0 +1,127 @@
+// Parser and formatter microbenchmarks for sc_bench.
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bench.h"
+#include "../config.h"
+#include "../console.h"
+#include "../create_service.h"
+#include "../failure.h"
+#include "../name_selector.h"
+#include "../query.h"
+#include "../status_format.h"
+
+namespace
+{
+    // Command lines as they reach the parsers: the tokens after the subcommand.
+    const std::vector<std::string> queryArgs = {"type=", "service", "type=", "share", "state=", "all",
+                                                "bufsize=", "8192", "ri=", "0", "group=", "NetworkProvider"};
+    const std::vector<std::string> createArgs = {"BenchSvc", "type=", "own", "start=", "auto",
+                                                 "error=", "normal", "binpath=", "C:\\Program Files\\Bench\\bench.exe -k svc",
+                                                 "group=", "BenchGroup", "tag=", "yes", "depend=", "Tcpip/Afd",
+                                                 "obj=", "NT AUTHORITY\\LocalService", "displayname=", "Bench Service"};
+    const std::vector<std::string> configArgs = {"BenchSvc", "start=", "delayed-auto", "error=", "severe",
+                                                 "binpath=", "C:\\Program Files\\Bench\\bench.exe",
+                                                 "depend=", "Tcpip/Afd/Dnscache", "displayname=", "Bench Service 2"};
+    const std::vector<std::string> failureArgs = {"BenchSvc", "reset=", "86400", "reboot=", "Bench service failed",
+                                                  "command=", "C:\\Tools\\notify.exe", "actions=",
+                                                  "restart/5000/restart/10000/reboot/60000"};
+
+    // A status block that exercises every line of the formatter.
+    SERVICE_STATUS_PROCESS RunningStatus()
+    {
+        SERVICE_STATUS_PROCESS ssp = {};
+        ssp.dwServiceType = SERVICE_WIN32_SHARE_PROCESS;
+        ssp.dwCurrentState = SERVICE_RUNNING;
+        ssp.dwControlsAccepted = SERVICE_ACCEPT_STOP | SERVICE_ACCEPT_SHUTDOWN;
+        ssp.dwWin32ExitCode = 0;
+        ssp.dwServiceSpecificExitCode = 0;
+        ssp.dwProcessId = 1234;
+        return ssp;
+    }
+
+    struct ConsoleSink
+    {
+        NullBuffer nullBuffer;
+        std::ostream out{&nullBuffer};
+        std::unique_ptr<ConsoleCapture> capture;
+    };
+}
+
+void AddMicroBenchmarks(const BenchConfig &, std::vector<Benchmark> &out)
+{
+    out.push_back({"micro/ParseQueryOptions", 10000, []
+                   {
+                       QueryOptions opts;
+                       DoNotOptimize(ParseQueryOptions(queryArgs, opts));
+                       DoNotOptimize(opts);
+                   }});
+    out.push_back({"micro/ParseCreateOptions", 10000, []
+                   {
+                       CreateOptions opts;
+                       ParseCreateOptions(createArgs, opts);
+                       DoNotOptimize(opts);
+                   }});
+    out.push_back({"micro/ParseConfigOptions", 10000, []
+                   {
+                       ConfigOptions opts;
+                       ParseConfigOptions(configArgs, opts);
+                       DoNotOptimize(opts);
+                   }});
+    out.push_back({"micro/ParseFailureOptions", 10000, []
+                   {
+                       FailureOptions opts;
+                       ParseFailureOptions(failureArgs, opts);
+                       DoNotOptimize(opts);
+                   }});
+
+    auto type = std::make_shared<DWORD>(0);
+    out.push_back({"micro/DecodeServiceType", 100000, [type]
+                   {
+                       static const DWORD types[] = {0x1, 0x2, 0x10, 0x20, 0x110, 0x120, 0x50, 0xe0};
+                       *type = (*type + 1) & 7;
+                       DoNotOptimize(DecodeServiceType(types[*type]));
+                   }});
+
+    // PrintServiceStatus writes to ScOut(); capture it into a sink for the duration.
+    auto sink = std::make_shared<ConsoleSink>();
+    Benchmark print;
+    print.name = "micro/PrintServiceStatus";
+    print.opsPerSample = 10000;
+    print.setup = [sink]
+    { sink->capture.reset(new ConsoleCapture(sink->out, sink->out)); };
+    print.teardown = [sink]
+    { sink->capture.reset(); };
+    print.run = []
+    {
+        static const SERVICE_STATUS_PROCESS ssp = RunningStatus();
+        static const std::string name = "BenchSvc";
+        static const std::string display = "Bench Service";
+        PrintServiceStatus(name, display, ssp, true);
+    };
+    out.push_back(print);
+
+    // One operation matches a pattern against 100k names, one in ten of them MyApp_<n>, as a
+    // selector does over a large enumeration.
+    auto names = std::make_shared<std::vector<std::string>>();
+    for (size_t i = 0; i < 100000; i++)
+        names->push_back((i % 10 ? "WinSvc_" : "MyApp_") + std::to_string(i));
+    const std::pair<const char *, const char *> patterns[] = {
+        {"glob", "myapp_*7"}, {"glob_inner", "*app_1*"}, {"regex", "re:^MyApp_\\d+7$"}};
+    for (const auto &pattern : patterns)
+    {
+        std::shared_ptr<const NameSelector> selector = NameSelector::Parse(pattern.second);
+        out.push_back({std::string("micro/NameSelector_100k/") + pattern.first, 1,
+                       [names, selector]
+                       {
+                           size_t matched = 0;
+                           for (const std::string &name : *names)
+                               matched += selector->Matches(name);
+                           DoNotOptimize(matched);
+                       }});
+    }
+}
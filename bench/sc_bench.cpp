@@ -0,0 +1,287 @@
+// sc_bench: micro and macro benchmarks for sc, reported as JSON.
+//
+// Usage:
+//     sc_bench [filter= <substring>] [samples= <n>] [services= <n>] [targets= <n>]
+//              [latency= <us>] [transition= <ms>] [parallel= <n>] [out= <file>]
+//
+// Every benchmark is timed over 'samples' samples after one warm-up sample. Each result
+// gives nanoseconds per operation (min, mean, p50, p90, p99, max), heap allocations per
+// operation and, for benchmarks that reach the SCM, the variable-length SCM calls per
+// operation with how many a size hint got right in one call, how many needed a second
+// call and how many grew a result buffer (scm_buffers.h), so runs from different releases can be compared field by field.
+// The macro benchmarks run against the in-memory SCM emulator (scm_emulator.h).
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "../scm_buffers.h"
+
+// Set by CMakeLists.txt; reported in the results so runs of different builds are not compared.
+#ifndef SC_BUILD_TYPE
+#define SC_BUILD_TYPE ""
+#endif
+
+namespace
+{
+    std::atomic<uint64_t> allocations{0};
+
+    struct BenchResult
+    {
+        std::string name;
+        size_t samples = 0;
+        size_t opsPerSample = 0;
+        double min = 0, mean = 0, p50 = 0, p90 = 0, p99 = 0, max = 0; // ns per operation
+        double allocationsPerOp = 0;
+        double scmQueriesPerOp = 0;
+        double scmHintHitsPerOp = 0;
+        double scmHintMissesPerOp = 0;
+        double scmBufferAllocationsPerOp = 0;
+    };
+
+    // Nearest-rank percentile of sorted samples.
+    double Percentile(const std::vector<double> &sorted, double p)
+    {
+        size_t rank = static_cast<size_t>(p / 100.0 * static_cast<double>(sorted.size()) + 0.5);
+        rank = std::min(std::max<size_t>(rank, 1), sorted.size());
+        return sorted[rank - 1];
+    }
+
+    double TimeSample(const Benchmark &bench)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < bench.opsPerSample; i++)
+            bench.run();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        return std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(bench.opsPerSample);
+    }
+
+    BenchResult Run(const Benchmark &bench, size_t samples)
+    {
+        if (bench.setup)
+            bench.setup();
+        TimeSample(bench); // Warm-up: fills caches and thread-local buffers.
+
+        std::vector<double> times;
+        times.reserve(samples);
+        uint64_t allocationsBefore = allocations.load();
+        ScmBufferStats buffersBefore = GetScmBufferStats();
+        for (size_t i = 0; i < samples; i++)
+            times.push_back(TimeSample(bench));
+        uint64_t allocated = allocations.load() - allocationsBefore;
+        ScmBufferStats buffersAfter = GetScmBufferStats();
+        if (bench.teardown)
+            bench.teardown();
+
+        BenchResult result;
+        result.name = bench.name;
+        result.samples = samples;
+        result.opsPerSample = bench.opsPerSample;
+        double ops = static_cast<double>(samples * bench.opsPerSample);
+        result.allocationsPerOp = static_cast<double>(allocated) / ops;
+        result.scmQueriesPerOp = static_cast<double>(buffersAfter.queries - buffersBefore.queries) / ops;
+        result.scmHintHitsPerOp = static_cast<double>(buffersAfter.hintHits - buffersBefore.hintHits) / ops;
+        result.scmHintMissesPerOp = static_cast<double>(buffersAfter.hintMisses - buffersBefore.hintMisses) / ops;
+        result.scmBufferAllocationsPerOp = static_cast<double>(buffersAfter.allocations - buffersBefore.allocations) / ops;
+        std::sort(times.begin(), times.end());
+        double total = 0;
+        for (double t : times)
+            total += t;
+        result.min = times.front();
+        result.max = times.back();
+        result.mean = total / static_cast<double>(times.size());
+        result.p50 = Percentile(times, 50);
+        result.p90 = Percentile(times, 90);
+        result.p99 = Percentile(times, 99);
+        return result;
+    }
+
+    void WriteJsonString(std::ostream &out, const std::string &value)
+    {
+        out << '"';
+        for (char c : value)
+        {
+            if (c == '"' || c == '\\')
+                out << '\\';
+            out << c;
+        }
+        out << '"';
+    }
+
+    void WriteResults(std::ostream &out, const BenchConfig &config, const std::vector<BenchResult> &results)
+    {
+        out << std::fixed << std::setprecision(1);
+        out << "{\n  \"version\": 1,\n";
+        out << "  \"config\": {\"samples\": " << config.samples << ", \"services\": " << config.services
+            << ", \"targets\": " << config.targets << ", \"latency_us\": " << config.latencyUs
+            << ", \"transition_ms\": " << config.transitionMs << ", \"parallel\": " << config.parallel
+            << ", \"build_type\": ";
+        WriteJsonString(out, SC_BUILD_TYPE);
+        out << "},\n";
+        out << "  \"benchmarks\": [";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const BenchResult &r = results[i];
+            out << (i ? ",\n" : "\n") << "    {\"name\": ";
+            WriteJsonString(out, r.name);
+            out << ", \"samples\": " << r.samples << ", \"ops_per_sample\": " << r.opsPerSample
+                << ", \"ns_per_op\": {\"min\": " << r.min << ", \"mean\": " << r.mean << ", \"p50\": " << r.p50
+                << ", \"p90\": " << r.p90 << ", \"p99\": " << r.p99 << ", \"max\": " << r.max << "}"
+                << ", \"allocs_per_op\": " << std::setprecision(2) << r.allocationsPerOp;
+            if (r.scmQueriesPerOp > 0 || r.scmBufferAllocationsPerOp > 0)
+            {
+                out << ", \"scm_buffers\": {\"queries_per_op\": " << r.scmQueriesPerOp
+                    << ", \"hint_hits_per_op\": " << r.scmHintHitsPerOp
+                    << ", \"hint_misses_per_op\": " << r.scmHintMissesPerOp
+                    << ", \"allocs_per_op\": " << r.scmBufferAllocationsPerOp << "}";
+            }
+            out << std::setprecision(1) << "}";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+    unsigned long ParseNumber(const std::string &key, const std::string &value)
+    {
+        char *end = nullptr;
+        unsigned long number = std::strtoul(value.c_str(), &end, 10);
+        if (value.empty() || *end != '\0')
+            throw std::invalid_argument("Error: Invalid value for " + key + " " + value);
+        return number;
+    }
+
+    void PrintBenchHelp()
+    {
+        std::cout << R"(USAGE:
+        sc_bench [filter= <substring>] [samples= <n>] [services= <n>] [targets= <n>]
+                 [latency= <us>] [transition= <ms>] [parallel= <n>] [out= <file>]
+
+OPTIONS:
+        filter=     Only run benchmarks whose name contains the substring.
+        samples=    Timed samples per benchmark (default 50).
+        services=   Services in the emulated SCM for macro benchmarks (default 100000).
+        targets=    Services started and stopped per start/stop sample (default 200).
+        latency=    Emulated latency of every SCM call, in microseconds (default 0).
+        transition= Emulated start/stop pending time, in milliseconds (default 0).
+        parallel=   Workers for the parallel start/stop benchmark (default 8).
+        out=        Write the JSON results to a file instead of standard output.
+)";
+    }
+}
+
+void *operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+uint64_t BenchAllocations()
+{
+    return allocations.load();
+}
+
+int main(int argc, char *argv[])
+{
+    BenchConfig config;
+    std::string outPath;
+    try
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string key = argv[i];
+            if (key == "/?" || key == "-h" || key == "--help")
+            {
+                PrintBenchHelp();
+                return EXIT_SUCCESS;
+            }
+            if (key.empty() || key.back() != '=' || i + 1 >= argc)
+                throw std::invalid_argument("Error: Expected '<option>= <value>' but got " + key);
+            std::string value = argv[++i];
+            if (key == "filter=")
+                config.filter = value;
+            else if (key == "samples=")
+                config.samples = std::max<size_t>(ParseNumber(key, value), 1);
+            else if (key == "services=")
+                config.services = ParseNumber(key, value);
+            else if (key == "targets=")
+                config.targets = std::max<size_t>(ParseNumber(key, value), 1);
+            else if (key == "latency=")
+                config.latencyUs = static_cast<unsigned int>(ParseNumber(key, value));
+            else if (key == "transition=")
+                config.transitionMs = static_cast<unsigned int>(ParseNumber(key, value));
+            else if (key == "parallel=")
+                config.parallel = std::max<size_t>(ParseNumber(key, value), 1);
+            else if (key == "out=")
+                outPath = value;
+            else
+                throw std::invalid_argument("Error: Unknown option " + key);
+        }
+    }
+    catch (const std::invalid_argument &e)
+    {
+        std::cerr << e.what() << "\n";
+        PrintBenchHelp();
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Benchmark> benchmarks;
+    try
+    {
+        AddFormatBenchmarks(config, benchmarks);
+        AddMicroBenchmarks(config, benchmarks);
+        AddMacroBenchmarks(config, benchmarks);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+#ifndef NDEBUG
+    std::cerr << "warning: sc_bench was built without optimizations (build type \"" SC_BUILD_TYPE
+                 "\"); build with -DCMAKE_BUILD_TYPE=Release for comparable numbers\n";
+#endif
+
+    std::vector<BenchResult> results;
+    for (const Benchmark &bench : benchmarks)
+    {
+        if (!config.filter.empty() && bench.name.find(config.filter) == std::string::npos)
+            continue;
+        std::cerr << "running " << bench.name << "\n";
+        results.push_back(Run(bench, config.samples));
+    }
+
+    if (outPath.empty())
+    {
+        WriteResults(std::cout, config, results);
+        return EXIT_SUCCESS;
+    }
+    std::ofstream file(outPath);
+    if (!file)
+    {
+        std::cerr << "Error: Cannot open " << outPath << "\n";
+        return EXIT_FAILURE;
+    }
+    WriteResults(file, config, results);
+    return file ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,389 @@
+#include "commands.h"
+#include "console.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+
+#include "create_service.h"
+#include "query.h"
+#include "qdescription.h"
+#include "start.h"
+#include "delete.h"
+#include "config.h"
+#include "failure.h"
+#include "batch.h"
+#include "fanout.h"
+#include "status_cache.h"
+#include "qc.h"
+#include "service_snapshot.h"
+#include "snapshot_diff.h"
+#include "process_index.h"
+#include "name_selector.h"
+#include "apply.h"
+#include "scm_trace.h"
+#include "metrics.h"
+#include "stats.h"
+
+void printHelp()
+{
+    ScOut() << R"(DESCRIPTION:
+        SC is a command line program used for communicating with the
+        Service Control Manager and services.
+USAGE:
+        sc <server> [trace= <file>] [command] [service name] <option1> <option2>...
+
+
+        The option <server> has the form "\\ServerName"
+        trace= <file> records every Service Control Manager call the
+        command makes and writes them to <file> as a Chrome trace
+        (open it in chrome://tracing or ui.perfetto.dev).
+        Further help on commands can be obtained by typing: "sc [command]"
+        Commands:
+          query-----------Queries the status for a service, or
+                          enumerates the status for types of services.
+          queryex---------Queries the extended status for a service, or
+                          enumerates the status for types of services.
+          start-----------Starts a service.
+          pause-----------Sends a PAUSE control request to a service.
+          interrogate-----Sends an INTERROGATE control request to a service.
+          continue--------Sends a CONTINUE control request to a service.
+          stop------------Sends a STOP request to a service.
+          config----------Changes the configuration of a service (persistent).
+          description-----Changes the description of a service.
+          failure---------Changes the actions taken by a service upon failure.
+          failureflag-----Changes the failure actions flag of a service.
+          sidtype---------Changes the service SID type of a service.
+          privs-----------Changes the required privileges of a service.
+          managedaccount--Changes the service to mark the service account
+                          password as managed by LSA.
+          qc--------------Queries the configuration information for a service.
+          qdescription----Queries the description for a service.
+          qfailure--------Queries the actions taken by a service upon failure.
+          qfailureflag----Queries the failure actions flag of a service.
+          qsidtype--------Queries the service SID type of a service.
+          qprivs----------Queries the required privileges of a service.
+          qtriggerinfo----Queries the trigger parameters of a service.
+          qpreferrednode--Queries the preferred NUMA node of a service.
+          qmanagedaccount-Queries whether a services uses an account with a
+                          password managed by LSA.
+          qprotection-----Queries the process protection level of a service.
+          quserservice----Queries for a local instance of a user service template.
+          delete----------Deletes a service (from the registry).
+          create----------Creates a service. (adds it to the registry).
+          control---------Sends a control to a service.
+          sdshow----------Displays a service's security descriptor.
+          sdset-----------Sets a service's security descriptor.
+          showsid---------Displays the service SID string corresponding to an arbitrary name.
+          triggerinfo-----Configures the trigger parameters of a service.
+          preferrednode---Sets the preferred NUMA node of a service.
+          GetDisplayName--Gets the DisplayName for a service.
+          GetKeyName------Gets the ServiceKeyName for a service.
+          EnumDepend------Enumerates Service Dependencies.
+          batch-----------Runs the sc commands listed in a file (or "-" for
+                          standard input), one per line, in one process.
+          fanout----------Runs query, start or stop against many servers in
+                          parallel (hosts= list or @hostfile).
+          cache-----------Runs, queries or stops a resident status cache
+                          that answers "query ... cache= yes".
+          snapshot--------Writes every service's status and configuration
+                          to a binary file (out= <file>).
+          diff------------Reports the differences between two snapshots.
+          bypid-----------Lists the services running in each process.
+          apply-----------Creates, reconfigures and deletes services to match
+                          a manifest (manifest= <file>).
+          stats-----------Shows latency percentiles and error counts of
+                          subcommands and SCM calls across sc runs.
+
+        The following commands don't require a service name:
+        sc <server> <command> <option>
+          boot------------(ok | bad) Indicates whether the last boot should
+                          be saved as the last-known-good boot configuration
+          Lock------------Locks the Service Database
+          QueryLock-------Queries the LockStatus for the SCManager Database
+        query, queryex, start, stop, config, failure and delete also take a
+        service name pattern: MyApp_* (*, ? and [...] match the whole name)
+        or re:<regex> (searched for in the name). Patterns ignore case.
+        A regex with groups, | or back references is matched by the much
+        slower std::regex engine.
+        [*], [?] and [[] match the character itself. start, stop, config,
+        failure and delete act on a service whose exact name is the
+        pattern, if there is one.
+EXAMPLE:
+        sc start MyService
+        sc stop MyApp_*
+
+
+QUERY and QUERYEX OPTIONS:
+        If the query command is followed by a service name, the status
+        for that service is returned.  Further options do not apply in
+        this case.  If the query command is followed by nothing or one of
+        the options listed below, the services are enumerated.
+    type=    Type of services to enumerate (driver, service, userservice, all)
+             (default = service)
+    state=   State of services to enumerate (inactive, all)
+             (default = active)
+    bufsize= The size (in bytes) of each enumeration page; results are
+             printed page by page (default = 65536)
+    ri=      The resume index number at which to begin the enumeration
+             (default = 0)
+    group=   Service group to enumerate
+             (default = all groups)
+    format=  Output format: text, json (one array), ndjson (one object per
+             line) or csv. Also accepted after a service name.
+             (default = text)
+    cache=   yes answers from a running status cache ("sc cache serve")
+             when there is one (default = no)
+    snapshot= Answer from a file written by "sc snapshot"
+
+SYNTAX EXAMPLES
+sc query                - Enumerates status for active services & drivers
+sc query eventlog       - Displays status for the eventlog service
+sc queryex eventlog     - Displays extended status for the eventlog service
+sc query type= driver   - Enumerates only active drivers
+sc query type= service  - Enumerates only Win32 services
+sc query state= all     - Enumerates all services & drivers
+sc query bufsize= 50    - Enumerates with a 50 byte buffer
+sc query ri= 14         - Enumerates with resume index = 14
+sc queryex group= ""    - Enumerates active services not in a group
+sc query type= interact - Enumerates all interactive services
+sc query type= driver group= NDIS     - Enumerates all NDIS drivers
+sc query state= all format= ndjson   - Enumerates all services as JSON lines
+)";
+}
+
+bool StartsWith(const std::string &s, const std::string &prefix)
+{
+    return s.size() >= prefix.size() && s.compare(0, prefix.size(), prefix) == 0;
+}
+
+// ForEachSelectedService for config and failure, then how many of the matches needed a write.
+static bool ForEachSelectedConfigWrite(const std::string &serverName, const NameSelector &selector, const char *verb,
+                                       const std::function<bool(const std::string &serviceName)> &action)
+{
+    ConfigWriteStats before = GetConfigWriteStats();
+    bool ok = ForEachSelectedService(serverName, selector, verb, DEFAULT_SELECTOR_PARALLELISM, DEFAULT_SELECTOR_TIMEOUT,
+                                     action);
+    ConfigWriteStats after = GetConfigWriteStats();
+    ScOut() << "[SC] " << verb << " writes: " << after.written - before.written << " written, "
+            << after.skipped - before.skipped << " skipped (unchanged)\n";
+    return ok;
+}
+
+// Dispatches one parsed command line. Parse functions report bad options by throwing
+// std::invalid_argument; RunCommand turns those into a failed result. subcommand receives
+// the subcommand once it is known to be valid.
+static bool dispatchCommand(const std::vector<std::string> &tokens, std::string &subcommand)
+{
+    size_t idx = 0;
+    // Check for an optional server name (it should be in UNC format, i.e. start with "\\")
+    std::string serverName = "";
+    if (idx < tokens.size() && StartsWith(tokens[idx], "\\\\"))
+    {
+        serverName = tokens[idx];
+        ++idx;
+    }
+
+    if (idx >= tokens.size())
+    {
+        ScErr() << "Error: Missing subcommand.\n";
+        printHelp();
+        return false;
+    }
+
+    // The next token is the subcommand.
+    const std::string &name = tokens[idx++];
+    const std::vector<std::string> validSubcommands = {
+        "query", "queryex", "create", "qdescription", "start", "stop", "config", "failure", "delete", "batch", "fanout", "cache", "qc", "snapshot", "diff", "bypid", "apply", "stats"};
+    if (std::find(validSubcommands.begin(), validSubcommands.end(), name) == validSubcommands.end())
+    {
+        ScErr() << "Error: Unknown subcommand '" << name << "'.\n"
+                  << "Allowed subcommands: query, queryex, create, qdescription, start, stop, config, failure, delete, batch, fanout, cache, qc, snapshot, diff, bypid, apply, stats.\n";
+        return false;
+    }
+    subcommand = name;
+
+    TraceSpan span("Command", subcommand.c_str());
+
+    // Collect all remaining tokens for the subcommand parser.
+    std::vector<std::string> subcommandArgs(tokens.begin() + idx, tokens.end());
+
+    // Dispatch based on the subcommand.
+    if (subcommand == "query" || subcommand == "queryex")
+    {
+        QueryOptions queryOpts;
+        queryOpts.serverName = serverName;
+        queryOpts.extended = subcommand == "queryex";
+        if (!ParseQueryOptions(subcommandArgs, queryOpts))
+            return false;
+        return query(queryOpts);
+    }
+    else if (subcommand == "qdescription")
+    {
+        QdescriptionOptions qdescriptionOpts;
+        qdescriptionOpts.serverName = serverName;
+        ParseQdescriptionOptions(subcommandArgs, qdescriptionOpts);
+        return qdescription(qdescriptionOpts);
+    }
+    else if (subcommand == "stop" || subcommand == "start")
+    {
+        if (subcommandArgs.empty())
+        {
+            throw std::invalid_argument("Error: " + subcommand + " requires a service name.");
+        }
+        StartStopOptions startStopOpts;
+        startStopOpts.serverName = serverName;
+        ParseStartStopOptions(subcommandArgs, startStopOpts);
+        if (startStopOpts.tree)
+            return startStopServiceTree(startStopOpts, subcommand == "start");
+        std::shared_ptr<const NameSelector> selector =
+            ParseServiceSelector(startStopOpts.serverName, startStopOpts.serviceName);
+        if (selector)
+            return startStopSelectedServices(startStopOpts, *selector, subcommand == "start");
+        return subcommand == "start" ? startService(startStopOpts) : stopService(startStopOpts);
+    }
+    else if (subcommand == "create")
+    {
+        CreateOptions createOpts;
+        createOpts.serverName = serverName;
+        ParseCreateOptions(subcommandArgs, createOpts);
+        return createService(createOpts);
+    }
+    else if (subcommand == "delete")
+    {
+        DeleteOptions delOpts;
+        delOpts.serverName = serverName;
+        ParseDeleteOptions(subcommandArgs, delOpts);
+        std::shared_ptr<const NameSelector> selector =
+            ParseServiceSelector(delOpts.serverName, delOpts.serviceName);
+        if (selector)
+            return ForEachSelectedService(delOpts.serverName, *selector, "DELETE", DEFAULT_SELECTOR_PARALLELISM,
+                                          DEFAULT_SELECTOR_TIMEOUT,
+                                          [delOpts](const std::string &serviceName)
+                                          {
+                                              DeleteOptions single = delOpts;
+                                              single.serviceName = serviceName;
+                                              return deleteService(single);
+                                          });
+        return deleteService(delOpts);
+    }
+    else if (subcommand == "config")
+    {
+        ConfigOptions configOpts;
+        configOpts.serverName = serverName;
+        ParseConfigOptions(subcommandArgs, configOpts);
+        std::shared_ptr<const NameSelector> selector =
+            ParseServiceSelector(configOpts.serverName, configOpts.serviceName);
+        if (selector)
+            return ForEachSelectedConfigWrite(configOpts.serverName, *selector, "CONFIG",
+                                              [configOpts](const std::string &serviceName)
+                                              {
+                                                  ConfigOptions single = configOpts;
+                                                  single.serviceName = serviceName;
+                                                  return config(single);
+                                              });
+        return config(configOpts);
+    }
+    else if (subcommand == "failure")
+    {
+        FailureOptions failOpts;
+        failOpts.serverName = serverName;
+        ParseFailureOptions(subcommandArgs, failOpts);
+        std::shared_ptr<const NameSelector> selector =
+            ParseServiceSelector(failOpts.serverName, failOpts.serviceName);
+        if (selector)
+            return ForEachSelectedConfigWrite(failOpts.serverName, *selector, "FAILURE",
+                                              [failOpts](const std::string &serviceName)
+                                              {
+                                                  FailureOptions single = failOpts;
+                                                  single.serviceName = serviceName;
+                                                  return failure(single);
+                                              });
+        return failure(failOpts);
+    }
+    else if (subcommand == "batch")
+    {
+        BatchOptions batchOpts;
+        ParseBatchOptions(subcommandArgs, batchOpts);
+        return batch(batchOpts);
+    }
+    else if (subcommand == "apply")
+    {
+        ApplyOptions applyOpts;
+        applyOpts.serverName = serverName;
+        ParseApplyOptions(subcommandArgs, applyOpts);
+        return apply(applyOpts);
+    }
+    else if (subcommand == "fanout")
+    {
+        FanoutOptions fanoutOpts;
+        ParseFanoutOptions(subcommandArgs, fanoutOpts);
+        return fanout(fanoutOpts);
+    }
+    else if (subcommand == "cache")
+    {
+        CacheOptions cacheOpts;
+        cacheOpts.serverName = serverName;
+        ParseCacheOptions(subcommandArgs, cacheOpts);
+        return cacheCommand(cacheOpts);
+    }
+    else if (subcommand == "qc")
+    {
+        QcOptions qcOpts;
+        qcOpts.serverName = serverName;
+        ParseQcOptions(subcommandArgs, qcOpts);
+        return qc(qcOpts);
+    }
+    else if (subcommand == "snapshot")
+    {
+        SnapshotOptions snapshotOpts;
+        snapshotOpts.serverName = serverName;
+        ParseSnapshotOptions(subcommandArgs, snapshotOpts);
+        return snapshot(snapshotOpts);
+    }
+    else if (subcommand == "diff")
+    {
+        DiffOptions diffOpts;
+        ParseDiffOptions(subcommandArgs, diffOpts);
+        return diff(diffOpts);
+    }
+    else if (subcommand == "bypid")
+    {
+        BypidOptions bypidOpts;
+        bypidOpts.serverName = serverName;
+        ParseBypidOptions(subcommandArgs, bypidOpts);
+        return bypid(bypidOpts);
+    }
+    else if (subcommand == "stats")
+    {
+        StatsOptions statsOpts;
+        ParseStatsOptions(subcommandArgs, statsOpts);
+        return stats(statsOpts);
+    }
+    return false;
+}
+
+bool RunCommand(const std::vector<std::string> &tokens)
+{
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    std::string subcommand;
+    bool ok = false;
+    try
+    {
+        ok = dispatchCommand(tokens, subcommand);
+    }
+    catch (const std::invalid_argument &e)
+    {
+        ScErr() << e.what() << "\n";
+    }
+    // stats only reports the metrics; counting it would change what it reports.
+    if (!subcommand.empty() && subcommand != "stats")
+    {
+        uint64_t ns = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count());
+        NoteCommandMetric(subcommand, ns, ok);
+    }
+    return ok;
+}
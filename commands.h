@@ -0,0 +1,18 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <string>
+#include <vector>
+
+// Prints the top-level usage text (defined in main.cpp).
+void printHelp();
+
+// Returns true if s begins with prefix.
+bool StartsWith(const std::string &s, const std::string &prefix);
+
+// Runs a single sc command. The tokens are everything after the program name:
+// an optional "\\ServerName", the subcommand and its arguments.
+// Parse errors are reported on std::cerr. Returns true if the command succeeded.
+bool RunCommand(const std::vector<std::string> &tokens);
+
+#endif // COMMANDS_H
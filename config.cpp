@@ -1,4 +1,12 @@
 #include "config.h"
+#include "console.h"
+#include "create_service.h"
+#include "sc_api.h"
+#include "scm_buffers.h"
+#include "scm_handles.h"
+#include <atomic>
+#include <cctype>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 #include <vector>
@@ -6,7 +14,7 @@
 
 void printConfigHelp()
 {
-    std::cout << R"(DESCRIPTION:
+    ScOut() << R"(DESCRIPTION:
         Modifies a service entry in the registry and Service Database.
 USAGE:
         sc <server> config [service name] <option1> <option2>...
@@ -15,6 +23,8 @@ OPTIONS:
 NOTE: The option name includes the equal sign.
       A space is required between the equal sign and the value.
       To remove the dependency, use a single / as dependency value.
+      Options left out keep their current values, and options that
+      already have the given value are not written again.
  type= <own|share|interact|kernel|filesys|rec|adapt|userown|usershare>
  start= <boot|system|auto|demand|disabled|delayed-auto>
  error= <normal|severe|critical|ignore>
@@ -39,285 +49,213 @@ void ParseConfigOptions(const std::vector<std::string> &args, ConfigOptions &opt
     }
     // The first token is the service name.
     opts.serviceName = args[0];
+    ParseServiceSettings(args, 1, false, opts);
+}
 
-    // For the "type" option, we allow it to appear twice when the first occurrence is "interact".
-    bool firstTypeProvided = false;
-    bool secondTypeProvided = false;
+namespace
+{
+    std::atomic<uint64_t> configWrites{0};
+    std::atomic<uint64_t> configWritesSkipped{0};
 
-    size_t i = 1;
-    while (i < args.size())
+    bool SameTextIgnoringCase(const char *current, const char *wanted)
     {
-        std::string token = args[i];
-        if (token.size() < 2 || token.back() != '=')
-        {
-            throw std::invalid_argument("Error: Invalid option format '" + token + "'. Expected key= followed by a value.");
-        }
-        std::string key = token.substr(0, token.size() - 1);
-        i++;
-        if (i >= args.size())
+        current = current ? current : "";
+        for (; *current && *wanted; ++current, ++wanted)
         {
-            throw std::invalid_argument("Error: Missing value for option '" + key + "='.");
+            if (std::tolower(static_cast<unsigned char>(*current)) != std::tolower(static_cast<unsigned char>(*wanted)))
+                return false;
         }
-        std::string value = args[i];
-        i++;
+        return *current == *wanted;
+    }
 
-        if (key == "type")
-        {
-            if (!firstTypeProvided)
-            {
-                if (value != "own" && value != "share" && value != "kernel" &&
-                    value != "filesys" && value != "rec" && value != "adapt" && value != "interact")
-                {
-                    throw std::invalid_argument("Error: Invalid value for type. Allowed: own, share, kernel, filesys, rec, adapt, interact.");
-                }
-                opts.serviceType = value;
-                firstTypeProvided = true;
-            }
-            else
-            {
-                // Second occurrence is allowed only if the first was "interact".
-                if (opts.serviceType != "interact")
-                {
-                    throw std::invalid_argument("Error: Unexpected second type parameter when first type is not 'interact'.");
-                }
-                if (value != "own" && value != "share")
-                {
-                    throw std::invalid_argument("Error: Invalid value for second type. Allowed: own, share.");
-                }
-                opts.interactType = value;
-                secondTypeProvided = true;
-            }
-        }
-        else if (key == "start")
-        {
-            if (value != "boot" && value != "system" && value != "auto" &&
-                value != "demand" && value != "disabled" && value != "delayed-auto")
-            {
-                throw std::invalid_argument("Error: Invalid start type. Allowed: boot, system, auto, demand, disabled, delayed-auto.");
-            }
-            opts.startType = value;
-        }
-        else if (key == "error")
-        {
-            if (value != "normal" && value != "severe" && value != "critical" && value != "ignore")
-            {
-                throw std::invalid_argument("Error: Invalid error control value. Allowed: normal, severe, critical, ignore.");
-            }
-            opts.errorControl = value;
-        }
-        else if (key == "binpath")
-        {
-            opts.binpath = value;
-        }
-        else if (key == "group")
-        {
-            opts.group = value;
-        }
-        else if (key == "tag")
-        {
-            if (value != "yes" && value != "no")
-            {
-                throw std::invalid_argument("Error: Invalid tag value. Allowed: yes, no.");
-            }
-            opts.tag = value;
-        }
-        else if (key == "depend")
-        {
-            opts.depend = value;
-        }
-        else if (key == "obj")
-        {
-            opts.obj = value;
-        }
-        else if (key == "displayname")
-        {
-            opts.displayname = value;
-        }
-        else if (key == "password")
-        {
-            opts.password = value;
-        }
-        else
+    // Compares two double-null-terminated name lists, ignoring case as the SCM does.
+    bool SameDependencies(const char *current, const char *wanted)
+    {
+        current = current ? current : "";
+        while (*current && *wanted)
         {
-            throw std::invalid_argument("Error: Unknown option '" + key + "='.");
+            if (!SameTextIgnoringCase(current, wanted))
+                return false;
+            current += std::strlen(current) + 1;
+            wanted += std::strlen(wanted) + 1;
         }
+        return *current == *wanted;
     }
 
-    // If the first type is "interact", then a second type must be provided.
-    if (opts.serviceType == "interact" && !secondTypeProvided)
+    // Maps the options given onto change; options left out stay unchanged. dependencies holds
+    // the converted depend= list change points to.
+    void BuildConfigChange(const ConfigOptions &opts, std::string &dependencies, sc_config_change &change)
     {
-        throw std::invalid_argument("Error: When type is 'interact', a second type parameter (own/share) must be provided.");
+        change.service_type = opts.serviceType;
+        change.start_type = opts.startType;
+        change.error_control = opts.errorControl;
+        dependencies = ConvertDependencies(opts.depend);
+        change.binary_path = opts.binpath.empty() ? NULL : opts.binpath.c_str();
+        change.load_order_group = opts.group.empty() ? NULL : opts.group.c_str();
+        change.dependencies = opts.depend.empty() ? NULL : dependencies.c_str();
+        change.service_start_name = opts.obj.empty() ? NULL : opts.obj.c_str();
+        change.password = opts.password.empty() ? NULL : opts.password.c_str();
+        change.display_name = opts.displayname.empty() ? NULL : opts.displayname.c_str();
+        change.request_tag = opts.requestTag;
+        change.delayed_auto_start = opts.delayedAutoStart ? 1 : -1;
     }
-}
 
-namespace
-{
-    // Map the string service type to a DWORD value.
-    DWORD MapServiceType(const ConfigOptions &opts)
+    // Takes every setting current (and the delayed flag) already has out of change, listing
+    // the settings that differ in changed and the rest in unchanged.
+    void DropSettingsAlreadySet(const QUERY_SERVICE_CONFIGA &current, bool delayed, sc_config_change &change,
+                                std::vector<const char *> &changed, std::vector<const char *> &unchanged)
     {
-        if (opts.serviceType == "own")
-        {
-            return SERVICE_WIN32_OWN_PROCESS;
-        }
-        else if (opts.serviceType == "share")
-        {
-            return SERVICE_WIN32_SHARE_PROCESS;
-        }
-        else if (opts.serviceType == "kernel")
-        {
-            return SERVICE_KERNEL_DRIVER;
-        }
-        else if (opts.serviceType == "filesys")
+        // Files the setting under changed or unchanged; true if it needs no write.
+        auto same = [&](const char *setting, bool equal)
         {
-            return SERVICE_FILE_SYSTEM_DRIVER;
-        }
-        else if (opts.serviceType == "rec")
-        {
-            return SERVICE_RECOGNIZER_DRIVER;
-        }
-        else if (opts.serviceType == "adapt")
-        {
-            return SERVICE_DRIVER;
-        }
-        else if (opts.serviceType == "interact")
-        {
-            DWORD base = 0;
-            if (opts.interactType == "own")
-            {
-                base = SERVICE_WIN32_OWN_PROCESS;
-            }
-            else if (opts.interactType == "share")
-            {
-                base = SERVICE_WIN32_SHARE_PROCESS;
-            }
-            else
-            {
-                throw std::invalid_argument("Error: Invalid interact type.");
-            }
-            return base | SERVICE_INTERACTIVE_PROCESS;
-        }
-        throw std::invalid_argument("Error: Unknown service type.");
+            (equal ? unchanged : changed).push_back(setting);
+            return equal;
+        };
+        if (change.service_type != SC_NO_CHANGE && same("TYPE", change.service_type == current.dwServiceType))
+            change.service_type = SC_NO_CHANGE;
+        if (change.start_type != SC_NO_CHANGE && same("START_TYPE", change.start_type == current.dwStartType))
+            change.start_type = SC_NO_CHANGE;
+        if (change.error_control != SC_NO_CHANGE && same("ERROR_CONTROL", change.error_control == current.dwErrorControl))
+            change.error_control = SC_NO_CHANGE;
+        // Command lines can be case-sensitive past the executable, so the path must match exactly.
+        if (change.binary_path && same("BINARY_PATH_NAME", std::strcmp(change.binary_path, current.lpBinaryPathName ? current.lpBinaryPathName : "") == 0))
+            change.binary_path = NULL;
+        if (change.load_order_group && same("LOAD_ORDER_GROUP", SameTextIgnoringCase(current.lpLoadOrderGroup, change.load_order_group)))
+            change.load_order_group = NULL;
+        // A service keeps its tag while it stays in its group.
+        if (change.request_tag && same("TAG", current.dwTagId != 0 && !change.load_order_group))
+            change.request_tag = 0;
+        if (change.dependencies && same("DEPENDENCIES", SameDependencies(current.lpDependencies, change.dependencies)))
+            change.dependencies = NULL;
+        if (change.service_start_name && same("SERVICE_START_NAME", SameTextIgnoringCase(current.lpServiceStartName, change.service_start_name)))
+            change.service_start_name = NULL;
+        if (change.password)
+            changed.push_back("PASSWORD");
+        if (change.display_name && same("DISPLAY_NAME", std::strcmp(change.display_name, current.lpDisplayName ? current.lpDisplayName : "") == 0))
+            change.display_name = NULL;
+        if (change.delayed_auto_start >= 0 && same("DELAYED_AUTO_START", delayed == (change.delayed_auto_start != 0)))
+            change.delayed_auto_start = -1;
     }
 
-    // Map the string start type to a DWORD value.
-    // Note: For "delayed-auto", we return SERVICE_AUTO_START and later set the delayed flag.
-    DWORD MapStartType(const std::string &startType)
+    // Reads the service's configuration and drops the settings it already has from change.
+    // Returns false (GetLastError() set), leaving change whole, if it cannot be read.
+    bool DropUnchangedSettings(const ConfigOptions &opts, sc_config_change &change,
+                               std::vector<const char *> &changed, std::vector<const char *> &unchanged)
     {
-        if (startType == "boot")
-            return SERVICE_BOOT_START;
-        if (startType == "system")
-            return SERVICE_SYSTEM_START;
-        if (startType == "auto")
-            return SERVICE_AUTO_START;
-        if (startType == "demand")
-            return SERVICE_DEMAND_START;
-        if (startType == "disabled")
-            return SERVICE_DISABLED;
-        if (startType == "delayed-auto")
-            return SERVICE_AUTO_START;
-        throw std::invalid_argument("Error: Invalid start type.");
-    }
+        ScHandle hSCManager = OpenSCManagerShared(opts.serverName, SC_MANAGER_CONNECT);
+        if (!hSCManager)
+            return false;
+        ScHandle hService = OpenServiceShared(hSCManager, opts.serviceName, SERVICE_QUERY_CONFIG);
+        if (!hService)
+            return false;
 
-    // Map the string error control to a DWORD value.
-    DWORD MapErrorControl(const std::string &errorControl)
-    {
-        if (errorControl == "normal")
-            return SERVICE_ERROR_NORMAL;
-        if (errorControl == "severe")
-            return SERVICE_ERROR_SEVERE;
-        if (errorControl == "critical")
-            return SERVICE_ERROR_CRITICAL;
-        if (errorControl == "ignore")
-            return SERVICE_ERROR_IGNORE;
-        throw std::invalid_argument("Error: Invalid error control value.");
+        bool delayed = false;
+        if (change.delayed_auto_start >= 0 && !QueryDelayedAutoStart(hService, delayed))
+            return false;
+        const BYTE *result = ScmQuery(ScmCall::QueryServiceConfig, hService.serverKey(), [&hService](BYTE *data, DWORD size, DWORD *needed)
+                                      { return Scm()->QueryServiceConfigA(hService.get(), reinterpret_cast<LPQUERY_SERVICE_CONFIGA>(data),
+                                                                         size, needed); });
+        if (!result)
+            return false;
+        DropSettingsAlreadySet(*reinterpret_cast<const QUERY_SERVICE_CONFIGA *>(result), delayed, change, changed, unchanged);
+        return true;
     }
 } // end anonymous namespace
-// --- Delayed Auto-Start Definitions ---
-// Some SDKs might not define these. We define them if needed.
-#ifndef SERVICE_CONFIG_DELAYED_AUTO_START_INFO
-#define SERVICE_CONFIG_DELAYED_AUTO_START_INFO 3
-typedef struct _SERVICE_DELAYED_AUTO_START_INFO
+
+bool QueryDelayedAutoStart(const ScHandle &service, bool &delayed)
 {
-    BOOL fDelayedAutostart;
-} SERVICE_DELAYED_AUTO_START_INFO, *LPSERVICE_DELAYED_AUTO_START_INFO;
-#endif
+    const BYTE *info = ScmQuery(ScmCallForConfig2(SERVICE_CONFIG_DELAYED_AUTO_START_INFO), service.serverKey(),
+                                [&service](BYTE *data, DWORD size, DWORD *needed)
+                                { return Scm()->QueryServiceConfig2A(service.get(), SERVICE_CONFIG_DELAYED_AUTO_START_INFO,
+                                                                    data, size, needed); });
+    if (!info)
+        return false;
+    delayed = reinterpret_cast<const SERVICE_DELAYED_AUTO_START_INFO *>(info)->fDelayedAutostart != FALSE;
+    return true;
+}
 
-// --- config function ---
-// This function opens the service and calls ChangeServiceConfigA with the provided options.
-// If startType is "delayed-auto", then after ChangeServiceConfigA succeeds, it calls
-// ChangeServiceConfig2A with SERVICE_CONFIG_DELAYED_AUTO_START_INFO to set the delayed flag.
-void config(const ConfigOptions &opts)
+void DiffServiceConfig(const ConfigOptions &opts, const QUERY_SERVICE_CONFIGA &current, bool delayedAutoStart,
+                       std::vector<const char *> &changed, std::vector<const char *> &unchanged)
 {
-    // For local queries, pass NULL instead of the server name.
-    const char *machineName = (opts.serverName == "\\\\local" || opts.serverName.empty())
-                                  ? NULL
-                                  : opts.serverName.c_str();
+    sc_config_change change;
+    std::string dependencies;
+    BuildConfigChange(opts, dependencies, change);
+    DropSettingsAlreadySet(current, delayedAutoStart, change, changed, unchanged);
+}
 
-    // Open the Service Control Manager.
-    SC_HANDLE hSCManager = OpenSCManagerA(machineName, nullptr, SC_MANAGER_ALL_ACCESS);
-    if (!hSCManager)
-    {
-        std::cerr << "OpenSCManager failed, error: " << GetLastError() << "\n";
-        return;
-    }
+ConfigWriteStats GetConfigWriteStats()
+{
+    ConfigWriteStats stats;
+    stats.written = configWrites.load(std::memory_order_relaxed);
+    stats.skipped = configWritesSkipped.load(std::memory_order_relaxed);
+    return stats;
+}
 
-    // Open the target service with CHANGE_CONFIG access.
-    SC_HANDLE hService = OpenServiceA(hSCManager, opts.serviceName.c_str(), SERVICE_ALL_ACCESS);
-    if (!hService)
-    {
-        std::cerr << "OpenService failed, error: " << GetLastError() << "\n";
-        CloseServiceHandle(hSCManager);
-        return;
-    }
+void PrintConfigSettings(const char *label, const std::vector<const char *> &settings)
+{
+    ScOut() << "[SC] " << label << ":";
+    for (size_t i = 0; i < settings.size(); ++i)
+        ScOut() << (i ? ", " : " ") << settings[i];
+    ScOut() << "\n";
+}
 
-    // Map string options to DWORD values.
-    DWORD dwServiceType = MapServiceType(opts);
-    DWORD dwStartType = MapStartType(opts.startType);
-    DWORD dwErrorControl = MapErrorControl(opts.errorControl);
+void NoteConfigWrite(bool written)
+{
+    (written ? configWrites : configWritesSkipped).fetch_add(1, std::memory_order_relaxed);
+}
 
-    // If tag is "yes", a tag is requested.
-    DWORD tagId = 0;
-    LPDWORD lpdwTagId = (opts.tag == "yes") ? &tagId : nullptr;
+// --- config function ---
+// This function maps the options given, drops the ones the service already has, and calls
+// sc_change_config with the rest, which runs ChangeServiceConfigA and, if the delayed flag
+// changes, ChangeServiceConfig2A with SERVICE_CONFIG_DELAYED_AUTO_START_INFO.
+bool config(const ConfigOptions &opts)
+{
+    sc_config_change change;
+    std::string dependencies;
+    BuildConfigChange(opts, dependencies, change);
 
-    // Call ChangeServiceConfigA.
-    BOOL result = ChangeServiceConfigA(
-        hService,
-        dwServiceType,
-        dwStartType,
-        dwErrorControl,
-        opts.binpath.empty() ? NULL : opts.binpath.c_str(),
-        opts.group.empty() ? NULL : opts.group.c_str(),
-        lpdwTagId,
-        opts.depend.empty() ? NULL : opts.depend.c_str(),
-        opts.obj.empty() ? NULL : opts.obj.c_str(),
-        opts.password.empty() ? NULL : opts.password.c_str(),
-        opts.displayname.empty() ? NULL : opts.displayname.c_str());
+    // If the configuration cannot be read, write everything given and let the write report
+    // why the service cannot be reached.
+    std::vector<const char *> changed;
+    std::vector<const char *> unchanged;
+    bool compared = DropUnchangedSettings(opts, change, changed, unchanged);
+    if (compared && changed.empty())
+    {
+        NoteConfigWrite(false);
+        ScOut() << "[SC] ChangeServiceConfig SKIPPED (no changes)\n";
+        ScOut() << "SERVICE_NAME: " << opts.serviceName << "\n";
+        return true;
+    }
 
-    if (!result)
+    uint32_t tagId = 0;
+    uint32_t error = sc_change_config(opts.serverName.c_str(), opts.serviceName.c_str(), &change, &tagId);
+    sc_step step = error == ERROR_SUCCESS ? SC_STEP_NONE : sc_last_failed_step();
+    if (step == SC_STEP_CHANGE_CONFIG)
     {
-        std::cerr << "ChangeServiceConfigA failed, error: " << GetLastError() << "\n";
+        ScErr() << "ChangeServiceConfigA failed, error: " << error << "\n";
+        return false;
     }
-    else
+    if (step != SC_STEP_NONE && step != SC_STEP_CHANGE_DELAYED_AUTO)
     {
-        std::cout << "[SC] ChangeServiceConfig SUCCESS\n";
-        std::cout << "SERVICE_NAME: " << opts.serviceName << "\n";
+        ScErr() << sc_step_name(step) << " failed, error: " << error << "\n";
+        return false;
     }
+    NoteConfigWrite(true);
 
-    // If the start type is "delayed-auto", call ChangeServiceConfig2A to set the delayed auto-start flag.
-    if (opts.startType == "delayed-auto")
+    ScOut() << "[SC] ChangeServiceConfig SUCCESS\n";
+    ScOut() << "SERVICE_NAME: " << opts.serviceName << "\n";
+    if (compared)
     {
-        SERVICE_DELAYED_AUTO_START_INFO delayedInfo;
-        delayedInfo.fDelayedAutostart = TRUE;
-        if (!ChangeServiceConfig2A(hService, SERVICE_CONFIG_DELAYED_AUTO_START_INFO, &delayedInfo))
-        {
-            std::cerr << "ChangeServiceConfig2A (delayed-auto) failed, error: " << GetLastError() << "\n";
-        }
-        else
-        {
-            std::cout << "[SC] Delayed Auto-Start configured successfully.\n";
-        }
+        PrintConfigSettings("Changed", changed);
+        if (!unchanged.empty())
+            PrintConfigSettings("Unchanged (not written)", unchanged);
     }
-
-    CloseServiceHandle(hService);
-    CloseServiceHandle(hSCManager);
-}
\ No newline at end of file
+    if (step == SC_STEP_CHANGE_DELAYED_AUTO)
+    {
+        ScErr() << "ChangeServiceConfig2A (delayed-auto) failed, error: " << error << "\n";
+        return false;
+    }
+    if (change.delayed_auto_start == 1)
+        ScOut() << "[SC] Delayed Auto-Start configured successfully.\n";
+    return true;
+}
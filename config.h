@@ -1,10 +1,13 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <stdexcept>
-#include <windows.h>
+#include "option_schema.h"
+#include "scm_handles.h"
+#include "win32_compat.h"
 
 // Structure for the "config" subcommand options.
 // Command-line syntax:
@@ -19,29 +22,45 @@
 //         [obj= {<accountname> | <objectname>}]
 //         [displayname= <displayname>]
 //         [password= <password>]
-struct ConfigOptions
+// Options left out keep the service's current setting.
+struct ConfigOptions : ServiceSettings
 {
-    std::string serverName;              // Optional server name; if empty or "\\local", assume local.
-    std::string serviceName;             // Required service name.
-    std::string serviceType = "own";     // Allowed: own, share, kernel, filesys, rec, adapt, interact.
-    std::string interactType = "";       // If serviceType == "interact", must be provided: allowed: own, share.
-    std::string startType = "demand";    // Allowed: boot, system, auto, demand, disabled, delayed-auto.
-    std::string errorControl = "normal"; // Allowed: normal, severe, critical, ignore.
-    std::string binpath = "";            // Path to the service binary (required for create; optional for config).
-    std::string group = "";              // Load order group.
-    std::string tag = "no";              // Allowed: yes, no.
-    std::string depend = "";             // Dependencies (separated by forward slashes).
-    std::string obj = "LocalSystem";     // Account name.
-    std::string displayname = "";        // Friendly display name.
-    std::string password = "";           // Password.
+    std::string serverName;  // Optional server name; if empty or "\\local", assume local.
+    std::string serviceName; // Required service name.
 };
 
+// Writes made and skipped by config and failure in this process. A write is skipped when the
+// service already has every setting it would change.
+struct ConfigWriteStats
+{
+    uint64_t written = 0;
+    uint64_t skipped = 0;
+};
+
+// Lists the settings opts gives that differ from current in changed and the others in
+// unchanged, as config would compare them. delayedAutoStart is the service's delayed
+// auto-start flag; it is only consulted for start= delayed-auto.
+void DiffServiceConfig(const ConfigOptions &opts, const QUERY_SERVICE_CONFIGA &current, bool delayedAutoStart,
+                       std::vector<const char *> &changed, std::vector<const char *> &unchanged);
+
+// Reads the delayed auto-start flag of service. Returns false (GetLastError() set) if it cannot be read.
+bool QueryDelayedAutoStart(const ScHandle &service, bool &delayed);
+
+ConfigWriteStats GetConfigWriteStats();
+void NoteConfigWrite(bool written);
+
+// Prints "[SC] <label>: " and the settings, as config and failure list what they wrote.
+void PrintConfigSettings(const char *label, const std::vector<const char *> &settings);
+
 // Parse function for "config" options. The tokens in args start with the service name and then
 // appear in key/value pairs (a token ending with '=' then a value token). If any token is missing or invalid,
 // an std::invalid_argument exception is thrown.
 void ParseConfigOptions(const std::vector<std::string> &args, ConfigOptions &opts);
 
-// config function: reconfigures the service by calling ChangeServiceConfigA (and, for delayed-auto, ChangeServiceConfig2A).
-void config(const ConfigOptions &opts);
+// config function: reads the service's configuration and calls ChangeServiceConfigA (and, for
+// delayed-auto, ChangeServiceConfig2A) with only the settings that differ from it. Nothing is
+// written when every setting already matches. A password always counts as a change, since it
+// cannot be read back.
+bool config(const ConfigOptions &opts);
 
 #endif // CONFIG_H
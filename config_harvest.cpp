@@ -0,0 +1,123 @@
+#include "config_harvest.h"
+#include "scm_buffers.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    // One position in the window. Its buffer is written by the worker that claimed the
+    // position and read by the caller once ready is set, never both at once.
+    struct HarvestSlot
+    {
+        std::vector<BYTE> buffer;
+        DWORD error = ERROR_SUCCESS;
+        const char *failedCall = nullptr;
+        bool ready = false;
+    };
+
+    void FetchConfig(const ScHandle &scm, const std::string &name, HarvestSlot &slot)
+    {
+        slot.error = ERROR_SUCCESS;
+        slot.failedCall = nullptr;
+        ScHandle service = OpenServiceShared(scm, name, SERVICE_QUERY_CONFIG);
+        if (!service)
+        {
+            slot.error = GetLastError();
+            slot.failedCall = "OpenService";
+            return;
+        }
+        auto query = [&service](BYTE *data, DWORD size, DWORD *needed)
+        {
+            return Scm()->QueryServiceConfigA(service.get(), reinterpret_cast<LPQUERY_SERVICE_CONFIGA>(data), size, needed);
+        };
+        if (!QueryScmBuffer(slot.buffer, ScmCall::QueryServiceConfig, service.serverKey(), query))
+        {
+            slot.error = GetLastError();
+            slot.failedCall = "QueryServiceConfig";
+        }
+    }
+}
+
+void HarvestConfigs(const ScHandle &scm, const std::vector<std::string> &names, size_t parallelism, size_t window,
+                    const std::function<void(const HarvestedConfig &)> &onConfig)
+{
+    window = std::max<size_t>(1, std::min(window, names.size()));
+    parallelism = std::max<size_t>(1, std::min(parallelism, window));
+    // The slots outlive the harvest, so the next harvest on this thread reuses their buffers.
+    // The workers reach them through this reference; their own thread_local would be empty.
+    thread_local std::vector<HarvestSlot> callerSlots;
+    std::vector<HarvestSlot> &slots = callerSlots;
+    if (slots.size() < window)
+        slots.resize(window);
+    for (HarvestSlot &slot : slots)
+        slot.ready = false;
+
+    std::mutex mutex;
+    std::condition_variable claimable; // The window moved on, or the harvest is over.
+    std::condition_variable reported;  // A slot became ready.
+    size_t next = 0;                   // Next position to claim.
+    size_t done = 0;                   // Positions already reported to the caller.
+    bool stopping = false;
+
+    auto work = [&]()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            claimable.wait(lock, [&]
+                           { return stopping || next == names.size() || next < done + window; });
+            if (stopping || next == names.size())
+                return;
+            size_t position = next++;
+            HarvestSlot &slot = slots[position % window];
+            lock.unlock();
+            FetchConfig(scm, names[position], slot);
+            lock.lock();
+            slot.ready = true;
+            reported.notify_one();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < parallelism; i++)
+        workers.emplace_back(work);
+    auto stopWorkers = [&]()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        claimable.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+    };
+
+    try
+    {
+        for (size_t position = 0; position < names.size(); position++)
+        {
+            HarvestSlot &slot = slots[position % window];
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                reported.wait(lock, [&slot]
+                              { return slot.ready; });
+            }
+            onConfig({names[position], slot.error, slot.failedCall,
+                      slot.error == ERROR_SUCCESS ? reinterpret_cast<const QUERY_SERVICE_CONFIGA *>(slot.buffer.data())
+                                                  : nullptr});
+            std::lock_guard<std::mutex> lock(mutex);
+            slot.ready = false;
+            done++;
+            claimable.notify_all();
+        }
+    }
+    catch (...)
+    {
+        stopWorkers();
+        throw;
+    }
+    stopWorkers();
+}
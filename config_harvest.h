@@ -0,0 +1,34 @@
+#ifndef CONFIG_HARVEST_H
+#define CONFIG_HARVEST_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "scm_handles.h"
+#include "win32_compat.h"
+
+// Default number of services in flight for HarvestConfigs.
+constexpr size_t DEFAULT_HARVEST_WINDOW = 256;
+
+// The outcome for one service. config points into a buffer owned by the harvest and is
+// only valid during the callback; it is null when error is not ERROR_SUCCESS.
+struct HarvestedConfig
+{
+    const std::string &serviceName;
+    DWORD error;
+    const char *failedCall; // "OpenService" or "QueryServiceConfig" when error is set.
+    const QUERY_SERVICE_CONFIGA *config;
+};
+
+// Fetches the configuration of every service in names on up to 'parallelism' worker
+// threads and calls onConfig on the calling thread in the order of names. At most 'window'
+// services are fetched ahead of the one being reported, so memory stays bounded however
+// many services there are. Each position in the window owns a buffer that is reused as the
+// window moves on; they start at the host's size hint for QueryServiceConfig (scm_buffers.h),
+// so a harvest allocates nothing per service and rarely needs a second call.
+void HarvestConfigs(const ScHandle &scm, const std::vector<std::string> &names, size_t parallelism, size_t window,
+                    const std::function<void(const HarvestedConfig &)> &onConfig);
+
+#endif // CONFIG_HARVEST_H
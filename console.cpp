@@ -0,0 +1,32 @@
+#include "console.h"
+
+#include <iostream>
+
+namespace
+{
+    thread_local std::ostream *threadOut = nullptr;
+    thread_local std::ostream *threadErr = nullptr;
+} // end anonymous namespace
+
+std::ostream &ScOut()
+{
+    return threadOut ? *threadOut : std::cout;
+}
+
+std::ostream &ScErr()
+{
+    return threadErr ? *threadErr : std::cerr;
+}
+
+ConsoleCapture::ConsoleCapture(std::ostream &out, std::ostream &err)
+    : previousOut(threadOut), previousErr(threadErr)
+{
+    threadOut = &out;
+    threadErr = &err;
+}
+
+ConsoleCapture::~ConsoleCapture()
+{
+    threadOut = previousOut;
+    threadErr = previousErr;
+}
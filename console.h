@@ -0,0 +1,26 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <iosfwd>
+
+// Streams the command functions write to. They are std::cout and std::cerr unless the
+// calling thread has installed a ConsoleCapture, which lets concurrent commands (fan-out
+// workers, for example) each collect their own output without interleaving.
+std::ostream &ScOut();
+std::ostream &ScErr();
+
+// Redirects ScOut()/ScErr() on the current thread for the lifetime of the object.
+class ConsoleCapture
+{
+public:
+    ConsoleCapture(std::ostream &out, std::ostream &err);
+    ~ConsoleCapture();
+    ConsoleCapture(const ConsoleCapture &) = delete;
+    ConsoleCapture &operator=(const ConsoleCapture &) = delete;
+
+private:
+    std::ostream *previousOut;
+    std::ostream *previousErr;
+};
+
+#endif // CONSOLE_H
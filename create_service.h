@@ -2,33 +2,33 @@
 #define CREATE_SERVICE_H
 
 #include <string>
-#include <windows.h>
+#include "option_schema.h"
+#include "win32_compat.h"
 #include <vector>
-// Structure for the "create" subcommand.
-struct CreateOptions
+// Structure for the "create" subcommand. The "type" parameter may appear twice: if the first
+// is "interact", a second gives the process type (own or share).
+struct CreateOptions : ServiceSettings
 {
     std::string serverName;
     std::string serviceName;
-    // The "type" parameter may appear twice.
-    // The first occurrence sets the service type.
-    // If it is "interact", then a second type parameter is expected to specify the process type.
-    std::string serviceType = "own"; // Allowed: own, share, kernel, filesys, rec, interact
-    std::string interactType = "";   // if serviceType==interact then this must be set. Allowed: own, share
 
-    std::string startType = "demand";    // Allowed: boot, system, auto, demand, disabled, delayed-auto
-    std::string errorControl = "normal"; // Allowed: normal, severe, critical, ignore
-    std::string binpath = "";            // Must be provided
-    std::string group = "";              // Load order group
-    std::string tag = "no";              // Allowed: yes, no
-    std::string depend = "";             // Dependencies (separated by forward slashes)
-    std::string obj = "LocalSystem";     // Account name (default LocalSystem)
-    std::string displayname = "";        // Friendly display name
-    std::string password = "";           // Password (if needed)
+    // Defaults: type= own, start= demand, error= normal, obj= LocalSystem. binpath= must be provided.
+    CreateOptions()
+    {
+        serviceType = SERVICE_WIN32_OWN_PROCESS;
+        startType = SERVICE_DEMAND_START;
+        errorControl = SERVICE_ERROR_NORMAL;
+        obj = "LocalSystem";
+    }
 };
 
 // Function declaration for creating the service.
-void createService(const CreateOptions &opts);
+bool createService(const CreateOptions &opts);
 
 void ParseCreateOptions(const std::vector<std::string> &args, CreateOptions &opts);
 
+// Converts a depend= value (names separated by '/') into the double-null-terminated list
+// CreateService and ChangeServiceConfig take. "/" gives an empty list, which removes all dependencies.
+std::string ConvertDependencies(const std::string &deps);
+
 #endif // CREATE_SERVICE_H
\ No newline at end of file
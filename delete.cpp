@@ -1,4 +1,6 @@
 #include "delete.h"
+#include "console.h"
+#include "sc_api.h"
 #include <iostream>
 #include <sstream>
 #include <vector>
@@ -6,7 +8,7 @@
 
 void printDeleteHelp()
 {
-    std::cout << R"(DESCRIPTION:
+    ScOut() << R"(DESCRIPTION:
         Deletes a service entry from the registry.
         If the service is running, or another process has an
         open handle to the service, the service is simply marked
@@ -54,43 +56,17 @@ void ParseDeleteOptions(const std::vector<std::string> &args, DeleteOptions &opt
     }
 }
 
-// deleteService: Deletes the service specified in opts using the Win32 API.
-void deleteService(const DeleteOptions &opts)
+// deleteService: Deletes the service specified in opts through sc_delete_service.
+bool deleteService(const DeleteOptions &opts)
 {
-    // For local queries, pass NULL to OpenSCManagerA.
-    const char *machineName = ((opts.serverName == "\\\\local") || (opts.serverName.empty()))
-                                  ? NULL
-                                  : opts.serverName.c_str();
-
-    // Open the Service Control Manager with connect rights.
-    SC_HANDLE hSCManager = OpenSCManagerA(machineName, nullptr, SC_MANAGER_CONNECT);
-    if (!hSCManager)
-    {
-        std::cerr << "OpenSCManager failed, error: " << GetLastError() << "\n";
-        return;
-    }
-
-    // Open the service with DELETE access.
-    SC_HANDLE hService = OpenServiceA(hSCManager, opts.serviceName.c_str(), DELETE);
-    if (!hService)
-    {
-        std::cerr << "OpenService failed, error: " << GetLastError() << "\n";
-        CloseServiceHandle(hSCManager);
-        return;
-    }
-
-    // Call DeleteService.
-    if (!DeleteService(hService))
-    {
-        std::cerr << "DeleteService failed, error: " << GetLastError() << "\n";
-    }
-    else
+    uint32_t error = sc_delete_service(opts.serverName.c_str(), opts.serviceName.c_str());
+    if (error != ERROR_SUCCESS)
     {
-        std::cout << "[SC] DeleteService SUCCESS\n";
-        std::cout << "SERVICE_NAME: " << opts.serviceName << "\n";
+        ScErr() << sc_step_name(sc_last_failed_step()) << " failed, error: " << error << "\n";
+        return false;
     }
 
-    // Cleanup.
-    CloseServiceHandle(hService);
-    CloseServiceHandle(hSCManager);
+    ScOut() << "[SC] DeleteService SUCCESS\n";
+    ScOut() << "SERVICE_NAME: " << opts.serviceName << "\n";
+    return true;
 }
\ No newline at end of file
@@ -4,7 +4,7 @@
 #include <string>
 #include <vector>
 #include <stdexcept>
-#include <windows.h>
+#include "win32_compat.h"
 
 // Structure for the "delete" subcommand options.
 struct DeleteOptions
@@ -22,6 +22,6 @@ struct DeleteOptions
 void ParseDeleteOptions(const std::vector<std::string> &args, DeleteOptions &opts);
 
 // deleteService function: deletes the specified service.
-void deleteService(const DeleteOptions &opts);
+bool deleteService(const DeleteOptions &opts);
 
 #endif // DELETE_SERVICE_H
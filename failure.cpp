@@ -1,15 +1,22 @@
 #include "failure.h"
+#include "config.h"
+#include "console.h"
+#include "option_schema.h"
+#include "sc_api.h"
+#include "scm_buffers.h"
+#include "scm_handles.h"
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
 #include <vector>
 #include <cstdlib>
-#include <windows.h>
+#include "win32_compat.h"
 
 
 void printFailureHelp()
 {
-    std::cout << R"(DESCRIPTION:
+    ScOut() << R"(DESCRIPTION:
         Changes the actions upon failure
 USAGE:
         sc <server> failure [service name] <option1> <option2>...
@@ -44,17 +51,21 @@ static std::vector<std::string> splitString(const std::string &str, char delimit
 // EnableShutdownPrivilege enables the SE_SHUTDOWN_NAME privilege for the current process.
 bool EnableShutdownPrivilege()
 {
+#ifndef _WIN32
+    // No process token to adjust; the SCM emulator does not check privileges.
+    return true;
+#else
     HANDLE hToken;
     if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &hToken))
     {
-        std::cerr << "OpenProcessToken failed, error: " << GetLastError() << "\n";
+        ScErr() << "OpenProcessToken failed, error: " << GetLastError() << "\n";
         return false;
     }
     TOKEN_PRIVILEGES tp;
     LUID luid;
     if (!LookupPrivilegeValue(NULL, SE_SHUTDOWN_NAME, &luid))
     {
-        std::cerr << "LookupPrivilegeValue failed, error: " << GetLastError() << "\n";
+        ScErr() << "LookupPrivilegeValue failed, error: " << GetLastError() << "\n";
         CloseHandle(hToken);
         return false;
     }
@@ -63,14 +74,31 @@ bool EnableShutdownPrivilege()
     tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
     if (!AdjustTokenPrivileges(hToken, FALSE, &tp, sizeof(tp), NULL, NULL))
     {
-        std::cerr << "AdjustTokenPrivileges failed, error: " << GetLastError() << "\n";
+        ScErr() << "AdjustTokenPrivileges failed, error: " << GetLastError() << "\n";
         CloseHandle(hToken);
         return false;
     }
     CloseHandle(hToken);
     return (GetLastError() == ERROR_SUCCESS);
+#endif
 }
 
+enum class FailureOption
+{
+    Reset,
+    Reboot,
+    Command,
+    Actions
+};
+
+static constexpr auto FAILURE_OPTIONS = MakeKeywordTable<FailureOption>({
+    {"reset", FailureOption::Reset},
+    {"reboot", FailureOption::Reboot},
+    {"command", FailureOption::Command},
+    {"actions", FailureOption::Actions},
+});
+static_assert(FAILURE_OPTIONS.Valid(), "no perfect hash for the failure options");
+
 // ParseFailureOptions: Parse command-line tokens into a FailureOptions struct.
 void ParseFailureOptions(const std::vector<std::string> &args, FailureOptions &opts)
 {
@@ -92,46 +120,49 @@ void ParseFailureOptions(const std::vector<std::string> &args, FailureOptions &o
     // Process remaining tokens as key/value pairs.
     while (index < args.size())
     {
-        std::string token = args[index];
+        const std::string &token = args[index];
         if (token.size() < 2 || token.back() != '=')
         {
             throw std::invalid_argument("Error: Invalid option format '" + token + "'. Expected key= followed by a value.");
         }
-        std::string key = token.substr(0, token.size() - 1);
         index++;
         if (index >= args.size())
         {
-            throw std::invalid_argument("Error: Missing value for option '" + key + "='.");
+            throw std::invalid_argument("Error: Missing value for option '" + token + "'.");
         }
-        std::string value = args[index];
+        const std::string &value = args[index];
         index++;
 
-        if (key == "reset")
+        const FailureOption *option = FAILURE_OPTIONS.Find(std::string_view(token.data(), token.size() - 1));
+        if (!option)
+        {
+            throw std::invalid_argument("Error: Unknown option '" + token + "'.");
+        }
+        switch (*option)
         {
+        case FailureOption::Reset:
             try
             {
                 opts.reset = std::stoi(value);
+                opts.resetGiven = true;
             }
             catch (...)
             {
                 throw std::invalid_argument("Error: reset must be an integer.");
             }
-        }
-        else if (key == "reboot")
-        {
+            break;
+        case FailureOption::Reboot:
             opts.reboot = value;
-        }
-        else if (key == "command")
-        {
+            opts.rebootGiven = true;
+            break;
+        case FailureOption::Command:
             opts.command = value;
-        }
-        else if (key == "actions")
-        {
+            opts.commandGiven = true;
+            break;
+        case FailureOption::Actions:
             opts.actions = value;
-        }
-        else
-        {
-            throw std::invalid_argument("Error: Unknown option '" + key + "='.");
+            opts.actionsGiven = true;
+            break;
         }
     }
     // If actions is provided, reset must be non-zero.
@@ -141,50 +172,36 @@ void ParseFailureOptions(const std::vector<std::string> &args, FailureOptions &o
     }
 }
 
-// failure: Configures service failure actions using ChangeServiceConfig2A.
-void failure(const FailureOptions &opts)
+// A list of do-nothing actions (which failure writes to apply a reset period alone) does
+// the same as no list.
+static bool SameActions(const SC_ACTION *current, DWORD count, const std::vector<SC_ACTION> &wanted)
 {
-    // For local queries, if serverName is empty or "\\local", pass NULL.
-    const char *machineName = (opts.serverName.empty() || opts.serverName == "\\\\local")
-                                  ? NULL
-                                  : opts.serverName.c_str();
-
-    // Open the Service Control Manager with all access.
-    SC_HANDLE hSCManager = OpenSCManagerA(machineName, NULL, SC_MANAGER_ALL_ACCESS);
-    if (!hSCManager)
+    auto active = [](const SC_ACTION *actions, size_t n)
     {
-        std::cerr << "OpenSCManager failed, error: " << GetLastError() << "\n";
-        return;
-    }
-
-    // Open the service with all access.
-    SC_HANDLE hService = OpenServiceA(hSCManager, opts.serviceName.c_str(), SERVICE_ALL_ACCESS);
-    if (!hService)
+        for (size_t i = 0; i < n; i++)
+        {
+            if (actions[i].Type != SC_ACTION_NONE)
+                return n;
+        }
+        return static_cast<size_t>(0);
+    };
+    size_t n = active(current, current ? count : 0);
+    if (n != active(wanted.data(), wanted.size()))
+        return false;
+    for (size_t i = 0; i < n; i++)
     {
-        std::cerr << "OpenService failed, error: " << GetLastError() << "\n";
-        CloseServiceHandle(hSCManager);
-        return;
+        if (current[i].Type != wanted[i].Type || current[i].Delay != wanted[i].Delay)
+            return false;
     }
+    return true;
+}
 
-    // Use the ANSI version of the structure to match our LPSTR strings.
-    SERVICE_FAILURE_ACTIONSA sfa;
-    sfa.dwResetPeriod = opts.reset; // seconds
-    sfa.lpRebootMsg = opts.reboot.empty() ? NULL : const_cast<LPSTR>(opts.reboot.c_str());
-    sfa.lpCommand = opts.command.empty() ? NULL : const_cast<LPSTR>(opts.command.c_str());
-
-    // Build the actions list.
+// Builds the action list actions= gives; actions= "" (or none) gives an empty list. Throws
+// std::invalid_argument if the list is malformed.
+static std::vector<SC_ACTION> BuildFailureActions(const FailureOptions &opts)
+{
     std::vector<SC_ACTION> actionsVector;
-    if (opts.actions == "\"\"" || opts.actions.empty())
-    {
-        // Supply a do-nothing action so that the reset period is applied.
-        SC_ACTION noneAction;
-        noneAction.Type = SC_ACTION_NONE;
-        noneAction.Delay = 0;
-        actionsVector.push_back(noneAction);
-        sfa.cActions = 1;
-        sfa.lpsaActions = actionsVector.data();
-    }
-    else
+    if (opts.actionsGiven && opts.actions != "\"\"" && !opts.actions.empty())
     {
         // The actions string is expected to be in the form, e.g., "restart/5000/reboot/30000"
         std::vector<std::string> tokens = splitString(opts.actions, '/');
@@ -195,27 +212,16 @@ void failure(const FailureOptions &opts)
         for (size_t i = 0; i < tokens.size(); i += 2)
         {
             SC_ACTION act;
-            std::string actionType = tokens[i];
-            if (actionType == "run")
-            {
-                if (opts.command.empty())
-                {
-                    throw std::invalid_argument("Error: 'run' action specified but command parameter is missing (command= parameter).");
-                }
-                act.Type = SC_ACTION_RUN_COMMAND;
-            }
-            else if (actionType == "restart")
+            const SC_ACTION_TYPE *type = FAILURE_ACTION_VALUES.Find(tokens[i]);
+            if (!type)
             {
-                act.Type = SC_ACTION_RESTART;
+                throw std::invalid_argument("Error: Unknown action type '" + tokens[i] + "'. Allowed values: " + FAILURE_ACTION_VALUES.Names() + ".");
             }
-            else if (actionType == "reboot")
+            if (*type == SC_ACTION_RUN_COMMAND && opts.command.empty())
             {
-                act.Type = SC_ACTION_REBOOT;
-            }
-            else
-            {
-                throw std::invalid_argument("Error: Unknown action type '" + actionType + "'. Allowed values: run, restart, reboot.");
+                throw std::invalid_argument("Error: 'run' action specified but command parameter is missing (command= parameter).");
             }
+            act.Type = *type;
             try
             {
                 act.Delay = static_cast<DWORD>(std::stoul(tokens[i + 1]));
@@ -226,33 +232,143 @@ void failure(const FailureOptions &opts)
             }
             actionsVector.push_back(act);
         }
-        sfa.cActions = static_cast<DWORD>(actionsVector.size());
-        sfa.lpsaActions = actionsVector.data();
+    }
+    return actionsVector;
+}
+
+// Which of the settings given differ from current. When current is null (the settings could
+// not be read) every setting given does; otherwise each is listed in changed or unchanged.
+struct FailureDelta
+{
+    bool reset = false;
+    bool reboot = false;
+    bool command = false;
+    bool actions = false;
+};
+
+static FailureDelta CompareFailureActions(const FailureOptions &opts, const std::vector<SC_ACTION> &actions,
+                                          const SERVICE_FAILURE_ACTIONSA *current,
+                                          std::vector<const char *> &changed, std::vector<const char *> &unchanged)
+{
+    auto differs = [&](const char *setting, bool given, bool equal)
+    {
+        if (!given)
+            return false;
+        if (!current)
+            return true;
+        (equal ? unchanged : changed).push_back(setting);
+        return !equal;
+    };
+    auto sameText = [](const char *currentText, const std::string &wanted)
+    { return wanted == (currentText ? currentText : ""); };
+    FailureDelta delta;
+    delta.reset = differs("RESET_PERIOD", opts.resetGiven, current && current->dwResetPeriod == static_cast<DWORD>(opts.reset));
+    delta.reboot = differs("REBOOT_MESSAGE", opts.rebootGiven, current && sameText(current->lpRebootMsg, opts.reboot));
+    delta.command = differs("COMMAND_LINE", opts.commandGiven, current && sameText(current->lpCommand, opts.command));
+    delta.actions = differs("FAILURE_ACTIONS", opts.actionsGiven,
+                            current && SameActions(current->lpsaActions, current->cActions, actions));
+    return delta;
+}
+
+void DiffFailureActions(const FailureOptions &opts, const SERVICE_FAILURE_ACTIONSA &current,
+                        std::vector<const char *> &changed, std::vector<const char *> &unchanged)
+{
+    CompareFailureActions(opts, BuildFailureActions(opts), &current, changed, unchanged);
+}
+
+// failure: Configures service failure actions through sc_change_failure_actions. Reads the
+// current failure actions first and writes only the settings given that differ from them.
+bool failure(const FailureOptions &opts)
+{
+    ScHandle hSCManager = OpenSCManagerShared(opts.serverName, SC_MANAGER_CONNECT);
+    if (!hSCManager)
+    {
+        ScErr() << "OpenSCManager failed, error: " << GetLastError() << "\n";
+        return false;
+    }
+
+    ScHandle hService = OpenServiceShared(hSCManager, opts.serviceName, SERVICE_QUERY_CONFIG);
+    if (!hService)
+    {
+        ScErr() << "OpenService failed, error: " << GetLastError() << "\n";
+        return false;
+    }
+
+    std::vector<SC_ACTION> actionsVector = BuildFailureActions(opts);
+
+    // Compare with the current settings. If they cannot be read, everything given is written.
+    const BYTE *info = ScmQuery(ScmCall::QueryFailureActions, hService.serverKey(), [&hService](BYTE *data, DWORD size, DWORD *needed)
+                                  { return Scm()->QueryServiceConfig2A(hService.get(), SERVICE_CONFIG_FAILURE_ACTIONS, data, size, needed); });
+    const SERVICE_FAILURE_ACTIONSA *current = reinterpret_cast<const SERVICE_FAILURE_ACTIONSA *>(info);
+    std::vector<const char *> changed;
+    std::vector<const char *> unchanged;
+    FailureDelta delta = CompareFailureActions(opts, actionsVector, current, changed, unchanged);
+    if (!delta.reset && !delta.reboot && !delta.command && !delta.actions)
+    {
+        NoteConfigWrite(false);
+        ScOut() << "[SC] ChangeServiceConfig2 SKIPPED (no changes)\n";
+        ScOut() << "SERVICE_NAME: " << opts.serviceName << "\n";
+        return true;
+    }
+
+    // Null strings and a null action list are left as they are.
+    sc_failure_actions change;
+    change.reset_period = 0;
+    change.reboot_message = delta.reboot ? opts.reboot.c_str() : nullptr;
+    change.command = delta.command ? opts.command.c_str() : nullptr;
+    change.actions = nullptr;
+    change.action_count = 0;
+    std::vector<sc_failure_action> actionList;
+    if (delta.reset || delta.actions)
+    {
+        // The reset period is only applied along with an action list, so a new one alone is
+        // written with the current actions.
+        if (!opts.actionsGiven && current && current->lpsaActions)
+            actionsVector.assign(current->lpsaActions, current->lpsaActions + current->cActions);
+        if (actionsVector.empty())
+        {
+            // Supply a do-nothing action so that the reset period is applied.
+            SC_ACTION noneAction;
+            noneAction.Type = SC_ACTION_NONE;
+            noneAction.Delay = 0;
+            actionsVector.push_back(noneAction);
+        }
+        for (const SC_ACTION &action : actionsVector)
+            actionList.push_back({static_cast<uint32_t>(action.Type), action.Delay});
+        change.reset_period =
+            opts.resetGiven ? static_cast<uint32_t>(opts.reset) : current ? current->dwResetPeriod : 0;
+        change.actions = actionList.data();
+        change.action_count = static_cast<uint32_t>(actionList.size());
     }
 
     // If a reboot action is being configured, enable the shutdown privilege.
-    if (opts.actions.find("reboot") != std::string::npos)
+    bool reboots = std::any_of(actionsVector.begin(), actionsVector.end(),
+                               [](const SC_ACTION &act)
+                               { return act.Type == SC_ACTION_REBOOT; });
+    if (reboots)
     {
         if (!EnableShutdownPrivilege())
         {
-            std::cerr << "Failed to enable shutdown privilege.\n";
-            CloseServiceHandle(hService);
-            CloseServiceHandle(hSCManager);
-            return;
+            ScErr() << "Failed to enable shutdown privilege.\n";
+            return false;
         }
     }
 
-    // Call ChangeServiceConfig2A to set the failure actions.
-    if (!ChangeServiceConfig2A(hService, SERVICE_CONFIG_FAILURE_ACTIONS, &sfa))
+    uint32_t error = sc_change_failure_actions(opts.serverName.c_str(), opts.serviceName.c_str(), &change);
+    if (error != ERROR_SUCCESS)
     {
-        std::cerr << "ChangeServiceConfig2A failed, error: " << GetLastError() << "\n";
+        ScErr() << sc_step_name(sc_last_failed_step()) << " failed, error: " << error << "\n";
+        return false;
     }
-    else
+
+    NoteConfigWrite(true);
+    ScOut() << "[SC] ChangeServiceConfig2 SUCCESS\n";
+    ScOut() << "SERVICE_NAME: " << opts.serviceName << "\n";
+    if (current)
     {
-        std::cout << "[SC] ChangeServiceConfig2 SUCCESS\n";
-        std::cout << "SERVICE_NAME: " << opts.serviceName << "\n";
+        PrintConfigSettings("Changed", changed);
+        if (!unchanged.empty())
+            PrintConfigSettings("Unchanged (not written)", unchanged);
     }
-
-    CloseServiceHandle(hService);
-    CloseServiceHandle(hSCManager);
+    return true;
 }
@@ -4,7 +4,7 @@
 #include <string>
 #include <vector>
 #include <stdexcept>
-#include <windows.h>
+#include "win32_compat.h"
 
 // Structure for the "failure" subcommand options.
 // Command-line syntax (after any optional server name):
@@ -19,6 +19,11 @@ struct FailureOptions
     std::string reboot;      // Broadcast message (reboot=).
     std::string command;     // Command-line command to run on failure (command=).
     std::string actions;     // Failure actions string; for example: "restart/5000/reboot/10000" or "".
+    // Which options were given; the others keep the service's current settings.
+    bool resetGiven = false;
+    bool rebootGiven = false;
+    bool commandGiven = false;
+    bool actionsGiven = false;
 };
 
 // Parse function for the failure subcommand options.
@@ -26,7 +31,13 @@ struct FailureOptions
 // and then key/value pairs (with keys ending in '='). If any parameter is missing or malformed, an std::invalid_argument is thrown.
 void ParseFailureOptions(const std::vector<std::string> &args, FailureOptions &opts);
 
-// failure function: Configures the service failure actions by calling ChangeServiceConfig2A.
-void failure(const FailureOptions &opts);
+// failure function: Configures the service failure actions by calling ChangeServiceConfig2A,
+// unless the service already has every setting given.
+bool failure(const FailureOptions &opts);
+
+// Lists the settings opts gives that differ from current in changed and the others in
+// unchanged, as failure would compare them. Throws std::invalid_argument if actions= is malformed.
+void DiffFailureActions(const FailureOptions &opts, const SERVICE_FAILURE_ACTIONSA &current,
+                        std::vector<const char *> &changed, std::vector<const char *> &unchanged);
 
 #endif // FAILURE_H
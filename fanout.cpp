@@ -0,0 +1,175 @@
+#include "fanout.h"
+#include "commands.h"
+#include "console.h"
+#include "task_pool.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+void printFanoutHelp()
+{
+    ScOut() << R"(DESCRIPTION:
+        Runs the same query, start or stop command against many servers
+        at once. Each server's output is printed as one block when that
+        server finishes.
+USAGE:
+        sc fanout hosts= <server1,server2,...|@hostfile> [parallel= <n>]
+                  [timeout= <ms>] <query|start|stop> [arguments]
+
+OPTIONS:
+        hosts=    Comma-separated server names, or @ followed by a file
+                  with one server name per line.
+        parallel= Maximum number of servers worked on at once
+                  (default = 16)
+        timeout=  Time limit per server in milliseconds; a server that
+                  takes longer is reported as TIMEOUT (default = 60000)
+EXAMPLE:
+        sc fanout hosts= @web.txt parallel= 32 stop MyService
+)";
+}
+
+namespace
+{
+    // Server names may be given with or without the leading "\\".
+    std::string NormalizeServer(const std::string &name)
+    {
+        if (name.compare(0, 2, "\\\\") == 0)
+            return name;
+        return "\\\\" + name;
+    }
+
+    void AddServer(const std::string &raw, std::vector<std::string> &servers)
+    {
+        size_t first = raw.find_first_not_of(" \t\r");
+        if (first == std::string::npos || raw[first] == '#')
+            return;
+        size_t last = raw.find_last_not_of(" \t\r");
+        servers.push_back(NormalizeServer(raw.substr(first, last - first + 1)));
+    }
+
+    unsigned int ParseUnsigned(const std::string &key, const std::string &value)
+    {
+        try
+        {
+            size_t used = 0;
+            unsigned long parsed = std::stoul(value, &used);
+            if (used == value.size() && parsed > 0)
+                return static_cast<unsigned int>(parsed);
+        }
+        catch (...)
+        {
+        }
+        throw std::invalid_argument("Error: " + key + "= must be a positive integer.");
+    }
+} // end anonymous namespace
+
+// ParseFanoutOptions: key= value pairs, then the command that is run against every server.
+void ParseFanoutOptions(const std::vector<std::string> &args, FanoutOptions &opts)
+{
+    size_t i = 0;
+    while (i < args.size() && args[i].size() >= 2 && args[i].back() == '=')
+    {
+        std::string key = args[i].substr(0, args[i].size() - 1);
+        i++;
+        if (i >= args.size())
+        {
+            throw std::invalid_argument("Error: Missing value for option '" + key + "='.");
+        }
+        std::string value = args[i];
+        i++;
+
+        if (key == "hosts")
+        {
+            if (!value.empty() && value[0] == '@')
+            {
+                std::ifstream file(value.substr(1));
+                if (!file)
+                {
+                    throw std::invalid_argument("Error: Unable to open host file '" + value.substr(1) + "'.");
+                }
+                std::string line;
+                while (std::getline(file, line))
+                    AddServer(line, opts.servers);
+            }
+            else
+            {
+                std::istringstream list(value);
+                std::string name;
+                while (std::getline(list, name, ','))
+                    AddServer(name, opts.servers);
+            }
+        }
+        else if (key == "parallel")
+        {
+            opts.parallel = ParseUnsigned(key, value);
+        }
+        else if (key == "timeout")
+        {
+            opts.timeoutMs = ParseUnsigned(key, value);
+        }
+        else
+        {
+            throw std::invalid_argument("Error: Unknown option '" + key + "='.");
+        }
+    }
+
+    opts.command.assign(args.begin() + i, args.end());
+    if (opts.servers.empty())
+    {
+        printFanoutHelp();
+        throw std::invalid_argument("Error: fanout requires hosts= with at least one server.");
+    }
+    if (opts.command.empty())
+    {
+        printFanoutHelp();
+        throw std::invalid_argument("Error: fanout requires a command to run.");
+    }
+    const std::string &subcommand = opts.command[0];
+    if (subcommand != "query" && subcommand != "start" && subcommand != "stop")
+    {
+        throw std::invalid_argument("Error: fanout supports query, start and stop only.");
+    }
+}
+
+bool fanout(const FanoutOptions &opts)
+{
+    std::vector<BoundedTask> tasks;
+    for (const std::string &server : opts.servers)
+    {
+        std::vector<std::string> tokens;
+        tokens.push_back(server);
+        tokens.insert(tokens.end(), opts.command.begin(), opts.command.end());
+        tasks.push_back([tokens]()
+                        { return RunCommand(tokens); });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    size_t succeeded = 0, failed = 0, timedOut = 0;
+    RunBoundedTasks(tasks, opts.parallel, std::chrono::milliseconds(opts.timeoutMs),
+                    [&](const TaskOutcome &outcome)
+                    {
+                        const char *status = outcome.timedOut ? "TIMEOUT" : (outcome.ok ? "SUCCESS" : "FAILED");
+                        if (outcome.timedOut)
+                            ++timedOut;
+                        else if (outcome.ok)
+                            ++succeeded;
+                        else
+                            ++failed;
+
+                        std::ostream &out = ScOut();
+                        out << "[SC] FANOUT " << opts.servers[outcome.index] << ": " << status
+                            << " (" << outcome.elapsedMs << " ms)\n";
+                        out << outcome.output;
+                        if (!outcome.output.empty() && outcome.output.back() != '\n')
+                            out << "\n";
+                        out.flush();
+                    });
+
+    auto total = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    ScOut() << "[SC] FANOUT " << opts.servers.size() << " server(s), " << succeeded << " succeeded, "
+            << failed << " failed, " << timedOut << " timed out, " << total.count() << " ms\n";
+    return failed == 0 && timedOut == 0;
+}
@@ -0,0 +1,28 @@
+#ifndef FANOUT_H
+#define FANOUT_H
+
+#include <string>
+#include <vector>
+
+// Structure for the "fanout" subcommand options.
+// Command-line syntax:
+//   sc.exe fanout hosts= {<server>[,<server>...] | @<hostfile>} [parallel= <n>] [timeout= <ms>]
+//          {query | start | stop} [<arguments>...]
+struct FanoutOptions
+{
+    std::vector<std::string> servers;  // Target servers in "\\ServerName" form.
+    unsigned int parallel = 16;        // Maximum number of servers worked on at once.
+    unsigned int timeoutMs = 60000;    // Per-server limit; slower servers are reported as timed out.
+    std::vector<std::string> command;  // Subcommand and its arguments, run against every server.
+};
+
+// Parse function for "fanout" options. Host files hold one server per line; blank lines and
+// lines starting with # are ignored. Throws std::invalid_argument on bad input.
+void ParseFanoutOptions(const std::vector<std::string> &args, FanoutOptions &opts);
+
+// fanout function: runs opts.command against every server on a bounded worker pool and
+// prints each server's output as one block when it finishes.
+// Returns true if the command succeeded on every server.
+bool fanout(const FanoutOptions &opts);
+
+#endif // FANOUT_H
@@ -0,0 +1,443 @@
+#include "local_ipc.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+#ifdef _WIN32
+#include "win32_compat.h"
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+std::string DefaultCacheEndpoint()
+{
+    if (const char *endpoint = std::getenv("SC_CACHE_ENDPOINT"))
+    {
+        if (*endpoint)
+            return endpoint;
+    }
+#ifdef _WIN32
+    return "\\\\.\\pipe\\sc-cache";
+#else
+    if (const char *runtimeDir = std::getenv("XDG_RUNTIME_DIR"))
+    {
+        if (*runtimeDir)
+            return std::string(runtimeDir) + "/sc-cache.sock";
+    }
+    return "/tmp/sc-cache-" + std::to_string(getuid()) + ".sock";
+#endif
+}
+
+#ifdef _WIN32
+
+namespace
+{
+    constexpr DWORD PIPE_BUFFER_SIZE = 64 * 1024;
+
+    HANDLE CreatePipeInstance(const std::string &endpoint, bool first)
+    {
+        DWORD openMode = PIPE_ACCESS_DUPLEX | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0);
+        return CreateNamedPipeA(endpoint.c_str(), openMode,
+                                PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                                PIPE_UNLIMITED_INSTANCES, PIPE_BUFFER_SIZE, PIPE_BUFFER_SIZE, 0, nullptr);
+    }
+
+    class PipeConnection : public LocalConnection
+    {
+    public:
+        explicit PipeConnection(HANDLE pipe) : pipe(pipe) {}
+
+        ~PipeConnection() override
+        {
+            FlushFileBuffers(pipe);
+            DisconnectNamedPipe(pipe);
+            CloseHandle(pipe);
+        }
+
+        bool ReadRequest(std::string &request) override
+        {
+            request.clear();
+            char chunk[512];
+            // The pipe is synchronous, so wait for data with PeekNamedPipe; a ReadFile with
+            // nothing to read would block for as long as the client liked.
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(LOCAL_REQUEST_TIMEOUT_MS);
+            for (;;)
+            {
+                DWORD available = 0;
+                if (!PeekNamedPipe(pipe, nullptr, 0, nullptr, &available, nullptr))
+                    return false;
+                if (available == 0)
+                {
+                    if (std::chrono::steady_clock::now() >= deadline)
+                        return false;
+                    Sleep(1);
+                    continue;
+                }
+                DWORD read = 0;
+                if (!ReadFile(pipe, chunk, static_cast<DWORD>(std::min<size_t>(available, sizeof(chunk))), &read,
+                              nullptr) ||
+                    read == 0)
+                    return false;
+                request.append(chunk, read);
+                size_t newline = request.find('\n');
+                if (newline != std::string::npos)
+                {
+                    request.resize(newline);
+                    return true;
+                }
+            }
+        }
+
+        bool WriteResponse(const std::string &response) override
+        {
+            size_t offset = 0;
+            while (offset < response.size())
+            {
+                DWORD written = 0;
+                DWORD chunk = static_cast<DWORD>(std::min<size_t>(response.size() - offset, PIPE_BUFFER_SIZE));
+                if (!WriteFile(pipe, response.data() + offset, chunk, &written, nullptr))
+                    return false;
+                offset += written;
+            }
+            return true;
+        }
+
+    private:
+        HANDLE pipe;
+    };
+}
+
+struct LocalServer::Impl
+{
+    std::string endpoint;
+    HANDLE next = INVALID_HANDLE_VALUE; // Instance waiting for the next client.
+};
+
+LocalServer::LocalServer() : impl(new Impl()) {}
+
+LocalServer::~LocalServer()
+{
+    Close();
+}
+
+bool LocalServer::Listen(const std::string &endpoint, std::string &error)
+{
+    impl->endpoint = endpoint;
+    impl->next = CreatePipeInstance(endpoint, true);
+    if (impl->next == INVALID_HANDLE_VALUE)
+    {
+        DWORD lastError = GetLastError();
+        error = lastError == ERROR_ACCESS_DENIED ? "another server is already listening on " + endpoint
+                                                 : "CreateNamedPipe failed, error: " + std::to_string(lastError);
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<LocalConnection> LocalServer::Accept()
+{
+    if (impl->next == INVALID_HANDLE_VALUE)
+        return nullptr;
+    if (!ConnectNamedPipe(impl->next, nullptr) && GetLastError() != ERROR_PIPE_CONNECTED)
+        return nullptr;
+    std::unique_ptr<LocalConnection> connection(new PipeConnection(impl->next));
+    impl->next = CreatePipeInstance(impl->endpoint, false);
+    return connection;
+}
+
+void LocalServer::Close()
+{
+    if (impl->next != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(impl->next);
+        impl->next = INVALID_HANDLE_VALUE;
+    }
+}
+
+bool LocalRequest(const std::string &endpoint, const std::string &request, std::string &response)
+{
+    HANDLE pipe = INVALID_HANDLE_VALUE;
+    for (int attempt = 0; attempt < 2 && pipe == INVALID_HANDLE_VALUE; attempt++)
+    {
+        pipe = CreateFileA(endpoint.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+        if (pipe == INVALID_HANDLE_VALUE && (GetLastError() != ERROR_PIPE_BUSY || !WaitNamedPipeA(endpoint.c_str(), 1000)))
+            return false;
+    }
+    if (pipe == INVALID_HANDLE_VALUE)
+        return false;
+
+    std::string line = request + "\n";
+    DWORD written = 0;
+    bool ok = WriteFile(pipe, line.data(), static_cast<DWORD>(line.size()), &written, nullptr) && written == line.size();
+    response.clear();
+    char chunk[64 * 1024];
+    // As in ReadRequest, wait for data with PeekNamedPipe so a server that never answers
+    // cannot hold the caller past the deadline.
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(LOCAL_REQUEST_TIMEOUT_MS);
+    while (ok)
+    {
+        DWORD available = 0;
+        if (!PeekNamedPipe(pipe, nullptr, 0, nullptr, &available, nullptr))
+            break;
+        if (available == 0)
+        {
+            if (std::chrono::steady_clock::now() >= deadline)
+                ok = false;
+            else
+                Sleep(1);
+            continue;
+        }
+        DWORD read = 0;
+        if (!ReadFile(pipe, chunk, static_cast<DWORD>(std::min<size_t>(available, sizeof(chunk))), &read, nullptr) ||
+            read == 0)
+            break;
+        response.append(chunk, read);
+    }
+    DWORD error = GetLastError();
+    CloseHandle(pipe);
+    // The server disconnects once the response is written.
+    return ok && (error == ERROR_BROKEN_PIPE || error == ERROR_SUCCESS || error == ERROR_PIPE_NOT_CONNECTED);
+}
+
+#else
+
+namespace
+{
+    bool MakeAddress(const std::string &endpoint, sockaddr_un &address)
+    {
+        if (endpoint.size() >= sizeof(address.sun_path))
+            return false;
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, endpoint.c_str(), endpoint.size() + 1);
+        return true;
+    }
+
+    using Clock = std::chrono::steady_clock;
+
+    // Waits until fd is ready for events. Returns false once the deadline passes.
+    bool WaitReady(int fd, short events, Clock::time_point deadline)
+    {
+        for (;;)
+        {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now());
+            if (remaining.count() <= 0)
+                return false;
+            pollfd ready = {fd, events, 0};
+            int result = poll(&ready, 1, static_cast<int>(remaining.count()));
+            if (result < 0 && errno == EINTR)
+                continue;
+            return result > 0;
+        }
+    }
+
+    // Connects a non-blocking socket to endpoint, waiting until the deadline for a server
+    // whose backlog is full.
+    int ConnectTo(const std::string &endpoint, Clock::time_point deadline)
+    {
+        sockaddr_un address;
+        if (!MakeAddress(endpoint, address))
+            return -1;
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return -1;
+        if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == 0)
+        {
+            for (;;)
+            {
+                if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0)
+                    return fd;
+                if (errno == EINTR)
+                    continue;
+                if (errno == EINPROGRESS)
+                {
+                    int error = 0;
+                    socklen_t length = sizeof(error);
+                    if (WaitReady(fd, POLLOUT, deadline) &&
+                        getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0)
+                        return fd;
+                    break;
+                }
+                // Linux refuses a full backlog with EAGAIN rather than queueing the connect.
+                if (errno != EAGAIN || Clock::now() >= deadline)
+                    break;
+                usleep(1000);
+            }
+        }
+        close(fd);
+        return -1;
+    }
+
+    bool SendAll(int fd, const char *data, size_t size, Clock::time_point deadline)
+    {
+        while (size > 0)
+        {
+            ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR)
+                continue;
+            if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && WaitReady(fd, POLLOUT, deadline))
+                continue;
+            if (sent <= 0)
+                return false;
+            data += sent;
+            size -= static_cast<size_t>(sent);
+        }
+        return true;
+    }
+
+    class SocketConnection : public LocalConnection
+    {
+    public:
+        explicit SocketConnection(int fd) : fd(fd) {}
+
+        ~SocketConnection() override
+        {
+            close(fd);
+        }
+
+        bool ReadRequest(std::string &request) override
+        {
+            request.clear();
+            char chunk[512];
+            auto deadline = Clock::now() + std::chrono::milliseconds(LOCAL_REQUEST_TIMEOUT_MS);
+            for (;;)
+            {
+                if (!WaitReady(fd, POLLIN, deadline))
+                    return false;
+                ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+                if (received < 0 && errno == EINTR)
+                    continue;
+                if (received <= 0)
+                    return false;
+                request.append(chunk, static_cast<size_t>(received));
+                size_t newline = request.find('\n');
+                if (newline != std::string::npos)
+                {
+                    request.resize(newline);
+                    return true;
+                }
+            }
+        }
+
+        bool WriteResponse(const std::string &response) override
+        {
+            // The socket blocks, so the deadline only matters if it ever reports EAGAIN.
+            return SendAll(fd, response.data(), response.size(),
+                           Clock::now() + std::chrono::milliseconds(LOCAL_REQUEST_TIMEOUT_MS));
+        }
+
+    private:
+        int fd;
+    };
+}
+
+struct LocalServer::Impl
+{
+    std::string endpoint;
+    int fd = -1;
+};
+
+LocalServer::LocalServer() : impl(new Impl()) {}
+
+LocalServer::~LocalServer()
+{
+    Close();
+}
+
+bool LocalServer::Listen(const std::string &endpoint, std::string &error)
+{
+    sockaddr_un address;
+    if (!MakeAddress(endpoint, address))
+    {
+        error = "endpoint path is too long: " + endpoint;
+        return false;
+    }
+    // A socket file nobody answers on is left over from a server that did not exit cleanly.
+    int existing = ConnectTo(endpoint, Clock::now() + std::chrono::milliseconds(LOCAL_REQUEST_TIMEOUT_MS));
+    if (existing >= 0)
+    {
+        close(existing);
+        error = "another server is already listening on " + endpoint;
+        return false;
+    }
+    unlink(endpoint.c_str());
+
+    impl->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (impl->fd < 0 || bind(impl->fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+        listen(impl->fd, 64) != 0)
+    {
+        error = "cannot listen on " + endpoint + ": " + std::strerror(errno);
+        Close();
+        return false;
+    }
+    impl->endpoint = endpoint;
+    return true;
+}
+
+std::unique_ptr<LocalConnection> LocalServer::Accept()
+{
+    while (impl->fd >= 0)
+    {
+        int client = accept(impl->fd, nullptr, nullptr);
+        if (client >= 0)
+            return std::unique_ptr<LocalConnection>(new SocketConnection(client));
+        if (errno != EINTR && errno != ECONNABORTED)
+            break;
+    }
+    return nullptr;
+}
+
+void LocalServer::Close()
+{
+    if (impl->fd >= 0)
+    {
+        close(impl->fd);
+        impl->fd = -1;
+    }
+    if (!impl->endpoint.empty())
+    {
+        unlink(impl->endpoint.c_str());
+        impl->endpoint.clear();
+    }
+}
+
+bool LocalRequest(const std::string &endpoint, const std::string &request, std::string &response)
+{
+    // One deadline covers the whole exchange, so a server that stopped answering sends the
+    // caller back to the SCM instead of hanging it.
+    auto deadline = Clock::now() + std::chrono::milliseconds(LOCAL_REQUEST_TIMEOUT_MS);
+    int fd = ConnectTo(endpoint, deadline);
+    if (fd < 0)
+        return false;
+    std::string line = request + "\n";
+    bool ok = SendAll(fd, line.data(), line.size(), deadline);
+    response.clear();
+    char chunk[64 * 1024];
+    while (ok)
+    {
+        if (!WaitReady(fd, POLLIN, deadline))
+        {
+            ok = false;
+            break;
+        }
+        ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+        if (received < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+            continue;
+        if (received < 0)
+            ok = false;
+        if (received <= 0)
+            break;
+        response.append(chunk, static_cast<size_t>(received));
+    }
+    close(fd);
+    return ok;
+}
+
+#endif
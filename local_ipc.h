@@ -0,0 +1,61 @@
+#ifndef LOCAL_IPC_H
+#define LOCAL_IPC_H
+
+#include <memory>
+#include <string>
+
+// Request/response messaging between processes on the same machine: a named pipe on
+// Windows, a Unix domain socket elsewhere. A client connects, sends one request, reads
+// the response until the server closes the connection.
+
+// How long a server waits for a client's request line before giving up on the connection,
+// and how long a client waits to connect and read the whole response before giving up.
+constexpr unsigned int LOCAL_REQUEST_TIMEOUT_MS = 2000;
+
+// Default endpoint for the status cache: \\.\pipe\sc-cache on Windows, otherwise
+// $XDG_RUNTIME_DIR/sc-cache.sock or /tmp/sc-cache-<uid>.sock. SC_CACHE_ENDPOINT overrides it.
+std::string DefaultCacheEndpoint();
+
+// One accepted client connection.
+class LocalConnection
+{
+public:
+    virtual ~LocalConnection() = default;
+
+    // Reads the request: everything up to the first newline (not included). Returns false if
+    // the client closes the connection or the line is not complete within LOCAL_REQUEST_TIMEOUT_MS.
+    virtual bool ReadRequest(std::string &request) = 0;
+
+    // Sends the whole response. The connection closes when the object is destroyed.
+    virtual bool WriteResponse(const std::string &response) = 0;
+};
+
+// Listens on an endpoint and hands out one connection at a time. Connections are
+// independent of the server and of each other, so each may be served on its own thread.
+class LocalServer
+{
+public:
+    LocalServer();
+    ~LocalServer();
+    LocalServer(const LocalServer &) = delete;
+    LocalServer &operator=(const LocalServer &) = delete;
+
+    // Starts listening. Fails (with a message in error) if another server owns the endpoint.
+    bool Listen(const std::string &endpoint, std::string &error);
+
+    // Waits for the next client. Returns nullptr on failure or after Close().
+    std::unique_ptr<LocalConnection> Accept();
+
+    void Close();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+// Sends request to the server on endpoint and reads its full response.
+// Returns false if no server is listening, the exchange fails or the server does not
+// answer within LOCAL_REQUEST_TIMEOUT_MS.
+bool LocalRequest(const std::string &endpoint, const std::string &request, std::string &response);
+
+#endif // LOCAL_IPC_H
@@ -0,0 +1,827 @@
+#ifdef _WIN32
+// Before windows.h (through metrics.h), which would otherwise pull in the old winsock.h.
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#endif
+
+#include "metrics.h"
+#include "atomic_file.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#pragma comment(lib, "ws2_32.lib")
+#endif
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const char METRICS_HEADER[] = "sc-metrics 1";
+
+    // The ScmBackend methods, in the order of ScmBackend.
+    enum class ScmMetricCall
+    {
+        OpenSCManager,
+        OpenService,
+        CloseServiceHandle,
+        QueryServiceStatusEx,
+        EnumServicesStatusEx,
+        EnumDependentServices,
+        QueryServiceConfig,
+        QueryServiceConfig2,
+        ChangeServiceConfig,
+        ChangeServiceConfig2,
+        CreateService,
+        DeleteService,
+        StartService,
+        ControlService,
+        NotifyServiceStatusChange,
+        Count
+    };
+    constexpr size_t SCM_CALL_COUNT = static_cast<size_t>(ScmMetricCall::Count);
+    const char *const SCM_CALL_NAMES[SCM_CALL_COUNT] = {
+        "OpenSCManagerA", "OpenServiceA", "CloseServiceHandle", "QueryServiceStatusEx", "EnumServicesStatusExA",
+        "EnumDependentServicesA", "QueryServiceConfigA", "QueryServiceConfig2A", "ChangeServiceConfigA",
+        "ChangeServiceConfig2A", "CreateServiceA", "DeleteService", "StartServiceA", "ControlService",
+        "NotifyServiceStatusChangeA"};
+
+    using Clock = std::chrono::steady_clock;
+
+    LatencyHistogram scmHistograms[SCM_CALL_COUNT];
+    std::atomic<uint64_t> enumCalls{0};
+    std::atomic<uint64_t> enumBytes{0};
+
+    // Errors and commands are rare next to calls, so a lock is cheap enough for them.
+    std::mutex metricsMutex;
+    std::map<std::pair<size_t, DWORD>, uint64_t> scmErrors;
+    std::map<std::string, std::unique_ptr<LatencyHistogram>> commandHistograms;
+    std::map<std::string, uint64_t> commandFailures;
+
+    unsigned HighestBit(uint64_t value)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return static_cast<unsigned>(index);
+#else
+        return 63u - static_cast<unsigned>(__builtin_clzll(value));
+#endif
+    }
+
+    uint64_t ElapsedNs(Clock::time_point since)
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - since).count());
+    }
+
+    void RecordCall(ScmMetricCall call, Clock::time_point begin, DWORD error)
+    {
+        size_t index = static_cast<size_t>(call);
+        scmHistograms[index].Record(ElapsedNs(begin));
+        if (error != ERROR_SUCCESS)
+        {
+            std::lock_guard<std::mutex> lock(metricsMutex);
+            scmErrors[{index, error}]++;
+        }
+    }
+
+    // Records a call that returned ok, leaving the thread's last error as the call set it.
+    void RecordResult(ScmMetricCall call, Clock::time_point begin, bool ok)
+    {
+        DWORD error = ok ? ERROR_SUCCESS : GetLastError();
+        RecordCall(call, begin, error);
+        SetLastError(error);
+    }
+
+    std::string EnvironmentValue(const char *name)
+    {
+        const char *value = std::getenv(name);
+        return value ? value : "";
+    }
+
+    void WriteLatency(std::string &out, const char *kind, const std::string &name, const LatencyData &data)
+    {
+        out += kind;
+        out += '\t' + name + '\t' + std::to_string(data.count) + '\t' + std::to_string(data.sumNs) + '\t' +
+               std::to_string(data.maxNs) + '\t';
+        bool any = false;
+        for (size_t i = 0; i < data.buckets.size(); i++)
+        {
+            if (!data.buckets[i])
+                continue;
+            out += (any ? "," : "") + std::to_string(i) + ":" + std::to_string(data.buckets[i]);
+            any = true;
+        }
+        out += any ? "\n" : "-\n";
+    }
+
+    bool ReadLatency(std::istringstream &fields, LatencyData &data)
+    {
+        std::string buckets;
+        if (!(fields >> data.count >> data.sumNs >> data.maxNs >> buckets))
+            return false;
+        if (buckets == "-")
+            return true;
+        std::istringstream entries(buckets);
+        std::string entry;
+        while (std::getline(entries, entry, ','))
+        {
+            size_t colon = entry.find(':');
+            if (colon == std::string::npos)
+                return false;
+            unsigned long long bucket = std::strtoull(entry.c_str(), nullptr, 10);
+            unsigned long long count = std::strtoull(entry.c_str() + colon + 1, nullptr, 10);
+            if (bucket >= data.buckets.size())
+                return false;
+            data.buckets[bucket] += count;
+        }
+        return true;
+    }
+
+    std::string Seconds(uint64_t ns)
+    {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.9g", static_cast<double>(ns) / 1e9);
+        return text;
+    }
+
+    // Label values may hold any character but \, " and newline, which are escaped.
+    std::string LabelValue(const std::string &value)
+    {
+        std::string escaped;
+        for (char c : value)
+        {
+            if (c == '\\' || c == '"')
+                escaped += '\\';
+            if (c == '\n')
+            {
+                escaped += "\\n";
+                continue;
+            }
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    // Histogram buckets at every power of two nanoseconds from about 1 us to about 69 s.
+    // Those are bucket boundaries of LatencyData, so the cumulative counts are exact.
+    void AppendHistogram(std::string &out, const char *metric, const char *label, const std::string &value,
+                         const LatencyData &data)
+    {
+        std::string labels = std::string(label) + "=\"" + LabelValue(value) + "\"";
+        uint64_t cumulative = 0;
+        size_t bucket = 0;
+        for (unsigned exponent = 10; exponent <= 36; exponent++)
+        {
+            uint64_t bound = uint64_t(1) << exponent;
+            for (; bucket < LatencyBucket(bound); bucket++)
+                cumulative += data.buckets[bucket];
+            out += std::string(metric) + "_bucket{" + labels + ",le=\"" + Seconds(bound) + "\"} " +
+                   std::to_string(cumulative) + "\n";
+        }
+        out += std::string(metric) + "_bucket{" + labels + ",le=\"+Inf\"} " + std::to_string(data.count) + "\n";
+        out += std::string(metric) + "_sum{" + labels + "} " + Seconds(data.sumNs) + "\n";
+        out += std::string(metric) + "_count{" + labels + "} " + std::to_string(data.count) + "\n";
+    }
+} // end anonymous namespace
+
+size_t LatencyBucket(uint64_t ns)
+{
+    if (ns < 2 * LATENCY_SUB_BUCKETS)
+        return static_cast<size_t>(ns);
+    unsigned exponent = HighestBit(ns);
+    if (exponent >= LATENCY_MAX_EXPONENT)
+        return LATENCY_BUCKETS - 1;
+    unsigned shift = exponent - LATENCY_SUB_BUCKET_BITS;
+    return 2 * LATENCY_SUB_BUCKETS + (exponent - LATENCY_SUB_BUCKET_BITS - 1) * LATENCY_SUB_BUCKETS +
+           static_cast<size_t>((ns >> shift) - LATENCY_SUB_BUCKETS);
+}
+
+uint64_t LatencyBucketUpperBound(size_t bucket)
+{
+    if (bucket < 2 * LATENCY_SUB_BUCKETS)
+        return bucket;
+    size_t group = (bucket - 2 * LATENCY_SUB_BUCKETS) / LATENCY_SUB_BUCKETS;
+    size_t sub = (bucket - 2 * LATENCY_SUB_BUCKETS) % LATENCY_SUB_BUCKETS;
+    unsigned shift = static_cast<unsigned>(group) + 1;
+    return ((uint64_t(LATENCY_SUB_BUCKETS + sub) + 1) << shift) - 1;
+}
+
+void LatencyData::Merge(const LatencyData &other)
+{
+    count += other.count;
+    sumNs += other.sumNs;
+    maxNs = std::max(maxNs, other.maxNs);
+    for (size_t i = 0; i < buckets.size(); i++)
+        buckets[i] += other.buckets[i];
+}
+
+uint64_t LatencyData::Percentile(double fraction) const
+{
+    if (count == 0)
+        return 0;
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(fraction * static_cast<double>(count) + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); i++)
+    {
+        seen += buckets[i];
+        if (seen >= rank)
+            return std::min(LatencyBucketUpperBound(i), maxNs);
+    }
+    return maxNs;
+}
+
+void LatencyHistogram::Record(uint64_t ns)
+{
+    count.fetch_add(1, std::memory_order_relaxed);
+    sumNs.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t max = maxNs.load(std::memory_order_relaxed);
+    while (ns > max && !maxNs.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+    {
+    }
+    buckets[LatencyBucket(ns)].fetch_add(1, std::memory_order_relaxed);
+}
+
+LatencyData LatencyHistogram::Read() const
+{
+    LatencyData data;
+    data.count = count.load(std::memory_order_relaxed);
+    data.sumNs = sumNs.load(std::memory_order_relaxed);
+    data.maxNs = maxNs.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++)
+        data.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+    return data;
+}
+
+void MetricsData::Merge(const MetricsData &other)
+{
+    for (const auto &entry : other.commands)
+        commands[entry.first].Merge(entry.second);
+    for (const auto &entry : other.commandFailures)
+        commandFailures[entry.first] += entry.second;
+    for (const auto &entry : other.scmCalls)
+        scmCalls[entry.first].Merge(entry.second);
+    for (const auto &entry : other.errors)
+        errors[entry.first] += entry.second;
+    enumCalls += other.enumCalls;
+    enumBytes += other.enumBytes;
+}
+
+bool MetricsData::Empty() const
+{
+    return commands.empty() && scmCalls.empty() && errors.empty() && enumCalls == 0;
+}
+
+MetricsScmBackend::MetricsScmBackend(std::shared_ptr<ScmBackend> inner) : inner(std::move(inner)) {}
+
+SC_HANDLE MetricsScmBackend::OpenSCManagerA(LPCSTR machineName, LPCSTR databaseName, DWORD desiredAccess)
+{
+    Clock::time_point begin = Clock::now();
+    SC_HANDLE result = inner->OpenSCManagerA(machineName, databaseName, desiredAccess);
+    RecordResult(ScmMetricCall::OpenSCManager, begin, result != NULL);
+    return result;
+}
+
+SC_HANDLE MetricsScmBackend::OpenServiceA(SC_HANDLE hSCManager, LPCSTR serviceName, DWORD desiredAccess)
+{
+    Clock::time_point begin = Clock::now();
+    SC_HANDLE result = inner->OpenServiceA(hSCManager, serviceName, desiredAccess);
+    RecordResult(ScmMetricCall::OpenService, begin, result != NULL);
+    return result;
+}
+
+BOOL MetricsScmBackend::CloseServiceHandle(SC_HANDLE handle)
+{
+    Clock::time_point begin = Clock::now();
+    BOOL result = inner->CloseServiceHandle(handle);
+    RecordResult(ScmMetricCall::CloseServiceHandle, begin, result != FALSE);
+    return result;
+}
+
+BOOL MetricsScmBackend::QueryServiceStatusEx(SC_HANDLE hService, int infoLevel, LPBYTE buffer, DWORD bufSize,
+                                             LPDWORD bytesNeeded)
+{
+    Clock::time_point begin = Clock::now();
+    BOOL result = inner->QueryServiceStatusEx(hService, infoLevel, buffer, bufSize, bytesNeeded);
+    RecordResult(ScmMetricCall::QueryServiceStatusEx, begin, result != FALSE);
+    return result;
+}
+
+BOOL MetricsScmBackend::EnumServicesStatusExA(SC_HANDLE hSCManager, int infoLevel, DWORD serviceType,
+                                              DWORD serviceState, LPBYTE services, DWORD bufSize,
+                                              LPDWORD bytesNeeded, LPDWORD servicesReturned, LPDWORD resumeHandle,
+                                              LPCSTR groupName)
+{
+    Clock::time_point begin = Clock::now();
+    BOOL result = inner->EnumServicesStatusExA(hSCManager, infoLevel, serviceType, serviceState, services, bufSize,
+                                               bytesNeeded, servicesReturned, resumeHandle, groupName);
+    DWORD error = result ? ERROR_SUCCESS : GetLastError();
+    RecordCall(ScmMetricCall::EnumServicesStatusEx, begin, error);
+    // A full page comes back with ERROR_MORE_DATA; count its entries and names as well.
+    if ((error == ERROR_SUCCESS || error == ERROR_MORE_DATA) && infoLevel == SC_ENUM_PROCESS_INFO &&
+        servicesReturned && *servicesReturned)
+    {
+        const ENUM_SERVICE_STATUS_PROCESSA *entries = reinterpret_cast<const ENUM_SERVICE_STATUS_PROCESSA *>(services);
+        uint64_t bytes = uint64_t(*servicesReturned) * sizeof(ENUM_SERVICE_STATUS_PROCESSA);
+        for (DWORD i = 0; i < *servicesReturned; i++)
+        {
+            bytes += entries[i].lpServiceName ? std::strlen(entries[i].lpServiceName) + 1 : 0;
+            bytes += entries[i].lpDisplayName ? std::strlen(entries[i].lpDisplayName) + 1 : 0;
+        }
+        enumCalls.fetch_add(1, std::memory_order_relaxed);
+        enumBytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+    SetLastError(error);
+    return result;
+}
+
+BOOL MetricsScmBackend::EnumDependentServicesA(SC_HANDLE hService, DWORD serviceState,
+                                               LPENUM_SERVICE_STATUSA services, DWORD bufSize, LPDWORD bytesNeeded,
+                                               LPDWORD servicesReturned)
+{
+    Clock::time_point begin = Clock::now();
+    BOOL result = inner->EnumDependentServicesA(hService, serviceState, services, bufSize, bytesNeeded,
+                                                servicesReturned);
+    RecordResult(ScmMetricCall::EnumDependentServices, begin, result != FALSE);
+    return result;
+}
+
+BOOL MetricsScmBackend::QueryServiceConfigA(SC_HANDLE hService, LPQUERY_SERVICE_CONFIGA config, DWORD bufSize,
+                                            LPDWORD bytesNeeded)
+{
+    Clock::time_point begin = Clock::now();
+    BOOL result = inner->QueryServiceConfigA(hService, config, bufSize, bytesNeeded);
+    RecordResult(ScmMetricCall::QueryServiceConfig, begin, result != FALSE);
+    return result;
+}
+
+BOOL MetricsScmBackend::QueryServiceConfig2A(SC_HANDLE hService, DWORD infoLevel, LPBYTE buffer, DWORD bufSize,
+                                             LPDWORD bytesNeeded)
+{
+    Clock::time_point begin = Clock::now();
+    BOOL result = inner->QueryServiceConfig2A(hService, infoLevel, buffer, bufSize, bytesNeeded);
+    RecordResult(ScmMetricCall::QueryServiceConfig2, begin, result != FALSE);
+    return result;
+}
+
+BOOL MetricsScmBackend::ChangeServiceConfigA(SC_HANDLE hService, DWORD serviceType, DWORD startType,
+                                             DWORD errorControl, LPCSTR binaryPathName, LPCSTR loadOrderGroup,
+                                             LPDWORD tagId, LPCSTR dependencies, LPCSTR serviceStartName,
+                                             LPCSTR password, LPCSTR displayName)
+{
+    Clock::time_point begin = Clock::now();
+    BOOL result = inner->ChangeServiceConfigA(hService, serviceType, startType, errorControl, binaryPathName,
+                                              loadOrderGroup, tagId, dependencies, serviceStartName, password,
+                                              displayName);
+    RecordResult(ScmMetricCall::ChangeServiceConfig, begin, result != FALSE);
+    return result;
+}
+
+BOOL MetricsScmBackend::ChangeServiceConfig2A(SC_HANDLE hService, DWORD infoLevel, LPVOID info)
+{
+    Clock::time_point begin = Clock::now();
+    BOOL result = inner->ChangeServiceConfig2A(hService, infoLevel, info);
+    RecordResult(ScmMetricCall::ChangeServiceConfig2, begin, result != FALSE);
+    return result;
+}
+
+SC_HANDLE MetricsScmBackend::CreateServiceA(SC_HANDLE hSCManager, LPCSTR serviceName, LPCSTR displayName,
+                                            DWORD desiredAccess, DWORD serviceType, DWORD startType,
+                                            DWORD errorControl, LPCSTR binaryPathName, LPCSTR loadOrderGroup,
+                                            LPDWORD tagId, LPCSTR dependencies, LPCSTR serviceStartName,
+                                            LPCSTR password)
+{
+    Clock::time_point begin = Clock::now();
+    SC_HANDLE result = inner->CreateServiceA(hSCManager, serviceName, displayName, desiredAccess, serviceType,
+                                             startType, errorControl, binaryPathName, loadOrderGroup, tagId,
+                                             dependencies, serviceStartName, password);
+    RecordResult(ScmMetricCall::CreateService, begin, result != NULL);
+    return result;
+}
+
+BOOL MetricsScmBackend::DeleteService(SC_HANDLE hService)
+{
+    Clock::time_point begin = Clock::now();
+    BOOL result = inner->DeleteService(hService);
+    RecordResult(ScmMetricCall::DeleteService, begin, result != FALSE);
+    return result;
+}
+
+BOOL MetricsScmBackend::StartServiceA(SC_HANDLE hService, DWORD numArgs, LPCSTR *args)
+{
+    Clock::time_point begin = Clock::now();
+    BOOL result = inner->StartServiceA(hService, numArgs, args);
+    RecordResult(ScmMetricCall::StartService, begin, result != FALSE);
+    return result;
+}
+
+BOOL MetricsScmBackend::ControlService(SC_HANDLE hService, DWORD control, LPSERVICE_STATUS status)
+{
+    Clock::time_point begin = Clock::now();
+    BOOL result = inner->ControlService(hService, control, status);
+    RecordResult(ScmMetricCall::ControlService, begin, result != FALSE);
+    return result;
+}
+
+DWORD MetricsScmBackend::NotifyServiceStatusChangeA(SC_HANDLE hService, DWORD notifyMask, PSERVICE_NOTIFYA notify)
+{
+    Clock::time_point begin = Clock::now();
+    DWORD error = inner->NotifyServiceStatusChangeA(hService, notifyMask, notify);
+    RecordCall(ScmMetricCall::NotifyServiceStatusChange, begin, error);
+    return error;
+}
+
+void StartScmMetrics()
+{
+    SetScmBackend(std::make_shared<MetricsScmBackend>(CurrentScmBackend()));
+}
+
+void NoteCommandMetric(const std::string &command, uint64_t ns, bool ok)
+{
+    std::lock_guard<std::mutex> lock(metricsMutex);
+    std::unique_ptr<LatencyHistogram> &histogram = commandHistograms[command];
+    if (!histogram)
+        histogram.reset(new LatencyHistogram());
+    histogram->Record(ns);
+    if (!ok)
+        commandFailures[command]++;
+}
+
+MetricsData CurrentMetrics()
+{
+    MetricsData data;
+    for (size_t i = 0; i < SCM_CALL_COUNT; i++)
+    {
+        LatencyData calls = scmHistograms[i].Read();
+        if (calls.count)
+            data.scmCalls[SCM_CALL_NAMES[i]] = std::move(calls);
+    }
+    data.enumCalls = enumCalls.load(std::memory_order_relaxed);
+    data.enumBytes = enumBytes.load(std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(metricsMutex);
+    for (const auto &entry : scmErrors)
+        data.errors[{SCM_CALL_NAMES[entry.first.first], entry.first.second}] = entry.second;
+    for (const auto &entry : commandHistograms)
+        data.commands[entry.first] = entry.second->Read();
+    data.commandFailures = commandFailures;
+    return data;
+}
+
+std::string DefaultMetricsPath()
+{
+    if (const char *configured = std::getenv("SC_METRICS"))
+    {
+        std::string path = configured;
+        return path == "off" ? "" : path;
+    }
+#ifdef _WIN32
+    std::string localAppData = EnvironmentValue("LOCALAPPDATA");
+    return localAppData.empty() ? "" : localAppData + "\\sc-metrics";
+#else
+    std::string cacheHome = EnvironmentValue("XDG_CACHE_HOME");
+    if (!cacheHome.empty())
+        return cacheHome + "/sc-metrics";
+    std::string home = EnvironmentValue("HOME");
+    return home.empty() ? "" : home + "/.sc-metrics";
+#endif
+}
+
+// Lines are tab-separated:
+//   command <name> <count> <sum ns> <max ns> <bucket>:<count>,...   (or - for no buckets)
+//   failures <name> <count>
+//   scm <function> <count> <sum ns> <max ns> <bucket>:<count>,...
+//   error <function> <code> <count>
+//   enum <pages> <bytes>
+bool LoadMetricsFile(const std::string &path, MetricsData &data)
+{
+    std::ifstream in(path);
+    if (!in)
+        return true;
+    std::string line;
+    if (!std::getline(in, line))
+        return true;
+    if (line != METRICS_HEADER)
+        return false;
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        std::string kind, name;
+        if (!std::getline(fields, kind, '\t'))
+            continue;
+        if (kind == "enum")
+        {
+            uint64_t calls = 0, bytes = 0;
+            if (fields >> calls >> bytes)
+            {
+                data.enumCalls += calls;
+                data.enumBytes += bytes;
+            }
+            continue;
+        }
+        if (!std::getline(fields, name, '\t'))
+            continue;
+        if (kind == "command" || kind == "scm")
+        {
+            LatencyData latency;
+            if (ReadLatency(fields, latency))
+                (kind == "command" ? data.commands : data.scmCalls)[name].Merge(latency);
+        }
+        else if (kind == "failures")
+        {
+            uint64_t count = 0;
+            if (fields >> count)
+                data.commandFailures[name] += count;
+        }
+        else if (kind == "error")
+        {
+            DWORD code = 0;
+            uint64_t count = 0;
+            if (fields >> code >> count)
+                data.errors[{name, code}] += count;
+        }
+    }
+    return true;
+}
+
+bool SaveScmMetrics()
+{
+    std::string path = DefaultMetricsPath();
+    MetricsData data = CurrentMetrics();
+    if (path.empty() || data.Empty())
+        return true;
+    // Concurrent runs take turns adding to the file; each sees what the one before wrote.
+    // A file that is not a metrics file is left alone rather than overwritten.
+    FileLock lock(path);
+    MetricsData saved;
+    if (!LoadMetricsFile(path, saved))
+        return false;
+    data.Merge(saved);
+
+    std::string out = std::string(METRICS_HEADER) + "\n";
+    for (const auto &entry : data.commands)
+        WriteLatency(out, "command", entry.first, entry.second);
+    for (const auto &entry : data.commandFailures)
+        out += "failures\t" + entry.first + "\t" + std::to_string(entry.second) + "\n";
+    for (const auto &entry : data.scmCalls)
+        WriteLatency(out, "scm", entry.first, entry.second);
+    for (const auto &entry : data.errors)
+        out += "error\t" + entry.first.first + "\t" + std::to_string(entry.first.second) + "\t" +
+               std::to_string(entry.second) + "\n";
+    out += "enum\t" + std::to_string(data.enumCalls) + "\t" + std::to_string(data.enumBytes) + "\n";
+    return ReplaceFileContents(path, out);
+}
+
+bool ResetScmMetrics()
+{
+    std::string path = DefaultMetricsPath();
+    if (path.empty())
+        return true;
+    FileLock lock(path);
+    return ReplaceFileContents(path, std::string(METRICS_HEADER) + "\n");
+}
+
+const char *ErrorCodeName(DWORD error)
+{
+    switch (error)
+    {
+    case ERROR_ACCESS_DENIED:
+        return "ERROR_ACCESS_DENIED";
+    case ERROR_INVALID_HANDLE:
+        return "ERROR_INVALID_HANDLE";
+    case ERROR_INVALID_PARAMETER:
+        return "ERROR_INVALID_PARAMETER";
+    case ERROR_CALL_NOT_IMPLEMENTED:
+        return "ERROR_CALL_NOT_IMPLEMENTED";
+    case ERROR_INSUFFICIENT_BUFFER:
+        return "ERROR_INSUFFICIENT_BUFFER";
+    case ERROR_INVALID_NAME:
+        return "ERROR_INVALID_NAME";
+    case ERROR_MORE_DATA:
+        return "ERROR_MORE_DATA";
+    case ERROR_DEPENDENT_SERVICES_RUNNING:
+        return "ERROR_DEPENDENT_SERVICES_RUNNING";
+    case ERROR_INVALID_SERVICE_CONTROL:
+        return "ERROR_INVALID_SERVICE_CONTROL";
+    case ERROR_SERVICE_REQUEST_TIMEOUT:
+        return "ERROR_SERVICE_REQUEST_TIMEOUT";
+    case ERROR_SERVICE_DATABASE_LOCKED:
+        return "ERROR_SERVICE_DATABASE_LOCKED";
+    case ERROR_SERVICE_ALREADY_RUNNING:
+        return "ERROR_SERVICE_ALREADY_RUNNING";
+    case ERROR_SERVICE_DISABLED:
+        return "ERROR_SERVICE_DISABLED";
+    case ERROR_CIRCULAR_DEPENDENCY:
+        return "ERROR_CIRCULAR_DEPENDENCY";
+    case ERROR_SERVICE_DOES_NOT_EXIST:
+        return "ERROR_SERVICE_DOES_NOT_EXIST";
+    case ERROR_SERVICE_CANNOT_ACCEPT_CTRL:
+        return "ERROR_SERVICE_CANNOT_ACCEPT_CTRL";
+    case ERROR_SERVICE_NOT_ACTIVE:
+        return "ERROR_SERVICE_NOT_ACTIVE";
+    case ERROR_SERVICE_DEPENDENCY_FAIL:
+        return "ERROR_SERVICE_DEPENDENCY_FAIL";
+    case ERROR_INVALID_SERVICE_LOCK:
+        return "ERROR_INVALID_SERVICE_LOCK";
+    case ERROR_SERVICE_MARKED_FOR_DELETE:
+        return "ERROR_SERVICE_MARKED_FOR_DELETE";
+    case ERROR_SERVICE_EXISTS:
+        return "ERROR_SERVICE_EXISTS";
+    case ERROR_TIMEOUT:
+        return "ERROR_TIMEOUT";
+    default:
+        return nullptr;
+    }
+}
+
+std::string FormatPrometheusMetrics(const MetricsData &data)
+{
+    std::string out;
+    out += "# HELP sc_command_duration_seconds Time each sc subcommand took.\n"
+           "# TYPE sc_command_duration_seconds histogram\n";
+    for (const auto &entry : data.commands)
+        AppendHistogram(out, "sc_command_duration_seconds", "command", entry.first, entry.second);
+    out += "# HELP sc_command_failures_total Subcommands that failed.\n"
+           "# TYPE sc_command_failures_total counter\n";
+    for (const auto &entry : data.commandFailures)
+        out += "sc_command_failures_total{command=\"" + LabelValue(entry.first) + "\"} " +
+               std::to_string(entry.second) + "\n";
+    out += "# HELP sc_scm_call_duration_seconds Time each Service Control Manager call took.\n"
+           "# TYPE sc_scm_call_duration_seconds histogram\n";
+    for (const auto &entry : data.scmCalls)
+        AppendHistogram(out, "sc_scm_call_duration_seconds", "call", entry.first, entry.second);
+    out += "# HELP sc_scm_errors_total Service Control Manager calls that failed, by error code.\n"
+           "# TYPE sc_scm_errors_total counter\n";
+    for (const auto &entry : data.errors)
+    {
+        const char *name = ErrorCodeName(entry.first.second);
+        out += "sc_scm_errors_total{call=\"" + LabelValue(entry.first.first) + "\",code=\"" +
+               std::to_string(entry.first.second) + "\",error=\"" + (name ? name : "") + "\"} " +
+               std::to_string(entry.second) + "\n";
+    }
+    out += "# HELP sc_enum_services_pages_total Pages EnumServicesStatusExA returned.\n"
+           "# TYPE sc_enum_services_pages_total counter\n"
+           "sc_enum_services_pages_total " +
+           std::to_string(data.enumCalls) + "\n";
+    out += "# HELP sc_enum_services_bytes_total Bytes of entries and names EnumServicesStatusExA returned.\n"
+           "# TYPE sc_enum_services_bytes_total counter\n"
+           "sc_enum_services_bytes_total " +
+           std::to_string(data.enumBytes) + "\n";
+    return out;
+}
+
+#ifdef _WIN32
+using SocketHandle = SOCKET;
+static void CloseSocket(SocketHandle s)
+{
+    closesocket(s);
+}
+static const int SEND_FLAGS = 0;
+#else
+using SocketHandle = int;
+static const SocketHandle INVALID_SOCKET = -1;
+static void CloseSocket(SocketHandle s)
+{
+    close(s);
+}
+static const int SEND_FLAGS = MSG_NOSIGNAL;
+#endif
+
+struct MetricsEndpoint::Impl
+{
+    SocketHandle listener = INVALID_SOCKET;
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+#ifdef _WIN32
+    bool winsockStarted = false;
+#endif
+
+    // Waits up to timeoutMs for s to be readable.
+    static bool Readable(SocketHandle s, long timeoutMs)
+    {
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(s, &readable);
+        timeval timeout = {timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+        return select(static_cast<int>(s + 1), &readable, nullptr, nullptr, &timeout) > 0;
+    }
+
+    // Reads the request head (the body of a GET is empty) and answers /metrics.
+    static void Serve(SocketHandle client)
+    {
+        std::string request;
+        char chunk[1024];
+        while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192 && Readable(client, 2000))
+        {
+            int received = recv(client, chunk, sizeof(chunk), 0);
+            if (received <= 0)
+                break;
+            request.append(chunk, static_cast<size_t>(received));
+        }
+        std::string target = request.substr(0, request.find("\r\n"));
+        bool metrics = target.compare(0, 13, "GET /metrics ") == 0 || target.compare(0, 6, "GET / ") == 0;
+        std::string body = metrics ? FormatPrometheusMetrics(CurrentMetrics()) : "Not found. Try /metrics.\n";
+        std::string response = std::string(metrics ? "HTTP/1.0 200 OK" : "HTTP/1.0 404 Not Found") +
+                               "\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: " +
+                               std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+        size_t sent = 0;
+        while (sent < response.size())
+        {
+            int n = send(client, response.data() + sent, static_cast<int>(response.size() - sent), SEND_FLAGS);
+            if (n <= 0)
+                break;
+            sent += static_cast<size_t>(n);
+        }
+    }
+
+    void Run()
+    {
+        while (!stopping)
+        {
+            if (!Readable(listener, 250))
+                continue;
+            SocketHandle client = accept(listener, nullptr, nullptr);
+            if (client == INVALID_SOCKET)
+                continue;
+            Serve(client);
+            CloseSocket(client);
+        }
+    }
+};
+
+MetricsEndpoint::MetricsEndpoint() : impl(new Impl()) {}
+
+MetricsEndpoint::~MetricsEndpoint()
+{
+    Stop();
+}
+
+bool MetricsEndpoint::Start(unsigned short port, std::string &error)
+{
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+    {
+        error = "WSAStartup failed";
+        return false;
+    }
+    impl->winsockStarted = true;
+#endif
+    impl->listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (impl->listener == INVALID_SOCKET)
+    {
+        error = "Cannot create a socket for the metrics endpoint.";
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(impl->listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&reuse), sizeof(reuse));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(impl->listener, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 ||
+        listen(impl->listener, 16) != 0)
+    {
+        error = "Cannot listen on 127.0.0.1:" + std::to_string(port) + " for metrics.";
+        CloseSocket(impl->listener);
+        impl->listener = INVALID_SOCKET;
+        return false;
+    }
+    impl->thread = std::thread([this]
+                               { impl->Run(); });
+    return true;
+}
+
+void MetricsEndpoint::Stop()
+{
+    impl->stopping = true;
+    if (impl->thread.joinable())
+        impl->thread.join();
+    if (impl->listener != INVALID_SOCKET)
+    {
+        CloseSocket(impl->listener);
+        impl->listener = INVALID_SOCKET;
+    }
+#ifdef _WIN32
+    if (impl->winsockStarted)
+    {
+        WSACleanup();
+        impl->winsockStarted = false;
+    }
+#endif
+}
@@ -0,0 +1,164 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "scm_backend.h"
+
+// Cumulative metrics sc keeps about itself: a latency histogram per subcommand and per SCM
+// call, the error codes each SCM call returned, and the bytes EnumServicesStatusExA returned.
+// A MetricsScmBackend records the SCM calls in lock-free counters. SaveScmMetrics adds this
+// run's counts to DefaultMetricsPath() at exit, and "sc stats" prints the totals.
+
+// Latencies are kept in nanoseconds, HDR style: values below 2 * SUB_BUCKETS have a bucket
+// each, and every power of two above that is split into SUB_BUCKETS linear buckets. A
+// bucket's bounds are then within 1/SUB_BUCKETS (6.25%) of each other.
+constexpr unsigned LATENCY_SUB_BUCKET_BITS = 4;
+constexpr size_t LATENCY_SUB_BUCKETS = size_t(1) << LATENCY_SUB_BUCKET_BITS;
+constexpr unsigned LATENCY_MAX_EXPONENT = 46; // About 19.5 hours; longer values count in the last bucket.
+constexpr size_t LATENCY_BUCKETS =
+    2 * LATENCY_SUB_BUCKETS + (LATENCY_MAX_EXPONENT - LATENCY_SUB_BUCKET_BITS - 1) * LATENCY_SUB_BUCKETS;
+
+size_t LatencyBucket(uint64_t ns);
+// The largest value that falls in bucket.
+uint64_t LatencyBucketUpperBound(size_t bucket);
+
+// A histogram as read out of the live counters or the metrics file.
+struct LatencyData
+{
+    uint64_t count = 0;
+    uint64_t sumNs = 0;
+    uint64_t maxNs = 0;
+    std::vector<uint64_t> buckets = std::vector<uint64_t>(LATENCY_BUCKETS);
+
+    void Merge(const LatencyData &other);
+    // The upper bound of the bucket holding the given fraction (0 to 1) of the values,
+    // capped at maxNs; 0 when the histogram is empty.
+    uint64_t Percentile(double fraction) const;
+};
+
+// A histogram any thread can record into without locking.
+class LatencyHistogram
+{
+public:
+    void Record(uint64_t ns);
+    LatencyData Read() const;
+
+private:
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sumNs{0};
+    std::atomic<uint64_t> maxNs{0};
+    std::array<std::atomic<uint64_t>, LATENCY_BUCKETS> buckets{};
+};
+
+// Everything the metrics hold, keyed by name so runs can be added together.
+struct MetricsData
+{
+    std::map<std::string, LatencyData> commands;                // By subcommand.
+    std::map<std::string, uint64_t> commandFailures;            // By subcommand.
+    std::map<std::string, LatencyData> scmCalls;                // By SCM function.
+    std::map<std::pair<std::string, DWORD>, uint64_t> errors;   // By SCM function and error code.
+    uint64_t enumCalls = 0;                                      // EnumServicesStatusExA pages returned.
+    uint64_t enumBytes = 0;                                      // Bytes of entries and names in them.
+
+    void Merge(const MetricsData &other);
+    bool Empty() const;
+};
+
+// Forwards every call to the backend it wraps, recording its latency and error code.
+class MetricsScmBackend : public ScmBackend
+{
+public:
+    explicit MetricsScmBackend(std::shared_ptr<ScmBackend> inner);
+
+    SC_HANDLE OpenSCManagerA(LPCSTR machineName, LPCSTR databaseName, DWORD desiredAccess) override;
+    SC_HANDLE OpenServiceA(SC_HANDLE hSCManager, LPCSTR serviceName, DWORD desiredAccess) override;
+    BOOL CloseServiceHandle(SC_HANDLE handle) override;
+    BOOL QueryServiceStatusEx(SC_HANDLE hService, int infoLevel, LPBYTE buffer, DWORD bufSize,
+                              LPDWORD bytesNeeded) override;
+    BOOL EnumServicesStatusExA(SC_HANDLE hSCManager, int infoLevel, DWORD serviceType, DWORD serviceState,
+                               LPBYTE services, DWORD bufSize, LPDWORD bytesNeeded, LPDWORD servicesReturned,
+                               LPDWORD resumeHandle, LPCSTR groupName) override;
+    BOOL EnumDependentServicesA(SC_HANDLE hService, DWORD serviceState, LPENUM_SERVICE_STATUSA services,
+                                DWORD bufSize, LPDWORD bytesNeeded, LPDWORD servicesReturned) override;
+    BOOL QueryServiceConfigA(SC_HANDLE hService, LPQUERY_SERVICE_CONFIGA config, DWORD bufSize,
+                             LPDWORD bytesNeeded) override;
+    BOOL QueryServiceConfig2A(SC_HANDLE hService, DWORD infoLevel, LPBYTE buffer, DWORD bufSize,
+                              LPDWORD bytesNeeded) override;
+    BOOL ChangeServiceConfigA(SC_HANDLE hService, DWORD serviceType, DWORD startType, DWORD errorControl,
+                              LPCSTR binaryPathName, LPCSTR loadOrderGroup, LPDWORD tagId, LPCSTR dependencies,
+                              LPCSTR serviceStartName, LPCSTR password, LPCSTR displayName) override;
+    BOOL ChangeServiceConfig2A(SC_HANDLE hService, DWORD infoLevel, LPVOID info) override;
+    SC_HANDLE CreateServiceA(SC_HANDLE hSCManager, LPCSTR serviceName, LPCSTR displayName, DWORD desiredAccess,
+                             DWORD serviceType, DWORD startType, DWORD errorControl, LPCSTR binaryPathName,
+                             LPCSTR loadOrderGroup, LPDWORD tagId, LPCSTR dependencies, LPCSTR serviceStartName,
+                             LPCSTR password) override;
+    BOOL DeleteService(SC_HANDLE hService) override;
+    BOOL StartServiceA(SC_HANDLE hService, DWORD numArgs, LPCSTR *args) override;
+    BOOL ControlService(SC_HANDLE hService, DWORD control, LPSERVICE_STATUS status) override;
+    DWORD NotifyServiceStatusChangeA(SC_HANDLE hService, DWORD notifyMask, PSERVICE_NOTIFYA notify) override;
+
+private:
+    std::shared_ptr<ScmBackend> inner;
+};
+
+// Puts a MetricsScmBackend in front of the current backend. Recording costs two clock reads
+// and a few relaxed atomic adds per call, so it stays on even when nothing is saved.
+void StartScmMetrics();
+
+// Records one run of a subcommand.
+void NoteCommandMetric(const std::string &command, uint64_t ns, bool ok);
+
+// The metrics recorded by this process.
+MetricsData CurrentMetrics();
+
+// SC_METRICS if set ("off" disables persistence), otherwise sc-metrics under
+// %LOCALAPPDATA% on Windows, $XDG_CACHE_HOME or, failing that, $HOME (as .sc-metrics).
+std::string DefaultMetricsPath();
+
+// Reads a metrics file. A missing file reads as empty; returns false if it exists but is
+// not a metrics file.
+bool LoadMetricsFile(const std::string &path, MetricsData &data);
+
+// Adds this run's metrics to the file, if anything was recorded. The file is locked while it
+// is read, merged and replaced, so concurrent runs each add their counts. Returns false if the
+// file could not be written, or exists and is not a metrics file.
+bool SaveScmMetrics();
+
+// Forgets the totals in the file. Returns false if the file could not be written.
+bool ResetScmMetrics();
+
+// Known Win32 error names, for reports; nullptr for other codes.
+const char *ErrorCodeName(DWORD error);
+
+// The metrics in the Prometheus text exposition format.
+std::string FormatPrometheusMetrics(const MetricsData &data);
+
+// Serves FormatPrometheusMetrics(CurrentMetrics()) over HTTP on 127.0.0.1:<port>, at
+// /metrics, from a thread of its own until Stop().
+class MetricsEndpoint
+{
+public:
+    MetricsEndpoint();
+    ~MetricsEndpoint();
+    MetricsEndpoint(const MetricsEndpoint &) = delete;
+    MetricsEndpoint &operator=(const MetricsEndpoint &) = delete;
+
+    // Fails (with a message in error) if the port cannot be bound.
+    bool Start(unsigned short port, std::string &error);
+    void Stop();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+#endif // METRICS_H
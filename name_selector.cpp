@@ -0,0 +1,867 @@
+// The prefilter compares 16 bytes at a time with SSE2, which every x64 target has; other
+// targets use the scalar loop.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NAME_SELECTOR_SSE2 1
+#else
+#define NAME_SELECTOR_SSE2 0
+#endif
+
+#include "name_selector.h"
+#include "console.h"
+#include "query.h"
+#include "scm_handles.h"
+#include "task_pool.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#if NAME_SELECTOR_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace
+{
+    char FoldCase(char c)
+    {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c | 0x20) : c;
+    }
+
+    std::string FoldCase(std::string s)
+    {
+        for (char &c : s)
+            c = FoldCase(c);
+        return s;
+    }
+
+    bool EqualsAt(std::string_view haystack, size_t at, std::string_view lowerNeedle)
+    {
+        for (size_t i = 0; i < lowerNeedle.size(); i++)
+        {
+            if (FoldCase(haystack[at + i]) != lowerNeedle[i])
+                return false;
+        }
+        return true;
+    }
+
+#if NAME_SELECTOR_SSE2
+    // A 16-byte load from p cannot fault if it stays within p's 4 KB page, even when it runs
+    // past the end of the string; the bytes past the end are masked off.
+    bool SafeToLoad16(const char *p)
+    {
+        return (reinterpret_cast<uintptr_t>(p) & 4095) <= 4096 - 16;
+    }
+
+    // Bit i is set where the needle's first and last characters match at position i.
+    unsigned CandidateMask(const char *at, size_t length, __m128i first, __m128i last, __m128i foldFirst,
+                           __m128i foldLast)
+    {
+        __m128i heads = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(at)), foldFirst);
+        __m128i tails = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(at + length - 1)), foldLast);
+        return static_cast<unsigned>(
+            _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(heads, first), _mm_cmpeq_epi8(tails, last))));
+    }
+
+    unsigned LowestBit(unsigned mask)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return index;
+#else
+        return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+    }
+#endif
+
+    bool IsGlob(const std::string &text)
+    {
+        return text.find_first_of("*?[") != std::string::npos;
+    }
+
+    // Where the [...] set starting at start ends (the index of its ']'), or npos. A ']' right
+    // after the '[' or a leading '!' or '^' belongs to the set.
+    size_t SetEnd(const std::string &glob, size_t start)
+    {
+        size_t i = start + 1;
+        if (i < glob.size() && (glob[i] == '!' || glob[i] == '^'))
+            i++;
+        if (i < glob.size() && glob[i] == ']')
+            i++;
+        return glob.find(']', i);
+    }
+
+    // Matches c against the glob element at p, setting next to the element after it.
+    bool MatchElement(const std::string &glob, size_t p, char c, size_t &next)
+    {
+        if (glob[p] == '?')
+        {
+            next = p + 1;
+            return true;
+        }
+        if (glob[p] != '[')
+        {
+            next = p + 1;
+            return glob[p] == c;
+        }
+        size_t end = SetEnd(glob, p);
+        next = end + 1;
+        size_t i = p + 1;
+        bool negated = glob[i] == '!' || glob[i] == '^';
+        if (negated)
+            i++;
+        bool found = false;
+        for (; i < end; i++)
+        {
+            if (i + 2 < end && glob[i + 1] == '-')
+            {
+                found = found || (c >= glob[i] && c <= glob[i + 2]);
+                i += 2;
+            }
+            else
+            {
+                found = found || glob[i] == c;
+            }
+        }
+        return found != negated;
+    }
+
+    // The longest run of characters every match of the glob contains.
+    std::string GlobLiteral(const std::string &glob)
+    {
+        std::string best, run;
+        for (size_t i = 0; i < glob.size(); i++)
+        {
+            char c = glob[i];
+            if (c == '*' || c == '?' || c == '[')
+            {
+                if (run.size() > best.size())
+                    best = run;
+                run.clear();
+                if (c == '[')
+                    i = SetEnd(glob, i);
+            }
+            else
+            {
+                run += c;
+            }
+        }
+        return run.size() > best.size() ? run : best;
+    }
+
+    // The characters before the glob's first wildcard and after its last one.
+    void GlobAnchors(const std::string &glob, std::string &prefix, std::string &suffix)
+    {
+        size_t firstWild = std::string::npos, afterLastWild = 0;
+        for (size_t i = 0; i < glob.size(); i++)
+        {
+            if (glob[i] != '*' && glob[i] != '?' && glob[i] != '[')
+                continue;
+            firstWild = std::min(firstWild, i);
+            if (glob[i] == '[')
+                i = SetEnd(glob, i);
+            afterLastWild = i + 1;
+        }
+        prefix = glob.substr(0, firstWild);
+        suffix = glob.substr(afterLastWild);
+    }
+
+    // The characters every match of a regex anchored with ^ starts with.
+    std::string RegexPrefix(const std::string &regex)
+    {
+        if (regex.empty() || regex[0] != '^' || regex.find('|') != std::string::npos)
+            return "";
+        size_t end = regex.find_first_of(".^$*+?{}[]()|\\", 1);
+        if (end == std::string::npos)
+            end = regex.size();
+        std::string prefix = regex.substr(1, end - 1);
+        // A quantifier that allows zero repeats makes the last character optional.
+        if (end < regex.size() && (regex[end] == '*' || regex[end] == '?' || regex[end] == '{') && !prefix.empty())
+            prefix.pop_back();
+        return prefix;
+    }
+
+    // The value of two hex digits, or -1.
+    int HexByte(char high, char low)
+    {
+        auto digit = [](char c)
+        {
+            c = FoldCase(c);
+            return c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        };
+        return digit(high) < 0 || digit(low) < 0 ? -1 : digit(high) * 16 + digit(low);
+    }
+
+    // The character the escape at regex[i] stands for, if it is one: an escaped punctuation
+    // mark, \xHH, \t, \n, \r, \f, \v or \0. Moves i to the escape's last character; returns -1
+    // (leaving i alone) for any other escape.
+    int CharacterEscape(const std::string &regex, size_t &i)
+    {
+        if (i + 1 >= regex.size())
+            return -1;
+        char next = regex[i + 1];
+        if (!std::isalnum(static_cast<unsigned char>(next)))
+        {
+            i++;
+            return static_cast<unsigned char>(next);
+        }
+        int value;
+        if (next == 'x' && i + 3 < regex.size() && (value = HexByte(regex[i + 2], regex[i + 3])) >= 0)
+        {
+            i += 3;
+            return value;
+        }
+        static const char CONTROLS[] = "t\tn\nr\rf\fv\v";
+        for (size_t k = 0; k + 1 < sizeof(CONTROLS); k += 2)
+        {
+            if (next == CONTROLS[k])
+            {
+                i++;
+                return CONTROLS[k + 1];
+            }
+        }
+        if (next == '0' && (i + 2 >= regex.size() || !std::isdigit(static_cast<unsigned char>(regex[i + 2]))))
+        {
+            i++;
+            return 0;
+        }
+        return -1;
+    }
+
+    // Adds the other case of every letter in set, as case-insensitive matching does.
+    void FoldSet(std::bitset<256> &set)
+    {
+        for (int c = 'a'; c <= 'z'; c++)
+        {
+            if (set[c] || set[c - 'a' + 'A'])
+            {
+                set.set(c);
+                set.set(c - 'a' + 'A');
+            }
+        }
+    }
+
+    // The set of characters \d, \w, \s, \D, \W or \S (named by letter) stands for; false for
+    // any other letter.
+    bool ClassEscape(char letter, std::bitset<256> &set)
+    {
+        std::bitset<256> members;
+        for (int c = 0; c < 128; c++)
+        {
+            switch (FoldCase(letter))
+            {
+            case 'd':
+                members[c] = std::isdigit(c) != 0;
+                break;
+            case 'w':
+                members[c] = std::isalnum(c) || c == '_';
+                break;
+            case 's':
+                members[c] = std::isspace(c) != 0;
+                break;
+            default:
+                return false;
+            }
+        }
+        set = letter >= 'A' && letter <= 'Z' ? ~members : members;
+        return true;
+    }
+
+    // Reads the [...] set starting at regex[start] into set and moves end to its ']'. False if
+    // the set holds anything but characters, ranges and class escapes.
+    bool ParseRegexSet(const std::string &regex, size_t start, std::bitset<256> &set, size_t &end)
+    {
+        size_t i = start + 1;
+        bool negated = i < regex.size() && regex[i] == '^';
+        if (negated)
+            i++;
+        // "[]" and "[^]" mean different things in different grammars, and "[[:alpha:]]" and
+        // friends are not characters.
+        if (i < regex.size() && regex[i] == ']')
+            return false;
+        std::bitset<256> members;
+        auto single = [&](int &c)
+        {
+            if (regex[i] == '[')
+                return false;
+            c = regex[i] == '\\' ? CharacterEscape(regex, i) : static_cast<unsigned char>(regex[i]);
+            return c >= 0;
+        };
+        for (; i < regex.size() && regex[i] != ']'; i++)
+        {
+            std::bitset<256> escaped;
+            if (regex[i] == '\\' && i + 1 < regex.size() && ClassEscape(regex[i + 1], escaped))
+            {
+                members |= escaped;
+                i++;
+                continue;
+            }
+            int low, high;
+            if (!single(low))
+                return false;
+            high = low;
+            if (i + 2 < regex.size() && regex[i + 1] == '-' && regex[i + 2] != ']')
+            {
+                i += 2;
+                if (!single(high) || high < low)
+                    return false;
+            }
+            for (int c = low; c <= high; c++)
+                members.set(c);
+        }
+        if (i >= regex.size())
+            return false;
+        FoldSet(members);
+        set = negated ? ~members : members;
+        end = i;
+        return true;
+    }
+
+    // Reads the quantifier at regex[i] (*, +, ?, {n}, {n,} or {n,m}, lazy or not) and moves i
+    // to its last character. Laziness is dropped: it changes which match is found, not whether
+    // there is one.
+    bool ParseQuantifier(const std::string &regex, size_t &i, size_t &min, size_t &max)
+    {
+        auto number = [&](size_t &at, size_t &value)
+        {
+            size_t digits = 0;
+            for (value = 0; at < regex.size() && std::isdigit(static_cast<unsigned char>(regex[at])); at++)
+            {
+                value = value * 10 + (regex[at] - '0');
+                if (++digits > 6)
+                    return false;
+            }
+            return digits > 0;
+        };
+        switch (regex[i])
+        {
+        case '*':
+            min = 0;
+            max = std::string::npos;
+            break;
+        case '+':
+            min = 1;
+            max = std::string::npos;
+            break;
+        case '?':
+            min = 0;
+            max = 1;
+            break;
+        case '{':
+        {
+            size_t at = i + 1;
+            if (!number(at, min) || at >= regex.size())
+                return false;
+            max = min;
+            if (regex[at] == ',')
+            {
+                at++;
+                max = std::string::npos;
+                if (at < regex.size() && regex[at] != '}' && (!number(at, max) || max < min))
+                    return false;
+            }
+            if (at >= regex.size() || regex[at] != '}')
+                return false;
+            i = at;
+            break;
+        }
+        default:
+            return false;
+        }
+        if (i + 1 < regex.size() && regex[i + 1] == '?')
+            i++;
+        return true;
+    }
+
+    // Whether a quantifier follows another, as in a+* or a{2}?? (a lazy ? aside). ECMAScript
+    // rejects that, but some std::regex implementations nest the two, which the literal
+    // analysis does not model.
+    bool HasStackedQuantifier(const std::string &regex)
+    {
+        for (size_t i = 0; i < regex.size(); i++)
+        {
+            size_t min, max;
+            if (regex[i] == '\\')
+            {
+                i++;
+            }
+            else if (regex[i] == '[')
+            {
+                while (i < regex.size() && regex[i] != ']')
+                    i += regex[i] == '\\' ? 2 : 1;
+            }
+            else if (i > 0 && regex[i - 1] != '(' && regex[i - 1] != '|' && ParseQuantifier(regex, i, min, max) &&
+                     i + 1 < regex.size() && std::strchr("*+?{", regex[i + 1]))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Which (atom, position) pairs a simple regex has failed to match from during the current
+    // search. Cells are stamped with the search's number, so they never need clearing.
+    struct RegexFailures
+    {
+        std::vector<uint32_t> cells;
+        uint32_t search = 0;
+        size_t stride = 0;
+    };
+
+    thread_local RegexFailures regexFailures;
+
+    // The longest run of characters every match of an ECMAScript regex contains. Patterns with
+    // alternation or groups are not analyzed; they get no prefilter.
+    std::string RegexLiteral(const std::string &regex)
+    {
+        if (regex.find_first_of("|(") != std::string::npos)
+            return "";
+        std::string best, run;
+        auto endRun = [&]()
+        {
+            if (run.size() > best.size())
+                best = run;
+            run.clear();
+        };
+        for (size_t i = 0; i < regex.size(); i++)
+        {
+            char c = regex[i];
+            switch (c)
+            {
+            case '\\':
+            {
+                // \d, \w, \s and \b (and their negations) are classes or assertions. Any other
+                // escape that is not a single character, such as \uHHHH, \cX or a back reference,
+                // spans characters this does not decode, so nothing after it is relied on.
+                char next = i + 1 < regex.size() ? regex[i + 1] : '\0';
+                int value = CharacterEscape(regex, i);
+                if (value >= 0)
+                {
+                    run += static_cast<char>(value);
+                }
+                else if (next != '\0' && std::strchr("dDwWsSbB", next))
+                {
+                    endRun();
+                    i++;
+                }
+                else
+                {
+                    endRun();
+                    return best;
+                }
+                break;
+            }
+            case '[':
+                endRun();
+                while (i < regex.size() && regex[i] != ']')
+                    i += regex[i] == '\\' ? 2 : 1;
+                break;
+            case '*':
+            case '?':
+            case '{':
+                // The character before may repeat zero times, so it is not required.
+                if (!run.empty())
+                    run.pop_back();
+                endRun();
+                if (c == '{')
+                    i = std::min(regex.find('}', i), regex.size());
+                break;
+            case '+':
+                endRun();
+                break;
+            case '.':
+            case '^':
+            case '$':
+                endRun();
+                break;
+            default:
+                run += c;
+                break;
+            }
+        }
+        endRun();
+        return best;
+    }
+}
+
+bool ContainsIgnoringCase(std::string_view haystack, std::string_view lowerNeedle)
+{
+    size_t length = lowerNeedle.size();
+    if (length == 0)
+        return true;
+    if (haystack.size() < length)
+        return false;
+    size_t lastStart = haystack.size() - length;
+    size_t i = 0;
+#if NAME_SELECTOR_SSE2
+    // Compare the needle's first and last characters at 16 starting positions at once, then
+    // check the rest only where both match. Setting bit 0x20 folds an upper-case letter to
+    // lower case, and is only done where the needle character is a letter.
+    auto foldFor = [](char c)
+    { return _mm_set1_epi8(c >= 'a' && c <= 'z' ? 0x20 : 0); };
+    const __m128i first = _mm_set1_epi8(lowerNeedle[0]);
+    const __m128i last = _mm_set1_epi8(lowerNeedle[length - 1]);
+    const __m128i foldFirst = foldFor(lowerNeedle[0]);
+    const __m128i foldLast = foldFor(lowerNeedle[length - 1]);
+    for (;; i += 16)
+    {
+        unsigned mask;
+        if (i + 16 <= lastStart + 1)
+            mask = CandidateMask(haystack.data() + i, length, first, last, foldFirst, foldLast);
+        else if (i <= lastStart && SafeToLoad16(haystack.data() + i) &&
+                 SafeToLoad16(haystack.data() + i + length - 1))
+            mask = CandidateMask(haystack.data() + i, length, first, last, foldFirst, foldLast) &
+                   ((1u << (lastStart - i + 1)) - 1);
+        else
+            break;
+        while (mask)
+        {
+            if (EqualsAt(haystack, i + LowestBit(mask), lowerNeedle))
+                return true;
+            mask &= mask - 1;
+        }
+        if (i + 16 > lastStart)
+            return false;
+    }
+#endif
+    for (; i <= lastStart; i++)
+    {
+        if (EqualsAt(haystack, i, lowerNeedle))
+            return true;
+    }
+    return false;
+}
+
+std::shared_ptr<const NameSelector> NameSelector::Parse(const std::string &text)
+{
+    bool isRegex = text.compare(0, 3, "re:") == 0;
+    if (!isRegex && !IsGlob(text))
+        return nullptr;
+
+    auto selector = std::make_shared<NameSelector>();
+    selector->text = text;
+    selector->isRegex = isRegex;
+    if (isRegex)
+    {
+        std::string regex = text.substr(3);
+        try
+        {
+            selector->pattern = std::regex(regex, std::regex::ECMAScript | std::regex::icase | std::regex::optimize);
+        }
+        catch (const std::regex_error &)
+        {
+            throw std::invalid_argument("Error: Invalid regular expression '" + regex + "'.");
+        }
+        if (HasStackedQuantifier(regex))
+            throw std::invalid_argument("Error: Invalid regular expression '" + regex + "'.");
+        selector->simpleRegex = selector->CompileAtoms(regex);
+        if (!selector->simpleRegex)
+        {
+            selector->atoms.clear();
+            selector->suffix.clear();
+            selector->prefix = FoldCase(RegexPrefix(regex));
+        }
+        selector->literal = FoldCase(RegexLiteral(regex));
+    }
+    else
+    {
+        selector->glob = FoldCase(text);
+        for (size_t i = 0; i < selector->glob.size(); i++)
+        {
+            if (selector->glob[i] != '[')
+                continue;
+            i = SetEnd(selector->glob, i);
+            if (i == std::string::npos)
+                throw std::invalid_argument("Error: Unterminated [ in service name pattern '" + text + "'.");
+        }
+        selector->literal = GlobLiteral(selector->glob);
+        GlobAnchors(selector->glob, selector->prefix, selector->suffix);
+    }
+    // The anchors are checked first; a literal no longer than them adds nothing.
+    if (selector->literal.size() <= std::max(selector->prefix.size(), selector->suffix.size()))
+        selector->literal.clear();
+    return selector;
+}
+
+std::shared_ptr<const NameSelector> ParseServiceSelector(const std::string &serverName, const std::string &text)
+{
+    if (text.compare(0, 3, "re:") != 0 && !IsGlob(text))
+        return nullptr;
+    // A service that cannot be opened for another reason, such as access denied, exists.
+    ScHandle scm = OpenSCManagerShared(serverName, SC_MANAGER_CONNECT);
+    if (scm && (OpenServiceShared(scm, text, SERVICE_QUERY_STATUS) ||
+                (GetLastError() != ERROR_SERVICE_DOES_NOT_EXIST && GetLastError() != ERROR_INVALID_NAME)))
+        return nullptr;
+    return NameSelector::Parse(text);
+}
+
+bool NameSelector::CompileAtoms(const std::string &regex)
+{
+    // A $ at the end anchors unless it is escaped.
+    size_t begin = 0, end = regex.size();
+    anchorStart = !regex.empty() && regex[0] == '^';
+    if (anchorStart)
+        begin = 1;
+    if (end > begin && regex[end - 1] == '$')
+    {
+        size_t backslashes = 0;
+        while (end - 1 - backslashes > begin && regex[end - 2 - backslashes] == '\\')
+            backslashes++;
+        anchorEnd = backslashes % 2 == 0;
+        if (anchorEnd)
+            end--;
+    }
+    std::string body = regex.substr(begin, end - begin);
+    for (size_t i = 0; i < body.size(); i++)
+    {
+        RegexAtom atom;
+        int value;
+        switch (body[i])
+        {
+        case '.':
+            atom.set.set();
+            atom.set.reset('\n');
+            atom.set.reset('\r');
+            break;
+        case '[':
+            if (!ParseRegexSet(body, i, atom.set, i))
+                return false;
+            break;
+        case '\\':
+            if (i + 1 < body.size() && ClassEscape(body[i + 1], atom.set))
+            {
+                i++;
+                break;
+            }
+            if ((value = CharacterEscape(body, i)) < 0)
+                return false;
+            atom.set.set(value);
+            FoldSet(atom.set);
+            break;
+        case '^':
+        case '$':
+        case '(':
+        case ')':
+        case '|':
+        case '*':
+        case '+':
+        case '?':
+        case '{':
+        case '}':
+        case ']':
+            return false;
+        default:
+            atom.set.set(static_cast<unsigned char>(body[i]));
+            FoldSet(atom.set);
+            break;
+        }
+        if (i + 1 < body.size() && std::strchr("*+?{", body[i + 1]) && !ParseQuantifier(body, ++i, atom.min, atom.max))
+            return false;
+        atoms.push_back(atom);
+    }
+
+    // Characters every match starts (with ^) or ends (with $) with go in the prefix and suffix,
+    // which Matches checks first; the matcher skips their atoms.
+    auto single = [](const RegexAtom &atom)
+    {
+        size_t count = atom.set.count();
+        if (atom.min != 1 || atom.max != 1 || count > 2)
+            return -1;
+        for (int c = 0; c < 256; c++)
+        {
+            if (atom.set[c])
+                return count == 1 || (c >= 'A' && c <= 'Z' && atom.set[c | 0x20]) ? c : -1;
+        }
+        return -1;
+    };
+    firstAtom = 0;
+    lastAtom = atoms.size();
+    prefix.clear();
+    suffix.clear();
+    int c;
+    while (anchorStart && firstAtom < lastAtom && (c = single(atoms[firstAtom])) >= 0)
+    {
+        prefix += FoldCase(static_cast<char>(c));
+        firstAtom++;
+    }
+    while (anchorEnd && lastAtom > firstAtom && (c = single(atoms[lastAtom - 1])) >= 0)
+    {
+        suffix.insert(suffix.begin(), FoldCase(static_cast<char>(c)));
+        lastAtom--;
+    }
+    // With one repeated atom at most, backtracking is linear and needs no memory of failures.
+    size_t repeated = 0;
+    for (size_t i = firstAtom; i < lastAtom; i++)
+        repeated += atoms[i].min != atoms[i].max;
+    rememberFailures = repeated > 1;
+    return true;
+}
+
+bool NameSelector::MatchAtomsAt(std::string_view name, size_t atom, size_t pos) const
+{
+    if (atom == lastAtom)
+        return !anchorEnd || pos == name.size() - suffix.size();
+    // Whether the atoms from here on match from pos does not depend on how pos was reached, so
+    // a failure holds for the rest of the search; remembering it keeps patterns like a*a*a*b
+    // from backtracking exponentially.
+    uint32_t *failed = rememberFailures ? &regexFailures.cells[atom * regexFailures.stride + pos] : nullptr;
+    if (failed && *failed == regexFailures.search)
+        return false;
+    const RegexAtom &current = atoms[atom];
+    size_t count = 0;
+    while (count < current.max && pos + count < name.size() &&
+           current.set[static_cast<unsigned char>(name[pos + count])])
+        count++;
+    for (size_t taken = count + 1; taken-- > current.min;)
+    {
+        if (MatchAtomsAt(name, atom + 1, pos + taken))
+            return true;
+    }
+    if (failed)
+        *failed = regexFailures.search;
+    return false;
+}
+
+bool NameSelector::MatchAtoms(std::string_view name) const
+{
+    if (rememberFailures)
+    {
+        RegexFailures &failures = regexFailures;
+        failures.stride = name.size() + 1;
+        if (failures.cells.size() < atoms.size() * failures.stride)
+            failures.cells.resize(atoms.size() * failures.stride);
+        if (++failures.search == 0)
+        {
+            std::fill(failures.cells.begin(), failures.cells.end(), 0);
+            failures.search = 1;
+        }
+    }
+    // The prefix is already known to match, so an anchored search starts after it.
+    size_t lastStart = anchorStart ? prefix.size() : name.size();
+    for (size_t start = anchorStart ? prefix.size() : 0; start <= lastStart; start++)
+    {
+        if (MatchAtomsAt(name, firstAtom, start))
+            return true;
+    }
+    return false;
+}
+
+bool NameSelector::MatchGlob(std::string_view name) const
+{
+    // Backtracking to the last * is enough: a later * can always absorb what an earlier one would.
+    size_t p = 0, n = 0;
+    size_t starP = std::string::npos, starN = 0;
+    while (n < name.size())
+    {
+        size_t next;
+        if (p < glob.size() && glob[p] == '*')
+        {
+            starP = ++p;
+            starN = n;
+            continue;
+        }
+        if (p < glob.size() && MatchElement(glob, p, FoldCase(name[n]), next))
+        {
+            p = next;
+            n++;
+            continue;
+        }
+        if (starP == std::string::npos)
+            return false;
+        p = starP;
+        n = ++starN;
+    }
+    while (p < glob.size() && glob[p] == '*')
+        p++;
+    return p == glob.size();
+}
+
+bool NameSelector::Matches(std::string_view name) const
+{
+    if (name.size() < prefix.size() + suffix.size() || !EqualsAt(name, 0, prefix) ||
+        !EqualsAt(name, name.size() - suffix.size(), suffix) || !ContainsIgnoringCase(name, literal))
+        return false;
+    if (simpleRegex)
+        return MatchAtoms(name);
+    if (isRegex)
+    {
+        // Reusing the match results keeps regex_search from allocating them on every call.
+        thread_local std::match_results<std::string_view::const_iterator> match;
+        return std::regex_search(name.begin(), name.end(), match, pattern);
+    }
+    return MatchGlob(name);
+}
+
+bool SelectServices(const std::string &serverName, const NameSelector &selector, std::vector<std::string> &names)
+{
+    ScHandle scm = OpenSCManagerShared(serverName, SC_MANAGER_ENUMERATE_SERVICE);
+    if (!scm)
+        return false;
+    return EnumerateServicePages(scm, SERVICE_DRIVER | SERVICE_WIN32, SERVICE_STATE_ALL, nullptr, 0, 0,
+                                 [&](const ENUM_SERVICE_STATUS_PROCESSA *services, DWORD count)
+                                 {
+                                     for (DWORD i = 0; i < count; i++)
+                                     {
+                                         if (selector.Matches(services[i].lpServiceName))
+                                             names.emplace_back(services[i].lpServiceName);
+                                     }
+                                     return true;
+                                 });
+}
+
+bool ForEachSelectedService(const std::string &serverName, const NameSelector &selector, const char *verb,
+                            size_t parallelism, std::chrono::milliseconds timeout,
+                            const std::function<bool(const std::string &serviceName)> &action)
+{
+    std::vector<std::string> names;
+    if (!SelectServices(serverName, selector, names))
+    {
+        ScErr() << "EnumServicesStatusEx failed, error: " << GetLastError() << "\n";
+        return false;
+    }
+    if (names.empty())
+    {
+        ScErr() << "[SC] No service matches \"" << selector.Text() << "\".\n";
+        return false;
+    }
+
+    std::vector<BoundedTask> tasks;
+    tasks.reserve(names.size());
+    // Timed-out tasks are abandoned, not joined, so each task owns what it uses.
+    for (const std::string &name : names)
+        tasks.push_back([action, name]()
+                        { return action(name); });
+
+    auto began = std::chrono::steady_clock::now();
+    size_t succeeded = 0, failed = 0, timedOut = 0;
+    RunBoundedTasks(tasks, parallelism, timeout,
+                    [&](const TaskOutcome &outcome)
+                    {
+                        const char *status = outcome.timedOut ? "TIMEOUT" : outcome.ok ? "SUCCESS" : "FAILED";
+                        if (outcome.timedOut)
+                            ++timedOut;
+                        else if (outcome.ok)
+                            ++succeeded;
+                        else
+                            ++failed;
+
+                        std::ostream &out = ScOut();
+                        out << "[SC] " << verb << " " << names[outcome.index] << ": " << status << " ("
+                            << outcome.elapsedMs << " ms)\n"
+                            << outcome.output;
+                        if (!outcome.output.empty() && outcome.output.back() != '\n')
+                            out << "\n";
+                        out.flush();
+                    });
+
+    auto total = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - began);
+    ScOut() << "[SC] " << verb << " " << names.size() << " service(s) matching \"" << selector.Text() << "\", "
+            << succeeded << " succeeded, " << failed << " failed, " << timedOut << " timed out, " << total.count()
+            << " ms\n";
+    return failed == 0 && timedOut == 0;
+}
@@ -0,0 +1,97 @@
+#ifndef NAME_SELECTOR_H
+#define NAME_SELECTOR_H
+
+#include <bitset>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Parallelism and per-service time limit for config, failure and delete over a selector;
+// start and stop use parallel= and their own wait limit.
+constexpr size_t DEFAULT_SELECTOR_PARALLELISM = 8;
+constexpr std::chrono::milliseconds DEFAULT_SELECTOR_TIMEOUT{60000};
+
+// A service name pattern given where a command takes a service name: a glob when the name
+// contains *, ? or [...] (matched against the whole name), or a regular expression after
+// "re:" (searched for anywhere in the name; anchor it with ^ and $). Matching ignores case,
+// as the SCM does. In a glob, [*], [?] and [[] match the character itself.
+//
+// Each selector keeps the characters every match starts and ends with, and the longest
+// literal every match must contain. Matches compares the ends first, then looks for the
+// literal with a vectorized case-insensitive substring search, so the glob or regex only
+// runs on names that pass both.
+//
+// A regex made only of characters, sets, \d, \w, \s, . and quantifiers, with ^ and $ only at
+// its ends, runs on a small backtracking matcher over byte sets that does not allocate.
+// Groups, alternation, back references and \b go to std::regex, which is many times slower
+// over a large enumeration.
+class NameSelector
+{
+public:
+    // Returns nullptr if text is an ordinary service name.
+    // Throws std::invalid_argument if it is a malformed pattern.
+    static std::shared_ptr<const NameSelector> Parse(const std::string &text);
+
+    bool Matches(std::string_view name) const;
+
+    const std::string &Text() const { return text; }
+    // The lower-cased literal the substring prefilter looks for; empty when the pattern has
+    // none longer than its anchored ends.
+    const std::string &RequiredLiteral() const { return literal; }
+
+private:
+    // One element of a simple regex: a character in set, repeated min to max times.
+    struct RegexAtom
+    {
+        std::bitset<256> set;
+        size_t min = 1;
+        size_t max = 1;
+    };
+
+    bool MatchGlob(std::string_view name) const;
+    // Compiles a simple regex into atoms; false if it uses anything else.
+    bool CompileAtoms(const std::string &regex);
+    bool MatchAtoms(std::string_view name) const;
+    bool MatchAtomsAt(std::string_view name, size_t atom, size_t pos) const;
+
+    std::string text;
+    bool isRegex = false;
+    std::string glob; // Lower-cased.
+    std::regex pattern;
+    std::vector<RegexAtom> atoms; // Used instead of pattern when simpleRegex is set.
+    bool simpleRegex = false;
+    size_t firstAtom = 0; // The atoms outside [firstAtom, lastAtom) are the prefix and suffix.
+    size_t lastAtom = 0;
+    bool rememberFailures = false;
+    bool anchorStart = false;
+    bool anchorEnd = false;
+    std::string prefix; // Lower-cased characters every match starts with.
+    std::string suffix; // Lower-cased characters every match ends with.
+    std::string literal;
+};
+
+// Parse for commands that change services: a name that looks like a pattern but is the exact
+// name of a service on serverName names that service alone, so "sc delete Foo[1]" deletes
+// Foo[1] when it exists rather than Foo1.
+std::shared_ptr<const NameSelector> ParseServiceSelector(const std::string &serverName, const std::string &text);
+
+// Case-insensitive search for a lower-cased needle, 16 bytes at a time where SSE2 is available.
+bool ContainsIgnoringCase(std::string_view haystack, std::string_view lowerNeedle);
+
+// The names of the services and drivers on serverName that selector matches, in
+// enumeration order. Returns false (GetLastError() set) if they cannot be enumerated.
+bool SelectServices(const std::string &serverName, const NameSelector &selector, std::vector<std::string> &names);
+
+// Runs action for every service selector matches, up to 'parallelism' at once, and prints
+// each one's output as a block headed "[SC] <verb> <name>: <status>", then a summary line.
+// Returns true if something matched and every action succeeded.
+bool ForEachSelectedService(const std::string &serverName, const NameSelector &selector, const char *verb,
+                            size_t parallelism, std::chrono::milliseconds timeout,
+                            const std::function<bool(const std::string &serviceName)> &action);
+
+#endif // NAME_SELECTOR_H
@@ -0,0 +1,165 @@
+#include "option_schema.h"
+#include <stdexcept>
+
+namespace
+{
+    enum class ServiceOption
+    {
+        Type,
+        Start,
+        Error,
+        BinPath,
+        Group,
+        Tag,
+        Depend,
+        Obj,
+        DisplayName,
+        Password
+    };
+
+    constexpr auto SERVICE_OPTIONS = MakeKeywordTable<ServiceOption>({
+        {"type", ServiceOption::Type},
+        {"start", ServiceOption::Start},
+        {"error", ServiceOption::Error},
+        {"binpath", ServiceOption::BinPath},
+        {"group", ServiceOption::Group},
+        {"tag", ServiceOption::Tag},
+        {"depend", ServiceOption::Depend},
+        {"obj", ServiceOption::Obj},
+        {"displayname", ServiceOption::DisplayName},
+        {"password", ServiceOption::Password},
+    });
+
+    static_assert(SERVICE_OPTIONS.Valid(), "no perfect hash for the create/config options");
+    static_assert(SERVICE_TYPE_VALUES.Valid() && INTERACT_TYPE_VALUES.Valid() && START_TYPE_VALUES.Valid() &&
+                      ERROR_CONTROL_VALUES.Valid() && YES_NO_VALUES.Valid() && FAILURE_ACTION_VALUES.Valid() &&
+                      ENUM_TYPE_VALUES.Valid() && ENUM_SERVICE_TYPE_VALUES.Valid() && STATE_VALUES.Valid(),
+                  "no perfect hash for an option value table");
+} // end anonymous namespace
+
+void ParseServiceSettings(const std::vector<std::string> &args, size_t first, bool createOptions,
+                          ServiceSettings &settings)
+{
+    // The "type" option may appear twice when the first occurrence is "interact".
+    bool firstTypeProvided = false;
+    bool interact = false;
+    bool secondTypeProvided = false;
+
+    size_t i = first;
+    while (i < args.size())
+    {
+        const std::string &token = args[i];
+        if (token.size() < 2 || token.back() != '=')
+        {
+            throw std::invalid_argument("Error: Invalid option format '" + token + "'. Expected key= followed by a value.");
+        }
+        std::string_view key(token.data(), token.size() - 1);
+        i++;
+        if (i >= args.size())
+        {
+            throw std::invalid_argument("Error: Missing value for option '" + token + "'.");
+        }
+        const std::string &value = args[i];
+        i++;
+
+        const ServiceOption *option = SERVICE_OPTIONS.Find(key);
+        if (!option)
+        {
+            throw std::invalid_argument("Error: Unknown option '" + token + "'.");
+        }
+        switch (*option)
+        {
+        case ServiceOption::Type:
+            if (!firstTypeProvided)
+            {
+                const DWORD *type = SERVICE_TYPE_VALUES.Find(value);
+                if (createOptions && (!type || *type == SERVICE_DRIVER))
+                {
+                    throw std::invalid_argument("Error: Invalid value for type. Allowed: own, share, kernel, filesys, rec, interact.");
+                }
+                if (!type)
+                {
+                    throw std::invalid_argument("Error: Invalid value for type. Allowed: " + SERVICE_TYPE_VALUES.Names() + ".");
+                }
+                settings.serviceType = *type;
+                interact = *type == SERVICE_INTERACTIVE_PROCESS;
+                firstTypeProvided = true;
+            }
+            else
+            {
+                // Second occurrence is allowed only if the first was "interact".
+                if (!interact)
+                {
+                    throw std::invalid_argument("Error: Unexpected second type parameter when first type is not 'interact'.");
+                }
+                const DWORD *type = INTERACT_TYPE_VALUES.Find(value);
+                if (!type)
+                {
+                    throw std::invalid_argument("Error: Invalid value for second type. Allowed: " + INTERACT_TYPE_VALUES.Names() + ".");
+                }
+                settings.serviceType = SERVICE_INTERACTIVE_PROCESS | *type;
+                secondTypeProvided = true;
+            }
+            break;
+        case ServiceOption::Start:
+        {
+            const StartTypeValue *start = START_TYPE_VALUES.Find(value);
+            if (!start)
+            {
+                throw std::invalid_argument("Error: Invalid start type. Allowed: " + START_TYPE_VALUES.Names() + ".");
+            }
+            settings.startType = start->startType;
+            settings.delayedAutoStart = start->delayed;
+            break;
+        }
+        case ServiceOption::Error:
+        {
+            const DWORD *errorControl = ERROR_CONTROL_VALUES.Find(value);
+            if (!errorControl)
+            {
+                throw std::invalid_argument("Error: Invalid error control value. Allowed: " + ERROR_CONTROL_VALUES.Names() + ".");
+            }
+            settings.errorControl = *errorControl;
+            break;
+        }
+        case ServiceOption::BinPath:
+            settings.binpath = value;
+            break;
+        case ServiceOption::Group:
+            settings.group = value;
+            break;
+        case ServiceOption::Tag:
+        {
+            const bool *tag = YES_NO_VALUES.Find(value);
+            if (!tag)
+            {
+                throw std::invalid_argument("Error: Invalid tag value. Allowed: " + YES_NO_VALUES.Names() + ".");
+            }
+            settings.requestTag = *tag;
+            break;
+        }
+        case ServiceOption::Depend:
+            settings.depend = value;
+            break;
+        case ServiceOption::Obj:
+            settings.obj = value;
+            break;
+        case ServiceOption::DisplayName:
+            settings.displayname = value;
+            break;
+        case ServiceOption::Password:
+            settings.password = value;
+            break;
+        }
+    }
+
+    if (createOptions && settings.binpath.empty())
+    {
+        throw std::invalid_argument("Error: binpath parameter is required.");
+    }
+    // If the first type is "interact", then a second type must be provided.
+    if (interact && !secondTypeProvided)
+    {
+        throw std::invalid_argument("Error: When type is 'interact', a second type parameter (own/share) must be provided.");
+    }
+}
@@ -0,0 +1,220 @@
+#ifndef OPTION_SCHEMA_H
+#define OPTION_SCHEMA_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "win32_compat.h"
+
+// A keyword and the value it stands for.
+template <typename T>
+struct Keyword
+{
+    std::string_view name{};
+    T value{};
+};
+
+constexpr char LowerAscii(char c)
+{
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// Seeded FNV-1a over the lower-cased key, so keywords match in any case as sc.exe's options
+// do. The low bits of an FNV product only depend on the low bits of the input, so the high
+// half is folded in before the table masks off a slot.
+constexpr uint32_t KeywordHash(std::string_view key, uint32_t seed)
+{
+    uint32_t hash = 2166136261u ^ seed;
+    for (char c : key)
+    {
+        hash ^= static_cast<unsigned char>(LowerAscii(c));
+        hash *= 16777619u;
+    }
+    return hash ^ (hash >> 16);
+}
+
+constexpr bool KeywordEquals(std::string_view key, std::string_view keyword)
+{
+    if (key.size() != keyword.size())
+        return false;
+    for (size_t i = 0; i < key.size(); i++)
+    {
+        if (LowerAscii(key[i]) != keyword[i])
+            return false;
+    }
+    return true;
+}
+
+// A fixed set of lower-case keywords, looked up through a perfect hash chosen at compile
+// time: the constructor tries seeds until every keyword lands in a slot of its own, so Find
+// hashes the key once and compares it with at most one keyword. Declare tables constexpr and
+// static_assert Valid(), so that a set without a perfect seed fails the build.
+template <typename T, size_t N>
+class KeywordTable
+{
+public:
+    // Twice as many slots as keywords, rounded up to a power of two.
+    static constexpr size_t SLOTS = [] {
+        size_t slots = 1;
+        while (slots < 2 * N)
+            slots *= 2;
+        return slots;
+    }();
+
+    constexpr explicit KeywordTable(const Keyword<T> (&keywords)[N])
+    {
+        for (size_t i = 0; i < N; i++)
+            entries[i] = keywords[i];
+        for (uint32_t candidate = 1; candidate < 65536; candidate++)
+        {
+            if (TrySeed(candidate))
+            {
+                seed = candidate;
+                return;
+            }
+        }
+    }
+
+    constexpr bool Valid() const { return seed != 0; }
+
+    // The value of key, or nullptr if key is not one of the keywords.
+    constexpr const T *Find(std::string_view key) const
+    {
+        uint8_t slot = slots[KeywordHash(key, seed) & (SLOTS - 1)];
+        return slot && KeywordEquals(key, entries[slot - 1].name) ? &entries[slot - 1].value : nullptr;
+    }
+
+    // The keywords in table order, as "a, b, c", for error messages.
+    std::string Names() const
+    {
+        std::string names;
+        for (const Keyword<T> &entry : entries)
+        {
+            if (!names.empty())
+                names += ", ";
+            names.append(entry.name.data(), entry.name.size());
+        }
+        return names;
+    }
+
+private:
+    constexpr bool TrySeed(uint32_t candidate)
+    {
+        for (size_t i = 0; i < SLOTS; i++)
+            slots[i] = 0;
+        for (size_t i = 0; i < N; i++)
+        {
+            size_t slot = KeywordHash(entries[i].name, candidate) & (SLOTS - 1);
+            if (slots[slot])
+                return false;
+            slots[slot] = static_cast<uint8_t>(i + 1);
+        }
+        return true;
+    }
+
+    std::array<Keyword<T>, N> entries{};
+    std::array<uint8_t, SLOTS> slots{}; // Entry index + 1; 0 for an empty slot.
+    uint32_t seed = 0;
+};
+
+template <typename T, size_t N>
+constexpr KeywordTable<T, N> MakeKeywordTable(const Keyword<T> (&keywords)[N])
+{
+    static_assert(N < 256, "slots hold 8-bit entry indexes");
+    return KeywordTable<T, N>(keywords);
+}
+
+// start= values: the start type, and whether it is delayed-auto.
+struct StartTypeValue
+{
+    DWORD startType = SERVICE_DEMAND_START;
+    bool delayed = false;
+};
+
+// Values shared by the create, config, failure, query and qc parsers. Service types map to
+// the SCM type bits; interact is SERVICE_INTERACTIVE_PROCESS, completed by a second type=.
+constexpr auto SERVICE_TYPE_VALUES = MakeKeywordTable<DWORD>({
+    {"own", SERVICE_WIN32_OWN_PROCESS},
+    {"share", SERVICE_WIN32_SHARE_PROCESS},
+    {"kernel", SERVICE_KERNEL_DRIVER},
+    {"filesys", SERVICE_FILE_SYSTEM_DRIVER},
+    {"rec", SERVICE_RECOGNIZER_DRIVER},
+    {"adapt", SERVICE_DRIVER},
+    {"interact", SERVICE_INTERACTIVE_PROCESS},
+});
+constexpr auto INTERACT_TYPE_VALUES = MakeKeywordTable<DWORD>({
+    {"own", SERVICE_WIN32_OWN_PROCESS},
+    {"share", SERVICE_WIN32_SHARE_PROCESS},
+});
+constexpr auto START_TYPE_VALUES = MakeKeywordTable<StartTypeValue>({
+    {"boot", {SERVICE_BOOT_START, false}},
+    {"system", {SERVICE_SYSTEM_START, false}},
+    {"auto", {SERVICE_AUTO_START, false}},
+    {"demand", {SERVICE_DEMAND_START, false}},
+    {"disabled", {SERVICE_DISABLED, false}},
+    {"delayed-auto", {SERVICE_AUTO_START, true}},
+});
+constexpr auto ERROR_CONTROL_VALUES = MakeKeywordTable<DWORD>({
+    {"normal", SERVICE_ERROR_NORMAL},
+    {"severe", SERVICE_ERROR_SEVERE},
+    {"critical", SERVICE_ERROR_CRITICAL},
+    {"ignore", SERVICE_ERROR_IGNORE},
+});
+constexpr auto YES_NO_VALUES = MakeKeywordTable<bool>({
+    {"yes", true},
+    {"no", false},
+});
+constexpr auto FAILURE_ACTION_VALUES = MakeKeywordTable<SC_ACTION_TYPE>({
+    {"run", SC_ACTION_RUN_COMMAND},
+    {"restart", SC_ACTION_RESTART},
+    {"reboot", SC_ACTION_REBOOT},
+});
+// query and qc type=, as EnumServicesStatusEx type masks.
+constexpr auto ENUM_TYPE_VALUES = MakeKeywordTable<DWORD>({
+    {"driver", SERVICE_DRIVER},
+    {"service", SERVICE_WIN32},
+    {"all", SERVICE_DRIVER | SERVICE_WIN32},
+});
+// query's second type=; interact enumerates interactive own-process services.
+constexpr auto ENUM_SERVICE_TYPE_VALUES = MakeKeywordTable<DWORD>({
+    {"own", SERVICE_WIN32_OWN_PROCESS},
+    {"share", SERVICE_WIN32_SHARE_PROCESS},
+    {"interact", SERVICE_WIN32_OWN_PROCESS | SERVICE_INTERACTIVE_PROCESS},
+    {"kernel", SERVICE_KERNEL_DRIVER},
+    {"filesys", SERVICE_FILE_SYSTEM_DRIVER},
+    {"rec", SERVICE_RECOGNIZER_DRIVER},
+    {"adapt", SERVICE_DRIVER},
+});
+constexpr auto STATE_VALUES = MakeKeywordTable<DWORD>({
+    {"active", SERVICE_ACTIVE},
+    {"inactive", SERVICE_INACTIVE},
+    {"all", SERVICE_STATE_ALL},
+});
+
+// The settings create and config take, parsed into the values the SCM calls take. For
+// config, SERVICE_NO_CHANGE and empty strings keep the service's current setting.
+struct ServiceSettings
+{
+    DWORD serviceType = SERVICE_NO_CHANGE;  // SERVICE_* type bits.
+    DWORD startType = SERVICE_NO_CHANGE;    // SERVICE_*_START.
+    bool delayedAutoStart = false;          // start= delayed-auto; startType is then SERVICE_AUTO_START.
+    DWORD errorControl = SERVICE_NO_CHANGE; // SERVICE_ERROR_*.
+    bool requestTag = false;                // tag= yes.
+    std::string binpath;                    // Path to the service binary.
+    std::string group;                      // Load order group.
+    std::string depend;                     // Dependencies separated by '/'; "/" removes them all.
+    std::string obj;                        // Account name.
+    std::string displayname;                // Friendly display name.
+    std::string password;                   // Password.
+};
+
+// Parses the key= value pairs from args[first] on into settings. createOptions restricts
+// the values to those create accepts. Throws std::invalid_argument on the first bad token.
+void ParseServiceSettings(const std::vector<std::string> &args, size_t first, bool createOptions,
+                          ServiceSettings &settings);
+
+#endif // OPTION_SCHEMA_H
@@ -0,0 +1,227 @@
+#include "output_format.h"
+#include "status_format.h"
+
+#include <charconv>
+#include <cstring>
+#include <ostream>
+
+bool ParseOutputFormat(const std::string &value, OutputFormat &format)
+{
+    if (value == "text")
+        format = OutputFormat::Text;
+    else if (value == "json")
+        format = OutputFormat::Json;
+    else if (value == "ndjson")
+        format = OutputFormat::Ndjson;
+    else if (value == "csv")
+        format = OutputFormat::Csv;
+    else
+        return false;
+    return true;
+}
+
+RecordWriter::RecordWriter(std::ostream &out, OutputFormat format) : out(out), format(format) {}
+
+void RecordWriter::WriteStatus(std::string_view serviceName, const char *displayName, const SERVICE_STATUS_PROCESS &ssp)
+{
+    beginRecord();
+    field("service_name", serviceName);
+    if (displayName)
+        field("display_name", displayName);
+    else
+        nullField("display_name");
+    field("type", ssp.dwServiceType);
+    field("state", ssp.dwCurrentState);
+    field("state_name", StateToString(ssp.dwCurrentState));
+    field("controls_accepted", ssp.dwControlsAccepted);
+    field("win32_exit_code", ssp.dwWin32ExitCode);
+    field("service_exit_code", ssp.dwServiceSpecificExitCode);
+    field("checkpoint", ssp.dwCheckPoint);
+    field("wait_hint", ssp.dwWaitHint);
+    field("pid", ssp.dwProcessId);
+    field("flags", ssp.dwServiceFlags);
+    endRecord();
+}
+
+void RecordWriter::WriteConfig(std::string_view serviceName, const sc_service_config &config)
+{
+    auto optionalField = [this](std::string_view name, const char *value)
+    {
+        if (value)
+            field(name, value);
+        else
+            nullField(name);
+    };
+    beginRecord();
+    field("service_name", serviceName);
+    field("type", config.service_type);
+    field("start_type", config.start_type);
+    field("error_control", config.error_control);
+    optionalField("binary_path", config.binary_path);
+    optionalField("load_order_group", config.load_order_group);
+    field("tag", config.tag_id);
+    optionalField("display_name", config.display_name);
+    dependencies.clear();
+    for (const char *p = config.dependencies; p && *p; p += std::strlen(p) + 1)
+    {
+        if (!dependencies.empty())
+            dependencies += '/';
+        dependencies += p;
+    }
+    field("dependencies", dependencies);
+    optionalField("service_start_name", config.service_start_name);
+    endRecord();
+}
+
+void RecordWriter::WriteChange(std::string_view serviceName, std::string_view change, std::string_view fieldName,
+                               std::string_view before, std::string_view after)
+{
+    beginRecord();
+    field("service_name", serviceName);
+    field("change", change);
+    field("field", fieldName);
+    field("before", before);
+    field("after", after);
+    endRecord();
+}
+
+void RecordWriter::WriteDescription(std::string_view serviceName, const char *description)
+{
+    beginRecord();
+    field("service_name", serviceName);
+    if (description)
+        field("description", description);
+    else
+        nullField("description");
+    endRecord();
+}
+
+void RecordWriter::Finish()
+{
+    if (finished)
+        return;
+    finished = true;
+    if (format == OutputFormat::Json)
+        out << (records == 0 ? "[]\n" : "\n]\n");
+    out.flush();
+}
+
+void RecordWriter::beginRecord()
+{
+    // clear() keeps the capacity, so steady-state records do not allocate.
+    buffer.clear();
+    fields = 0;
+    if (format == OutputFormat::Json)
+        buffer += records == 0 ? "[\n{" : ",\n{";
+    else if (format == OutputFormat::Ndjson)
+        buffer += '{';
+}
+
+void RecordWriter::appendName(std::string_view name)
+{
+    if (fields++ > 0)
+        buffer += ',';
+    if (format == OutputFormat::Csv)
+    {
+        // The first record defines the header row.
+        if (records == 0)
+        {
+            if (!header.empty())
+                header += ',';
+            header += name;
+        }
+        return;
+    }
+    buffer += '"';
+    buffer += name;
+    buffer += "\":";
+}
+
+void RecordWriter::appendQuoted(std::string_view value)
+{
+    if (format == OutputFormat::Csv)
+    {
+        if (value.find_first_of(",\"\r\n") == std::string_view::npos)
+        {
+            buffer += value;
+            return;
+        }
+        buffer += '"';
+        for (char c : value)
+        {
+            if (c == '"')
+                buffer += '"';
+            buffer += c;
+        }
+        buffer += '"';
+        return;
+    }
+
+    // JSON string. Bytes outside ASCII are passed through in the ANSI code page.
+    static const char hexDigits[] = "0123456789abcdef";
+    buffer += '"';
+    for (char c : value)
+    {
+        unsigned char u = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\')
+        {
+            buffer += '\\';
+            buffer += c;
+        }
+        else if (c == '\n')
+            buffer += "\\n";
+        else if (c == '\r')
+            buffer += "\\r";
+        else if (c == '\t')
+            buffer += "\\t";
+        else if (u < 0x20)
+        {
+            buffer += "\\u00";
+            buffer += hexDigits[u >> 4];
+            buffer += hexDigits[u & 0xF];
+        }
+        else
+            buffer += c;
+    }
+    buffer += '"';
+}
+
+void RecordWriter::field(std::string_view name, std::string_view value)
+{
+    appendName(name);
+    appendQuoted(value);
+}
+
+void RecordWriter::field(std::string_view name, DWORD value)
+{
+    appendName(name);
+    char digits[16];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    buffer.append(digits, result.ptr);
+}
+
+void RecordWriter::nullField(std::string_view name)
+{
+    appendName(name);
+    if (format != OutputFormat::Csv)
+        buffer += "null";
+}
+
+void RecordWriter::endRecord()
+{
+    if (format == OutputFormat::Csv)
+    {
+        if (records == 0)
+        {
+            header += '\n';
+            out.write(header.data(), static_cast<std::streamsize>(header.size()));
+        }
+        buffer += '\n';
+    }
+    else if (format == OutputFormat::Json)
+        buffer += '}';
+    else
+        buffer += "}\n";
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    records++;
+}
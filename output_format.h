@@ -0,0 +1,69 @@
+#ifndef OUTPUT_FORMAT_H
+#define OUTPUT_FORMAT_H
+
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include "sc_api.h"
+#include "win32_compat.h"
+
+// Output modes selectable with format= on query, qc, qdescription and diff.
+enum class OutputFormat
+{
+    Text,   // The sc.exe-style blocks (default).
+    Json,   // One JSON array, streamed element by element.
+    Ndjson, // One JSON object per line.
+    Csv     // A header row followed by one row per record (RFC 4180 quoting).
+};
+
+// Parses the value of format= ("text", "json", "ndjson" or "csv"). Returns false if unknown.
+bool ParseOutputFormat(const std::string &value, OutputFormat &format);
+
+// Streams flat records in one of the machine-readable formats. Each record is built in a
+// reusable buffer and written with a single call, so consumers can process the output
+// incrementally. CSV takes its header from the field names of the first record.
+class RecordWriter
+{
+public:
+    RecordWriter(std::ostream &out, OutputFormat format);
+    RecordWriter(const RecordWriter &) = delete;
+    RecordWriter &operator=(const RecordWriter &) = delete;
+
+    // Writes one record with the fields of a SERVICE_STATUS_PROCESS. displayName may be null.
+    void WriteStatus(std::string_view serviceName, const char *displayName, const SERVICE_STATUS_PROCESS &ssp);
+
+    // Writes one record with a service configuration. Dependencies are joined with '/',
+    // as config depend= takes them.
+    void WriteConfig(std::string_view serviceName, const sc_service_config &config);
+
+    // Writes one record describing a difference between two snapshots: change is "added",
+    // "removed" or "changed"; field, before and after are empty unless it is "changed".
+    void WriteChange(std::string_view serviceName, std::string_view change, std::string_view field,
+                     std::string_view before, std::string_view after);
+
+    // Writes one record with a service description. description may be null.
+    void WriteDescription(std::string_view serviceName, const char *description);
+
+    // Closes the JSON array (if any) and flushes. Safe to call when no record was written.
+    void Finish();
+
+private:
+    void beginRecord();
+    void field(std::string_view name, std::string_view value);
+    void field(std::string_view name, DWORD value);
+    void nullField(std::string_view name);
+    void endRecord();
+    void appendName(std::string_view name);
+    void appendQuoted(std::string_view value);
+
+    std::ostream &out;
+    OutputFormat format;
+    std::string buffer;
+    std::string header;
+    std::string dependencies; // Reused by WriteConfig.
+    size_t records = 0;
+    size_t fields = 0;
+    bool finished = false;
+};
+
+#endif // OUTPUT_FORMAT_H
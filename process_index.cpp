@@ -0,0 +1,201 @@
+#include "process_index.h"
+#include "console.h"
+#include "query.h"
+#include "scm_handles.h"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+void printBypidHelp()
+{
+    ScOut() << R"(DESCRIPTION:
+        Lists every process that hosts services, with the services running
+        in it, like "tasklist /svc". Use "sc queryex pid= <n>" for the full
+        status of the services in one process.
+USAGE:
+        sc <server> bypid [cache= {yes | no}] [endpoint= <path>]
+
+OPTIONS:
+        cache=    yes answers from a running status cache ("sc cache serve")
+                  when there is one (default = no)
+        endpoint= Pipe or socket of a cache started with "sc cache serve
+                  endpoint= <path>"; implies cache= yes
+)";
+}
+
+// ParseBypidOptions: key= value pairs only.
+void ParseBypidOptions(const std::vector<std::string> &args, BypidOptions &opts)
+{
+    size_t i = 0;
+    while (i < args.size())
+    {
+        const std::string &token = args[i];
+        if (token.size() < 2 || token.back() != '=')
+        {
+            printBypidHelp();
+            throw std::invalid_argument("Error: Invalid option format '" + token + "'. Expected key= followed by a value.");
+        }
+        std::string key = token.substr(0, token.size() - 1);
+        i++;
+        if (i >= args.size())
+        {
+            throw std::invalid_argument("Error: Missing value for option '" + key + "='.");
+        }
+        const std::string &value = args[i];
+        i++;
+
+        if (key == "cache")
+        {
+            if (value != "yes" && value != "no")
+                throw std::invalid_argument("Error: Invalid value for cache=. Allowed: yes, no.");
+            opts.useCache = value == "yes";
+        }
+        else if (key == "endpoint")
+        {
+            opts.cacheEndpoint = value;
+            opts.useCache = true;
+        }
+        else
+        {
+            throw std::invalid_argument("Error: Unknown option '" + key + "='.");
+        }
+    }
+}
+
+void ProcessIndex::Build(const std::vector<CachedServiceStatus> &services)
+{
+    positions.clear();
+    for (size_t i = 0; i < services.size(); i++)
+    {
+        DWORD processId = services[i].status.dwProcessId;
+        if (processId != 0)
+            positions[processId].push_back(i);
+    }
+}
+
+const std::vector<size_t> *ProcessIndex::Find(DWORD processId) const
+{
+    auto found = positions.find(processId);
+    return found == positions.end() ? nullptr : &found->second;
+}
+
+std::vector<DWORD> ProcessIndex::Processes() const
+{
+    std::vector<DWORD> processes;
+    processes.reserve(positions.size());
+    for (const auto &entry : positions)
+        processes.push_back(entry.first);
+    std::sort(processes.begin(), processes.end());
+    return processes;
+}
+
+namespace
+{
+    std::mutex sharedTablesMutex;
+    bool sharingTables = false;
+    std::map<std::string, std::shared_ptr<const ServiceProcessTable>> sharedTables; // Keyed by ScmServerKey().
+
+    std::shared_ptr<const ServiceProcessTable> EnumerateProcessTable(const std::string &serverName)
+    {
+        ScHandle scm = OpenSCManagerShared(serverName, SC_MANAGER_ENUMERATE_SERVICE);
+        if (!scm)
+            return nullptr;
+        auto table = std::make_shared<ServiceProcessTable>();
+        bool success = EnumerateServicePages(
+            scm, SERVICE_DRIVER | SERVICE_WIN32, SERVICE_ACTIVE, nullptr, 0, 0,
+            [&table](const ENUM_SERVICE_STATUS_PROCESSA *services, DWORD count)
+            {
+                for (DWORD i = 0; i < count; i++)
+                    table->services.push_back({services[i].lpServiceName, services[i].lpDisplayName,
+                                               services[i].ServiceStatusProcess});
+                return true;
+            });
+        if (!success)
+            return nullptr;
+        table->index.Build(table->services);
+        return table;
+    }
+}
+
+std::shared_ptr<const ServiceProcessTable> LoadServiceProcessTable(const std::string &serverName)
+{
+    std::string key = ScmServerKey(serverName);
+    {
+        std::lock_guard<std::mutex> lock(sharedTablesMutex);
+        auto found = sharedTables.find(key);
+        if (found != sharedTables.end())
+            return found->second;
+    }
+
+    std::shared_ptr<const ServiceProcessTable> table = EnumerateProcessTable(serverName);
+    if (table)
+    {
+        std::lock_guard<std::mutex> lock(sharedTablesMutex);
+        if (sharingTables)
+            sharedTables[key] = table;
+    }
+    return table;
+}
+
+void SetProcessIndexSharing(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(sharedTablesMutex);
+    sharingTables = enabled;
+    sharedTables.clear();
+}
+
+void InvalidateSharedProcessTables()
+{
+    std::lock_guard<std::mutex> lock(sharedTablesMutex);
+    sharedTables.clear();
+}
+
+bool bypid(const BypidOptions &opts)
+{
+    std::shared_ptr<const ServiceProcessTable> table;
+    std::vector<CachedServiceStatus> cached;
+    unsigned int ageMs = 0;
+    if (opts.useCache && QueryCachedServices(opts.cacheEndpoint, opts.serverName, SERVICE_DRIVER | SERVICE_WIN32,
+                                             SERVICE_ACTIVE, cached, ageMs))
+    {
+        auto fromCache = std::make_shared<ServiceProcessTable>();
+        fromCache->services = std::move(cached);
+        fromCache->index.Build(fromCache->services);
+        table = std::move(fromCache);
+    }
+    else
+    {
+        table = LoadServiceProcessTable(opts.serverName);
+        if (!table)
+        {
+            ScErr() << "EnumServicesStatusEx failed, error: " << GetLastError() << "\n";
+            return false;
+        }
+    }
+
+    // One line per process: the PID, then its services separated by commas.
+    std::vector<DWORD> processes = table->index.Processes();
+    std::string out = "PID      SERVICES\n";
+    size_t hosted = 0;
+    for (DWORD processId : processes)
+    {
+        std::string pid = std::to_string(processId);
+        out += pid;
+        out.append(pid.size() < 9 ? 9 - pid.size() : 1, ' ');
+        const std::vector<size_t> &positions = *table->index.Find(processId);
+        for (size_t i = 0; i < positions.size(); i++)
+        {
+            if (i > 0)
+                out += ", ";
+            out += table->services[positions[i]].serviceName;
+        }
+        out += '\n';
+        hosted += positions.size();
+    }
+    out += "[SC] " + std::to_string(hosted) + " service(s) in " + std::to_string(processes.size()) + " process(es)\n";
+    ScOut() << out;
+    return true;
+}
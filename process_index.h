@@ -0,0 +1,65 @@
+#ifndef PROCESS_INDEX_H
+#define PROCESS_INDEX_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "status_cache.h"
+#include "win32_compat.h"
+
+// Groups services by the process hosting them, as tasklist /svc does. Positions refer to the
+// service list the index was built from; stopped services (PID 0) are not indexed.
+class ProcessIndex
+{
+public:
+    void Build(const std::vector<CachedServiceStatus> &services);
+
+    // Positions of the services running in processId, in list order; nullptr if there are none.
+    const std::vector<size_t> *Find(DWORD processId) const;
+
+    // Every indexed process ID, in ascending order.
+    std::vector<DWORD> Processes() const;
+
+private:
+    std::unordered_map<DWORD, std::vector<size_t>> positions;
+};
+
+// The active services of one server, from one enumeration pass, and their process index.
+struct ServiceProcessTable
+{
+    std::vector<CachedServiceStatus> services;
+    ProcessIndex index;
+};
+
+// Enumerates the active services and drivers of serverName and indexes them by process.
+// While sharing is on the table is kept per server and reused until it is invalidated.
+// Returns nullptr (GetLastError() set) on failure.
+std::shared_ptr<const ServiceProcessTable> LoadServiceProcessTable(const std::string &serverName);
+
+// Turns the reuse of process tables on or off (batch mode turns it on).
+void SetProcessIndexSharing(bool enabled);
+
+// Drops the shared tables. Batch mode calls it after any command that may change which
+// services run where.
+void InvalidateSharedProcessTables();
+
+// Structure for the "bypid" subcommand options.
+// Command-line syntax:
+//   sc.exe [<servername>] bypid [cache= {yes | no}] [endpoint= <path>]
+struct BypidOptions
+{
+    std::string serverName;
+    bool useCache = false;     // Answer from a running status cache when there is one.
+    std::string cacheEndpoint; // Where that cache listens; empty means DefaultCacheEndpoint().
+};
+
+// Parse function for "bypid" options. Throws std::invalid_argument on bad input.
+void ParseBypidOptions(const std::vector<std::string> &args, BypidOptions &opts);
+
+// bypid function: lists every process hosting services and the services in it.
+// Returns true on success.
+bool bypid(const BypidOptions &opts);
+
+#endif // PROCESS_INDEX_H
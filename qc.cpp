@@ -0,0 +1,394 @@
+#include "qc.h"
+#include "config_harvest.h"
+#include "console.h"
+#include "option_schema.h"
+#include "query.h"
+#include "scm_buffers.h"
+#include "service_snapshot.h"
+#include "status_format.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+void printQcHelp()
+{
+    ScOut() << R"(DESCRIPTION:
+        Queries the configuration information for a service.
+USAGE:
+        sc <server> qc [service name] <bufferSize> [format= {text | json | ndjson | csv}]
+                       [snapshot= <file>]
+        sc <server> qc [type= {driver | service | all}] [state= {active | inactive | all}]
+                       [parallel= <n>] [format= ...] [snapshot= <file>]
+
+        Without a service name, the configuration of every enumerated
+        service is printed, in enumeration order; "sc qc" alone lists
+        every service.
+
+OPTIONS:
+        format=   Output format: text, json, ndjson or csv (default = text)
+        snapshot= Read the configuration from a file written by
+                  "sc snapshot" instead of asking the SCM.
+        type=     Services to enumerate: driver, service or all
+                  (default = service)
+        state=    States to enumerate: active, inactive or all
+                  (default = all)
+        parallel= Configurations fetched at once (default = 16)
+)";
+}
+
+namespace
+{
+    enum class QcOption
+    {
+        Format,
+        Snapshot,
+        Type,
+        State,
+        Parallel
+    };
+
+    constexpr auto QC_OPTIONS = MakeKeywordTable<QcOption>({
+        {"format", QcOption::Format},
+        {"snapshot", QcOption::Snapshot},
+        {"type", QcOption::Type},
+        {"state", QcOption::State},
+        {"parallel", QcOption::Parallel},
+    });
+    static_assert(QC_OPTIONS.Valid(), "no perfect hash for the qc options");
+} // end anonymous namespace
+
+// ParseQcOptions: the service name and an optional buffer size, or nothing to enumerate,
+// then key= value pairs. No arguments at all enumerate with the defaults.
+void ParseQcOptions(const std::vector<std::string> &args, QcOptions &opts)
+{
+    size_t i = 0;
+    if (!args.empty() && (args[0].empty() || args[0].back() != '='))
+        opts.serviceName = args[i++];
+    if (!opts.serviceName.empty() && i < args.size() && args[i].find('=') == std::string::npos)
+    {
+        try
+        {
+            size_t used = 0;
+            unsigned long parsed = std::stoul(args[i], &used);
+            if (used != args[i].size())
+                throw std::invalid_argument(args[i]);
+            opts.bufsize = static_cast<unsigned int>(parsed);
+        }
+        catch (const std::exception &)
+        {
+            throw std::invalid_argument("Error: Invalid buffer size '" + args[i] + "'.");
+        }
+        i++;
+    }
+
+    while (i < args.size())
+    {
+        const std::string &token = args[i];
+        if (token.size() < 2 || token.back() != '=')
+        {
+            throw std::invalid_argument("Error: Invalid option format '" + token + "'. Expected key= followed by a value.");
+        }
+        i++;
+        if (i >= args.size())
+        {
+            throw std::invalid_argument("Error: Missing value for option '" + token + "'.");
+        }
+        const std::string &value = args[i];
+        i++;
+
+        const QcOption *option = QC_OPTIONS.Find(std::string_view(token.data(), token.size() - 1));
+        if (!option)
+        {
+            throw std::invalid_argument("Error: Unknown option '" + token + "'.");
+        }
+        if (*option != QcOption::Format && *option != QcOption::Snapshot && !opts.serviceName.empty())
+        {
+            throw std::invalid_argument("Error: " + token + " only applies when enumerating services.");
+        }
+        switch (*option)
+        {
+        case QcOption::Format:
+            if (!ParseOutputFormat(value, opts.format))
+                throw std::invalid_argument("Error: Invalid value for format=. Allowed: text, json, ndjson, csv.");
+            break;
+        case QcOption::Snapshot:
+            opts.snapshot = value;
+            break;
+        case QcOption::Type:
+        {
+            const DWORD *enumType = ENUM_TYPE_VALUES.Find(value);
+            if (!enumType)
+                throw std::invalid_argument("Error: Invalid value for type=. Allowed: " + ENUM_TYPE_VALUES.Names() + ".");
+            opts.enumType = *enumType;
+            break;
+        }
+        case QcOption::State:
+        {
+            const DWORD *state = STATE_VALUES.Find(value);
+            if (!state)
+                throw std::invalid_argument("Error: Invalid value for state=. Allowed: " + STATE_VALUES.Names() + ".");
+            opts.state = *state;
+            break;
+        }
+        case QcOption::Parallel:
+            try
+            {
+                size_t used = 0;
+                unsigned long parsed = std::stoul(value, &used);
+                if (used != value.size() || parsed == 0 || parsed > 256)
+                    throw std::invalid_argument(value);
+                opts.parallel = static_cast<unsigned int>(parsed);
+            }
+            catch (const std::exception &)
+            {
+                throw std::invalid_argument("Error: Invalid value for parallel=. Allowed: 1 to 256.");
+            }
+            break;
+        }
+    }
+}
+
+namespace
+{
+    // Appends the sc.exe qc block for one service, from the SERVICE_NAME line on.
+    void AppendServiceConfig(std::string &out, const std::string &serviceName, const sc_service_config &config)
+    {
+        auto text = [](const char *value)
+        {
+            return value ? value : "";
+        };
+        char line[64];
+        out += "\nSERVICE_NAME: ";
+        out += serviceName;
+        std::snprintf(line, sizeof(line), "\n        TYPE               : %-3x ", config.service_type);
+        out += line;
+        out += DecodeServiceType(config.service_type);
+        std::snprintf(line, sizeof(line), "\n        START_TYPE         : %-3u ", config.start_type);
+        out += line;
+        out += StartTypeToString(config.start_type);
+        std::snprintf(line, sizeof(line), "\n        ERROR_CONTROL      : %-3u ", config.error_control);
+        out += line;
+        out += ErrorControlToString(config.error_control);
+        out += "\n        BINARY_PATH_NAME   : ";
+        out += text(config.binary_path);
+        out += "\n        LOAD_ORDER_GROUP   : ";
+        out += text(config.load_order_group);
+        out += "\n        TAG                : " + std::to_string(config.tag_id);
+        out += "\n        DISPLAY_NAME       : ";
+        out += text(config.display_name);
+        out += "\n        DEPENDENCIES       : ";
+        for (const char *p = config.dependencies; p && *p; p += std::strlen(p) + 1)
+        {
+            if (p != config.dependencies)
+                out += "\n                           : ";
+            out += p;
+        }
+        out += "\n        SERVICE_START_NAME : ";
+        out += text(config.service_start_name);
+        out += "\n";
+    }
+
+    sc_service_config ToServiceConfig(const QUERY_SERVICE_CONFIGA &qsc)
+    {
+        sc_service_config config;
+        config.service_type = qsc.dwServiceType;
+        config.start_type = qsc.dwStartType;
+        config.error_control = qsc.dwErrorControl;
+        config.tag_id = qsc.dwTagId;
+        config.binary_path = qsc.lpBinaryPathName;
+        config.load_order_group = qsc.lpLoadOrderGroup;
+        config.dependencies = qsc.lpDependencies;
+        config.service_start_name = qsc.lpServiceStartName;
+        config.display_name = qsc.lpDisplayName;
+        return config;
+    }
+
+    // Writes the configurations of an enumeration one at a time, through a text buffer
+    // reused between services or a single structured record stream.
+    class ConfigListWriter
+    {
+    public:
+        explicit ConfigListWriter(OutputFormat format) : format(format), records(ScOut(), format) {}
+
+        void Write(const std::string &serviceName, const sc_service_config &config)
+        {
+            written++;
+            if (format != OutputFormat::Text)
+            {
+                records.WriteConfig(serviceName, config);
+                return;
+            }
+            block.clear();
+            AppendServiceConfig(block, serviceName, config);
+            ScOut().write(block.data(), static_cast<std::streamsize>(block.size()));
+        }
+
+        void Fail(const std::string &serviceName, const std::string &reason)
+        {
+            failed++;
+            ScErr() << "[SC] " << serviceName << ": " << reason << "\n";
+        }
+
+        void Finish(std::chrono::steady_clock::time_point started)
+        {
+            records.Finish();
+            if (format == OutputFormat::Text)
+            {
+                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - started);
+                ScOut() << "\n[SC] QueryServiceConfig " << written << " service(s), " << failed << " failed, "
+                        << elapsed.count() << " ms\n";
+            }
+        }
+
+        size_t Failed() const { return failed; }
+
+    private:
+        OutputFormat format;
+        RecordWriter records;
+        std::string block;
+        size_t written = 0;
+        size_t failed = 0;
+    };
+
+    bool qcSnapshot(const QcOptions &opts)
+    {
+        auto started = std::chrono::steady_clock::now();
+        ServiceSnapshot snapshot;
+        std::string error;
+        if (!snapshot.Open(opts.snapshot, error))
+        {
+            ScErr() << "Error: Cannot read snapshot '" << opts.snapshot << "': " << error << ".\n";
+            return false;
+        }
+        if (opts.serviceName.empty())
+        {
+            DWORD serviceType = opts.enumType, serviceState = opts.state;
+            ConfigListWriter writer(opts.format);
+            for (size_t i = 0; i < snapshot.Count(); i++)
+            {
+                const SnapshotService &service = snapshot.Service(i);
+                bool stopped = service.currentState == SERVICE_STOPPED;
+                if ((service.serviceType & serviceType) == 0 || (serviceState == SERVICE_ACTIVE && stopped) ||
+                    (serviceState == SERVICE_INACTIVE && !stopped))
+                    continue;
+                if (service.flags & SNAPSHOT_HAS_CONFIG)
+                    writer.Write(snapshot.String(service.name), snapshot.Config(service));
+                else
+                    writer.Fail(snapshot.String(service.name), "The snapshot has no configuration for it.");
+            }
+            writer.Finish(started);
+            return writer.Failed() == 0;
+        }
+
+        size_t index;
+        if (!snapshot.Find(opts.serviceName, index))
+        {
+            ScErr() << "OpenService failed, error: " << ERROR_SERVICE_DOES_NOT_EXIST << "\n";
+            return false;
+        }
+        const SnapshotService &service = snapshot.Service(index);
+        if (!(service.flags & SNAPSHOT_HAS_CONFIG))
+        {
+            ScErr() << "Error: The snapshot has no configuration for " << opts.serviceName << ".\n";
+            return false;
+        }
+        PrintServiceConfig(opts.serviceName, snapshot.Config(service), opts.format);
+        return true;
+    }
+
+    // Enumerates the services, then fetches their configurations on a worker pool with a
+    // bounded window and prints them in enumeration order as they arrive.
+    bool qcEnumerate(const QcOptions &opts)
+    {
+        auto started = std::chrono::steady_clock::now();
+        ScHandle scm = OpenSCManagerShared(opts.serverName, SC_MANAGER_ENUMERATE_SERVICE);
+        if (!scm)
+        {
+            ScErr() << "OpenSCManager failed, error: " << GetLastError() << "\n";
+            return false;
+        }
+        DWORD serviceType = opts.enumType, serviceState = opts.state;
+        std::vector<std::string> names;
+        bool success = EnumerateServicePages(scm, serviceType, serviceState, nullptr, 0, 0,
+                                             [&names](const ENUM_SERVICE_STATUS_PROCESSA *services, DWORD count)
+                                             {
+                                                 for (DWORD i = 0; i < count; i++)
+                                                     names.emplace_back(services[i].lpServiceName);
+                                                 return true;
+                                             });
+        if (!success)
+        {
+            ScErr() << "EnumServicesStatusEx failed, error: " << GetLastError() << "\n";
+            return false;
+        }
+
+        ConfigListWriter writer(opts.format);
+        HarvestConfigs(scm, names, opts.parallel, std::max<size_t>(DEFAULT_HARVEST_WINDOW, 4 * opts.parallel),
+                       [&writer](const HarvestedConfig &harvested)
+                       {
+                           if (harvested.config)
+                               writer.Write(harvested.serviceName, ToServiceConfig(*harvested.config));
+                           else
+                               writer.Fail(harvested.serviceName, std::string(harvested.failedCall) + " failed, error: " +
+                                                                     std::to_string(harvested.error));
+                       });
+        writer.Finish(started);
+        return writer.Failed() == 0;
+    }
+}
+
+void PrintServiceConfig(const std::string &serviceName, const sc_service_config &config, OutputFormat format)
+{
+    if (format != OutputFormat::Text)
+    {
+        RecordWriter writer(ScOut(), format);
+        writer.WriteConfig(serviceName, config);
+        writer.Finish();
+        return;
+    }
+    std::string out = "[SC] QueryServiceConfig SUCCESS\n";
+    AppendServiceConfig(out, serviceName, config);
+    ScOut() << out;
+}
+
+bool qc(const QcOptions &opts)
+{
+    if (!opts.snapshot.empty())
+        return qcSnapshot(opts);
+    if (opts.serviceName.empty())
+        return qcEnumerate(opts);
+
+    sc_service_config config;
+    // The strings never need more room than the SCM's own result, so the host's size hint
+    // for QueryServiceConfig makes a second call unlikely.
+    std::vector<char> strings(opts.bufsize ? opts.bufsize
+                                           : ScmSizeHint(ScmServerKey(opts.serverName), ScmCall::QueryServiceConfig));
+    size_t required = 0;
+    uint32_t error = sc_query_config(opts.serverName.c_str(), opts.serviceName.c_str(), &config, strings.data(),
+                                     strings.size(), &required);
+    if (error == ERROR_INSUFFICIENT_BUFFER && sc_last_failed_step() == SC_STEP_QUERY_CONFIG)
+    {
+        if (opts.bufsize)
+        {
+            // An explicit buffer size is honored, as sc.exe does.
+            ScErr() << "QueryServiceConfig failed, error: " << error << "\n"
+                    << "[SC] GetServiceConfig needs " << required << " bytes\n";
+            return false;
+        }
+        strings.resize(required);
+        error = sc_query_config(opts.serverName.c_str(), opts.serviceName.c_str(), &config, strings.data(),
+                                strings.size(), &required);
+    }
+    if (error != ERROR_SUCCESS)
+    {
+        ScErr() << sc_step_name(sc_last_failed_step()) << " failed, error: " << error << "\n";
+        return false;
+    }
+    PrintServiceConfig(opts.serviceName, config, opts.format);
+    return true;
+}
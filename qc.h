@@ -0,0 +1,40 @@
+#ifndef QC_H
+#define QC_H
+
+#include <string>
+#include <vector>
+
+#include "output_format.h"
+#include "sc_api.h"
+#include "win32_compat.h"
+
+// Structure for the "qc" subcommand options.
+// Command-line syntax:
+//   sc.exe [<servername>] qc <servicename> [<bufsize>] [format= {text | json | ndjson | csv}] [snapshot= <file>]
+//   sc.exe [<servername>] qc [type= {driver | service | all}] [state= {active | inactive | all}]
+//                            [parallel= <n>] [format= ...] [snapshot= <file>]
+// Without a service name, the configuration of every enumerated service is printed.
+struct QcOptions
+{
+    std::string serverName;   // If empty, the local machine is used.
+    std::string serviceName;  // Empty to enumerate.
+    unsigned int bufsize = 0; // Initial string buffer size; 0 lets the query size it.
+    OutputFormat format = OutputFormat::Text;
+    std::string snapshot;     // Read the configuration from this snapshot instead of the SCM.
+    DWORD enumType = SERVICE_WIN32;   // Enumeration only: type mask of driver, service or all.
+    DWORD state = SERVICE_STATE_ALL;  // Enumeration only: active, inactive or all.
+    unsigned int parallel = 16;       // Enumeration only: configurations fetched at once.
+};
+
+// Parse function for "qc" options. Throws std::invalid_argument on bad input.
+void ParseQcOptions(const std::vector<std::string> &args, QcOptions &opts);
+
+// qc function: prints the configuration of a service as sc.exe does, or of every enumerated
+// service, fetched on a bounded number of worker threads.
+// Returns true on success.
+bool qc(const QcOptions &opts);
+
+// Prints one configuration in the sc.exe qc layout, or as a record in a structured format.
+void PrintServiceConfig(const std::string &serviceName, const sc_service_config &config, OutputFormat format);
+
+#endif // QC_H
@@ -7,33 +7,27 @@
 #endif
 
 #include "qdescription.h"
-#include <windows.h>
-#include <winsvc.h>
+#include "console.h"
+#include "sc_api.h"
+#include "scm_buffers.h"
+#include "scm_handles.h"
+#include "service_snapshot.h"
+#include "win32_compat.h"
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <vector>
 
-// If QUERY_SERVICE_CONFIG2A is not defined by the SDK, define it here.
-#ifndef QUERY_SERVICE_CONFIG2A
-typedef struct _QUERY_SERVICE_CONFIG2A
-{
-    LPSTR lpServiceSid;
-    LPSTR lpDescription;
-} QUERY_SERVICE_CONFIG2A, *LPQUERY_SERVICE_CONFIG2A;
-#endif
-
-// Also, if LPQUERY_SERVICE_CONFIG2A is not defined, define it.
-#ifndef LPQUERY_SERVICE_CONFIG2A
-typedef QUERY_SERVICE_CONFIG2A *LPQUERY_SERVICE_CONFIG2A;
-#endif
-
 
 void printQdescriptionHelp()
 {
-    std::cout << R"(DESCRIPTION:
+    ScOut() << R"(DESCRIPTION:
         Retrieves the description string of a service.
 USAGE:
-        sc <server> qdescription [service name] <bufferSize>
+        sc <server> qdescription [service name] <bufferSize> [format= {text | json | ndjson | csv}]
+                                [snapshot= <file>]
+
+        snapshot= reads the description from a file written by "sc snapshot".
 )";
 }
 
@@ -43,6 +37,7 @@ USAGE:
 //    qdescription <serviceName>
 // or
 //    qdescription <serverName> <serviceName>
+// either optionally followed by "format= <text|json|ndjson|csv>" and "snapshot= <file>".
 // If extra tokens are present, or if the serviceName is missing, throw an error.
 void ParseQdescriptionOptions(const std::vector<std::string> &args, QdescriptionOptions &opts)
 {
@@ -66,76 +61,110 @@ void ParseQdescriptionOptions(const std::vector<std::string> &args, Qdescription
     }
     else
     {
-        // No server name provided; default to local.
-        opts.serverName = "\\\\local";
+        // No server name provided; keep the one given before the subcommand, or default to local.
+        if (opts.serverName.empty())
+            opts.serverName = "\\\\local";
         opts.serviceName = args[0];
         index++;
     }
+    while (index + 2 <= args.size() && (args[index] == "format=" || args[index] == "snapshot="))
+    {
+        if (args[index] == "snapshot=")
+            opts.snapshot = args[index + 1];
+        else if (!ParseOutputFormat(args[index + 1], opts.format))
+            throw std::invalid_argument("Error: Invalid value for format=. Allowed: text, json, ndjson, csv.");
+        index += 2;
+    }
     if (index < args.size())
     {
         throw std::invalid_argument("Error: qdescription does not accept extra arguments.");
     }
-    qdescription(opts);
 }
 
-void qdescription(const QdescriptionOptions &opts)
+namespace
 {
-    // For the local machine, we pass NULL to OpenSCManagerA
-    LPCSTR machineName = (opts.serverName == "\\\\local") ? NULL : opts.serverName.c_str();
-
-    // Open a handle to the Service Control Manager.
-    SC_HANDLE hSCManager = OpenSCManagerA(machineName, NULL, SC_MANAGER_CONNECT);
-    if (!hSCManager)
+    // Prints a description in the selected format; description may be null.
+    void printDescription(const QdescriptionOptions &opts, const char *description)
     {
-        std::cerr << "Failed to open Service Control Manager. Error: " << GetLastError() << std::endl;
-        return;
-    }
-
-    // Open the specified service with the SERVICE_QUERY_CONFIG access right.
-    SC_HANDLE hService = OpenServiceA(hSCManager, opts.serviceName.c_str(), SERVICE_QUERY_CONFIG);
-    if (!hService)
-    {
-        std::cerr << "Failed to open service \"" << opts.serviceName << "\". Error: " << GetLastError() << std::endl;
-        CloseServiceHandle(hSCManager);
-        return;
+        if (opts.format != OutputFormat::Text)
+        {
+            RecordWriter writer(ScOut(), opts.format);
+            writer.WriteDescription(opts.serviceName, description);
+            writer.Finish();
+        }
+        else if (description)
+        {
+            ScOut() << "Service Description: " << description << std::endl;
+        }
+        else
+        {
+            ScOut() << "No description available for the service." << std::endl;
+        }
     }
 
-    // Allocate a buffer for the service description.
-    std::vector<BYTE> buffer(opts.bufsize);
-    DWORD bytesNeeded = 0;
-
-    // Query the service description (SERVICE_CONFIG_DESCRIPTION)
-    BOOL success = QueryServiceConfig2A(hService, SERVICE_CONFIG_DESCRIPTION, buffer.data(), opts.bufsize, &bytesNeeded);
-    if (!success)
+    bool qdescriptionSnapshot(const QdescriptionOptions &opts)
     {
-        DWORD err = GetLastError();
-        if (err == ERROR_INSUFFICIENT_BUFFER)
+        ServiceSnapshot snapshot;
+        std::string error;
+        if (!snapshot.Open(opts.snapshot, error))
+        {
+            ScErr() << "Error: Cannot read snapshot '" << opts.snapshot << "': " << error << "." << std::endl;
+            return false;
+        }
+        size_t index;
+        if (!snapshot.Find(opts.serviceName, index))
         {
-            // Resize buffer to the needed size and try again.
-            buffer.resize(bytesNeeded);
-            success = QueryServiceConfig2A(hService, SERVICE_CONFIG_DESCRIPTION, buffer.data(), bytesNeeded, &bytesNeeded);
+            ScErr() << "Failed to open service \"" << opts.serviceName << "\". Error: " << ERROR_SERVICE_DOES_NOT_EXIST
+                    << std::endl;
+            return false;
         }
-        if (!success)
+        const SnapshotService &service = snapshot.Service(index);
+        if (!(service.flags & SNAPSHOT_HAS_DESCRIPTION))
         {
-            std::cerr << "QueryServiceConfig2 failed. Error: " << GetLastError() << std::endl;
-            CloseServiceHandle(hService);
-            CloseServiceHandle(hSCManager);
-            return;
+            ScErr() << "Error: The snapshot has no description for " << opts.serviceName << "." << std::endl;
+            return false;
         }
+        const char *description = snapshot.String(service.description);
+        printDescription(opts, description && *description ? description : nullptr);
+        return true;
     }
+}
+
+bool qdescription(const QdescriptionOptions &opts)
+{
+    if (!opts.snapshot.empty())
+        return qdescriptionSnapshot(opts);
 
-    // Cast the buffer to a SERVICE_DESCRIPTIONA pointer.
-    SERVICE_DESCRIPTIONA *pDesc = reinterpret_cast<SERVICE_DESCRIPTIONA *>(buffer.data());
-    if (pDesc && pDesc->lpDescription)
+    // Start with the requested buffer size, or the host's size hint for descriptions if that
+    // is more, and grow it once if the description does not fit.
+    std::vector<char> buffer(std::max<size_t>(opts.bufsize > 0 ? opts.bufsize : 1,
+                                              ScmSizeHint(ScmServerKey(opts.serverName), ScmCall::QueryDescription)));
+    size_t required = 0;
+    uint32_t error = sc_query_description(opts.serverName.c_str(), opts.serviceName.c_str(), buffer.data(),
+                                          buffer.size(), &required);
+    if (error == ERROR_INSUFFICIENT_BUFFER && sc_last_failed_step() == SC_STEP_QUERY_DESCRIPTION)
     {
-        std::cout << "Service Description: " << pDesc->lpDescription << std::endl;
+        buffer.resize(required);
+        error = sc_query_description(opts.serverName.c_str(), opts.serviceName.c_str(), buffer.data(),
+                                     buffer.size(), &required);
     }
-    else
+    if (error != ERROR_SUCCESS)
     {
-        std::cout << "No description available for the service." << std::endl;
+        switch (sc_last_failed_step())
+        {
+        case SC_STEP_OPEN_SCM:
+            ScErr() << "Failed to open Service Control Manager. Error: " << error << std::endl;
+            break;
+        case SC_STEP_OPEN_SERVICE:
+            ScErr() << "Failed to open service \"" << opts.serviceName << "\". Error: " << error << std::endl;
+            break;
+        default:
+            ScErr() << "QueryServiceConfig2 failed. Error: " << error << std::endl;
+            break;
+        }
+        return false;
     }
 
-    // Clean up open handles.
-    CloseServiceHandle(hService);
-    CloseServiceHandle(hSCManager);
-}
\ No newline at end of file
+    printDescription(opts, buffer[0] ? buffer.data() : nullptr);
+    return true;
+}
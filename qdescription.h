@@ -5,18 +5,22 @@
 #include <vector>
 #include <stdexcept>
 
+#include "output_format.h"
+
 // Structure for the "qdescription" subcommand options.
 struct QdescriptionOptions
 {
     std::string serverName = "";
     std::string serviceName;
     int bufsize = 1024; // Default buffer size
+    OutputFormat format = OutputFormat::Text;
+    std::string snapshot; // Read the description from this snapshot instead of the SCM.
 };
 
 // Parse function to validate and fill in QdescriptionOptions.
 void ParseQdescriptionOptions(const std::vector<std::string> &args, QdescriptionOptions &opts);
 
 // qdescription function to query the service description.
-void qdescription(const QdescriptionOptions &opts);
+bool qdescription(const QdescriptionOptions &opts);
 
 #endif // QDESCRIPTION_H
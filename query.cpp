@@ -1,33 +1,67 @@
+#ifdef _MSC_VER
 #pragma comment(lib, "advapi32.lib")
+#endif
 
-#include <Windows.h>
+#include "win32_compat.h"
+#include <algorithm>
 #include <iostream>
-#include <sstream>
 #include <vector>
-#include <iomanip>
 
 #include "query.h"
+#include "console.h"
+#include "process_index.h"
+#include "sc_api.h"
+#include "scm_buffers.h"
+#include "scm_handles.h"
+#include "name_selector.h"
+#include "service_filter.h"
+#include "service_snapshot.h"
+#include "status_cache.h"
+#include "status_format.h"
 
 
 void printQueryHelp()
 {
-    std::cout << R"(sc.exe [<servername>] query [<servicename>] [type= {driver | service | all}] [type= {own | share | interact | kernel | filesys | rec | adapt}] [state= {active | inactive | all}] [bufsize= <Buffersize>] [ri= <Resumeindex>] [group= <groupname>]
+    ScOut() << R"(sc.exe [<servername>] query [<servicename>] [type= {driver | service | all}] [type= {own | share | interact | kernel | filesys | rec | adapt}] [state= {active | inactive | all}] [bufsize= <Buffersize>] [ri= <Resumeindex>] [group= <groupname>] [format= {text | json | ndjson | csv}] [cache= {yes | no}] [endpoint= <path>] [snapshot= <file>] [pid= <n>] [where= <expression>]
 
     QUERY and QUERYEX OPTIONS:
         If the query command is followed by a service name, the status
         for that service is returned.  Further options do not apply in
         this case.  If the query command is followed by nothing or one of
         the options listed below, the services are enumerated.
+        A name pattern such as MyApp_* (*, ? and [...] match the whole
+        name) or re:<regex> (searched for in the name) enumerates the
+        matching services of every type and state, and takes all of the
+        options below. Patterns ignore case.
     type=    Type of services to enumerate (driver, service, userservice, all)
              (default = service)
     state=   State of services to enumerate (active, inactive, all)
              (default = active)
-    bufsize= The size (in bytes) of the enumeration buffer
-             (default = 4096)
+    bufsize= The size (in bytes) of each enumeration page; results are
+             printed page by page (default = the size earlier runs needed
+             against the server, at least 65536)
     ri=      The resume index number at which to begin the enumeration
              (default = 0)
     group=   Service group to enumerate
              (default = all groups)
+    format=  Output format: text, json (one array), ndjson (one object per
+             line) or csv. Also accepted after a service name.
+             (default = text)
+    cache=   yes answers from a running status cache ("sc cache serve")
+             and falls back to the SCM when none is running or it does
+             not know the service. Ignored with ri= and group=. Also
+             accepted after a service name.
+             (default = no)
+    endpoint= Pipe or socket of a cache started with "sc cache serve
+             endpoint= <path>"; implies cache= yes. Also accepted after a
+             service name.
+    snapshot= Answer from a file written by "sc snapshot" instead of the
+             SCM. Also accepted after a service name.
+    pid=     Only the services running in this process, whatever their
+             type and state (see also "sc bypid").
+    where=   Only the services matching an expression, tested on each
+             enumerated service (see WHERE EXPRESSIONS below). Combines
+             with the other options, including cache=, snapshot= and pid=.
 
 SYNTAX EXAMPLES
 sc query                - Enumerates status for active services & drivers
@@ -41,34 +75,101 @@ sc query ri= 14         - Enumerates with resume index = 14
 sc queryex group= ""    - Enumerates active services not in a group
 sc query type= interact - Enumerates all interactive services
 sc query type= driver group= NDIS     - Enumerates all NDIS drivers
-)";
+sc query state= all format= ndjson   - Enumerates all services as JSON lines
+sc query state= all cache= yes       - Enumerates all services from the status cache
+sc query state= all snapshot= a.scsnap - Enumerates all services recorded in a snapshot
+sc queryex pid= 1080    - Displays extended status for the services in process 1080
+sc query state= all where= "state==RUNNING && name~^Win && pid!=0"
+                        - Enumerates running services whose names start with Win
+sc query where= "start==AUTO && state!=RUNNING" - Lists automatic services that are not running
+sc query MyApp_*        - Displays status for every service whose name starts with MyApp_
+sc query "re:^MyApp_[0-9]+$" state= active - Enumerates the active MyApp_<number> services
+
+)" << SERVICE_FILTER_HELP;
 }
 
 
+namespace
+{
+    enum class QueryOption
+    {
+        Type,
+        State,
+        BufSize,
+        ResumeIndex,
+        Group,
+        Format,
+        Cache,
+        Endpoint,
+        Snapshot,
+        Pid,
+        Where
+    };
+
+    constexpr auto QUERY_OPTIONS = MakeKeywordTable<QueryOption>({
+        {"type", QueryOption::Type},
+        {"state", QueryOption::State},
+        {"bufsize", QueryOption::BufSize},
+        {"ri", QueryOption::ResumeIndex},
+        {"group", QueryOption::Group},
+        {"format", QueryOption::Format},
+        {"cache", QueryOption::Cache},
+        {"endpoint", QueryOption::Endpoint},
+        {"snapshot", QueryOption::Snapshot},
+        {"pid", QueryOption::Pid},
+        {"where", QueryOption::Where},
+    });
+    static_assert(QUERY_OPTIONS.Valid(), "no perfect hash for the query options");
+} // end anonymous namespace
+
 // Parse all tokens (arguments) following the subcommand for the "query" subcommand.
 // This function itself decides if the service name is provided as the first token.
-int ParseQueryOptions(const std::vector<std::string> &tokens, QueryOptions &opts)
+// Returns false (after printing the reason) if the options are invalid.
+bool ParseQueryOptions(const std::vector<std::string> &tokens, QueryOptions &opts)
 {
     size_t index = 0;
 
     if (tokens.size() == 0)
     {
-        query(opts);
         return true;
     }
     // If the first token does not contain '=' then treat it as the optional service name.
-    if (tokens[index].find('=') == std::string::npos && tokens.size() > 1)
+    // Only format=, cache=, endpoint= and snapshot= may follow it. A name pattern (name_selector.h)
+    // enumerates the services it matches, in any type and state unless type= or state= say
+    // otherwise, and takes every option.
+    if (tokens[index].find('=') == std::string::npos)
     {
-        std::cerr << "Error: service name cannot be used with any other flags" << "\n";
-        printQueryHelp();
-        return EXIT_FAILURE;
+        try
+        {
+            opts.names = NameSelector::Parse(tokens[index]);
+        }
+        catch (const std::invalid_argument &e)
+        {
+            ScErr() << e.what() << "\n";
+            return false;
+        }
+    }
+    if (opts.names)
+    {
+        opts.enumType = SERVICE_DRIVER | SERVICE_WIN32;
+        opts.state = SERVICE_STATE_ALL;
+        ++index;
     }
-    if (index < tokens.size() && tokens[index].find('=') == std::string::npos)
+    else if (tokens[index].find('=') == std::string::npos)
     {
+        for (size_t i = 1; i < tokens.size(); i += 2)
+        {
+            if ((tokens[i] != "format=" && tokens[i] != "cache=" && tokens[i] != "endpoint=" &&
+                 tokens[i] != "snapshot=") ||
+                i + 1 >= tokens.size())
+            {
+                ScErr() << "Error: service name cannot be used with any other flags" << "\n";
+                printQueryHelp();
+                return false;
+            }
+        }
         opts.serviceName = tokens[index];
-        query(opts);
-        return true;
-        //++index;
+        ++index;
     }
 
     bool firstTypeFound = false;
@@ -79,420 +180,569 @@ int ParseQueryOptions(const std::vector<std::string> &tokens, QueryOptions &opts
         const std::string &keyToken = tokens[index];
         if (keyToken.size() < 2 || keyToken.back() != '=')
         {
-            std::cerr << "Error: Option token '" << keyToken
+            ScErr() << "Error: Option token '" << keyToken
                       << "' is not correctly formatted. Expected key= followed by its value.\n";
             return false;
         }
-        std::string key = keyToken.substr(0, keyToken.size() - 1);
+        std::string_view key(keyToken.data(), keyToken.size() - 1);
         ++index; // Move to value token.
         if (index >= tokens.size())
         {
-            std::cerr << "Error: Missing value for option '" << key << "='\n";
+            ScErr() << "Error: Missing value for option '" << keyToken << "'\n";
             return false;
         }
-        std::string value = tokens[index];
+        const std::string &value = tokens[index];
         ++index;
 
-        if (key == "type")
+        const QueryOption *option = QUERY_OPTIONS.Find(key);
+        if (!option)
+        {
+            ScErr() << "Error: Unknown option '" << keyToken << "'\n";
+            printQueryHelp();
+            return false;
+        }
+
+        switch (*option)
         {
+        case QueryOption::Type:
             if (!firstTypeFound)
             {
-                if (value != "driver" && value != "service" && value != "all")
+                const DWORD *enumType = ENUM_TYPE_VALUES.Find(value);
+                if (!enumType)
                 {
-                    std::cerr << "Error: Invalid value for type=. Allowed: driver, service, all.\n";
+                    ScErr() << "Error: Invalid value for type=. Allowed: " << ENUM_TYPE_VALUES.Names() << ".\n";
                     printQueryHelp();
-                    return EXIT_FAILURE;
+                    return false;
                 }
-                opts.enumType = value;
+                opts.enumType = *enumType;
                 firstTypeFound = true;
             }
             else
             {
-                if (value != "own" && value != "share" && value != "interact" &&
-                    value != "kernel" && value != "filesys" && value != "rec" && value != "adapt")
+                const DWORD *serviceType = ENUM_SERVICE_TYPE_VALUES.Find(value);
+                if (!serviceType)
                 {
-                    std::cerr << "Error: Invalid value for second type=. Allowed: own, share, interact, kernel, filesys, rec, adapt.\n";
+                    ScErr() << "Error: Invalid value for second type=. Allowed: " << ENUM_SERVICE_TYPE_VALUES.Names() << ".\n";
                     printQueryHelp();
-                    return EXIT_FAILURE;
+                    return false;
                 }
-                opts.type2Provided = true;
-                opts.serviceType = value;
+                opts.serviceType = *serviceType;
             }
-        }
-        else if (key == "state")
+            break;
+        case QueryOption::State:
         {
-            if (value != "active" && value != "inactive" && value != "all")
+            const DWORD *state = STATE_VALUES.Find(value);
+            if (!state)
             {
-                std::cerr << "Error: Invalid value for state=. Allowed: active, inactive, all.\n";
+                ScErr() << "Error: Invalid value for state=. Allowed: " << STATE_VALUES.Names() << ".\n";
                 printQueryHelp();
-                return EXIT_FAILURE;
+                return false;
             }
-            opts.state = value;
+            opts.state = *state;
+            break;
         }
-        else if (key == "bufsize")
-        {
+        case QueryOption::BufSize:
             try
             {
                 opts.bufsize = std::stoul(value);
             }
             catch (...)
             {
-                std::cerr << "Error: Invalid numeric value for bufsize=.\n";
+                ScErr() << "Error: Invalid numeric value for bufsize=.\n";
                 printQueryHelp();
-                return EXIT_FAILURE;
+                return false;
             }
-        }
-        else if (key == "ri")
-        {
+            break;
+        case QueryOption::ResumeIndex:
             try
             {
                 opts.resumeIndex = std::stoul(value);
             }
             catch (...)
             {
-                std::cerr << "Error: Invalid numeric value for ri=.\n";
+                ScErr() << "Error: Invalid numeric value for ri=.\n";
                 printQueryHelp();
-                return EXIT_FAILURE;
+                return false;
             }
-        }
-        else if (key == "group")
-        {
+            break;
+        case QueryOption::Group:
             opts.group = value;
-        }
-        else
+            break;
+        case QueryOption::Format:
+            if (!ParseOutputFormat(value, opts.format))
+            {
+                ScErr() << "Error: Invalid value for format=. Allowed: text, json, ndjson, csv.\n";
+                printQueryHelp();
+                return false;
+            }
+            break;
+        case QueryOption::Cache:
         {
-            std::cerr << "Error: Unknown option '" << key << "='\n";
-            printQueryHelp();
-            return EXIT_FAILURE;
+            const bool *useCache = YES_NO_VALUES.Find(value);
+            if (!useCache)
+            {
+                ScErr() << "Error: Invalid value for cache=. Allowed: " << YES_NO_VALUES.Names() << ".\n";
+                printQueryHelp();
+                return false;
+            }
+            opts.useCache = *useCache;
+            break;
+        }
+        case QueryOption::Endpoint:
+            opts.cacheEndpoint = value;
+            opts.useCache = true;
+            break;
+        case QueryOption::Snapshot:
+            opts.snapshot = value;
+            break;
+        case QueryOption::Pid:
+            try
+            {
+                size_t used = 0;
+                opts.processId = static_cast<DWORD>(std::stoul(value, &used));
+                if (used != value.size() || opts.processId == 0)
+                    throw std::invalid_argument(value);
+            }
+            catch (...)
+            {
+                ScErr() << "Error: Invalid process ID for pid=.\n";
+                printQueryHelp();
+                return false;
+            }
+            opts.byProcess = true;
+            break;
+        case QueryOption::Where:
+            try
+            {
+                opts.where = ServiceFilter::Compile(value);
+            }
+            catch (const std::invalid_argument &e)
+            {
+                ScErr() << e.what() << "\n";
+                return false;
+            }
+            break;
         }
     }
 
-    query(opts);
     return true;
 }
 
 /*
 void query(const QueryOptions &opts) {
-    std::cout << "Parsed Query Options:\n";
-    std::cout << "  Server Name:  " << opts.serverName << "\n";
-    std::cout << "  Service Name: " << opts.serviceName << "\n";
-    std::cout << "  Enum Type:    " << opts.enumType << "\n";
-    std::cout << "  Service Type: " << opts.serviceType << "\n";
-    std::cout << "  State:        " << opts.state << "\n";
-    std::cout << "  Bufsize:      " << opts.bufsize << "\n";
-    std::cout << "  Resume Index: " << opts.resumeIndex << "\n";
-    std::cout << "  Group:        " << opts.group << "\n";
+    ScOut() << "Parsed Query Options:\n";
+    ScOut() << "  Server Name:  " << opts.serverName << "\n";
+    ScOut() << "  Service Name: " << opts.serviceName << "\n";
+    ScOut() << "  Enum Type:    0x" << std::hex << opts.enumType << "\n";
+    ScOut() << "  Service Type: 0x" << opts.serviceType << "\n";
+    ScOut() << "  State:        " << std::dec << opts.state << "\n";
+    ScOut() << "  Bufsize:      " << opts.bufsize << "\n";
+    ScOut() << "  Resume Index: " << opts.resumeIndex << "\n";
+    ScOut() << "  Group:        " << opts.group << "\n";
 }
 */
 
-// Define our bit masks for convenience.
-constexpr DWORD OWN_BIT = SERVICE_WIN32_OWN_PROCESS;           // 0x10
-constexpr DWORD SHARE_BIT = SERVICE_WIN32_SHARE_PROCESS;       // 0x20
-constexpr DWORD EXTRA_MASK = 0xC0;                             // bits 0x40 and 0x80
-constexpr DWORD INTERACTIVE_BIT = SERVICE_INTERACTIVE_PROCESS; // 0x100
-
-// Helper: Convert a numeric service state into a string.
-std::string StateToString(DWORD state)
+// Prints one service status block in sc.exe format with a single write per record.
+void PrintServiceStatus(std::string_view serviceName, std::string_view displayName,
+                        const SERVICE_STATUS_PROCESS &ssp, bool showDisplayName, bool extended)
 {
-    switch (state)
-    {
-    case SERVICE_STOPPED:
-        return "STOPPED";
-    case SERVICE_START_PENDING:
-        return "START_PENDING";
-    case SERVICE_STOP_PENDING:
-        return "STOP_PENDING";
-    case SERVICE_RUNNING:
-        return "RUNNING";
-    case SERVICE_CONTINUE_PENDING:
-        return "CONTINUE_PENDING";
-    case SERVICE_PAUSE_PENDING:
-        return "PAUSE_PENDING";
-    case SERVICE_PAUSED:
-        return "PAUSED";
-    default:
-        return "UNKNOWN";
-    }
+    thread_local ServiceStatusFormatter formatter;
+    std::string_view text = formatter.Format(serviceName, displayName, ssp, showDisplayName, extended);
+    ScOut().write(text.data(), static_cast<std::streamsize>(text.size()));
 }
 
-// Helper: Decode the dwServiceType field into a human–readable string.
-// This function distinguishes among:
-//   - Driver types: KERNEL_DRIVER, FILE_SYSTEM_DRIVER, RECOGNIZER_DRIVER
-//   - Win32 service types:
-//       • If both OWN and SHARE bits are set with no extra bits, return "WIN32" (as sc.exe does for WinHttpAutoProxySvc, type 0x30).
-//       • If OWN is set (and SHARE is not) return "WIN32_OWN_PROCESS" (plus " INTERACTIVE" if applicable).
-//       • If SHARE is set (and OWN is not) return either "WIN32_SHARE_PROCESS" or "USER_SHARE_PROCESS" (if bit 0x40 is set)
-//         and append " INSTANCE" if bit 0x80 is set.
-//       • If both OWN and SHARE are set but extra bits are present (as with 0xF0 for WpnUserService_a35a6), return "ERROR".
-std::string DecodeServiceType(DWORD type)
+namespace
 {
-    // Check for driver types.
-    if (type & SERVICE_KERNEL_DRIVER)
-        return "KERNEL_DRIVER";
-    if (type & SERVICE_FILE_SYSTEM_DRIVER)
-        return "FILE_SYSTEM_DRIVER";
-    if (type & SERVICE_RECOGNIZER_DRIVER)
-        return "RECOGNIZER_DRIVER";
-
-    bool own = (type & OWN_BIT) != 0;
-    bool share = (type & SHARE_BIT) != 0;
-    bool interactive = (type & INTERACTIVE_BIT) != 0;
-    DWORD extras = type & EXTRA_MASK;
-
-    // If both OWN and SHARE are set...
-    if (own && share)
+    SERVICE_STATUS_PROCESS ToStatusProcess(const sc_service_status &status)
     {
-        // If the only bits set are OWN and SHARE (ignoring interactive), return "WIN32".
-        if (((type & ~(INTERACTIVE_BIT)) == (OWN_BIT | SHARE_BIT)))
-            return interactive ? "WIN32 INTERACTIVE" : "WIN32";
-        // Otherwise (if extras are present) return "ERROR" to match sc.exe for WpnUserService_a35a6.
-        return "ERROR";
+        SERVICE_STATUS_PROCESS ssp;
+        ssp.dwServiceType = status.service_type;
+        ssp.dwCurrentState = status.current_state;
+        ssp.dwControlsAccepted = status.controls_accepted;
+        ssp.dwWin32ExitCode = status.win32_exit_code;
+        ssp.dwServiceSpecificExitCode = status.service_exit_code;
+        ssp.dwCheckPoint = status.checkpoint;
+        ssp.dwWaitHint = status.wait_hint;
+        ssp.dwProcessId = status.process_id;
+        ssp.dwServiceFlags = status.service_flags;
+        return ssp;
     }
-    // If only OWN is set:
-    if (own)
-        return interactive ? "WIN32_OWN_PROCESS INTERACTIVE" : "WIN32_OWN_PROCESS";
-    // If only SHARE is set:
-    if (share)
+
+    // The EnumServicesStatusExA type and state masks selected by type= and state=.
+    // If no second type= was given, "service" covers both own and share processes so that
+    // services like OneSyncSvc_a35a6 are not omitted.
+    void EnumerationFilter(const QueryOptions &opts, DWORD &serviceType, DWORD &serviceState)
     {
-        std::string result;
-        if (type & 0x40)
-            result = "USER_SHARE_PROCESS";
-        else
-            result = "WIN32_SHARE_PROCESS";
-        if (type & 0x80)
-            result += " INSTANCE";
-        if (interactive)
-            result += " INTERACTIVE";
-        return result;
+        serviceType = opts.enumType;
+        if (opts.enumType == SERVICE_DRIVER && (opts.serviceType & SERVICE_DRIVER))
+        {
+            // kernel, filesys, rec or adapt; a service type= leaves every driver.
+            serviceType = opts.serviceType & SERVICE_DRIVER;
+        }
+        else if (opts.enumType == SERVICE_WIN32 && opts.serviceType)
+        {
+            // own, share or interact; a driver type= falls back to own processes.
+            serviceType = (opts.serviceType & SERVICE_WIN32) ? opts.serviceType : SERVICE_WIN32_OWN_PROCESS;
+        }
+        serviceState = opts.state;
     }
-    return "ERROR";
-}
 
-// Updated PrintServiceStatus function.
-// Updated PrintServiceStatus with an additional parameter to control display of the display name.
-void PrintServiceStatus(const std::string &serviceName, const std::string &displayName,
-                        const SERVICE_STATUS_PROCESS &ssp, bool showDisplayName)
-{
-    std::cout << "\n";
-    std::cout << "SERVICE_NAME: " << serviceName << "\n";
-    if (showDisplayName)
+    // True if the service matches the name pattern and where=, when they are given.
+    bool Selected(const QueryOptions &opts, const char *serviceName, const char *displayName,
+                  const SERVICE_STATUS_PROCESS &status, const ServiceConfigReader &readConfig)
     {
-        std::cout << "DISPLAY_NAME: " << displayName << "\n";
+        return (!opts.names || opts.names->Matches(serviceName)) &&
+               (!opts.where || opts.where->Matches(serviceName, displayName, status, readConfig));
     }
 
-    std::ostringstream hexStream;
-    hexStream << std::hex << std::nouppercase << ssp.dwServiceType;
-    std::string typeHex = hexStream.str();
+    // Reads the configuration fields where= tests from the SCM, opening scm on first use so
+    // that filters on status alone never touch it.
+    ServiceConfigReader ScmConfigReader(const std::string &serverName, ScHandle &scm)
+    {
+        return [&serverName, &scm](const char *serviceName, ServiceConfigFields &fields)
+        {
+            if (!scm)
+                scm = OpenSCManagerShared(serverName, SC_MANAGER_CONNECT);
+            ScHandle service = scm ? OpenServiceShared(scm, serviceName, SERVICE_QUERY_CONFIG) : ScHandle();
+            if (!service)
+                return false;
+            const BYTE *result = ScmQuery(ScmCall::QueryServiceConfig, service.serverKey(), [&service](BYTE *data, DWORD size, DWORD *needed)
+                                          { return Scm()->QueryServiceConfigA(service.get(), reinterpret_cast<LPQUERY_SERVICE_CONFIGA>(data),
+                                                                             size, needed); });
+            if (!result)
+                return false;
+            const QUERY_SERVICE_CONFIGA *config = reinterpret_cast<const QUERY_SERVICE_CONFIGA *>(result);
+            fields.startType = config->dwStartType;
+            fields.errorControl = config->dwErrorControl;
+            fields.binaryPath = config->lpBinaryPathName;
+            fields.loadOrderGroup = config->lpLoadOrderGroup;
+            fields.serviceStartName = config->lpServiceStartName;
+            return true;
+        };
+    }
 
-    std::string typeDesc = DecodeServiceType(ssp.dwServiceType);
-    std::cout << "        TYPE               : " << typeHex << "   " << typeDesc << "\n";
+    // Answers a query from a snapshot file. Enumeration follows the snapshot's name order;
+    // ri= skips that many services of it and group= matches the recorded load order group.
+    // pid= matches the recorded process IDs.
+    bool querySnapshot(const QueryOptions &opts)
+    {
+        ServiceSnapshot snapshot;
+        std::string error;
+        if (!snapshot.Open(opts.snapshot, error))
+        {
+            ScErr() << "Error: Cannot read snapshot '" << opts.snapshot << "': " << error << ".\n";
+            return false;
+        }
 
-    std::string stateStr = StateToString(ssp.dwCurrentState);
-    std::cout << "        STATE              : " << ssp.dwCurrentState << "  " << stateStr << "\n";
+        RecordWriter writer(ScOut(), opts.format);
+        if (!opts.serviceName.empty())
+        {
+            size_t index;
+            if (!snapshot.Find(opts.serviceName, index))
+            {
+                ScErr() << "OpenService failed, error: " << ERROR_SERVICE_DOES_NOT_EXIST << "\n";
+                return false;
+            }
+            const SnapshotService &service = snapshot.Service(index);
+            if (opts.format == OutputFormat::Text)
+                PrintServiceStatus(opts.serviceName, opts.serviceName, ServiceSnapshot::Status(service), false,
+                                   opts.extended);
+            else
+                writer.WriteStatus(opts.serviceName, snapshot.String(service.displayName),
+                                   ServiceSnapshot::Status(service));
+        }
+        else
+        {
+            DWORD serviceType, serviceState;
+            EnumerationFilter(opts, serviceType, serviceState);
+            const SnapshotService *current = nullptr;
+            ServiceConfigReader readConfig = [&snapshot, &current](const char *, ServiceConfigFields &fields)
+            {
+                if (!(current->flags & SNAPSHOT_HAS_CONFIG))
+                    return false;
+                fields.startType = current->startType;
+                fields.errorControl = current->errorControl;
+                fields.binaryPath = snapshot.String(current->binaryPath);
+                fields.loadOrderGroup = snapshot.String(current->loadOrderGroup);
+                fields.serviceStartName = snapshot.String(current->serviceStartName);
+                return true;
+            };
+            for (size_t i = opts.resumeIndex; i < snapshot.Count(); i++)
+            {
+                const SnapshotService &service = snapshot.Service(i);
+                current = &service;
+                bool stopped = service.currentState == SERVICE_STOPPED;
+                if (opts.byProcess)
+                {
+                    if (service.processId != opts.processId)
+                        continue;
+                }
+                else if ((service.serviceType & serviceType) == 0 || (serviceState == SERVICE_ACTIVE && stopped) ||
+                         (serviceState == SERVICE_INACTIVE && !stopped))
+                    continue;
+                if (!opts.group.empty())
+                {
+                    const char *group = snapshot.String(service.loadOrderGroup);
+                    if (CompareServiceNames(group ? group : "", opts.group) != 0)
+                        continue;
+                }
+                if (!Selected(opts, snapshot.String(service.name), snapshot.String(service.displayName),
+                              ServiceSnapshot::Status(service), readConfig))
+                    continue;
+                if (opts.format == OutputFormat::Text)
+                    PrintServiceStatus(snapshot.String(service.name), snapshot.String(service.displayName),
+                                       ServiceSnapshot::Status(service), true, opts.extended);
+                else
+                    writer.WriteStatus(snapshot.String(service.name), snapshot.String(service.displayName),
+                                       ServiceSnapshot::Status(service));
+            }
+        }
+        if (opts.format != OutputFormat::Text)
+            writer.Finish();
+        return true;
+    }
 
-    // Print control flags only if the service is not stopped.
-    if (ssp.dwCurrentState != SERVICE_STOPPED)
+    // Answers pid= from the status cache, or else from the process index of one enumeration
+    // pass, which batch mode keeps for the following lines.
+    bool queryProcess(const QueryOptions &opts)
     {
-        std::vector<std::string> controls;
-        if (ssp.dwControlsAccepted & SERVICE_ACCEPT_STOP)
-            controls.push_back("STOPPABLE");
-        else
-            controls.push_back("NOT_STOPPABLE");
-        if (ssp.dwControlsAccepted & SERVICE_ACCEPT_PAUSE_CONTINUE)
-            controls.push_back("PAUSABLE");
-        else
-            controls.push_back("NOT_PAUSABLE");
-        if (ssp.dwControlsAccepted & SERVICE_ACCEPT_PRESHUTDOWN)
-            controls.push_back("ACCEPTS_PRESHUTDOWN");
-        else if (ssp.dwControlsAccepted & SERVICE_ACCEPT_SHUTDOWN)
-            controls.push_back("ACCEPTS_SHUTDOWN");
+        std::shared_ptr<const ServiceProcessTable> table;
+        std::vector<CachedServiceStatus> cached;
+        unsigned int ageMs = 0;
+        if (opts.useCache && QueryCachedProcess(opts.cacheEndpoint, opts.serverName, opts.processId, cached, ageMs))
+        {
+            auto fromCache = std::make_shared<ServiceProcessTable>();
+            fromCache->services = std::move(cached);
+            fromCache->index.Build(fromCache->services);
+            table = std::move(fromCache);
+        }
         else
-            controls.push_back("IGNORES_SHUTDOWN");
+        {
+            table = LoadServiceProcessTable(opts.serverName);
+            if (!table)
+            {
+                ScErr() << "EnumServicesStatusEx failed, error: " << GetLastError() << "\n";
+                return false;
+            }
+        }
+        const std::vector<size_t> *positions = table->index.Find(opts.processId);
+        if (!positions)
+        {
+            ScErr() << "[SC] No service is running in process " << opts.processId << ".\n";
+            return false;
+        }
 
-        std::cout << "                                (";
-        for (size_t i = 0; i < controls.size(); ++i)
+        RecordWriter writer(ScOut(), opts.format);
+        ScHandle configScm;
+        ServiceConfigReader readConfig = ScmConfigReader(opts.serverName, configScm);
+        for (size_t position : *positions)
         {
-            std::cout << controls[i];
-            if (i != controls.size() - 1)
-                std::cout << ", ";
+            const CachedServiceStatus &service = table->services[position];
+            if (!Selected(opts, service.serviceName.c_str(), service.displayName.c_str(), service.status, readConfig))
+                continue;
+            if (opts.format == OutputFormat::Text)
+                PrintServiceStatus(service.serviceName, service.displayName, service.status, true, opts.extended);
+            else
+                writer.WriteStatus(service.serviceName, service.displayName.c_str(), service.status);
         }
-        std::cout << ")\n";
+        if (opts.format != OutputFormat::Text)
+            writer.Finish();
+        return true;
     }
+}
+
+// Enumerates services page by page into the calling thread's enumeration buffer, cut to
+// pageSize bytes, starting at resumeIndex. A pageSize of 0 sizes the page from the host's
+// hint, and a first page that comes back short raises the hint to the whole result, so the
+// next enumeration of that host takes one call. The page only grows (by doubling, up to
+// what the SCM reports as needed) when a single record does not fit.
+bool EnumerateServicePages(const ScHandle &scm, DWORD serviceType, DWORD serviceState, const char *group,
+                           DWORD pageSize, DWORD resumeIndex, const ServicePageCallback &onPage)
+{
+    bool learning = pageSize == 0;
+    if (learning)
+        pageSize = std::max<DWORD>(DEFAULT_ENUM_PAGE_SIZE,
+                                   std::min<DWORD>(ScmSizeHint(scm.serverKey(), ScmCall::EnumServicesStatus),
+                                                   MAX_AUTO_ENUM_PAGE_SIZE));
+    std::vector<BYTE> &buffer = ScmThreadBuffer(ScmCall::EnumServicesStatus);
+    ResizeScmBuffer(buffer, pageSize);
+    DWORD resumeHandle = resumeIndex;
+    bool firstPage = true;
+    for (;;)
+    {
+        DWORD bytesNeeded = 0, servicesReturned = 0;
+        BOOL success = Scm()->EnumServicesStatusExA(
+            scm.get(),
+            SC_ENUM_PROCESS_INFO,
+            serviceType,
+            serviceState,
+            buffer.data(),
+            static_cast<DWORD>(buffer.size()),
+            &bytesNeeded,
+            &servicesReturned,
+            &resumeHandle,
+            group);
+        if (!success && GetLastError() != ERROR_MORE_DATA)
+            return false;
+        if (learning && firstPage)
+        {
+            // bytesNeeded covers the services that did not fit, so the page plus that holds them all.
+            firstPage = false;
+            NoteScmHint(success != FALSE);
+            if (!success)
+                NoteScmSize(scm.serverKey(), ScmCall::EnumServicesStatus,
+                            static_cast<DWORD>(std::min<size_t>(buffer.size() + bytesNeeded, MAX_AUTO_ENUM_PAGE_SIZE)));
+        }
 
-    std::cout << "        WIN32_EXIT_CODE    : " << ssp.dwWin32ExitCode
-              << "  (0x" << std::hex << ssp.dwWin32ExitCode << std::dec << ")\n";
-    std::cout << "        SERVICE_EXIT_CODE  : " << ssp.dwServiceSpecificExitCode
-              << "  (0x" << std::hex << ssp.dwServiceSpecificExitCode << std::dec << ")\n";
-    std::cout << "        CHECKPOINT         : 0x" << std::hex << ssp.dwCheckPoint << std::dec << "\n";
-    std::cout << "        WAIT_HINT          : 0x" << std::hex << ssp.dwWaitHint << std::dec << "\n";
+        if (servicesReturned == 0 && !success)
+        {
+            // Not even one record fits in the page.
+            ResizeScmBuffer(buffer, std::min<size_t>(buffer.size() * 2, std::max<size_t>(bytesNeeded, buffer.size() + 1)));
+            continue;
+        }
+
+        if (!onPage(reinterpret_cast<const ENUM_SERVICE_STATUS_PROCESSA *>(buffer.data()), servicesReturned) || success)
+            return true;
+    }
 }
 
 //
 // The query function uses low-level Win32 APIs (ANSI versions) to query services similar to sc.exe.
 // It uses the QueryOptions settings and applies the following logic:
-//  - If a service name is provided, query that service only.
+//  - With cache= yes, answer from a running status cache if there is one.
+//  - If a service name is provided, query that service only through sc_query_status.
 //  - Otherwise, enumerate services filtered by the "enumType" and "state" options.
-//    If no second type= parameter was provided (type2Provided == false), then for "service"
-//    enumeration we use SERVICE_WIN32 (both own and share) so that services like OneSyncSvc_a35a6 are not omitted.
+//  - With snapshot=, answer from the snapshot file instead of the SCM.
+//  - With pid=, list the services running in that process.
 //
 
-void query(const QueryOptions &opts)
+bool query(const QueryOptions &opts)
 {
+    if (!opts.snapshot.empty())
+        return querySnapshot(opts);
+    if (opts.byProcess)
+        return queryProcess(opts);
+
     if (!opts.serviceName.empty())
     {
-        // Query a specific service.
-        SC_HANDLE hSCManager = OpenSCManagerA(opts.serverName.c_str(), nullptr, SC_MANAGER_CONNECT);
-        if (!hSCManager)
+        CachedServiceStatus cached;
+        unsigned int ageMs = 0;
+        if (opts.useCache && QueryCachedStatus(opts.cacheEndpoint, opts.serverName, opts.serviceName, cached, ageMs))
         {
-            std::cerr << "OpenSCManager failed, error: " << GetLastError() << "\n";
-            return;
+            if (opts.format == OutputFormat::Text)
+            {
+                PrintServiceStatus(opts.serviceName, opts.serviceName, cached.status, false, opts.extended);
+            }
+            else
+            {
+                RecordWriter writer(ScOut(), opts.format);
+                writer.WriteStatus(opts.serviceName, cached.displayName.c_str(), cached.status);
+                writer.Finish();
+            }
+            return true;
         }
-        SC_HANDLE hService = OpenServiceA(hSCManager, opts.serviceName.c_str(), SERVICE_QUERY_STATUS | SERVICE_QUERY_CONFIG);
-        if (!hService)
+
+        // Query a specific service.
+        sc_service_status status;
+        uint32_t error = sc_query_status(opts.serverName.c_str(), opts.serviceName.c_str(), &status);
+        if (error != ERROR_SUCCESS)
         {
-            std::cerr << "OpenService failed, error: " << GetLastError() << "\n";
-            CloseServiceHandle(hSCManager);
-            return;
+            ScErr() << sc_step_name(sc_last_failed_step()) << " failed, error: " << error << "\n";
+            return false;
         }
+        SERVICE_STATUS_PROCESS ssp = ToStatusProcess(status);
 
-        SERVICE_STATUS_PROCESS ssp;
-        DWORD bytesNeeded = 0;
-        if (!QueryServiceStatusEx(hService, SC_STATUS_PROCESS_INFO, reinterpret_cast<LPBYTE>(&ssp),
-                                  sizeof(ssp), &bytesNeeded))
+        if (opts.format == OutputFormat::Text)
         {
-            std::cerr << "QueryServiceStatusEx failed, error: " << GetLastError() << "\n";
-            CloseServiceHandle(hService);
-            CloseServiceHandle(hSCManager);
-            return;
+            // Pass false for showDisplayName when querying a specific service.
+            PrintServiceStatus(opts.serviceName, opts.serviceName, ssp, false, opts.extended);
         }
-
-        // Retrieve configuration (to get the display name), though we won't show it.
-        LPQUERY_SERVICE_CONFIGA config = nullptr;
-        DWORD bytesNeeded2 = 0;
-        QueryServiceConfigA(hService, nullptr, 0, &bytesNeeded2);
-        if (GetLastError() == ERROR_INSUFFICIENT_BUFFER)
+        else
         {
-            config = reinterpret_cast<LPQUERY_SERVICE_CONFIGA>(LocalAlloc(LPTR, bytesNeeded2));
-            if (config && !QueryServiceConfigA(hService, config, bytesNeeded2, &bytesNeeded2))
+            // Structured output carries the display name, which needs the configuration.
+            sc_service_config config;
+            std::vector<char> strings(ScmSizeHint(ScmServerKey(opts.serverName), ScmCall::QueryServiceConfig));
+            size_t required = 0;
+            error = sc_query_config(opts.serverName.c_str(), opts.serviceName.c_str(), &config, strings.data(),
+                                    strings.size(), &required);
+            if (error == ERROR_INSUFFICIENT_BUFFER && sc_last_failed_step() == SC_STEP_QUERY_CONFIG)
             {
-                std::cerr << "QueryServiceConfig failed, error: " << GetLastError() << "\n";
-                LocalFree(config);
-                CloseServiceHandle(hService);
-                CloseServiceHandle(hSCManager);
-                return;
+                strings.resize(required);
+                error = sc_query_config(opts.serverName.c_str(), opts.serviceName.c_str(), &config, strings.data(),
+                                        strings.size(), &required);
             }
+            if (error != ERROR_SUCCESS)
+            {
+                ScErr() << sc_step_name(sc_last_failed_step()) << " failed, error: " << error << "\n";
+                return false;
+            }
+            RecordWriter writer(ScOut(), opts.format);
+            writer.WriteStatus(opts.serviceName, config.display_name, ssp);
+            writer.Finish();
         }
-        std::string displayName = (config && config->lpDisplayName) ? config->lpDisplayName : opts.serviceName;
-
-        // Pass false for showDisplayName when querying a specific service.
-        PrintServiceStatus(opts.serviceName, displayName, ssp, false);
-
-        if (config)
-            LocalFree(config);
-        CloseServiceHandle(hService);
-        CloseServiceHandle(hSCManager);
     }
     else
     {
         // Enumerate services.
-        SC_HANDLE hSCManager = OpenSCManagerA(opts.serverName.c_str(), nullptr, SC_MANAGER_ENUMERATE_SERVICE);
-        if (!hSCManager)
-        {
-            std::cerr << "OpenSCManager failed, error: " << GetLastError() << "\n";
-            return;
-        }
-
-        DWORD dwServiceType = 0;
-        if (opts.enumType == "driver")
+        DWORD dwServiceType, dwServiceState;
+        EnumerationFilter(opts, dwServiceType, dwServiceState);
+
+        RecordWriter writer(ScOut(), opts.format);
+        ScHandle hSCManager; // Opened below, or by readConfig if where= answers from the cache.
+        ServiceConfigReader readConfig = ScmConfigReader(opts.serverName, hSCManager);
+        auto writeService = [&opts, &writer, &readConfig](const char *serviceName, const char *displayName,
+                                                          const SERVICE_STATUS_PROCESS &ssp)
         {
-            if (opts.serviceType == "kernel")
-                dwServiceType = SERVICE_KERNEL_DRIVER;
-            else if (opts.serviceType == "filesys")
-                dwServiceType = SERVICE_FILE_SYSTEM_DRIVER;
-            else if (opts.serviceType == "rec")
-                dwServiceType = SERVICE_RECOGNIZER_DRIVER;
-            else if (opts.serviceType == "adapt")
-                dwServiceType = SERVICE_DRIVER;
-            else
-                dwServiceType = SERVICE_DRIVER;
-        }
-        else if (opts.enumType == "service")
-        {
-            if (opts.type2Provided)
-            {
-                if (opts.serviceType == "own")
-                    dwServiceType = SERVICE_WIN32_OWN_PROCESS;
-                else if (opts.serviceType == "share")
-                    dwServiceType = SERVICE_WIN32_SHARE_PROCESS;
-                else if (opts.serviceType == "interact")
-                    dwServiceType = SERVICE_WIN32_OWN_PROCESS | SERVICE_INTERACTIVE_PROCESS;
-                else
-                    dwServiceType = SERVICE_WIN32_OWN_PROCESS;
-            }
+            if (!Selected(opts, serviceName, displayName, ssp, readConfig))
+                return;
+            // For enumeration, we show the display name.
+            if (opts.format == OutputFormat::Text)
+                PrintServiceStatus(serviceName, displayName, ssp, true, opts.extended);
             else
-            {
-                dwServiceType = SERVICE_WIN32; // Enumerate both own and share.
-            }
-        }
-        else if (opts.enumType == "all")
+                writer.WriteStatus(serviceName, displayName, ssp);
+        };
+
+        // The cache holds every service in enumeration order, so it can answer type and
+        // state filters but not a resume index or a group.
+        std::vector<CachedServiceStatus> cached;
+        unsigned int ageMs = 0;
+        if (opts.useCache && opts.resumeIndex == 0 && opts.group.empty() &&
+            QueryCachedServices(opts.cacheEndpoint, opts.serverName, dwServiceType, dwServiceState, cached, ageMs))
         {
-            dwServiceType = SERVICE_DRIVER | SERVICE_WIN32;
+            for (const CachedServiceStatus &service : cached)
+                writeService(service.serviceName.c_str(), service.displayName.c_str(), service.status);
+            if (opts.format != OutputFormat::Text)
+                writer.Finish();
+            return true;
         }
 
-        DWORD dwServiceState = 0;
-        if (opts.state == "active")
-            dwServiceState = SERVICE_ACTIVE;
-        else if (opts.state == "inactive")
-            dwServiceState = SERVICE_INACTIVE;
-        else if (opts.state == "all")
-            dwServiceState = SERVICE_STATE_ALL;
-
-        DWORD bytesNeeded = 0, servicesReturned = 0;
-        DWORD resumeHandle = opts.resumeIndex;
-        BOOL success = EnumServicesStatusExA(
-            hSCManager,
-            SC_ENUM_PROCESS_INFO,
-            dwServiceType,
-            dwServiceState,
-            nullptr,
-            0,
-            &bytesNeeded,
-            &servicesReturned,
-            &resumeHandle,
-            opts.group.empty() ? nullptr : opts.group.c_str());
-        if (!success && GetLastError() != ERROR_MORE_DATA)
+        hSCManager = OpenSCManagerShared(opts.serverName, SC_MANAGER_ENUMERATE_SERVICE);
+        if (!hSCManager)
         {
-            std::cerr << "EnumServicesStatusEx failed, error: " << GetLastError() << "\n";
-            CloseServiceHandle(hSCManager);
-            return;
+            ScErr() << "OpenSCManager failed, error: " << GetLastError() << "\n";
+            return false;
         }
 
-        std::vector<BYTE> buffer(bytesNeeded);
-        success = EnumServicesStatusExA(
-            hSCManager,
-            SC_ENUM_PROCESS_INFO,
-            dwServiceType,
-            dwServiceState,
-            buffer.data(),
-            bytesNeeded,
-            &bytesNeeded,
-            &servicesReturned,
-            &resumeHandle,
-            opts.group.empty() ? nullptr : opts.group.c_str());
+        // Stream the enumeration one page at a time so output starts with the first page
+        // and memory stays bounded by the page size.
+        bool success = EnumerateServicePages(
+            hSCManager, dwServiceType, dwServiceState,
+            opts.group.empty() ? nullptr : opts.group.c_str(), opts.bufsize, opts.resumeIndex,
+            [&writeService](const ENUM_SERVICE_STATUS_PROCESSA *services, DWORD count)
+            {
+                for (DWORD i = 0; i < count; i++)
+                    writeService(services[i].lpServiceName, services[i].lpDisplayName,
+                                 services[i].ServiceStatusProcess);
+                ScOut().flush();
+                return true;
+            });
+        if (opts.format != OutputFormat::Text)
+            writer.Finish();
         if (!success)
         {
-            std::cerr << "EnumServicesStatusEx (second call) failed, error: " << GetLastError() << "\n";
-            CloseServiceHandle(hSCManager);
-            return;
-        }
-
-        LPENUM_SERVICE_STATUS_PROCESSA services = reinterpret_cast<LPENUM_SERVICE_STATUS_PROCESSA>(buffer.data());
-        for (DWORD i = 0; i < servicesReturned; i++)
-        {
-            // For enumeration, we show the display name.
-            PrintServiceStatus(services[i].lpServiceName, services[i].lpDisplayName,
-                               services[i].ServiceStatusProcess, true);
+            ScErr() << "EnumServicesStatusEx failed, error: " << GetLastError() << "\n";
+            return false;
         }
-        CloseServiceHandle(hSCManager);
     }
+    return true;
 }
@@ -3,8 +3,23 @@
 #define SERVICE_ADAPTER 0x00000004
 #define SERVICE_RECOGNIZER_DRIVER 0x00000008
 
+#include <functional>
+#include <memory>
 #include <string>
-#include <windows.h>
+#include <string_view>
+#include <vector>
+#include "win32_compat.h"
+
+#include "output_format.h"
+#include "name_selector.h"
+#include "option_schema.h"
+#include "scm_handles.h"
+#include "service_filter.h"
+
+// Smallest enumeration page used when bufsize= is not given.
+constexpr unsigned int DEFAULT_ENUM_PAGE_SIZE = 64 * 1024;
+// Largest page a size hint can ask for; beyond it enumeration just takes more pages.
+constexpr unsigned int MAX_AUTO_ENUM_PAGE_SIZE = 4 * 1024 * 1024;
 
 // Our QueryOptions structure.
 struct QueryOptions
@@ -13,25 +28,55 @@ struct QueryOptions
     std::string serverName = "\\\\local";
     // Optional service name.
     std::string serviceName = "";
-    // The first appearance of type=; allowed: driver, service, all (default "service")
-    std::string enumType = "service";
-    // The second appearance of type=; allowed: own, share, interact, kernel, filesys, rec, adapt.
-    // If not provided, we will enumerate all Win32 services.
-    std::string serviceType = "own";
-    // A flag indicating if a second type parameter was explicitly provided.
-    bool type2Provided = false;
-    // State filter; allowed: active, inactive, all (default "active")
-    std::string state = "active";
-    // Enumeration buffer size (in bytes); default is 1024.
-    unsigned int bufsize = 1024;
+    // The first appearance of type=, as a type mask: driver, service or all (default service).
+    DWORD enumType = SERVICE_WIN32;
+    // The second appearance of type=: own, share, interact, kernel, filesys, rec or adapt.
+    // 0 if not provided, in which case every type enumType covers is enumerated.
+    DWORD serviceType = 0;
+    // State filter: active, inactive or all (default active).
+    DWORD state = SERVICE_ACTIVE;
+    // Enumeration page size (in bytes); 0 sizes the page from the host's size hint.
+    unsigned int bufsize = 0;
     // Resume index; default is 0.
     unsigned int resumeIndex = 0;
     // Optional group name; if empty then all groups are enumerated.
     std::string group = "";
+    // Output format; text prints the sc.exe-style blocks.
+    OutputFormat format = OutputFormat::Text;
+    // Answer from a running status cache ("sc cache serve") when there is one.
+    bool useCache = false;
+    // Where that cache listens; empty means DefaultCacheEndpoint().
+    std::string cacheEndpoint;
+    // Answer from this snapshot file ("sc snapshot") instead of the SCM.
+    std::string snapshot;
+    // queryex: also print the PID and FLAGS of each service.
+    bool extended = false;
+    // pid=: only the services running in processId.
+    bool byProcess = false;
+    DWORD processId = 0;
+    // A service name pattern given instead of a name; null for none.
+    std::shared_ptr<const NameSelector> names;
+    // where=: only the services matching this compiled expression; null for all.
+    std::shared_ptr<const ServiceFilter> where;
 };
 
-// Function declaration for creating the service.
-void query(const QueryOptions &opts);
-// Function declaration for parsing query options
-int ParseQueryOptions(const std::vector<std::string> &tokens, QueryOptions &opts);
+// Function declaration for querying or enumerating services.
+bool query(const QueryOptions &opts);
+// Prints one service status block in sc.exe format to ScOut(); extended selects the queryex layout.
+void PrintServiceStatus(std::string_view serviceName, std::string_view displayName,
+                        const SERVICE_STATUS_PROCESS &ssp, bool showDisplayName, bool extended = false);
+// Receives one page of enumerated services. The records are only valid during the call.
+// Returning false stops the enumeration.
+using ServicePageCallback = std::function<bool(const ENUM_SERVICE_STATUS_PROCESSA *services, DWORD count)>;
+
+// Enumerates services with EnumServicesStatusExA one page at a time, reusing the calling
+// thread's enumeration buffer (scm_buffers.h) cut to pageSize bytes and starting at
+// resumeIndex. A pageSize of 0 uses the host's size hint (at least DEFAULT_ENUM_PAGE_SIZE,
+// at most MAX_AUTO_ENUM_PAGE_SIZE) and learns from the result. The callback must not
+// enumerate again on the same thread.
+// Returns false (GetLastError() set) on failure; stopping early through the callback counts as success.
+bool EnumerateServicePages(const ScHandle &scm, DWORD serviceType, DWORD serviceState, const char *group,
+                           DWORD pageSize, DWORD resumeIndex, const ServicePageCallback &onPage);
+// Function declaration for parsing query options. Returns false if the options are invalid.
+bool ParseQueryOptions(const std::vector<std::string> &tokens, QueryOptions &opts);
 #endif // CREATE_SERVICE_H
\ No newline at end of file
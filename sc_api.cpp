@@ -0,0 +1,560 @@
+#include "sc_api.h"
+#include "query.h"
+#include "scm_buffers.h"
+#include "scm_handles.h"
+#include "service_wait.h"
+
+#include "win32_compat.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// --- Delayed Auto-Start Definitions ---
+// Some SDKs might not define these. We define them if needed.
+#ifndef SERVICE_CONFIG_DELAYED_AUTO_START_INFO
+#define SERVICE_CONFIG_DELAYED_AUTO_START_INFO 3
+typedef struct _SERVICE_DELAYED_AUTO_START_INFO
+{
+    BOOL fDelayedAutostart;
+} SERVICE_DELAYED_AUTO_START_INFO, *LPSERVICE_DELAYED_AUTO_START_INFO;
+#endif
+
+namespace
+{
+    thread_local sc_step lastFailedStep = SC_STEP_NONE;
+
+    // Records the failing step and hands the error back to the caller.
+    uint32_t Fail(sc_step step, DWORD error)
+    {
+        lastFailedStep = step;
+        return error;
+    }
+
+    uint32_t Succeed()
+    {
+        lastFailedStep = SC_STEP_NONE;
+        return ERROR_SUCCESS;
+    }
+
+    // Opens the SCM on server and the named service through the shared handle pool.
+    uint32_t OpenTarget(const char *server, const char *service, DWORD scmAccess, DWORD serviceAccess,
+                        ScHandle &scm, ScHandle &svc)
+    {
+        if (!service || !*service)
+            return Fail(SC_STEP_OPEN_SERVICE, ERROR_INVALID_NAME);
+        scm = OpenSCManagerShared(server ? server : "", scmAccess);
+        if (!scm)
+            return Fail(SC_STEP_OPEN_SCM, GetLastError());
+        svc = OpenServiceShared(scm, service, serviceAccess);
+        if (!svc)
+            return Fail(SC_STEP_OPEN_SERVICE, GetLastError());
+        return ERROR_SUCCESS;
+    }
+
+    void CopyStatus(const SERVICE_STATUS_PROCESS &ssp, sc_service_status &status)
+    {
+        status.service_type = ssp.dwServiceType;
+        status.current_state = ssp.dwCurrentState;
+        status.controls_accepted = ssp.dwControlsAccepted;
+        status.win32_exit_code = ssp.dwWin32ExitCode;
+        status.service_exit_code = ssp.dwServiceSpecificExitCode;
+        status.checkpoint = ssp.dwCheckPoint;
+        status.wait_hint = ssp.dwWaitHint;
+        status.process_id = ssp.dwProcessId;
+        status.service_flags = ssp.dwServiceFlags;
+    }
+
+    void CopyName(char (&dest)[SC_MAX_NAME], const char *source)
+    {
+        size_t length = source ? std::min(std::strlen(source), sizeof(dest) - 1) : 0;
+        if (length)
+            std::memcpy(dest, source, length);
+        dest[length] = '\0';
+    }
+
+    // Reads one page of the enumeration that starts at resume into buffer, cut to size bytes.
+    BOOL EnumPage(const ScHandle &scm, DWORD type, DWORD state, const char *group, std::vector<BYTE> &buffer,
+                  DWORD size, DWORD &resume, DWORD &count, DWORD &needed)
+    {
+        needed = 0;
+        count = 0;
+        return Scm()->EnumServicesStatusExA(scm.get(), SC_ENUM_PROCESS_INFO, type, state, buffer.data(), size,
+                                            &needed, &count, &resume, group);
+    }
+
+    // Bytes the first count records of a page take: the records up front, their strings behind.
+    DWORD PageBytes(const ENUM_SERVICE_STATUS_PROCESSA *services, DWORD count)
+    {
+        size_t bytes = count * sizeof(ENUM_SERVICE_STATUS_PROCESSA);
+        for (DWORD i = 0; i < count; i++)
+            bytes += std::strlen(services[i].lpServiceName) + 1 + std::strlen(services[i].lpDisplayName) + 1;
+        return static_cast<DWORD>(bytes);
+    }
+
+    // Finds the resume handle right after the first count records of the page at pageStart,
+    // which came back with more than count records in buffer. The handle is a position in the
+    // SCM's database, counting the services the filter skipped too, so it is read back from a
+    // page cut to hold exactly count records. One more byte admits at most one more record, so
+    // bisecting the page size between the bytes those records take and the full page finds it.
+    bool ResumeAfter(const ScHandle &scm, DWORD type, DWORD state, const char *group, std::vector<BYTE> &buffer,
+                     DWORD pageStart, DWORD count, DWORD &resume)
+    {
+        resume = pageStart;
+        if (count == 0)
+            return true;
+        DWORD low = PageBytes(reinterpret_cast<const ENUM_SERVICE_STATUS_PROCESSA *>(buffer.data()), count);
+        DWORD high = static_cast<DWORD>(buffer.size()) - 1;
+        for (DWORD size = low; low <= high; size = low + (high - low) / 2)
+        {
+            DWORD next = pageStart, returned = 0, needed = 0;
+            if (!EnumPage(scm, type, state, group, buffer, size, next, returned, needed) &&
+                GetLastError() != ERROR_MORE_DATA)
+                return false;
+            if (returned == count)
+            {
+                resume = next;
+                return true;
+            }
+            if (returned < count)
+                low = size + 1;
+            else
+                high = size - 1;
+        }
+        // The database changed under us; continuing at the page start repeats records rather than skipping any.
+        return true;
+    }
+
+    // Length in bytes of a double-NUL-terminated string list, including the final NUL.
+    size_t MultiStringLength(const char *list)
+    {
+        if (!list)
+            return 1;
+        const char *p = list;
+        while (*p)
+            p += std::strlen(p) + 1;
+        return static_cast<size_t>(p - list) + 1;
+    }
+
+    // Packs strings into the caller's buffer one after another.
+    class StringPacker
+    {
+    public:
+        StringPacker(char *buffer, size_t size) : buffer(buffer), size(size) {}
+
+        const char *add(const char *value, size_t length)
+        {
+            size_t start = used;
+            used += length;
+            if (!buffer || used > size)
+                return nullptr;
+            if (value)
+                std::memcpy(buffer + start, value, length);
+            else
+                std::memset(buffer + start, 0, length);
+            return buffer + start;
+        }
+        const char *add(const char *value) { return add(value ? value : "", (value ? std::strlen(value) : 0) + 1); }
+
+        size_t required() const { return used; }
+        bool fits() const { return buffer && used <= size; }
+
+    private:
+        char *buffer;
+        size_t size;
+        size_t used = 0;
+    };
+
+    // Waits for the transition requested by sc_start_service / sc_stop_service and maps the
+    // outcome to an error code.
+    uint32_t FinishTransition(const ScHandle &scm, const char *service, const ScHandle &svc, DWORD desiredState,
+                              DWORD pendingState, uint32_t timeoutMs, DWORD settledError, sc_transition &transition)
+    {
+        transition.waited = 1;
+        ServiceWaitOptions waitOpts;
+        waitOpts.timeoutMs = timeoutMs;
+        // transition.status still holds the status read before the request.
+        waitOpts.priorState = transition.status.current_state;
+        ServiceWaitResult wait;
+        {
+            Win32ServiceStatusSource source(svc.get());
+            wait = WaitForServiceState(source, desiredState, pendingState, waitOpts);
+        }
+        transition.timed_out = wait.timedOut;
+        transition.stalled = wait.stalled;
+        transition.elapsed_ms = wait.elapsedMs;
+        CopyStatus(wait.status, transition.status);
+        if (wait.reached)
+            return Succeed();
+
+        // Do not keep a handle that may still carry a pending status-change registration.
+        ForgetSharedService(scm, service);
+        if (wait.error != ERROR_SUCCESS)
+            return Fail(SC_STEP_QUERY_STATUS, wait.error);
+        if (wait.timedOut || wait.stalled)
+            return Fail(SC_STEP_WAIT, ERROR_SERVICE_REQUEST_TIMEOUT);
+        return Fail(SC_STEP_WAIT, wait.status.dwWin32ExitCode ? wait.status.dwWin32ExitCode : settledError);
+    }
+}
+
+const char *sc_step_name(sc_step step)
+{
+    switch (step)
+    {
+    case SC_STEP_OPEN_SCM:
+        return "OpenSCManager";
+    case SC_STEP_OPEN_SERVICE:
+        return "OpenService";
+    case SC_STEP_QUERY_STATUS:
+        return "QueryServiceStatusEx";
+    case SC_STEP_QUERY_CONFIG:
+        return "QueryServiceConfig";
+    case SC_STEP_QUERY_DESCRIPTION:
+        return "QueryServiceConfig2";
+    case SC_STEP_ENUMERATE:
+        return "EnumServicesStatusEx";
+    case SC_STEP_START:
+        return "StartService";
+    case SC_STEP_CONTROL:
+        return "ControlService";
+    case SC_STEP_WAIT:
+        return "WaitForServiceState";
+    case SC_STEP_CHANGE_CONFIG:
+        return "ChangeServiceConfig";
+    case SC_STEP_CHANGE_DELAYED_AUTO:
+        return "ChangeServiceConfig2";
+    case SC_STEP_DELETE:
+        return "DeleteService";
+    case SC_STEP_CREATE:
+        return "CreateService";
+    case SC_STEP_CHANGE_FAILURE:
+        return "ChangeServiceConfig2";
+    default:
+        return "";
+    }
+}
+
+sc_step sc_last_failed_step(void)
+{
+    return lastFailedStep;
+}
+
+void sc_set_handle_caching(int enabled)
+{
+    SetScmHandleSharing(enabled != 0);
+}
+
+uint32_t sc_query_status(const char *server, const char *service, sc_service_status *status)
+{
+    if (!status)
+        return Fail(SC_STEP_NONE, ERROR_INVALID_PARAMETER);
+    ScHandle scm, svc;
+    if (uint32_t error = OpenTarget(server, service, SC_MANAGER_CONNECT, SERVICE_QUERY_STATUS, scm, svc))
+        return error;
+
+    SERVICE_STATUS_PROCESS ssp;
+    DWORD bytesNeeded = 0;
+    if (!Scm()->QueryServiceStatusEx(svc.get(), SC_STATUS_PROCESS_INFO, reinterpret_cast<LPBYTE>(&ssp), sizeof(ssp),
+                                    &bytesNeeded))
+        return Fail(SC_STEP_QUERY_STATUS, GetLastError());
+    CopyStatus(ssp, *status);
+    return Succeed();
+}
+
+uint32_t sc_enum_services(const char *server, uint32_t service_type, uint32_t service_state, const char *group,
+                          sc_service_entry *entries, size_t capacity, size_t *returned, uint32_t *resume_index)
+{
+    if (!returned || (capacity && !entries))
+        return Fail(SC_STEP_NONE, ERROR_INVALID_PARAMETER);
+    *returned = 0;
+
+    ScHandle scm = OpenSCManagerShared(server ? server : "", SC_MANAGER_ENUMERATE_SERVICE);
+    if (!scm)
+        return Fail(SC_STEP_OPEN_SCM, GetLastError());
+
+    // Size the page for roughly the number of entries the caller can take.
+    size_t perEntry = sizeof(ENUM_SERVICE_STATUS_PROCESSA) + 128;
+    DWORD pageSize = static_cast<DWORD>(std::min<size_t>(std::max<size_t>(capacity, 1) * perEntry,
+                                                         DEFAULT_ENUM_PAGE_SIZE));
+    std::vector<BYTE> &buffer = ScmThreadBuffer(ScmCall::EnumServicesStatus);
+    ResizeScmBuffer(buffer, pageSize);
+    DWORD resume = resume_index ? *resume_index : 0;
+    bool more = false;
+    for (;;)
+    {
+        DWORD pageStart = resume, count = 0, bytesNeeded = 0;
+        BOOL success = EnumPage(scm, service_type, service_state, group, buffer, static_cast<DWORD>(buffer.size()),
+                                resume, count, bytesNeeded);
+        if (!success && GetLastError() != ERROR_MORE_DATA)
+            return Fail(SC_STEP_ENUMERATE, GetLastError());
+        if (count == 0 && !success)
+        {
+            // Not even one record fits in the page.
+            ResizeScmBuffer(buffer, std::min<size_t>(buffer.size() * 2, std::max<size_t>(bytesNeeded, buffer.size() + 1)));
+            resume = pageStart;
+            continue;
+        }
+
+        const ENUM_SERVICE_STATUS_PROCESSA *services = reinterpret_cast<const ENUM_SERVICE_STATUS_PROCESSA *>(buffer.data());
+        DWORD taken = static_cast<DWORD>(std::min<size_t>(count, capacity - *returned));
+        for (DWORD i = 0; i < taken; i++)
+        {
+            sc_service_entry &entry = entries[*returned];
+            CopyName(entry.service_name, services[i].lpServiceName);
+            CopyName(entry.display_name, services[i].lpDisplayName);
+            CopyStatus(services[i].ServiceStatusProcess, entry.status);
+            ++*returned;
+        }
+        if (taken < count)
+        {
+            // The caller's entries ran out inside the page; continue after the last one handed out.
+            if (!ResumeAfter(scm, service_type, service_state, group, buffer, pageStart, taken, resume))
+                return Fail(SC_STEP_ENUMERATE, GetLastError());
+            more = true;
+            break;
+        }
+        if (success)
+            break;
+        if (*returned == capacity)
+        {
+            more = true;
+            break;
+        }
+    }
+
+    if (resume_index)
+        *resume_index = more ? resume : 0;
+    return more ? Fail(SC_STEP_ENUMERATE, ERROR_MORE_DATA) : Succeed();
+}
+
+uint32_t sc_query_config(const char *server, const char *service, sc_service_config *config, char *strings,
+                         size_t strings_size, size_t *required)
+{
+    if (!config)
+        return Fail(SC_STEP_NONE, ERROR_INVALID_PARAMETER);
+    ScHandle scm, svc;
+    if (uint32_t error = OpenTarget(server, service, SC_MANAGER_CONNECT, SERVICE_QUERY_CONFIG, scm, svc))
+        return error;
+
+    const BYTE *result = ScmQuery(ScmCall::QueryServiceConfig, svc.serverKey(), [&](BYTE *buffer, DWORD size, DWORD *needed)
+                                  { return Scm()->QueryServiceConfigA(svc.get(), reinterpret_cast<LPQUERY_SERVICE_CONFIGA>(buffer),
+                                                                     size, needed); });
+    if (!result)
+        return Fail(SC_STEP_QUERY_CONFIG, GetLastError());
+    const QUERY_SERVICE_CONFIGA *qsc = reinterpret_cast<const QUERY_SERVICE_CONFIGA *>(result);
+
+    config->service_type = qsc->dwServiceType;
+    config->start_type = qsc->dwStartType;
+    config->error_control = qsc->dwErrorControl;
+    config->tag_id = qsc->dwTagId;
+
+    StringPacker packer(strings, strings_size);
+    config->binary_path = packer.add(qsc->lpBinaryPathName);
+    config->load_order_group = packer.add(qsc->lpLoadOrderGroup);
+    config->dependencies = packer.add(qsc->lpDependencies, MultiStringLength(qsc->lpDependencies));
+    config->service_start_name = packer.add(qsc->lpServiceStartName);
+    config->display_name = packer.add(qsc->lpDisplayName);
+    if (required)
+        *required = packer.required();
+    if (!packer.fits())
+        return Fail(SC_STEP_QUERY_CONFIG, ERROR_INSUFFICIENT_BUFFER);
+    return Succeed();
+}
+
+uint32_t sc_query_description(const char *server, const char *service, char *description, size_t size,
+                              size_t *required)
+{
+    ScHandle scm, svc;
+    if (uint32_t error = OpenTarget(server, service, SC_MANAGER_CONNECT, SERVICE_QUERY_CONFIG, scm, svc))
+        return error;
+
+    const BYTE *result = ScmQuery(ScmCall::QueryDescription, svc.serverKey(), [&](BYTE *buffer, DWORD bufferSize, DWORD *needed)
+                                  { return Scm()->QueryServiceConfig2A(svc.get(), SERVICE_CONFIG_DESCRIPTION, buffer, bufferSize,
+                                                                      needed); });
+    if (!result)
+        return Fail(SC_STEP_QUERY_DESCRIPTION, GetLastError());
+    const SERVICE_DESCRIPTIONA *desc = reinterpret_cast<const SERVICE_DESCRIPTIONA *>(result);
+
+    StringPacker packer(description, size);
+    packer.add(desc->lpDescription);
+    if (required)
+        *required = packer.required();
+    if (!packer.fits())
+        return Fail(SC_STEP_QUERY_DESCRIPTION, ERROR_INSUFFICIENT_BUFFER);
+    return Succeed();
+}
+
+uint32_t sc_change_config(const char *server, const char *service, const sc_config_change *change, uint32_t *tag_id)
+{
+    if (!change || (change->request_tag && !tag_id))
+        return Fail(SC_STEP_NONE, ERROR_INVALID_PARAMETER);
+    ScHandle scm, svc;
+    if (uint32_t error = OpenTarget(server, service, SC_MANAGER_CONNECT, SERVICE_CHANGE_CONFIG, scm, svc))
+        return error;
+
+    // A change that only sets the delayed auto-start flag makes no ChangeServiceConfig call.
+    bool configChanges = change->service_type != SC_NO_CHANGE || change->start_type != SC_NO_CHANGE ||
+                         change->error_control != SC_NO_CHANGE || change->binary_path || change->load_order_group ||
+                         change->dependencies || change->service_start_name || change->password ||
+                         change->display_name || change->request_tag;
+    DWORD tag = 0;
+    if (configChanges && !Scm()->ChangeServiceConfigA(svc.get(), change->service_type, change->start_type, change->error_control,
+                                    change->binary_path, change->load_order_group, change->request_tag ? &tag : nullptr,
+                                    change->dependencies, change->service_start_name, change->password,
+                                    change->display_name))
+        return Fail(SC_STEP_CHANGE_CONFIG, GetLastError());
+    if (change->request_tag)
+        *tag_id = tag;
+
+    if (change->delayed_auto_start >= 0)
+    {
+        SERVICE_DELAYED_AUTO_START_INFO delayedInfo;
+        delayedInfo.fDelayedAutostart = change->delayed_auto_start ? TRUE : FALSE;
+        if (!Scm()->ChangeServiceConfig2A(svc.get(), SERVICE_CONFIG_DELAYED_AUTO_START_INFO, &delayedInfo))
+            return Fail(SC_STEP_CHANGE_DELAYED_AUTO, GetLastError());
+    }
+    return Succeed();
+}
+
+uint32_t sc_start_service(const char *server, const char *service, uint32_t argc, const char **argv,
+                          uint32_t timeout_ms, sc_transition *transition)
+{
+    sc_transition local;
+    sc_transition &t = transition ? *transition : local;
+    t = sc_transition();
+
+    ScHandle scm, svc;
+    if (uint32_t error = OpenTarget(server, service, SC_MANAGER_CONNECT, SERVICE_START | SERVICE_QUERY_STATUS, scm, svc))
+        return error;
+
+    SERVICE_STATUS_PROCESS ssp;
+    DWORD bytesNeeded = 0;
+    if (!Scm()->QueryServiceStatusEx(svc.get(), SC_STATUS_PROCESS_INFO, reinterpret_cast<LPBYTE>(&ssp), sizeof(ssp),
+                                    &bytesNeeded))
+        return Fail(SC_STEP_QUERY_STATUS, GetLastError());
+    CopyStatus(ssp, t.status);
+    if (ssp.dwCurrentState == SERVICE_RUNNING)
+    {
+        t.already_in_state = 1;
+        return Succeed();
+    }
+
+    if (Scm()->StartServiceA(svc.get(), argc, argv))
+        t.request_sent = 1;
+    else if (GetLastError() != ERROR_SERVICE_ALREADY_RUNNING)
+        return Fail(SC_STEP_START, GetLastError());
+
+    return FinishTransition(scm, service, svc, SERVICE_RUNNING, SERVICE_START_PENDING, timeout_ms,
+                            ERROR_SERVICE_NOT_ACTIVE, t);
+}
+
+uint32_t sc_stop_service(const char *server, const char *service, uint32_t timeout_ms, sc_transition *transition)
+{
+    sc_transition local;
+    sc_transition &t = transition ? *transition : local;
+    t = sc_transition();
+
+    ScHandle scm, svc;
+    if (uint32_t error = OpenTarget(server, service, SC_MANAGER_CONNECT, SERVICE_STOP | SERVICE_QUERY_STATUS, scm, svc))
+        return error;
+
+    SERVICE_STATUS_PROCESS ssp;
+    DWORD bytesNeeded = 0;
+    if (!Scm()->QueryServiceStatusEx(svc.get(), SC_STATUS_PROCESS_INFO, reinterpret_cast<LPBYTE>(&ssp), sizeof(ssp),
+                                    &bytesNeeded))
+        return Fail(SC_STEP_QUERY_STATUS, GetLastError());
+    CopyStatus(ssp, t.status);
+    if (ssp.dwCurrentState == SERVICE_STOPPED)
+    {
+        t.already_in_state = 1;
+        return Succeed();
+    }
+
+    if (!Scm()->ControlService(svc.get(), SERVICE_CONTROL_STOP, reinterpret_cast<LPSERVICE_STATUS>(&ssp)))
+        return Fail(SC_STEP_CONTROL, GetLastError());
+    t.request_sent = 1;
+
+    return FinishTransition(scm, service, svc, SERVICE_STOPPED, SERVICE_STOP_PENDING, timeout_ms,
+                            ERROR_SERVICE_CANNOT_ACCEPT_CTRL, t);
+}
+
+uint32_t sc_create_service(const char *server, const char *service, const sc_service_create *create, uint32_t *tag_id)
+{
+    if (!create || (create->request_tag && !tag_id))
+        return Fail(SC_STEP_NONE, ERROR_INVALID_PARAMETER);
+    if (!service || !*service)
+        return Fail(SC_STEP_CREATE, ERROR_INVALID_NAME);
+    ScHandle scm = OpenSCManagerShared(server ? server : "", SC_MANAGER_CREATE_SERVICE);
+    if (!scm)
+        return Fail(SC_STEP_OPEN_SCM, GetLastError());
+
+    DWORD tag = 0;
+    SC_HANDLE svc = Scm()->CreateServiceA(scm.get(), service, create->display_name ? create->display_name : service,
+                                         SERVICE_CHANGE_CONFIG, create->service_type, create->start_type,
+                                         create->error_control, create->binary_path ? create->binary_path : "",
+                                         create->load_order_group, create->request_tag ? &tag : nullptr,
+                                         create->dependencies, create->service_start_name, create->password);
+    if (!svc)
+        return Fail(SC_STEP_CREATE, GetLastError());
+    if (create->request_tag)
+        *tag_id = tag;
+
+    DWORD error = ERROR_SUCCESS;
+    if (create->delayed_auto_start)
+    {
+        SERVICE_DELAYED_AUTO_START_INFO delayedInfo;
+        delayedInfo.fDelayedAutostart = TRUE;
+        if (!Scm()->ChangeServiceConfig2A(svc, SERVICE_CONFIG_DELAYED_AUTO_START_INFO, &delayedInfo))
+            error = GetLastError();
+    }
+    Scm()->CloseServiceHandle(svc);
+    if (error != ERROR_SUCCESS)
+        return Fail(SC_STEP_CHANGE_DELAYED_AUTO, error);
+    return Succeed();
+}
+
+uint32_t sc_change_failure_actions(const char *server, const char *service, const sc_failure_actions *actions)
+{
+    if (!actions || (actions->action_count && !actions->actions))
+        return Fail(SC_STEP_NONE, ERROR_INVALID_PARAMETER);
+    // Restart actions need SERVICE_START on the handle that sets them.
+    ScHandle scm, svc;
+    if (uint32_t error = OpenTarget(server, service, SC_MANAGER_CONNECT, SERVICE_CHANGE_CONFIG | SERVICE_START, scm, svc))
+        return error;
+
+    std::vector<SC_ACTION> list;
+    if (actions->actions)
+    {
+        for (uint32_t i = 0; i < actions->action_count; i++)
+        {
+            SC_ACTION action;
+            action.Type = static_cast<SC_ACTION_TYPE>(actions->actions[i].type);
+            action.Delay = actions->actions[i].delay_ms;
+            list.push_back(action);
+        }
+    }
+    SERVICE_FAILURE_ACTIONSA sfa;
+    sfa.dwResetPeriod = actions->actions ? actions->reset_period : 0;
+    sfa.lpRebootMsg = const_cast<LPSTR>(actions->reboot_message);
+    sfa.lpCommand = const_cast<LPSTR>(actions->command);
+    sfa.cActions = static_cast<DWORD>(list.size());
+    sfa.lpsaActions = actions->actions ? list.data() : nullptr;
+    if (!Scm()->ChangeServiceConfig2A(svc.get(), SERVICE_CONFIG_FAILURE_ACTIONS, &sfa))
+        return Fail(SC_STEP_CHANGE_FAILURE, GetLastError());
+    return Succeed();
+}
+
+uint32_t sc_delete_service(const char *server, const char *service)
+{
+    ScHandle scm, svc;
+    if (uint32_t error = OpenTarget(server, service, SC_MANAGER_CONNECT, DELETE, scm, svc))
+        return error;
+
+    bool deleted = Scm()->DeleteService(svc.get()) != FALSE;
+    DWORD error = GetLastError();
+    // A cached handle would keep the service marked for deletion; drop it.
+    ForgetSharedService(scm, service);
+    if (!deleted)
+        return Fail(SC_STEP_DELETE, error);
+    return Succeed();
+}
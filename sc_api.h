@@ -0,0 +1,222 @@
+#ifndef SC_API_H
+#define SC_API_H
+
+/*
+ * libsc: in-process access to the Service Control Manager with a C ABI.
+ *
+ * Every function returns a Win32 error code (0 on success) and never prints. Results are
+ * written to caller-provided structs and buffers; when a buffer is too small the function
+ * returns ERROR_INSUFFICIENT_BUFFER (or ERROR_MORE_DATA for enumeration) and reports the
+ * size it needs. sc_last_failed_step() tells which SCM call produced the error.
+ *
+ * A server name of NULL, "" or "\\local" means the local machine. The library is
+ * thread-safe; sc_set_handle_caching keeps SCM and service handles open between calls,
+ * which is what a caller polling in a loop wants.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(SC_API_DLL)
+#if defined(SC_API_EXPORTS)
+#define SC_API __declspec(dllexport)
+#else
+#define SC_API __declspec(dllimport)
+#endif
+#else
+#define SC_API
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Maximum length of a service or display name, including the terminating NUL. */
+#define SC_MAX_NAME 257
+
+/* Value for numeric sc_config_change fields that should keep their current setting. */
+#define SC_NO_CHANGE 0xffffffffu
+
+/* The SCM call that failed in the last unsuccessful libsc call on this thread. */
+typedef enum sc_step
+{
+    SC_STEP_NONE = 0,
+    SC_STEP_OPEN_SCM,            /* OpenSCManager */
+    SC_STEP_OPEN_SERVICE,        /* OpenService */
+    SC_STEP_QUERY_STATUS,        /* QueryServiceStatusEx */
+    SC_STEP_QUERY_CONFIG,        /* QueryServiceConfig */
+    SC_STEP_QUERY_DESCRIPTION,   /* QueryServiceConfig2 (SERVICE_CONFIG_DESCRIPTION) */
+    SC_STEP_ENUMERATE,           /* EnumServicesStatusEx */
+    SC_STEP_START,               /* StartService */
+    SC_STEP_CONTROL,             /* ControlService */
+    SC_STEP_WAIT,                /* Waiting for the state transition */
+    SC_STEP_CHANGE_CONFIG,       /* ChangeServiceConfig */
+    SC_STEP_CHANGE_DELAYED_AUTO, /* ChangeServiceConfig2 (delayed auto-start) */
+    SC_STEP_DELETE,              /* DeleteService */
+    SC_STEP_CREATE,              /* CreateService */
+    SC_STEP_CHANGE_FAILURE       /* ChangeServiceConfig2 (failure actions) */
+} sc_step;
+
+/* Fields of SERVICE_STATUS_PROCESS. */
+typedef struct sc_service_status
+{
+    uint32_t service_type;
+    uint32_t current_state;
+    uint32_t controls_accepted;
+    uint32_t win32_exit_code;
+    uint32_t service_exit_code;
+    uint32_t checkpoint;
+    uint32_t wait_hint;
+    uint32_t process_id;
+    uint32_t service_flags;
+} sc_service_status;
+
+/* One enumerated service. */
+typedef struct sc_service_entry
+{
+    char service_name[SC_MAX_NAME];
+    char display_name[SC_MAX_NAME];
+    sc_service_status status;
+} sc_service_entry;
+
+/* Fields of QUERY_SERVICE_CONFIG. The strings point into the caller's string buffer;
+   dependencies is a list of NUL-terminated names ending with an empty string. */
+typedef struct sc_service_config
+{
+    uint32_t service_type;
+    uint32_t start_type;
+    uint32_t error_control;
+    uint32_t tag_id;
+    const char *binary_path;
+    const char *load_order_group;
+    const char *dependencies;
+    const char *service_start_name;
+    const char *display_name;
+} sc_service_config;
+
+/* Arguments of sc_change_config. SC_NO_CHANGE / NULL leave a setting untouched. */
+typedef struct sc_config_change
+{
+    uint32_t service_type;
+    uint32_t start_type;
+    uint32_t error_control;
+    const char *binary_path;
+    const char *load_order_group;
+    const char *dependencies;
+    const char *service_start_name;
+    const char *password;
+    const char *display_name;
+    int request_tag;        /* Non-zero to have the SCM assign a tag (returned in *tag_id). */
+    int delayed_auto_start; /* 1 or 0 to set the delayed auto-start flag, -1 to leave it. */
+} sc_config_change;
+
+/* Arguments of sc_create_service. NULL strings are left empty, except that display_name
+   defaults to the service name. */
+typedef struct sc_service_create
+{
+    uint32_t service_type;
+    uint32_t start_type;
+    uint32_t error_control;
+    const char *binary_path;
+    const char *load_order_group;
+    const char *dependencies; /* NUL-terminated names ending with an empty string. */
+    const char *service_start_name;
+    const char *password;
+    const char *display_name;
+    int request_tag;        /* Non-zero to have the SCM assign a tag (returned in *tag_id). */
+    int delayed_auto_start; /* Non-zero to set the delayed auto-start flag. */
+} sc_service_create;
+
+/* One failure action: an SC_ACTION_* type and the delay before it, in milliseconds. */
+typedef struct sc_failure_action
+{
+    uint32_t type;
+    uint32_t delay_ms;
+} sc_failure_action;
+
+/* Arguments of sc_change_failure_actions. NULL leaves a setting untouched; "" clears a string. */
+typedef struct sc_failure_actions
+{
+    uint32_t reset_period;            /* Seconds, or INFINITE. Only written along with actions. */
+    const char *reboot_message;
+    const char *command;
+    const sc_failure_action *actions; /* NULL leaves the actions and the reset period. */
+    uint32_t action_count;
+} sc_failure_actions;
+
+/* Outcome of sc_start_service / sc_stop_service. */
+typedef struct sc_transition
+{
+    int already_in_state;     /* The service was already running (start) or stopped (stop). */
+    int request_sent;         /* StartService / ControlService was accepted. */
+    int waited;               /* The call got as far as waiting for the transition. */
+    int timed_out;            /* The timeout elapsed before the transition completed. */
+    int stalled;              /* The service stopped advancing its checkpoint. */
+    uint32_t elapsed_ms;      /* Time spent waiting for the transition. */
+    sc_service_status status; /* Last status observed. */
+} sc_transition;
+
+/* Name of the SCM call behind a step, e.g. "OpenService". */
+SC_API const char *sc_step_name(sc_step step);
+
+/* Step that failed in the last unsuccessful call on this thread. */
+SC_API sc_step sc_last_failed_step(void);
+
+/* Keeps SCM and service handles open between calls (non-zero) or closes them (zero). */
+SC_API void sc_set_handle_caching(int enabled);
+
+/* Queries the current status of a service. */
+SC_API uint32_t sc_query_status(const char *server, const char *service, sc_service_status *status);
+
+/* Enumerates services of the given SERVICE_* type and SERVICE_ACTIVE/INACTIVE/STATE_ALL state,
+   starting at *resume_index. Fills up to capacity entries and sets *returned. Returns
+   ERROR_MORE_DATA when more services remain; *resume_index is then where to continue. */
+SC_API uint32_t sc_enum_services(const char *server, uint32_t service_type, uint32_t service_state,
+                                 const char *group, sc_service_entry *entries, size_t capacity,
+                                 size_t *returned, uint32_t *resume_index);
+
+/* Queries the configuration of a service. Its strings are copied into strings; *required
+   (optional) receives the number of bytes needed. */
+SC_API uint32_t sc_query_config(const char *server, const char *service, sc_service_config *config,
+                                char *strings, size_t strings_size, size_t *required);
+
+/* Copies the description of a service into description (empty if it has none). */
+SC_API uint32_t sc_query_description(const char *server, const char *service, char *description,
+                                     size_t size, size_t *required);
+
+/* Changes the configuration of a service. tag_id may be NULL unless request_tag is set. When every
+   field but delayed_auto_start is left unchanged, only the delayed auto-start flag is written. */
+SC_API uint32_t sc_change_config(const char *server, const char *service, const sc_config_change *change,
+                                 uint32_t *tag_id);
+
+/* Starts a service and waits up to timeout_ms for it to run. transition may be NULL. A wait that
+   times out or stalls fails with ERROR_SERVICE_REQUEST_TIMEOUT; one that settles in another
+   state fails with the service's exit code, or ERROR_SERVICE_NOT_ACTIVE if it reports none. */
+SC_API uint32_t sc_start_service(const char *server, const char *service, uint32_t argc, const char **argv,
+                                 uint32_t timeout_ms, sc_transition *transition);
+
+/* Stops a service and waits up to timeout_ms for it to stop. Errors as for sc_start_service,
+   with ERROR_SERVICE_CANNOT_ACCEPT_CTRL when the service settles without stopping. */
+SC_API uint32_t sc_stop_service(const char *server, const char *service, uint32_t timeout_ms,
+                                sc_transition *transition);
+
+/* Creates a service. tag_id may be NULL unless request_tag is set. If the service is created
+   but the delayed auto-start flag cannot be set, the error is returned with the step
+   SC_STEP_CHANGE_DELAYED_AUTO and the service is left in place. */
+SC_API uint32_t sc_create_service(const char *server, const char *service, const sc_service_create *create,
+                                  uint32_t *tag_id);
+
+/* Changes the actions taken when a service fails. A reboot action needs the SE_SHUTDOWN_NAME
+   privilege enabled in the caller's token; the library does not enable it. */
+SC_API uint32_t sc_change_failure_actions(const char *server, const char *service,
+                                          const sc_failure_actions *actions);
+
+/* Marks a service for deletion. */
+SC_API uint32_t sc_delete_service(const char *server, const char *service);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SC_API_H */
@@ -0,0 +1,163 @@
+#include "scm_backend.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <string>
+
+#include "scm_emulator.h"
+
+#ifdef _MSC_VER
+#pragma comment(lib, "advapi32.lib")
+#endif
+
+#ifdef _WIN32
+SC_HANDLE Win32ScmBackend::OpenSCManagerA(LPCSTR machineName, LPCSTR databaseName, DWORD desiredAccess)
+{
+    return ::OpenSCManagerA(machineName, databaseName, desiredAccess);
+}
+
+SC_HANDLE Win32ScmBackend::OpenServiceA(SC_HANDLE hSCManager, LPCSTR serviceName, DWORD desiredAccess)
+{
+    return ::OpenServiceA(hSCManager, serviceName, desiredAccess);
+}
+
+BOOL Win32ScmBackend::CloseServiceHandle(SC_HANDLE handle)
+{
+    return ::CloseServiceHandle(handle);
+}
+
+BOOL Win32ScmBackend::QueryServiceStatusEx(SC_HANDLE hService, int infoLevel, LPBYTE buffer, DWORD bufSize,
+                                           LPDWORD bytesNeeded)
+{
+    return ::QueryServiceStatusEx(hService, static_cast<SC_STATUS_TYPE>(infoLevel), buffer, bufSize, bytesNeeded);
+}
+
+BOOL Win32ScmBackend::EnumServicesStatusExA(SC_HANDLE hSCManager, int infoLevel, DWORD serviceType,
+                                            DWORD serviceState, LPBYTE services, DWORD bufSize,
+                                            LPDWORD bytesNeeded, LPDWORD servicesReturned, LPDWORD resumeHandle,
+                                            LPCSTR groupName)
+{
+    return ::EnumServicesStatusExA(hSCManager, static_cast<SC_ENUM_TYPE>(infoLevel), serviceType, serviceState,
+                                   services, bufSize, bytesNeeded, servicesReturned, resumeHandle, groupName);
+}
+
+BOOL Win32ScmBackend::EnumDependentServicesA(SC_HANDLE hService, DWORD serviceState,
+                                             LPENUM_SERVICE_STATUSA services, DWORD bufSize, LPDWORD bytesNeeded,
+                                             LPDWORD servicesReturned)
+{
+    return ::EnumDependentServicesA(hService, serviceState, services, bufSize, bytesNeeded, servicesReturned);
+}
+
+BOOL Win32ScmBackend::QueryServiceConfigA(SC_HANDLE hService, LPQUERY_SERVICE_CONFIGA config, DWORD bufSize,
+                                          LPDWORD bytesNeeded)
+{
+    return ::QueryServiceConfigA(hService, config, bufSize, bytesNeeded);
+}
+
+BOOL Win32ScmBackend::QueryServiceConfig2A(SC_HANDLE hService, DWORD infoLevel, LPBYTE buffer, DWORD bufSize,
+                                           LPDWORD bytesNeeded)
+{
+    return ::QueryServiceConfig2A(hService, infoLevel, buffer, bufSize, bytesNeeded);
+}
+
+BOOL Win32ScmBackend::ChangeServiceConfigA(SC_HANDLE hService, DWORD serviceType, DWORD startType,
+                                           DWORD errorControl, LPCSTR binaryPathName, LPCSTR loadOrderGroup,
+                                           LPDWORD tagId, LPCSTR dependencies, LPCSTR serviceStartName,
+                                           LPCSTR password, LPCSTR displayName)
+{
+    return ::ChangeServiceConfigA(hService, serviceType, startType, errorControl, binaryPathName, loadOrderGroup,
+                                  tagId, dependencies, serviceStartName, password, displayName);
+}
+
+BOOL Win32ScmBackend::ChangeServiceConfig2A(SC_HANDLE hService, DWORD infoLevel, LPVOID info)
+{
+    return ::ChangeServiceConfig2A(hService, infoLevel, info);
+}
+
+SC_HANDLE Win32ScmBackend::CreateServiceA(SC_HANDLE hSCManager, LPCSTR serviceName, LPCSTR displayName,
+                                          DWORD desiredAccess, DWORD serviceType, DWORD startType,
+                                          DWORD errorControl, LPCSTR binaryPathName, LPCSTR loadOrderGroup,
+                                          LPDWORD tagId, LPCSTR dependencies, LPCSTR serviceStartName,
+                                          LPCSTR password)
+{
+    return ::CreateServiceA(hSCManager, serviceName, displayName, desiredAccess, serviceType, startType,
+                            errorControl, binaryPathName, loadOrderGroup, tagId, dependencies, serviceStartName,
+                            password);
+}
+
+BOOL Win32ScmBackend::DeleteService(SC_HANDLE hService)
+{
+    return ::DeleteService(hService);
+}
+
+BOOL Win32ScmBackend::StartServiceA(SC_HANDLE hService, DWORD numArgs, LPCSTR *args)
+{
+    return ::StartServiceA(hService, numArgs, args);
+}
+
+BOOL Win32ScmBackend::ControlService(SC_HANDLE hService, DWORD control, LPSERVICE_STATUS status)
+{
+    return ::ControlService(hService, control, status);
+}
+
+DWORD Win32ScmBackend::NotifyServiceStatusChangeA(SC_HANDLE hService, DWORD notifyMask, PSERVICE_NOTIFYA notify)
+{
+#if _WIN32_WINNT >= 0x0600
+    return ::NotifyServiceStatusChangeA(hService, notifyMask, notify);
+#else
+    return ERROR_CALL_NOT_IMPLEMENTED;
+#endif
+}
+#endif // _WIN32
+
+namespace
+{
+    std::shared_ptr<ScmBackend> currentBackend;
+
+    unsigned long EnvNumber(const char *name, unsigned long fallback)
+    {
+        const char *value = std::getenv(name);
+        if (!value || !*value)
+            return fallback;
+        char *end = nullptr;
+        unsigned long number = std::strtoul(value, &end, 10);
+        return (end && *end == '\0') ? number : fallback;
+    }
+
+    std::shared_ptr<ScmBackend> CreateDefaultBackend()
+    {
+#ifdef _WIN32
+        const char *selected = std::getenv("SC_BACKEND");
+        if (!selected || std::string(selected) != "emulator")
+            return std::make_shared<Win32ScmBackend>();
+        const unsigned long defaultServices = 0;
+#else
+        // Without an SCM, give the commands something to list.
+        const unsigned long defaultServices = 200;
+#endif
+        ScmEmulatorOptions options;
+        options.services = EnvNumber("SC_EMULATOR_SERVICES", defaultServices);
+        options.callLatency = std::chrono::microseconds(EnvNumber("SC_EMULATOR_LATENCY_US", 0));
+        options.startDelay = std::chrono::milliseconds(EnvNumber("SC_EMULATOR_START_MS", 0));
+        options.stopDelay = std::chrono::milliseconds(EnvNumber("SC_EMULATOR_STOP_MS", 0));
+        return std::make_shared<ScmEmulator>(options);
+    }
+}
+
+std::shared_ptr<ScmBackend> CurrentScmBackend()
+{
+    std::shared_ptr<ScmBackend> backend = std::atomic_load(&currentBackend);
+    if (backend)
+        return backend;
+    // Two threads may race to create the default; the first one stored wins.
+    std::shared_ptr<ScmBackend> created = CreateDefaultBackend();
+    std::shared_ptr<ScmBackend> expected;
+    if (std::atomic_compare_exchange_strong(&currentBackend, &expected, created))
+        return created;
+    return expected;
+}
+
+void SetScmBackend(std::shared_ptr<ScmBackend> backend)
+{
+    std::atomic_store(&currentBackend, std::move(backend));
+}
@@ -0,0 +1,116 @@
+#ifndef SCM_BACKEND_H
+#define SCM_BACKEND_H
+
+#include <memory>
+#include <utility>
+
+#include "win32_compat.h"
+
+// The Service Control Manager calls sc makes, behind an interface so they can be served by
+// something other than the real SCM. Every method has the signature and error convention
+// of the Win32 function of the same name: failures return FALSE / NULL and set the
+// thread's last error.
+class ScmBackend
+{
+public:
+    virtual ~ScmBackend() = default;
+
+    virtual SC_HANDLE OpenSCManagerA(LPCSTR machineName, LPCSTR databaseName, DWORD desiredAccess) = 0;
+    virtual SC_HANDLE OpenServiceA(SC_HANDLE hSCManager, LPCSTR serviceName, DWORD desiredAccess) = 0;
+    virtual BOOL CloseServiceHandle(SC_HANDLE handle) = 0;
+
+    virtual BOOL QueryServiceStatusEx(SC_HANDLE hService, int infoLevel, LPBYTE buffer, DWORD bufSize,
+                                      LPDWORD bytesNeeded) = 0;
+    virtual BOOL EnumServicesStatusExA(SC_HANDLE hSCManager, int infoLevel, DWORD serviceType,
+                                       DWORD serviceState, LPBYTE services, DWORD bufSize, LPDWORD bytesNeeded,
+                                       LPDWORD servicesReturned, LPDWORD resumeHandle, LPCSTR groupName) = 0;
+    virtual BOOL EnumDependentServicesA(SC_HANDLE hService, DWORD serviceState, LPENUM_SERVICE_STATUSA services,
+                                        DWORD bufSize, LPDWORD bytesNeeded, LPDWORD servicesReturned) = 0;
+    virtual BOOL QueryServiceConfigA(SC_HANDLE hService, LPQUERY_SERVICE_CONFIGA config, DWORD bufSize,
+                                     LPDWORD bytesNeeded) = 0;
+    virtual BOOL QueryServiceConfig2A(SC_HANDLE hService, DWORD infoLevel, LPBYTE buffer, DWORD bufSize,
+                                      LPDWORD bytesNeeded) = 0;
+
+    virtual BOOL ChangeServiceConfigA(SC_HANDLE hService, DWORD serviceType, DWORD startType,
+                                      DWORD errorControl, LPCSTR binaryPathName, LPCSTR loadOrderGroup,
+                                      LPDWORD tagId, LPCSTR dependencies, LPCSTR serviceStartName,
+                                      LPCSTR password, LPCSTR displayName) = 0;
+    virtual BOOL ChangeServiceConfig2A(SC_HANDLE hService, DWORD infoLevel, LPVOID info) = 0;
+    virtual SC_HANDLE CreateServiceA(SC_HANDLE hSCManager, LPCSTR serviceName, LPCSTR displayName,
+                                     DWORD desiredAccess, DWORD serviceType, DWORD startType, DWORD errorControl,
+                                     LPCSTR binaryPathName, LPCSTR loadOrderGroup, LPDWORD tagId,
+                                     LPCSTR dependencies, LPCSTR serviceStartName, LPCSTR password) = 0;
+    virtual BOOL DeleteService(SC_HANDLE hService) = 0;
+
+    virtual BOOL StartServiceA(SC_HANDLE hService, DWORD numArgs, LPCSTR *args) = 0;
+    virtual BOOL ControlService(SC_HANDLE hService, DWORD control, LPSERVICE_STATUS status) = 0;
+
+    // Returns an error code like the Win32 function. Backends without notifications return
+    // ERROR_CALL_NOT_IMPLEMENTED, which makes callers fall back to polling.
+    virtual DWORD NotifyServiceStatusChangeA(SC_HANDLE hService, DWORD notifyMask, PSERVICE_NOTIFYA notify) = 0;
+};
+
+#ifdef _WIN32
+// Forwards every call to advapi32.
+class Win32ScmBackend : public ScmBackend
+{
+public:
+    SC_HANDLE OpenSCManagerA(LPCSTR machineName, LPCSTR databaseName, DWORD desiredAccess) override;
+    SC_HANDLE OpenServiceA(SC_HANDLE hSCManager, LPCSTR serviceName, DWORD desiredAccess) override;
+    BOOL CloseServiceHandle(SC_HANDLE handle) override;
+    BOOL QueryServiceStatusEx(SC_HANDLE hService, int infoLevel, LPBYTE buffer, DWORD bufSize,
+                              LPDWORD bytesNeeded) override;
+    BOOL EnumServicesStatusExA(SC_HANDLE hSCManager, int infoLevel, DWORD serviceType, DWORD serviceState,
+                               LPBYTE services, DWORD bufSize, LPDWORD bytesNeeded, LPDWORD servicesReturned,
+                               LPDWORD resumeHandle, LPCSTR groupName) override;
+    BOOL EnumDependentServicesA(SC_HANDLE hService, DWORD serviceState, LPENUM_SERVICE_STATUSA services,
+                                DWORD bufSize, LPDWORD bytesNeeded, LPDWORD servicesReturned) override;
+    BOOL QueryServiceConfigA(SC_HANDLE hService, LPQUERY_SERVICE_CONFIGA config, DWORD bufSize,
+                             LPDWORD bytesNeeded) override;
+    BOOL QueryServiceConfig2A(SC_HANDLE hService, DWORD infoLevel, LPBYTE buffer, DWORD bufSize,
+                              LPDWORD bytesNeeded) override;
+    BOOL ChangeServiceConfigA(SC_HANDLE hService, DWORD serviceType, DWORD startType, DWORD errorControl,
+                              LPCSTR binaryPathName, LPCSTR loadOrderGroup, LPDWORD tagId, LPCSTR dependencies,
+                              LPCSTR serviceStartName, LPCSTR password, LPCSTR displayName) override;
+    BOOL ChangeServiceConfig2A(SC_HANDLE hService, DWORD infoLevel, LPVOID info) override;
+    SC_HANDLE CreateServiceA(SC_HANDLE hSCManager, LPCSTR serviceName, LPCSTR displayName, DWORD desiredAccess,
+                             DWORD serviceType, DWORD startType, DWORD errorControl, LPCSTR binaryPathName,
+                             LPCSTR loadOrderGroup, LPDWORD tagId, LPCSTR dependencies, LPCSTR serviceStartName,
+                             LPCSTR password) override;
+    BOOL DeleteService(SC_HANDLE hService) override;
+    BOOL StartServiceA(SC_HANDLE hService, DWORD numArgs, LPCSTR *args) override;
+    BOOL ControlService(SC_HANDLE hService, DWORD control, LPSERVICE_STATUS status) override;
+    DWORD NotifyServiceStatusChangeA(SC_HANDLE hService, DWORD notifyMask, PSERVICE_NOTIFYA notify) override;
+};
+#endif
+
+// Returns the process-wide backend. It is created on first use: the real SCM on Windows,
+// or an ScmEmulator when SC_BACKEND=emulator is set or the platform has no SCM. The
+// emulator then reads SC_EMULATOR_SERVICES, SC_EMULATOR_LATENCY_US,
+// SC_EMULATOR_START_MS and SC_EMULATOR_STOP_MS from the environment.
+std::shared_ptr<ScmBackend> CurrentScmBackend();
+
+// Replaces the process-wide backend. Intended for start-up (benchmarks, tests); handles
+// opened through the previous backend are still closed by it.
+void SetScmBackend(std::shared_ptr<ScmBackend> backend);
+
+// Holds the backend a call is made on until the end of the expression making it, so a
+// SetScmBackend on another thread cannot destroy the backend mid-call.
+class ScmBackendRef
+{
+public:
+    explicit ScmBackendRef(std::shared_ptr<ScmBackend> backend) : backend(std::move(backend)) {}
+
+    ScmBackend *operator->() const { return backend.get(); }
+
+private:
+    std::shared_ptr<ScmBackend> backend;
+};
+
+// Shorthand for the current backend, used at every SCM call site as Scm()->Call(...).
+inline ScmBackendRef Scm()
+{
+    return ScmBackendRef(CurrentScmBackend());
+}
+
+#endif // SCM_BACKEND_H
@@ -0,0 +1,204 @@
+#include "scm_buffers.h"
+#include "atomic_file.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+namespace
+{
+    constexpr size_t CALL_COUNT = static_cast<size_t>(ScmCall::Count);
+
+    // Starting sizes: a default enumeration page, the documented maximum for
+    // QueryServiceConfig, and room for typical QueryServiceConfig2 results.
+    constexpr std::array<DWORD, CALL_COUNT> STARTING_SIZES = {64 * 1024, 8 * 1024, 1024, 1024, 256, 4096};
+
+    // Names used in the hints file, in ScmCall order.
+    const char *const CALL_NAMES[CALL_COUNT] = {"EnumServicesStatus", "QueryServiceConfig", "QueryDescription",
+                                                "QueryFailureActions", "QueryConfig2", "EnumDependentServices"};
+
+    // Hints read from a file are clamped to this, so a damaged file cannot make every call
+    // allocate gigabytes.
+    constexpr DWORD MAX_LOADED_HINT = 16 * 1024 * 1024;
+
+    const char *const HINTS_HEADER = "# sc size hints v1";
+
+    using HostHints = std::array<DWORD, CALL_COUNT>;
+
+    std::mutex hintsMutex;
+    bool hintsLoaded = false;
+    bool hintsChanged = false;
+    std::unordered_map<std::string, HostHints> hints; // Keyed by ScmServerKey().
+
+    std::atomic<uint64_t> queries{0};
+    std::atomic<uint64_t> hintHits{0};
+    std::atomic<uint64_t> hintMisses{0};
+    std::atomic<uint64_t> allocations{0};
+
+    std::string EnvironmentValue(const char *name)
+    {
+        const char *value = std::getenv(name);
+        return value ? value : "";
+    }
+
+    // Reads "host<TAB>call<TAB>size" lines. Lines that do not parse are skipped; the local
+    // host is written as "-" since its key is empty.
+    void LoadHints()
+    {
+        std::string path = DefaultSizeHintsPath();
+        if (path.empty())
+            return;
+        std::ifstream in(path);
+        std::string line;
+        if (!in || !std::getline(in, line) || line != HINTS_HEADER)
+            return;
+        while (std::getline(in, line))
+        {
+            std::istringstream fields(line);
+            std::string host, call;
+            unsigned long size = 0;
+            if (!std::getline(fields, host, '\t') || !std::getline(fields, call, '\t') || !(fields >> size))
+                continue;
+            if (host == "-")
+                host.clear();
+            for (size_t i = 0; i < CALL_COUNT; i++)
+            {
+                if (call != CALL_NAMES[i])
+                    continue;
+                auto inserted = hints.emplace(host, STARTING_SIZES);
+                DWORD &hint = inserted.first->second[i];
+                hint = std::max(hint, static_cast<DWORD>(std::min<unsigned long>(size, MAX_LOADED_HINT)));
+            }
+        }
+    }
+
+    // The hints for serverKey; the caller holds hintsMutex.
+    HostHints &HintsFor(const std::string &serverKey)
+    {
+        if (!hintsLoaded)
+        {
+            hintsLoaded = true;
+            LoadHints();
+        }
+        return hints.emplace(serverKey, STARTING_SIZES).first->second;
+    }
+}
+
+ScmBufferStats GetScmBufferStats()
+{
+    ScmBufferStats stats;
+    stats.queries = queries.load(std::memory_order_relaxed);
+    stats.hintHits = hintHits.load(std::memory_order_relaxed);
+    stats.hintMisses = hintMisses.load(std::memory_order_relaxed);
+    stats.allocations = allocations.load(std::memory_order_relaxed);
+    return stats;
+}
+
+ScmCall ScmCallForConfig2(DWORD level)
+{
+    switch (level)
+    {
+    case SERVICE_CONFIG_DESCRIPTION:
+        return ScmCall::QueryDescription;
+    case SERVICE_CONFIG_FAILURE_ACTIONS:
+        return ScmCall::QueryFailureActions;
+    default:
+        return ScmCall::QueryConfig2;
+    }
+}
+
+DWORD ScmSizeHint(const std::string &serverKey, ScmCall call)
+{
+    std::lock_guard<std::mutex> lock(hintsMutex);
+    return HintsFor(serverKey)[static_cast<size_t>(call)];
+}
+
+void NoteScmSize(const std::string &serverKey, ScmCall call, DWORD size)
+{
+    std::lock_guard<std::mutex> lock(hintsMutex);
+    DWORD &hint = HintsFor(serverKey)[static_cast<size_t>(call)];
+    if (size > hint)
+    {
+        hint = size;
+        hintsChanged = true;
+    }
+}
+
+void NoteScmHint(bool hit)
+{
+    queries.fetch_add(1, std::memory_order_relaxed);
+    (hit ? hintHits : hintMisses).fetch_add(1, std::memory_order_relaxed);
+}
+
+std::string DefaultSizeHintsPath()
+{
+    if (const char *configured = std::getenv("SC_SIZE_HINTS"))
+    {
+        std::string path = configured;
+        return path == "off" ? "" : path;
+    }
+#ifdef _WIN32
+    std::string localAppData = EnvironmentValue("LOCALAPPDATA");
+    return localAppData.empty() ? "" : localAppData + "\\sc-size-hints";
+#else
+    std::string cacheHome = EnvironmentValue("XDG_CACHE_HOME");
+    if (!cacheHome.empty())
+        return cacheHome + "/sc-size-hints";
+    std::string home = EnvironmentValue("HOME");
+    return home.empty() ? "" : home + "/.sc-size-hints";
+#endif
+}
+
+bool SaveScmSizeHints()
+{
+    std::lock_guard<std::mutex> lock(hintsMutex);
+    if (!hintsChanged)
+        return true;
+    std::string path = DefaultSizeHintsPath();
+    if (path.empty())
+        return true;
+
+    // Another run may have saved since this one loaded. Hints only grow, so reading the file
+    // again under the lock keeps its hints along with ours.
+    FileLock fileLock(path);
+    LoadHints();
+
+    // Only hints above the starting size are worth a line.
+    std::string out = std::string(HINTS_HEADER) + "\n";
+    for (const auto &entry : hints)
+    {
+        for (size_t i = 0; i < CALL_COUNT; i++)
+        {
+            if (entry.second[i] <= STARTING_SIZES[i])
+                continue;
+            out += entry.first.empty() ? "-" : entry.first;
+            out += '\t';
+            out += CALL_NAMES[i];
+            out += '\t';
+            out += std::to_string(entry.second[i]);
+            out += '\n';
+        }
+    }
+    if (!ReplaceFileContents(path, out))
+        return false;
+    hintsChanged = false;
+    return true;
+}
+
+std::vector<BYTE> &ScmThreadBuffer(ScmCall call)
+{
+    thread_local std::vector<BYTE> buffers[CALL_COUNT];
+    return buffers[static_cast<size_t>(call)];
+}
+
+void ResizeScmBuffer(std::vector<BYTE> &buffer, size_t size)
+{
+    if (size > buffer.capacity())
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    buffer.resize(size);
+}
@@ -0,0 +1,99 @@
+#ifndef SCM_BUFFERS_H
+#define SCM_BUFFERS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "win32_compat.h"
+
+// The SCM calls that return variable-length results. Each has its own per-thread buffer
+// and size hints, since an enumeration page and a description have nothing in common.
+enum class ScmCall
+{
+    EnumServicesStatus,
+    QueryServiceConfig,
+    QueryDescription,
+    QueryFailureActions,
+    QueryConfig2, // Other QueryServiceConfig2 levels.
+    EnumDependentServices,
+    Count
+};
+
+// Counters for the buffers behind ScmQuery and QueryScmBuffer, summed over all threads.
+struct ScmBufferStats
+{
+    uint64_t queries = 0;     // Calls made.
+    uint64_t hintHits = 0;    // The size hint was large enough: one round trip.
+    uint64_t hintMisses = 0;  // A second call with a larger buffer was needed.
+    uint64_t allocations = 0; // Times a buffer had to grow.
+};
+
+ScmBufferStats GetScmBufferStats();
+
+// The QueryServiceConfig2 call type for a SERVICE_CONFIG_* level.
+ScmCall ScmCallForConfig2(DWORD level);
+
+// Size hints: the largest size each call has needed on each host (keyed by ScmServerKey),
+// or the call's starting size for hosts not seen yet. The table is read from
+// DefaultSizeHintsPath() on first use and written back by SaveScmSizeHints, so a later run
+// against the same host sizes its first call right.
+DWORD ScmSizeHint(const std::string &serverKey, ScmCall call);
+
+// Records that call needed size bytes on the host, raising its hint.
+void NoteScmSize(const std::string &serverKey, ScmCall call, DWORD size);
+
+// Records whether a call sized by a hint needed a second round trip.
+void NoteScmHint(bool hit);
+
+// SC_SIZE_HINTS if set ("" or "off" disables persistence), otherwise sc-size-hints under
+// %LOCALAPPDATA% on Windows, $XDG_CACHE_HOME or, failing that, $HOME (as .sc-size-hints).
+std::string DefaultSizeHintsPath();
+
+// Writes the hint table back if it changed since it was read, merged with the hints other runs
+// saved meanwhile, replacing the file atomically. Returns false if it could not be written.
+bool SaveScmSizeHints();
+
+// The calling thread's buffer for call. Buffers only grow, so once they fit the largest
+// result nothing is allocated; a result stays valid until the next call of the same type
+// on the same thread.
+std::vector<BYTE> &ScmThreadBuffer(ScmCall call);
+
+// Resizes buffer, counting an allocation when its capacity has to grow.
+void ResizeScmBuffer(std::vector<BYTE> &buffer, size_t size);
+
+// Calls query(buffer, size, &bytesNeeded) with buffer grown to the host's size hint for
+// call, so the first call usually fits; otherwise grows it once to what the SCM asks for,
+// raises the hint and calls again. Returns false (GetLastError() set) if the query fails.
+template <typename Query>
+bool QueryScmBuffer(std::vector<BYTE> &buffer, ScmCall call, const std::string &serverKey, Query query)
+{
+    DWORD hint = ScmSizeHint(serverKey, call);
+    if (buffer.size() < hint)
+        ResizeScmBuffer(buffer, hint);
+    DWORD bytesNeeded = 0;
+    if (query(buffer.data(), static_cast<DWORD>(buffer.size()), &bytesNeeded))
+    {
+        NoteScmHint(true);
+        return true;
+    }
+    DWORD error = GetLastError();
+    if (error != ERROR_INSUFFICIENT_BUFFER && error != ERROR_MORE_DATA)
+        return false;
+    NoteScmHint(false);
+    NoteScmSize(serverKey, call, bytesNeeded);
+    ResizeScmBuffer(buffer, bytesNeeded);
+    return query(buffer.data(), static_cast<DWORD>(buffer.size()), &bytesNeeded) != FALSE;
+}
+
+// QueryScmBuffer into the calling thread's buffer for call. Returns the result, or nullptr
+// (GetLastError() set) if the query fails.
+template <typename Query>
+const BYTE *ScmQuery(ScmCall call, const std::string &serverKey, Query query)
+{
+    std::vector<BYTE> &buffer = ScmThreadBuffer(call);
+    return QueryScmBuffer(buffer, call, serverKey, query) ? buffer.data() : nullptr;
+}
+
+#endif // SCM_BUFFERS_H
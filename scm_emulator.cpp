@@ -0,0 +1,855 @@
+#include "scm_emulator.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <thread>
+
+namespace
+{
+    std::string LowerCase(const char *text)
+    {
+        std::string result = text ? text : "";
+        for (char &c : result)
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        return result;
+    }
+
+    bool HasAccess(DWORD granted, DWORD required)
+    {
+        return (granted & required) == required;
+    }
+
+    // Converts a double-NUL-terminated list into the stored form: each name followed by a NUL.
+    std::string StoreMultiString(const char *list)
+    {
+        std::string result;
+        for (const char *p = list; p && *p; p += std::strlen(p) + 1)
+        {
+            result += p;
+            result += '\0';
+        }
+        return result;
+    }
+
+    // Lays out a fixed-size structure at the front of a caller buffer and its strings after it.
+    class BufferWriter
+    {
+    public:
+        BufferWriter(LPBYTE buffer, size_t fixedSize) : buffer(buffer), offset(fixedSize) {}
+
+        // Copies length bytes and returns where they landed (or nullptr when only measuring).
+        LPSTR put(const void *data, size_t length)
+        {
+            LPSTR target = buffer ? reinterpret_cast<LPSTR>(buffer + offset) : nullptr;
+            if (target)
+                std::memcpy(target, data, length);
+            offset += length;
+            return target;
+        }
+        LPSTR putString(const std::string &value) { return put(value.c_str(), value.size() + 1); }
+        LPSTR putMultiString(const std::string &value)
+        {
+            LPSTR target = put(value.data(), value.size());
+            static const char terminator = '\0';
+            LPSTR end = put(&terminator, 1);
+            return target ? target : end;
+        }
+
+        size_t size() const { return offset; }
+
+    private:
+        LPBYTE buffer;
+        size_t offset;
+    };
+}
+
+ScmEmulator::ScmEmulator(const ScmEmulatorOptions &options) : options(options)
+{
+    AddSyntheticServices(options.services);
+}
+
+ScmEmulator::~ScmEmulator()
+{
+    for (Handle *handle : handles)
+        delete handle;
+}
+
+void ScmEmulator::AddService(const EmulatedService &service)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Record &record = services[LowerCase(service.name.c_str())];
+    record = Record();
+    record.service = service;
+}
+
+void ScmEmulator::AddSyntheticServices(size_t count)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t first = services.size();
+    for (size_t n = 0; n < count; n++)
+    {
+        size_t i = first + n;
+        char name[32];
+        std::snprintf(name, sizeof(name), "EmuSvc%06zu", i);
+
+        EmulatedService service;
+        service.name = name;
+        service.displayName = "Emulated Service " + std::to_string(i);
+        service.description = "Synthetic service " + std::to_string(i) + " served by the SCM emulator.";
+        service.binaryPath = "C:\\Windows\\System32\\svchost.exe -k emu" + std::to_string(i % 16);
+        service.serviceType = (i % 4 == 0) ? SERVICE_WIN32_OWN_PROCESS : SERVICE_WIN32_SHARE_PROCESS;
+        service.startType = (i % 3 == 0) ? SERVICE_AUTO_START : SERVICE_DEMAND_START;
+        if (i % 50 == 49)
+            service.startType = SERVICE_DISABLED;
+        if (i % 10 == 0)
+            service.group = "EmuGroup" + std::to_string(i % 3);
+        service.controlsAccepted = SERVICE_ACCEPT_STOP | ((i % 5 == 0) ? SERVICE_ACCEPT_SHUTDOWN : 0);
+        if (i % 3 == 0)
+        {
+            service.state = SERVICE_RUNNING;
+            service.processId = processIdFor(service);
+        }
+
+        Record &record = services[LowerCase(name)];
+        record = Record();
+        record.service = std::move(service);
+    }
+}
+
+ScmEmulatorStats ScmEmulator::Stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    ScmEmulatorStats stats;
+    stats.calls = calls.load();
+    stats.openHandles = handles.size();
+    stats.services = services.size();
+    return stats;
+}
+
+void ScmEmulator::simulateLatency()
+{
+    calls.fetch_add(1, std::memory_order_relaxed);
+    if (options.callLatency.count() > 0)
+        std::this_thread::sleep_for(options.callLatency);
+}
+
+// Validates a handle. Sets the last error and returns nullptr when it is unknown, of the
+// wrong kind, or lacks requiredAccess.
+ScmEmulator::Handle *ScmEmulator::lookup(SC_HANDLE handle, bool manager, DWORD requiredAccess)
+{
+    Handle *h = reinterpret_cast<Handle *>(handle);
+    if (!h || handles.find(h) == handles.end() || h->manager != manager)
+    {
+        SetLastError(ERROR_INVALID_HANDLE);
+        return nullptr;
+    }
+    if (!HasAccess(h->access, requiredAccess))
+    {
+        SetLastError(ERROR_ACCESS_DENIED);
+        return nullptr;
+    }
+    return h;
+}
+
+ScmEmulator::Record *ScmEmulator::serviceFor(Handle *handle)
+{
+    auto it = services.find(handle->key);
+    return it == services.end() ? nullptr : &it->second;
+}
+
+void ScmEmulator::advance(Record &record, Clock::time_point now)
+{
+    if (record.targetState == 0 || now < record.transitionEnd)
+        return;
+    record.service.state = record.targetState;
+    record.targetState = 0;
+    if (record.service.state == SERVICE_STOPPED)
+        record.service.processId = 0;
+}
+
+SERVICE_STATUS_PROCESS ScmEmulator::statusOf(Record &record, Clock::time_point now)
+{
+    advance(record, now);
+    const EmulatedService &service = record.service;
+    SERVICE_STATUS_PROCESS ssp = {};
+    ssp.dwServiceType = service.serviceType;
+    ssp.dwCurrentState = service.state;
+    ssp.dwControlsAccepted = service.state == SERVICE_RUNNING ? service.controlsAccepted : 0;
+    ssp.dwWin32ExitCode = service.win32ExitCode;
+    ssp.dwProcessId = service.processId;
+    if (record.targetState != 0)
+    {
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - record.transitionStart).count();
+        DWORD interval = std::max<DWORD>(options.checkpointIntervalMs, 1);
+        ssp.dwCheckPoint = 1 + static_cast<DWORD>(elapsed / interval);
+        ssp.dwWaitHint = options.waitHintMs;
+    }
+    return ssp;
+}
+
+// Share-process services with the same binary path run in one host process, as the
+// services of one svchost group do.
+DWORD ScmEmulator::processIdFor(const EmulatedService &service)
+{
+    if (!(service.serviceType & SERVICE_WIN32_SHARE_PROCESS))
+        return nextProcessId++;
+    auto host = hostProcesses.emplace(service.binaryPath, 0);
+    if (host.second)
+        host.first->second = nextProcessId++;
+    return host.first->second;
+}
+
+void ScmEmulator::beginTransition(Record &record, DWORD pendingState, DWORD targetState,
+                                  std::chrono::milliseconds delay)
+{
+    Clock::time_point now = Clock::now();
+    record.service.win32ExitCode = 0;
+    if (targetState == SERVICE_RUNNING)
+        record.service.processId = processIdFor(record.service);
+    if (delay.count() <= 0)
+    {
+        record.service.state = targetState;
+        if (targetState == SERVICE_STOPPED)
+            record.service.processId = 0;
+        return;
+    }
+    record.service.state = pendingState;
+    record.targetState = targetState;
+    record.transitionStart = now;
+    record.transitionEnd = now + delay;
+}
+
+SC_HANDLE ScmEmulator::newServiceHandle(Record &record, const std::string &key, DWORD access)
+{
+    Handle *h = new Handle();
+    h->access = access;
+    h->key = key;
+    handles.insert(h);
+    record.handles++;
+    return reinterpret_cast<SC_HANDLE>(h);
+}
+
+void ScmEmulator::releaseService(const std::string &key)
+{
+    auto it = services.find(key);
+    if (it == services.end())
+        return;
+    if (it->second.handles > 0)
+        it->second.handles--;
+    if (it->second.deleted && it->second.handles == 0)
+    {
+        if (cursorKey == key)
+            cursorKey.clear();
+        services.erase(it);
+    }
+}
+
+SC_HANDLE ScmEmulator::OpenSCManagerA(LPCSTR, LPCSTR, DWORD desiredAccess)
+{
+    simulateLatency();
+    std::lock_guard<std::mutex> lock(mutex);
+    Handle *h = new Handle();
+    h->manager = true;
+    h->access = desiredAccess;
+    handles.insert(h);
+    return reinterpret_cast<SC_HANDLE>(h);
+}
+
+SC_HANDLE ScmEmulator::OpenServiceA(SC_HANDLE hSCManager, LPCSTR serviceName, DWORD desiredAccess)
+{
+    simulateLatency();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!lookup(hSCManager, true, 0))
+        return nullptr;
+    if (!serviceName || !*serviceName)
+    {
+        SetLastError(ERROR_INVALID_NAME);
+        return nullptr;
+    }
+    std::string key = LowerCase(serviceName);
+    auto it = services.find(key);
+    if (it == services.end())
+    {
+        SetLastError(ERROR_SERVICE_DOES_NOT_EXIST);
+        return nullptr;
+    }
+    return newServiceHandle(it->second, key, desiredAccess);
+}
+
+BOOL ScmEmulator::CloseServiceHandle(SC_HANDLE handle)
+{
+    simulateLatency();
+    std::lock_guard<std::mutex> lock(mutex);
+    Handle *h = reinterpret_cast<Handle *>(handle);
+    if (!h || handles.erase(h) == 0)
+    {
+        SetLastError(ERROR_INVALID_HANDLE);
+        return FALSE;
+    }
+    if (!h->manager)
+        releaseService(h->key);
+    delete h;
+    return TRUE;
+}
+
+BOOL ScmEmulator::QueryServiceStatusEx(SC_HANDLE hService, int infoLevel, LPBYTE buffer, DWORD bufSize,
+                                       LPDWORD bytesNeeded)
+{
+    simulateLatency();
+    std::lock_guard<std::mutex> lock(mutex);
+    Handle *h = lookup(hService, false, SERVICE_QUERY_STATUS);
+    if (!h)
+        return FALSE;
+    if (infoLevel != SC_STATUS_PROCESS_INFO)
+    {
+        SetLastError(ERROR_INVALID_LEVEL);
+        return FALSE;
+    }
+    *bytesNeeded = sizeof(SERVICE_STATUS_PROCESS);
+    if (bufSize < sizeof(SERVICE_STATUS_PROCESS))
+    {
+        SetLastError(ERROR_INSUFFICIENT_BUFFER);
+        return FALSE;
+    }
+    Record *record = serviceFor(h);
+    SERVICE_STATUS_PROCESS ssp = statusOf(*record, Clock::now());
+    std::memcpy(buffer, &ssp, sizeof(ssp));
+    return TRUE;
+}
+
+BOOL ScmEmulator::EnumServicesStatusExA(SC_HANDLE hSCManager, int infoLevel, DWORD serviceType,
+                                        DWORD serviceState, LPBYTE buffer, DWORD bufSize, LPDWORD bytesNeeded,
+                                        LPDWORD servicesReturned, LPDWORD resumeHandle, LPCSTR groupName)
+{
+    simulateLatency();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!lookup(hSCManager, true, SC_MANAGER_ENUMERATE_SERVICE))
+        return FALSE;
+    if (infoLevel != SC_ENUM_PROCESS_INFO)
+    {
+        SetLastError(ERROR_INVALID_LEVEL);
+        return FALSE;
+    }
+    if (serviceState < SERVICE_ACTIVE || serviceState > SERVICE_STATE_ALL)
+    {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return FALSE;
+    }
+
+    // Find the starting service, reusing the cursor left by the previous page if it matches.
+    std::string group = LowerCase(groupName);
+    std::string filter = std::to_string(serviceType) + '/' + std::to_string(serviceState) + '/' +
+                         (groupName ? "=" + group : std::string("*"));
+    DWORD index = resumeHandle ? *resumeHandle : 0;
+    auto it = services.end();
+    bool continuation = false;
+    if (index != 0 && index == cursorIndex && !cursorKey.empty())
+    {
+        it = services.find(cursorKey);
+        continuation = it != services.end() && filter == cursorFilter;
+    }
+    if (it == services.end())
+        it = index < services.size() ? std::next(services.begin(), index) : services.end();
+    Clock::time_point now = Clock::now();
+    auto matches = [&](Record &record)
+    {
+        const EmulatedService &service = record.service;
+        if ((service.serviceType & serviceType) == 0)
+            return false;
+        advance(record, now);
+        bool stopped = service.state == SERVICE_STOPPED;
+        if ((serviceState == SERVICE_ACTIVE && stopped) || (serviceState == SERVICE_INACTIVE && !stopped))
+            return false;
+        return !groupName || LowerCase(service.group.c_str()) == group;
+    };
+
+    // Records fill the buffer from the front and their strings from the back, as the SCM does.
+    size_t front = 0;
+    size_t back = bufSize;
+    DWORD returned = 0;
+    size_t returnedBytes = 0;
+    size_t needed = 0;
+    bool full = false;
+    for (; it != services.end(); ++it, ++index)
+    {
+        Record &record = it->second;
+        if (!matches(record))
+            continue;
+        const EmulatedService &service = record.service;
+        size_t stringBytes = service.name.size() + 1 + service.displayName.size() + 1;
+        size_t entryBytes = sizeof(ENUM_SERVICE_STATUS_PROCESSA) + stringBytes;
+        if (full || front + entryBytes > back)
+        {
+            if (!full)
+            {
+                full = true;
+                cursorIndex = index;
+                cursorKey = it->first;
+                if (resumeHandle)
+                    *resumeHandle = index;
+                if (continuation && cursorRemaining > returnedBytes)
+                {
+                    // Only the previous page walked the rest; reuse its total.
+                    needed = std::max(cursorRemaining - returnedBytes, entryBytes);
+                    break;
+                }
+            }
+            needed += entryBytes;
+            continue;
+        }
+        returnedBytes += entryBytes;
+
+        ENUM_SERVICE_STATUS_PROCESSA *entry = reinterpret_cast<ENUM_SERVICE_STATUS_PROCESSA *>(buffer + front);
+        front += sizeof(ENUM_SERVICE_STATUS_PROCESSA);
+        back -= service.displayName.size() + 1;
+        entry->lpDisplayName = reinterpret_cast<LPSTR>(buffer + back);
+        std::memcpy(entry->lpDisplayName, service.displayName.c_str(), service.displayName.size() + 1);
+        back -= service.name.size() + 1;
+        entry->lpServiceName = reinterpret_cast<LPSTR>(buffer + back);
+        std::memcpy(entry->lpServiceName, service.name.c_str(), service.name.size() + 1);
+        entry->ServiceStatusProcess = statusOf(record, now);
+        returned++;
+    }
+
+    *servicesReturned = returned;
+    *bytesNeeded = static_cast<DWORD>(needed);
+    if (full)
+    {
+        cursorFilter = filter;
+        cursorRemaining = needed;
+        SetLastError(ERROR_MORE_DATA);
+        return FALSE;
+    }
+    if (resumeHandle)
+        *resumeHandle = 0;
+    cursorKey.clear();
+    return TRUE;
+}
+
+// Appends the services that depend on key, deepest dependents first, so the result is an
+// order in which they can be stopped. Called with the mutex held.
+void ScmEmulator::collectDependents(const std::string &key, std::vector<std::string> &order,
+                                    std::set<std::string> &seen)
+{
+    const Record &target = services.at(key);
+    std::string groupEntry = target.service.group.empty() ? std::string() : "+" + LowerCase(target.service.group.c_str());
+    for (const auto &entry : services)
+    {
+        const std::string &dependencies = entry.second.service.dependencies;
+        bool depends = false;
+        size_t pos = 0;
+        while (pos < dependencies.size() && !depends)
+        {
+            std::string name = LowerCase(dependencies.c_str() + pos);
+            depends = name == key || (!groupEntry.empty() && name == groupEntry);
+            pos += name.size() + 1;
+        }
+        if (depends && seen.insert(entry.first).second)
+        {
+            collectDependents(entry.first, order, seen);
+            order.push_back(entry.first);
+        }
+    }
+}
+
+BOOL ScmEmulator::EnumDependentServicesA(SC_HANDLE hService, DWORD serviceState, LPENUM_SERVICE_STATUSA buffer,
+                                         DWORD bufSize, LPDWORD bytesNeeded, LPDWORD servicesReturned)
+{
+    simulateLatency();
+    std::lock_guard<std::mutex> lock(mutex);
+    Handle *h = lookup(hService, false, SERVICE_ENUMERATE_DEPENDENTS);
+    if (!h)
+        return FALSE;
+    if (serviceState < SERVICE_ACTIVE || serviceState > SERVICE_STATE_ALL)
+    {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return FALSE;
+    }
+
+    std::vector<std::string> order;
+    std::set<std::string> seen = {h->key};
+    collectDependents(h->key, order, seen);
+
+    Clock::time_point now = Clock::now();
+    std::vector<std::pair<Record *, SERVICE_STATUS_PROCESS>> matches;
+    size_t needed = 0;
+    for (const std::string &key : order)
+    {
+        Record &record = services.at(key);
+        SERVICE_STATUS_PROCESS ssp = statusOf(record, now);
+        bool stopped = ssp.dwCurrentState == SERVICE_STOPPED;
+        if ((serviceState == SERVICE_ACTIVE && stopped) || (serviceState == SERVICE_INACTIVE && !stopped))
+            continue;
+        matches.emplace_back(&record, ssp);
+        needed += sizeof(ENUM_SERVICE_STATUSA) + record.service.name.size() + 1 + record.service.displayName.size() + 1;
+    }
+
+    *bytesNeeded = static_cast<DWORD>(needed);
+    *servicesReturned = 0;
+    if (!buffer || bufSize < needed)
+    {
+        SetLastError(ERROR_MORE_DATA);
+        return FALSE;
+    }
+
+    // Same layout as EnumServicesStatusExA: records at the front, strings at the back.
+    LPBYTE base = reinterpret_cast<LPBYTE>(buffer);
+    size_t back = bufSize;
+    for (size_t i = 0; i < matches.size(); i++)
+    {
+        const EmulatedService &service = matches[i].first->service;
+        ENUM_SERVICE_STATUSA &entry = buffer[i];
+        back -= service.displayName.size() + 1;
+        entry.lpDisplayName = reinterpret_cast<LPSTR>(base + back);
+        std::memcpy(entry.lpDisplayName, service.displayName.c_str(), service.displayName.size() + 1);
+        back -= service.name.size() + 1;
+        entry.lpServiceName = reinterpret_cast<LPSTR>(base + back);
+        std::memcpy(entry.lpServiceName, service.name.c_str(), service.name.size() + 1);
+        std::memcpy(&entry.ServiceStatus, &matches[i].second, sizeof(SERVICE_STATUS));
+    }
+    *servicesReturned = static_cast<DWORD>(matches.size());
+    return TRUE;
+}
+
+BOOL ScmEmulator::QueryServiceConfigA(SC_HANDLE hService, LPQUERY_SERVICE_CONFIGA config, DWORD bufSize,
+                                      LPDWORD bytesNeeded)
+{
+    simulateLatency();
+    std::lock_guard<std::mutex> lock(mutex);
+    Handle *h = lookup(hService, false, SERVICE_QUERY_CONFIG);
+    if (!h)
+        return FALSE;
+    const EmulatedService &service = serviceFor(h)->service;
+
+    // Measure first, then write.
+    BufferWriter measure(nullptr, sizeof(QUERY_SERVICE_CONFIGA));
+    measure.putString(service.binaryPath);
+    measure.putString(service.group);
+    measure.putMultiString(service.dependencies);
+    measure.putString(service.startName);
+    measure.putString(service.displayName);
+    *bytesNeeded = static_cast<DWORD>(measure.size());
+    if (!config || bufSize < measure.size())
+    {
+        SetLastError(ERROR_INSUFFICIENT_BUFFER);
+        return FALSE;
+    }
+
+    BufferWriter writer(reinterpret_cast<LPBYTE>(config), sizeof(QUERY_SERVICE_CONFIGA));
+    config->dwServiceType = service.serviceType;
+    config->dwStartType = service.startType;
+    config->dwErrorControl = service.errorControl;
+    config->dwTagId = service.tagId;
+    config->lpBinaryPathName = writer.putString(service.binaryPath);
+    config->lpLoadOrderGroup = writer.putString(service.group);
+    config->lpDependencies = writer.putMultiString(service.dependencies);
+    config->lpServiceStartName = writer.putString(service.startName);
+    config->lpDisplayName = writer.putString(service.displayName);
+    return TRUE;
+}
+
+BOOL ScmEmulator::QueryServiceConfig2A(SC_HANDLE hService, DWORD infoLevel, LPBYTE buffer, DWORD bufSize,
+                                       LPDWORD bytesNeeded)
+{
+    simulateLatency();
+    std::lock_guard<std::mutex> lock(mutex);
+    Handle *h = lookup(hService, false, SERVICE_QUERY_CONFIG);
+    if (!h)
+        return FALSE;
+    const EmulatedService &service = serviceFor(h)->service;
+
+    size_t fixed = 0;
+    switch (infoLevel)
+    {
+    case SERVICE_CONFIG_DESCRIPTION:
+        fixed = sizeof(SERVICE_DESCRIPTIONA);
+        break;
+    case SERVICE_CONFIG_FAILURE_ACTIONS:
+        fixed = sizeof(SERVICE_FAILURE_ACTIONSA);
+        break;
+    case SERVICE_CONFIG_DELAYED_AUTO_START_INFO:
+        fixed = sizeof(SERVICE_DELAYED_AUTO_START_INFO);
+        break;
+    default:
+        SetLastError(ERROR_INVALID_LEVEL);
+        return FALSE;
+    }
+
+    // Writes the variable part; with a null buffer it only measures.
+    auto layout = [&](LPBYTE target)
+    {
+        BufferWriter writer(target, fixed);
+        if (infoLevel == SERVICE_CONFIG_DESCRIPTION)
+        {
+            LPSTR description = service.description.empty() ? nullptr : writer.putString(service.description);
+            if (target)
+                reinterpret_cast<SERVICE_DESCRIPTIONA *>(target)->lpDescription = description;
+        }
+        else if (infoLevel == SERVICE_CONFIG_FAILURE_ACTIONS)
+        {
+            SC_ACTION *actions = service.failureActions.empty()
+                                     ? nullptr
+                                     : reinterpret_cast<SC_ACTION *>(writer.put(service.failureActions.data(),
+                                                                                service.failureActions.size() * sizeof(SC_ACTION)));
+            LPSTR reboot = service.rebootMessage.empty() ? nullptr : writer.putString(service.rebootMessage);
+            LPSTR command = service.failureCommand.empty() ? nullptr : writer.putString(service.failureCommand);
+            if (target)
+            {
+                SERVICE_FAILURE_ACTIONSA *sfa = reinterpret_cast<SERVICE_FAILURE_ACTIONSA *>(target);
+                sfa->dwResetPeriod = service.failureResetPeriod;
+                sfa->lpRebootMsg = reboot;
+                sfa->lpCommand = command;
+                sfa->cActions = static_cast<DWORD>(service.failureActions.size());
+                sfa->lpsaActions = actions;
+            }
+        }
+        else if (target)
+        {
+            reinterpret_cast<SERVICE_DELAYED_AUTO_START_INFO *>(target)->fDelayedAutostart =
+                service.delayedAutoStart ? TRUE : FALSE;
+        }
+        return writer.size();
+    };
+
+    size_t size = layout(nullptr);
+    *bytesNeeded = static_cast<DWORD>(size);
+    if (!buffer || bufSize < size)
+    {
+        SetLastError(ERROR_INSUFFICIENT_BUFFER);
+        return FALSE;
+    }
+    layout(buffer);
+    return TRUE;
+}
+
+BOOL ScmEmulator::ChangeServiceConfigA(SC_HANDLE hService, DWORD serviceType, DWORD startType, DWORD errorControl,
+                                       LPCSTR binaryPathName, LPCSTR loadOrderGroup, LPDWORD tagId,
+                                       LPCSTR dependencies, LPCSTR serviceStartName, LPCSTR, LPCSTR displayName)
+{
+    simulateLatency();
+    std::lock_guard<std::mutex> lock(mutex);
+    Handle *h = lookup(hService, false, SERVICE_CHANGE_CONFIG);
+    if (!h)
+        return FALSE;
+    Record *record = serviceFor(h);
+    if (record->deleted)
+    {
+        SetLastError(ERROR_SERVICE_MARKED_FOR_DELETE);
+        return FALSE;
+    }
+
+    EmulatedService &service = record->service;
+    if (serviceType != SERVICE_NO_CHANGE)
+        service.serviceType = serviceType;
+    if (startType != SERVICE_NO_CHANGE)
+        service.startType = startType;
+    if (errorControl != SERVICE_NO_CHANGE)
+        service.errorControl = errorControl;
+    if (binaryPathName)
+        service.binaryPath = binaryPathName;
+    if (loadOrderGroup)
+        service.group = loadOrderGroup;
+    if (dependencies)
+        service.dependencies = StoreMultiString(dependencies);
+    if (serviceStartName)
+        service.startName = serviceStartName;
+    if (displayName)
+        service.displayName = displayName;
+    if (tagId)
+    {
+        if (service.tagId == 0)
+            service.tagId = nextTagId++;
+        *tagId = service.tagId;
+    }
+    return TRUE;
+}
+
+BOOL ScmEmulator::ChangeServiceConfig2A(SC_HANDLE hService, DWORD infoLevel, LPVOID info)
+{
+    simulateLatency();
+    std::lock_guard<std::mutex> lock(mutex);
+    Handle *h = lookup(hService, false, SERVICE_CHANGE_CONFIG);
+    if (!h)
+        return FALSE;
+    if (!info)
+    {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return FALSE;
+    }
+    EmulatedService &service = serviceFor(h)->service;
+
+    switch (infoLevel)
+    {
+    case SERVICE_CONFIG_DESCRIPTION:
+    {
+        const SERVICE_DESCRIPTIONA *desc = static_cast<const SERVICE_DESCRIPTIONA *>(info);
+        if (desc->lpDescription)
+            service.description = desc->lpDescription;
+        return TRUE;
+    }
+    case SERVICE_CONFIG_FAILURE_ACTIONS:
+    {
+        const SERVICE_FAILURE_ACTIONSA *sfa = static_cast<const SERVICE_FAILURE_ACTIONSA *>(info);
+        if (sfa->lpRebootMsg)
+            service.rebootMessage = sfa->lpRebootMsg;
+        if (sfa->lpCommand)
+            service.failureCommand = sfa->lpCommand;
+        if (sfa->lpsaActions)
+        {
+            service.failureResetPeriod = sfa->dwResetPeriod;
+            service.failureActions.assign(sfa->lpsaActions, sfa->lpsaActions + sfa->cActions);
+        }
+        return TRUE;
+    }
+    case SERVICE_CONFIG_DELAYED_AUTO_START_INFO:
+        service.delayedAutoStart = static_cast<const SERVICE_DELAYED_AUTO_START_INFO *>(info)->fDelayedAutostart != FALSE;
+        return TRUE;
+    default:
+        SetLastError(ERROR_INVALID_LEVEL);
+        return FALSE;
+    }
+}
+
+SC_HANDLE ScmEmulator::CreateServiceA(SC_HANDLE hSCManager, LPCSTR serviceName, LPCSTR displayName,
+                                      DWORD desiredAccess, DWORD serviceType, DWORD startType, DWORD errorControl,
+                                      LPCSTR binaryPathName, LPCSTR loadOrderGroup, LPDWORD tagId,
+                                      LPCSTR dependencies, LPCSTR serviceStartName, LPCSTR)
+{
+    simulateLatency();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!lookup(hSCManager, true, SC_MANAGER_CREATE_SERVICE))
+        return nullptr;
+    if (!serviceName || !*serviceName || std::strlen(serviceName) >= 256)
+    {
+        SetLastError(ERROR_INVALID_NAME);
+        return nullptr;
+    }
+    if (!binaryPathName || !*binaryPathName)
+    {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return nullptr;
+    }
+    std::string key = LowerCase(serviceName);
+    auto existing = services.find(key);
+    if (existing != services.end())
+    {
+        SetLastError(existing->second.deleted ? ERROR_SERVICE_MARKED_FOR_DELETE : ERROR_SERVICE_EXISTS);
+        return nullptr;
+    }
+
+    Record &record = services[key];
+    EmulatedService &service = record.service;
+    service.name = serviceName;
+    service.displayName = displayName ? displayName : serviceName;
+    service.binaryPath = binaryPathName;
+    service.group = loadOrderGroup ? loadOrderGroup : "";
+    service.dependencies = StoreMultiString(dependencies);
+    service.startName = serviceStartName ? serviceStartName : "LocalSystem";
+    service.serviceType = serviceType;
+    service.startType = startType;
+    service.errorControl = errorControl;
+    if (tagId)
+    {
+        service.tagId = nextTagId++;
+        *tagId = service.tagId;
+    }
+    return newServiceHandle(record, key, desiredAccess);
+}
+
+BOOL ScmEmulator::DeleteService(SC_HANDLE hService)
+{
+    simulateLatency();
+    std::lock_guard<std::mutex> lock(mutex);
+    Handle *h = lookup(hService, false, DELETE);
+    if (!h)
+        return FALSE;
+    Record *record = serviceFor(h);
+    if (record->deleted)
+    {
+        SetLastError(ERROR_SERVICE_MARKED_FOR_DELETE);
+        return FALSE;
+    }
+    // Like the SCM, the service goes away once the last handle to it is closed.
+    record->deleted = true;
+    return TRUE;
+}
+
+BOOL ScmEmulator::StartServiceA(SC_HANDLE hService, DWORD, LPCSTR *)
+{
+    simulateLatency();
+    std::lock_guard<std::mutex> lock(mutex);
+    Handle *h = lookup(hService, false, SERVICE_START);
+    if (!h)
+        return FALSE;
+    Record *record = serviceFor(h);
+    advance(*record, Clock::now());
+    if (record->deleted)
+    {
+        SetLastError(ERROR_SERVICE_MARKED_FOR_DELETE);
+        return FALSE;
+    }
+    if (record->service.startType == SERVICE_DISABLED)
+    {
+        SetLastError(ERROR_SERVICE_DISABLED);
+        return FALSE;
+    }
+    if (record->service.state != SERVICE_STOPPED)
+    {
+        SetLastError(ERROR_SERVICE_ALREADY_RUNNING);
+        return FALSE;
+    }
+    beginTransition(*record, SERVICE_START_PENDING, SERVICE_RUNNING, options.startDelay);
+    return TRUE;
+}
+
+BOOL ScmEmulator::ControlService(SC_HANDLE hService, DWORD control, LPSERVICE_STATUS status)
+{
+    simulateLatency();
+    std::lock_guard<std::mutex> lock(mutex);
+    DWORD required = control == SERVICE_CONTROL_STOP          ? SERVICE_STOP
+                     : control == SERVICE_CONTROL_INTERROGATE ? SERVICE_INTERROGATE
+                                                              : SERVICE_PAUSE_CONTINUE;
+    Handle *h = lookup(hService, false, required);
+    if (!h)
+        return FALSE;
+    Record *record = serviceFor(h);
+    Clock::time_point now = Clock::now();
+    SERVICE_STATUS_PROCESS ssp = statusOf(*record, now);
+
+    DWORD error = ERROR_SUCCESS;
+    if (ssp.dwCurrentState == SERVICE_STOPPED)
+        error = ERROR_SERVICE_NOT_ACTIVE;
+    else if (record->targetState != 0)
+        error = ERROR_SERVICE_CANNOT_ACCEPT_CTRL;
+    else if (control == SERVICE_CONTROL_STOP)
+    {
+        if (!(ssp.dwControlsAccepted & SERVICE_ACCEPT_STOP))
+            error = ERROR_INVALID_SERVICE_CONTROL;
+        else
+        {
+            beginTransition(*record, SERVICE_STOP_PENDING, SERVICE_STOPPED, options.stopDelay);
+            ssp = statusOf(*record, now);
+        }
+    }
+    else if (control != SERVICE_CONTROL_INTERROGATE)
+        error = ERROR_INVALID_SERVICE_CONTROL;
+
+    // The SCM reports the latest status even when it rejects the control.
+    if (status)
+        std::memcpy(status, &ssp, sizeof(SERVICE_STATUS));
+    if (error != ERROR_SUCCESS)
+    {
+        SetLastError(error);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+DWORD ScmEmulator::NotifyServiceStatusChangeA(SC_HANDLE, DWORD, PSERVICE_NOTIFYA)
+{
+    simulateLatency();
+    return ERROR_CALL_NOT_IMPLEMENTED;
+}
@@ -0,0 +1,155 @@
+#ifndef SCM_EMULATOR_H
+#define SCM_EMULATOR_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "scm_backend.h"
+
+// Tuning knobs for ScmEmulator.
+struct ScmEmulatorOptions
+{
+    size_t services = 0;                                  // Synthetic services created up front.
+    std::chrono::microseconds callLatency{0};             // Delay added to every SCM call.
+    std::chrono::milliseconds startDelay{0};              // Time a service spends in START_PENDING.
+    std::chrono::milliseconds stopDelay{0};               // Time a service spends in STOP_PENDING.
+    DWORD waitHintMs = 2000;                              // dwWaitHint reported while pending.
+    DWORD checkpointIntervalMs = 100;                     // dwCheckPoint advances once per interval.
+};
+
+// One service held by the emulator.
+struct EmulatedService
+{
+    std::string name;
+    std::string displayName;
+    std::string description;
+    std::string binaryPath;
+    std::string group;
+    std::string dependencies; // Double-NUL-terminated list, as in QUERY_SERVICE_CONFIGA.
+    std::string startName = "LocalSystem";
+    DWORD serviceType = SERVICE_WIN32_OWN_PROCESS;
+    DWORD startType = SERVICE_DEMAND_START;
+    DWORD errorControl = SERVICE_ERROR_NORMAL;
+    DWORD tagId = 0;
+    DWORD state = SERVICE_STOPPED;
+    DWORD controlsAccepted = SERVICE_ACCEPT_STOP;
+    DWORD win32ExitCode = 0;
+    DWORD processId = 0;
+    bool delayedAutoStart = false;
+    DWORD failureResetPeriod = 0;
+    std::string rebootMessage;
+    std::string failureCommand;
+    std::vector<SC_ACTION> failureActions;
+};
+
+// Counters reported by ScmEmulator::Stats.
+struct ScmEmulatorStats
+{
+    uint64_t calls = 0;       // SCM calls served.
+    uint64_t openHandles = 0; // Handles currently open.
+    size_t services = 0;      // Services currently registered.
+};
+
+// In-memory stand-in for the Service Control Manager. It keeps services sorted by name (as
+// the SCM enumerates them), enforces handle access rights, and runs start/stop transitions
+// on the wall clock: a started service reports START_PENDING with an advancing checkpoint
+// until startDelay has elapsed, then RUNNING. Every call can be slowed down by callLatency.
+// The machine name passed to OpenSCManagerA is ignored; all servers share one database.
+class ScmEmulator : public ScmBackend
+{
+public:
+    explicit ScmEmulator(const ScmEmulatorOptions &options = ScmEmulatorOptions());
+    ~ScmEmulator() override;
+
+    // Adds (or replaces) a service. Names are case-insensitive, as in the SCM.
+    void AddService(const EmulatedService &service);
+
+    // Creates count synthetic services named EmuSvc000000, EmuSvc000001, ...
+    void AddSyntheticServices(size_t count);
+
+    ScmEmulatorStats Stats() const;
+
+    SC_HANDLE OpenSCManagerA(LPCSTR machineName, LPCSTR databaseName, DWORD desiredAccess) override;
+    SC_HANDLE OpenServiceA(SC_HANDLE hSCManager, LPCSTR serviceName, DWORD desiredAccess) override;
+    BOOL CloseServiceHandle(SC_HANDLE handle) override;
+    BOOL QueryServiceStatusEx(SC_HANDLE hService, int infoLevel, LPBYTE buffer, DWORD bufSize,
+                              LPDWORD bytesNeeded) override;
+    BOOL EnumServicesStatusExA(SC_HANDLE hSCManager, int infoLevel, DWORD serviceType, DWORD serviceState,
+                               LPBYTE services, DWORD bufSize, LPDWORD bytesNeeded, LPDWORD servicesReturned,
+                               LPDWORD resumeHandle, LPCSTR groupName) override;
+    BOOL EnumDependentServicesA(SC_HANDLE hService, DWORD serviceState, LPENUM_SERVICE_STATUSA services,
+                                DWORD bufSize, LPDWORD bytesNeeded, LPDWORD servicesReturned) override;
+    BOOL QueryServiceConfigA(SC_HANDLE hService, LPQUERY_SERVICE_CONFIGA config, DWORD bufSize,
+                             LPDWORD bytesNeeded) override;
+    BOOL QueryServiceConfig2A(SC_HANDLE hService, DWORD infoLevel, LPBYTE buffer, DWORD bufSize,
+                              LPDWORD bytesNeeded) override;
+    BOOL ChangeServiceConfigA(SC_HANDLE hService, DWORD serviceType, DWORD startType, DWORD errorControl,
+                              LPCSTR binaryPathName, LPCSTR loadOrderGroup, LPDWORD tagId, LPCSTR dependencies,
+                              LPCSTR serviceStartName, LPCSTR password, LPCSTR displayName) override;
+    BOOL ChangeServiceConfig2A(SC_HANDLE hService, DWORD infoLevel, LPVOID info) override;
+    SC_HANDLE CreateServiceA(SC_HANDLE hSCManager, LPCSTR serviceName, LPCSTR displayName, DWORD desiredAccess,
+                             DWORD serviceType, DWORD startType, DWORD errorControl, LPCSTR binaryPathName,
+                             LPCSTR loadOrderGroup, LPDWORD tagId, LPCSTR dependencies, LPCSTR serviceStartName,
+                             LPCSTR password) override;
+    BOOL DeleteService(SC_HANDLE hService) override;
+    BOOL StartServiceA(SC_HANDLE hService, DWORD numArgs, LPCSTR *args) override;
+    BOOL ControlService(SC_HANDLE hService, DWORD control, LPSERVICE_STATUS status) override;
+    DWORD NotifyServiceStatusChangeA(SC_HANDLE hService, DWORD notifyMask, PSERVICE_NOTIFYA notify) override;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Record
+    {
+        EmulatedService service;
+        bool deleted = false;   // Marked for deletion; removed when the last handle closes.
+        size_t handles = 0;     // Open service handles.
+        DWORD targetState = 0;  // State a pending transition ends in.
+        Clock::time_point transitionStart;
+        Clock::time_point transitionEnd;
+    };
+
+    struct Handle
+    {
+        bool manager = false;
+        DWORD access = 0;
+        std::string key; // Lower-case service name for service handles.
+    };
+
+    void simulateLatency();
+    Handle *lookup(SC_HANDLE handle, bool manager, DWORD requiredAccess);
+    Record *serviceFor(Handle *handle);
+    void advance(Record &record, Clock::time_point now);
+    SERVICE_STATUS_PROCESS statusOf(Record &record, Clock::time_point now);
+    void beginTransition(Record &record, DWORD pendingState, DWORD targetState, std::chrono::milliseconds delay);
+    DWORD processIdFor(const EmulatedService &service);
+    SC_HANDLE newServiceHandle(Record &record, const std::string &key, DWORD access);
+    void releaseService(const std::string &key);
+    void collectDependents(const std::string &key, std::vector<std::string> &order, std::set<std::string> &seen);
+
+    ScmEmulatorOptions options;
+    mutable std::mutex mutex;
+    std::map<std::string, Record> services; // Keyed by lower-case name.
+    std::unordered_set<Handle *> handles;
+    DWORD nextProcessId = 1000;
+    std::map<std::string, DWORD> hostProcesses; // Binary path of share-process services to their host PID.
+    DWORD nextTagId = 1;
+    std::atomic<uint64_t> calls{0};
+
+    // Enumeration cursor: the SCM resume handle is the index of the next service, so
+    // remember where the previous page stopped to continue without rescanning. The bytes
+    // still needed are carried over too, so each page only walks the services it returns.
+    DWORD cursorIndex = 0;
+    std::string cursorKey;
+    std::string cursorFilter;
+    size_t cursorRemaining = 0;
+};
+
+#endif // SCM_EMULATOR_H
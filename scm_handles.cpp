@@ -0,0 +1,208 @@
+#include "scm_handles.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace
+{
+    // Read with std::atomic_load: fan-out workers abandoned after a timeout may still be
+    // using the pool after the batch that enabled it has turned it off.
+    std::shared_ptr<ScmHandlePool> sharedPool;
+
+    std::string ToLower(std::string s)
+    {
+        std::transform(s.begin(), s.end(), s.begin(),
+                       [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+        return s;
+    }
+
+    // Manager entries use the server key alone; service entries append the service name.
+    // Service names are case-insensitive, as in the SCM.
+    std::string ServiceEntryKey(const std::string &serverKey, const std::string &serviceName)
+    {
+        return serverKey + '\n' + ToLower(serviceName);
+    }
+} // end anonymous namespace
+
+const std::string &ScHandle::serverKey() const
+{
+    static const std::string localKey;
+    return ref ? ref->serverKey : localKey;
+}
+
+const char *MachineNameFor(const std::string &serverName)
+{
+    if (serverName.empty() || serverName == "\\\\local" || serverName == "\\local")
+        return NULL;
+    return serverName.c_str();
+}
+
+std::string ScmServerKey(const std::string &serverName)
+{
+    if (!MachineNameFor(serverName))
+        return std::string();
+    return ToLower(serverName);
+}
+
+ScmHandlePool::ScmHandlePool(std::chrono::milliseconds idleTimeout)
+    : idleTimeout(idleTimeout), lastSweep(std::chrono::steady_clock::now())
+{
+}
+
+ScHandle ScmHandlePool::acquire(const std::string &key, const std::string &serverKey, DWORD access,
+                                const std::function<SC_HANDLE(DWORD)> &open)
+{
+    DWORD widened = access;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastSweep > idleTimeout)
+            evictIdleLocked(now);
+
+        auto it = entries.find(key);
+        if (it != entries.end())
+        {
+            if ((it->second.access & access) == access)
+            {
+                ++stats.hits;
+                it->second.lastUsed = now;
+                return ScHandle(it->second.ref);
+            }
+            widened |= it->second.access;
+            ++stats.widenings;
+        }
+        ++stats.misses;
+    }
+
+    // Open outside the lock: against a remote server this is a network round-trip and
+    // other threads should keep hitting the cache meanwhile.
+    SC_HANDLE handle = open(widened);
+    if (!handle && widened != access)
+    {
+        // The wider request may be denied where the narrower one is allowed. Hand out an
+        // uncached handle and keep the existing entry.
+        handle = open(access);
+        if (!handle)
+            return ScHandle();
+        return ScHandle(std::make_shared<ScHandleRef>(handle, serverKey));
+    }
+    if (!handle)
+        return ScHandle();
+
+    auto ref = std::make_shared<ScHandleRef>(handle, serverKey);
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry &entry = entries[key];
+    // If another thread raced us to a handle with at least these rights, keep both alive
+    // but cache the wider one. A replaced handle closes when its last user releases it.
+    if (!entry.ref || (widened & entry.access) == entry.access)
+    {
+        entry.ref = ref;
+        entry.access = widened;
+    }
+    entry.lastUsed = std::chrono::steady_clock::now();
+    return ScHandle(ref);
+}
+
+ScHandle ScmHandlePool::OpenManager(const std::string &serverName, DWORD access)
+{
+    std::string serverKey = ScmServerKey(serverName);
+    return acquire(serverKey, serverKey, access,
+                   [&serverName](DWORD rights)
+                   { return Scm()->OpenSCManagerA(MachineNameFor(serverName), nullptr, rights); });
+}
+
+ScHandle ScmHandlePool::OpenService(const ScHandle &scm, const std::string &serviceName, DWORD access)
+{
+    return acquire(ServiceEntryKey(scm.serverKey(), serviceName), scm.serverKey(), access,
+                   [&scm, &serviceName](DWORD rights)
+                   { return Scm()->OpenServiceA(scm.get(), serviceName.c_str(), rights); });
+}
+
+void ScmHandlePool::Forget(const ScHandle &scm, const std::string &serviceName)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.erase(ServiceEntryKey(scm.serverKey(), serviceName));
+}
+
+size_t ScmHandlePool::EvictIdle()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return evictIdleLocked(std::chrono::steady_clock::now());
+}
+
+size_t ScmHandlePool::evictIdleLocked(std::chrono::steady_clock::time_point now)
+{
+    lastSweep = now;
+    size_t evicted = 0;
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        // use_count() == 1 means only the pool holds the handle.
+        if (it->second.ref.use_count() == 1 && now - it->second.lastUsed > idleTimeout)
+        {
+            it = entries.erase(it);
+            ++evicted;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    stats.evictions += evicted;
+    return evicted;
+}
+
+void ScmHandlePool::Clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+}
+
+ScmPoolStats ScmHandlePool::Stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    ScmPoolStats result = stats;
+    result.open = entries.size();
+    return result;
+}
+
+ScHandle OpenSCManagerShared(const std::string &serverName, DWORD access)
+{
+    if (auto pool = SharedScmHandlePool())
+        return pool->OpenManager(serverName, access);
+
+    SC_HANDLE handle = Scm()->OpenSCManagerA(MachineNameFor(serverName), nullptr, access);
+    if (!handle)
+        return ScHandle();
+    return ScHandle(std::make_shared<ScHandleRef>(handle, ScmServerKey(serverName)));
+}
+
+ScHandle OpenServiceShared(const ScHandle &scm, const std::string &serviceName, DWORD access)
+{
+    if (auto pool = SharedScmHandlePool())
+        return pool->OpenService(scm, serviceName, access);
+
+    SC_HANDLE handle = Scm()->OpenServiceA(scm.get(), serviceName.c_str(), access);
+    if (!handle)
+        return ScHandle();
+    return ScHandle(std::make_shared<ScHandleRef>(handle, scm.serverKey()));
+}
+
+void ForgetSharedService(const ScHandle &scm, const std::string &serviceName)
+{
+    if (auto pool = SharedScmHandlePool())
+        pool->Forget(scm, serviceName);
+}
+
+void SetScmHandleSharing(bool enabled)
+{
+    if (enabled && !SharedScmHandlePool())
+        std::atomic_store(&sharedPool, std::make_shared<ScmHandlePool>());
+    else if (!enabled)
+        std::atomic_store(&sharedPool, std::shared_ptr<ScmHandlePool>());
+}
+
+std::shared_ptr<ScmHandlePool> SharedScmHandlePool()
+{
+    return std::atomic_load(&sharedPool);
+}
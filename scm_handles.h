@@ -0,0 +1,133 @@
+#ifndef SCM_HANDLES_H
+#define SCM_HANDLES_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "scm_backend.h"
+
+// An open SC_HANDLE plus the server it belongs to. The handle is closed with
+// CloseServiceHandle, through the backend that opened it, when the last reference goes away.
+struct ScHandleRef
+{
+    ScHandleRef(SC_HANDLE handle, std::string serverKey)
+        : handle(handle), serverKey(std::move(serverKey)), backend(CurrentScmBackend()) {}
+    ~ScHandleRef()
+    {
+        if (handle)
+            backend->CloseServiceHandle(handle);
+    }
+    ScHandleRef(const ScHandleRef &) = delete;
+    ScHandleRef &operator=(const ScHandleRef &) = delete;
+
+    SC_HANDLE handle;
+    std::string serverKey; // Normalized server name (see ScmServerKey).
+    std::shared_ptr<ScmBackend> backend;
+};
+
+// RAII reference to an SCM or service handle. Handles handed out by the pool stay open
+// in the pool after the last ScHandle is destroyed; all others are closed.
+class ScHandle
+{
+public:
+    ScHandle() = default;
+    explicit ScHandle(std::shared_ptr<ScHandleRef> ref) : ref(std::move(ref)) {}
+
+    SC_HANDLE get() const { return ref ? ref->handle : nullptr; }
+    const std::string &serverKey() const;
+    explicit operator bool() const { return get() != nullptr; }
+    void reset() { ref.reset(); }
+
+private:
+    std::shared_ptr<ScHandleRef> ref;
+};
+
+// Counters reported by ScmHandlePool::Stats.
+struct ScmPoolStats
+{
+    uint64_t hits = 0;      // Requests served from a cached handle.
+    uint64_t misses = 0;    // Requests that had to open a handle.
+    uint64_t widenings = 0; // Misses caused by a cached handle lacking the requested rights.
+    uint64_t evictions = 0; // Idle handles closed by EvictIdle.
+    size_t open = 0;        // Handles currently cached.
+};
+
+// Thread-safe cache of SCM handles keyed by server and service handles keyed by server
+// and service name. A cached handle is reused when its access rights cover the request;
+// otherwise it is reopened with the union of both, so the rights only ever widen.
+// Entries not referenced by any ScHandle for longer than the idle timeout are evicted.
+class ScmHandlePool
+{
+public:
+    explicit ScmHandlePool(std::chrono::milliseconds idleTimeout = std::chrono::seconds(60));
+
+    // Opens (or reuses) a handle to the Service Control Manager on serverName.
+    // On failure the returned handle is empty and GetLastError() holds the error.
+    ScHandle OpenManager(const std::string &serverName, DWORD access);
+
+    // Opens (or reuses) a handle to serviceName through an SCM handle from this pool.
+    ScHandle OpenService(const ScHandle &scm, const std::string &serviceName, DWORD access);
+
+    // Drops a cached service handle, e.g. after DeleteService so the pool does not keep
+    // the service marked for deletion.
+    void Forget(const ScHandle &scm, const std::string &serviceName);
+
+    // Closes every unreferenced handle idle for longer than the timeout. Returns the count.
+    size_t EvictIdle();
+
+    // Drops every cached handle. Handles still referenced close when released.
+    void Clear();
+
+    ScmPoolStats Stats() const;
+
+private:
+    struct Entry
+    {
+        std::shared_ptr<ScHandleRef> ref;
+        DWORD access = 0;
+        std::chrono::steady_clock::time_point lastUsed;
+    };
+
+    ScHandle acquire(const std::string &key, const std::string &serverKey, DWORD access,
+                     const std::function<SC_HANDLE(DWORD)> &open);
+    size_t evictIdleLocked(std::chrono::steady_clock::time_point now);
+
+    mutable std::mutex mutex;
+    std::map<std::string, Entry> entries;
+    std::chrono::milliseconds idleTimeout;
+    std::chrono::steady_clock::time_point lastSweep;
+    ScmPoolStats stats;
+};
+
+// Returns the machine name to pass to OpenSCManagerA: NULL for an empty server name or
+// "\\local", otherwise the server name itself.
+const char *MachineNameFor(const std::string &serverName);
+
+// Normalizes a server name for use as a cache key: lower case, and empty for the local machine.
+std::string ScmServerKey(const std::string &serverName);
+
+// Opens the Service Control Manager on serverName with the requested access, through the
+// shared pool when one is enabled and directly otherwise.
+// On failure the returned handle is empty and GetLastError() holds the error.
+ScHandle OpenSCManagerShared(const std::string &serverName, DWORD access);
+
+// Opens serviceName through scm, using the shared pool when one is enabled.
+ScHandle OpenServiceShared(const ScHandle &scm, const std::string &serviceName, DWORD access);
+
+// Drops serviceName from the shared pool, if any.
+void ForgetSharedService(const ScHandle &scm, const std::string &serviceName);
+
+// Turns the process-wide handle pool on or off (batch mode turns it on).
+// Turning it off closes every cached handle.
+void SetScmHandleSharing(bool enabled);
+
+// Returns the process-wide handle pool, or nullptr when sharing is off.
+std::shared_ptr<ScmHandlePool> SharedScmHandlePool();
+
+#endif // SCM_HANDLES_H
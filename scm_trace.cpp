@@ -0,0 +1,356 @@
+#include "scm_trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    struct TraceEvent
+    {
+        const char *category;
+        const char *name;
+        char detail[48]; // Service, machine or command name; truncated.
+        uint64_t beginNs;
+        uint64_t endNs;
+        DWORD error;
+        DWORD buffer; // Buffer size offered to a query or enumeration.
+        DWORD needed; // Bytes the SCM asked for when the buffer was too small.
+        DWORD count;  // Entries an enumeration returned.
+    };
+
+    // Written only by the thread that owns it; written is published with release so the
+    // dump sees complete events.
+    struct TraceRing
+    {
+        explicit TraceRing(uint32_t tid) : tid(tid), events(new TraceEvent[TRACE_EVENTS_PER_THREAD]) {}
+
+        uint32_t tid;
+        std::atomic<uint64_t> written{0};
+        std::unique_ptr<TraceEvent[]> events;
+    };
+
+    std::atomic<bool> tracing{false};
+    std::chrono::steady_clock::time_point traceEpoch;
+    // Every ring ever created, so events outlive the threads that recorded them.
+    std::mutex ringsMutex;
+    std::vector<std::shared_ptr<TraceRing>> rings;
+
+    uint64_t NowNs()
+    {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - traceEpoch).count());
+    }
+
+    // The lock is only taken the first time a thread records.
+    TraceRing &ThisThreadRing()
+    {
+        thread_local std::shared_ptr<TraceRing> ring;
+        if (!ring)
+        {
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            ring = std::make_shared<TraceRing>(static_cast<uint32_t>(rings.size() + 1));
+            rings.push_back(ring);
+        }
+        return *ring;
+    }
+
+    void Record(const char *category, const char *name, const char *detail, uint64_t beginNs, DWORD error,
+                DWORD buffer = 0, DWORD needed = 0, DWORD count = 0)
+    {
+        uint64_t endNs = NowNs();
+        TraceRing &ring = ThisThreadRing();
+        uint64_t n = ring.written.load(std::memory_order_relaxed);
+        TraceEvent &event = ring.events[n % TRACE_EVENTS_PER_THREAD];
+        event.category = category;
+        event.name = name;
+        size_t length = 0;
+        for (; detail && detail[length] && length < sizeof(event.detail) - 1; length++)
+            event.detail[length] = detail[length];
+        event.detail[length] = '\0';
+        event.beginNs = beginNs;
+        event.endNs = endNs;
+        event.error = error;
+        event.buffer = buffer;
+        event.needed = needed;
+        event.count = count;
+        ring.written.store(n + 1, std::memory_order_release);
+    }
+
+    // Records an SCM call that returned ok, leaving the thread's last error as the call set it.
+    void RecordCall(const char *name, const char *detail, uint64_t beginNs, bool ok, DWORD buffer = 0,
+                    const DWORD *needed = nullptr, const DWORD *count = nullptr)
+    {
+        DWORD error = ok ? ERROR_SUCCESS : GetLastError();
+        Record("scm", name, detail, beginNs, error, buffer, !ok && needed ? *needed : 0, count ? *count : 0);
+        SetLastError(error);
+    }
+
+    void AppendJsonString(std::string &out, const char *text)
+    {
+        out += '"';
+        for (const char *p = text; *p; ++p)
+        {
+            unsigned char c = static_cast<unsigned char>(*p);
+            if (c == '"' || c == '\\')
+            {
+                out += '\\';
+                out += *p;
+            }
+            else if (c < 0x20)
+            {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            }
+            else
+            {
+                out += *p;
+            }
+        }
+        out += '"';
+    }
+
+    // Chrome trace timestamps are microseconds; keep the nanoseconds as the fraction.
+    void AppendMicroseconds(std::string &out, uint64_t ns)
+    {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%llu.%03u", static_cast<unsigned long long>(ns / 1000),
+                      static_cast<unsigned>(ns % 1000));
+        out += text;
+    }
+
+    void AppendEvent(std::string &out, uint32_t tid, const TraceEvent &event)
+    {
+        out += ",\n{\"name\":\"";
+        out += event.name;
+        out += "\",\"cat\":\"";
+        out += event.category;
+        out += "\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+        out += std::to_string(tid);
+        out += ",\"ts\":";
+        AppendMicroseconds(out, event.beginNs);
+        out += ",\"dur\":";
+        AppendMicroseconds(out, event.endNs - event.beginNs);
+        out += ",\"args\":{\"error\":";
+        out += std::to_string(event.error);
+        if (event.detail[0])
+        {
+            out += ",\"detail\":";
+            AppendJsonString(out, event.detail);
+        }
+        if (event.buffer)
+            out += ",\"buffer\":" + std::to_string(event.buffer);
+        if (event.needed)
+            out += ",\"needed\":" + std::to_string(event.needed);
+        if (event.count)
+            out += ",\"count\":" + std::to_string(event.count);
+        out += "}}";
+    }
+} // end anonymous namespace
+
+TracingScmBackend::TracingScmBackend(std::shared_ptr<ScmBackend> inner) : inner(std::move(inner)) {}
+
+SC_HANDLE TracingScmBackend::OpenSCManagerA(LPCSTR machineName, LPCSTR databaseName, DWORD desiredAccess)
+{
+    uint64_t begin = NowNs();
+    SC_HANDLE result = inner->OpenSCManagerA(machineName, databaseName, desiredAccess);
+    RecordCall("OpenSCManagerA", machineName, begin, result != NULL);
+    return result;
+}
+
+SC_HANDLE TracingScmBackend::OpenServiceA(SC_HANDLE hSCManager, LPCSTR serviceName, DWORD desiredAccess)
+{
+    uint64_t begin = NowNs();
+    SC_HANDLE result = inner->OpenServiceA(hSCManager, serviceName, desiredAccess);
+    RecordCall("OpenServiceA", serviceName, begin, result != NULL);
+    return result;
+}
+
+BOOL TracingScmBackend::CloseServiceHandle(SC_HANDLE handle)
+{
+    uint64_t begin = NowNs();
+    BOOL result = inner->CloseServiceHandle(handle);
+    RecordCall("CloseServiceHandle", nullptr, begin, result != FALSE);
+    return result;
+}
+
+BOOL TracingScmBackend::QueryServiceStatusEx(SC_HANDLE hService, int infoLevel, LPBYTE buffer, DWORD bufSize,
+                                             LPDWORD bytesNeeded)
+{
+    uint64_t begin = NowNs();
+    BOOL result = inner->QueryServiceStatusEx(hService, infoLevel, buffer, bufSize, bytesNeeded);
+    RecordCall("QueryServiceStatusEx", nullptr, begin, result != FALSE, bufSize, bytesNeeded);
+    return result;
+}
+
+BOOL TracingScmBackend::EnumServicesStatusExA(SC_HANDLE hSCManager, int infoLevel, DWORD serviceType,
+                                              DWORD serviceState, LPBYTE services, DWORD bufSize,
+                                              LPDWORD bytesNeeded, LPDWORD servicesReturned, LPDWORD resumeHandle,
+                                              LPCSTR groupName)
+{
+    uint64_t begin = NowNs();
+    BOOL result = inner->EnumServicesStatusExA(hSCManager, infoLevel, serviceType, serviceState, services, bufSize,
+                                               bytesNeeded, servicesReturned, resumeHandle, groupName);
+    RecordCall("EnumServicesStatusExA", groupName, begin, result != FALSE, bufSize, bytesNeeded, servicesReturned);
+    return result;
+}
+
+BOOL TracingScmBackend::EnumDependentServicesA(SC_HANDLE hService, DWORD serviceState,
+                                               LPENUM_SERVICE_STATUSA services, DWORD bufSize, LPDWORD bytesNeeded,
+                                               LPDWORD servicesReturned)
+{
+    uint64_t begin = NowNs();
+    BOOL result = inner->EnumDependentServicesA(hService, serviceState, services, bufSize, bytesNeeded,
+                                                servicesReturned);
+    RecordCall("EnumDependentServicesA", nullptr, begin, result != FALSE, bufSize, bytesNeeded, servicesReturned);
+    return result;
+}
+
+BOOL TracingScmBackend::QueryServiceConfigA(SC_HANDLE hService, LPQUERY_SERVICE_CONFIGA config, DWORD bufSize,
+                                            LPDWORD bytesNeeded)
+{
+    uint64_t begin = NowNs();
+    BOOL result = inner->QueryServiceConfigA(hService, config, bufSize, bytesNeeded);
+    RecordCall("QueryServiceConfigA", nullptr, begin, result != FALSE, bufSize, bytesNeeded);
+    return result;
+}
+
+BOOL TracingScmBackend::QueryServiceConfig2A(SC_HANDLE hService, DWORD infoLevel, LPBYTE buffer, DWORD bufSize,
+                                             LPDWORD bytesNeeded)
+{
+    uint64_t begin = NowNs();
+    BOOL result = inner->QueryServiceConfig2A(hService, infoLevel, buffer, bufSize, bytesNeeded);
+    RecordCall("QueryServiceConfig2A", nullptr, begin, result != FALSE, bufSize, bytesNeeded);
+    return result;
+}
+
+BOOL TracingScmBackend::ChangeServiceConfigA(SC_HANDLE hService, DWORD serviceType, DWORD startType,
+                                             DWORD errorControl, LPCSTR binaryPathName, LPCSTR loadOrderGroup,
+                                             LPDWORD tagId, LPCSTR dependencies, LPCSTR serviceStartName,
+                                             LPCSTR password, LPCSTR displayName)
+{
+    uint64_t begin = NowNs();
+    BOOL result = inner->ChangeServiceConfigA(hService, serviceType, startType, errorControl, binaryPathName,
+                                              loadOrderGroup, tagId, dependencies, serviceStartName, password,
+                                              displayName);
+    RecordCall("ChangeServiceConfigA", nullptr, begin, result != FALSE);
+    return result;
+}
+
+BOOL TracingScmBackend::ChangeServiceConfig2A(SC_HANDLE hService, DWORD infoLevel, LPVOID info)
+{
+    uint64_t begin = NowNs();
+    BOOL result = inner->ChangeServiceConfig2A(hService, infoLevel, info);
+    RecordCall("ChangeServiceConfig2A", nullptr, begin, result != FALSE);
+    return result;
+}
+
+SC_HANDLE TracingScmBackend::CreateServiceA(SC_HANDLE hSCManager, LPCSTR serviceName, LPCSTR displayName,
+                                            DWORD desiredAccess, DWORD serviceType, DWORD startType,
+                                            DWORD errorControl, LPCSTR binaryPathName, LPCSTR loadOrderGroup,
+                                            LPDWORD tagId, LPCSTR dependencies, LPCSTR serviceStartName,
+                                            LPCSTR password)
+{
+    uint64_t begin = NowNs();
+    SC_HANDLE result = inner->CreateServiceA(hSCManager, serviceName, displayName, desiredAccess, serviceType,
+                                             startType, errorControl, binaryPathName, loadOrderGroup, tagId,
+                                             dependencies, serviceStartName, password);
+    RecordCall("CreateServiceA", serviceName, begin, result != NULL);
+    return result;
+}
+
+BOOL TracingScmBackend::DeleteService(SC_HANDLE hService)
+{
+    uint64_t begin = NowNs();
+    BOOL result = inner->DeleteService(hService);
+    RecordCall("DeleteService", nullptr, begin, result != FALSE);
+    return result;
+}
+
+BOOL TracingScmBackend::StartServiceA(SC_HANDLE hService, DWORD numArgs, LPCSTR *args)
+{
+    uint64_t begin = NowNs();
+    BOOL result = inner->StartServiceA(hService, numArgs, args);
+    RecordCall("StartServiceA", nullptr, begin, result != FALSE);
+    return result;
+}
+
+BOOL TracingScmBackend::ControlService(SC_HANDLE hService, DWORD control, LPSERVICE_STATUS status)
+{
+    uint64_t begin = NowNs();
+    BOOL result = inner->ControlService(hService, control, status);
+    RecordCall("ControlService", nullptr, begin, result != FALSE);
+    return result;
+}
+
+DWORD TracingScmBackend::NotifyServiceStatusChangeA(SC_HANDLE hService, DWORD notifyMask, PSERVICE_NOTIFYA notify)
+{
+    uint64_t begin = NowNs();
+    DWORD error = inner->NotifyServiceStatusChangeA(hService, notifyMask, notify);
+    Record("scm", "NotifyServiceStatusChangeA", nullptr, begin, error);
+    return error;
+}
+
+void StartScmTrace()
+{
+    if (tracing.load(std::memory_order_acquire))
+        return;
+    traceEpoch = std::chrono::steady_clock::now();
+    SetScmBackend(std::make_shared<TracingScmBackend>(CurrentScmBackend()));
+    tracing.store(true, std::memory_order_release);
+}
+
+bool ScmTraceEnabled()
+{
+    return tracing.load(std::memory_order_relaxed);
+}
+
+bool WriteScmTrace(const std::string &path, std::string &error)
+{
+    std::vector<std::shared_ptr<TraceRing>> recorded;
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        recorded = rings;
+    }
+
+    std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+                      "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"sc\"}}";
+    uint64_t dropped = 0;
+    for (const std::shared_ptr<TraceRing> &ring : recorded)
+    {
+        out += ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string(ring->tid) +
+               ",\"args\":{\"name\":\"thread " + std::to_string(ring->tid) + "\"}}";
+        uint64_t written = ring->written.load(std::memory_order_acquire);
+        uint64_t first = written > TRACE_EVENTS_PER_THREAD ? written - TRACE_EVENTS_PER_THREAD : 0;
+        dropped += first;
+        for (uint64_t i = first; i < written; i++)
+            AppendEvent(out, ring->tid, ring->events[i % TRACE_EVENTS_PER_THREAD]);
+    }
+    out += "\n],\"otherData\":{\"dropped_events\":" + std::to_string(dropped) + "}}\n";
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file || !file.write(out.data(), static_cast<std::streamsize>(out.size())) || !file.flush())
+    {
+        error = "cannot write the file";
+        return false;
+    }
+    return true;
+}
+
+TraceSpan::TraceSpan(const char *name, const char *detail) : name(name), detail(detail)
+{
+    if (tracing.load(std::memory_order_relaxed))
+        beginNs = NowNs();
+    else
+        this->name = nullptr;
+}
+
+TraceSpan::~TraceSpan()
+{
+    if (name)
+        Record("sc", name, detail, beginNs, ERROR_SUCCESS);
+}
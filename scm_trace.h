@@ -0,0 +1,85 @@
+#ifndef SCM_TRACE_H
+#define SCM_TRACE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "scm_backend.h"
+
+// Tracing of SCM calls, enabled with the global option trace= <file>:
+//   sc.exe [<servername>] trace= <file> <command> ...
+// While tracing, every SCM call goes through a TracingScmBackend, which records its begin
+// and end time, error code and buffer sizes. Each thread records into a ring of its own, so
+// recording takes no lock. WriteScmTrace writes the events as a Chrome trace that
+// chrome://tracing and ui.perfetto.dev open. Without trace= nothing is installed, and a
+// TraceSpan costs one relaxed atomic load.
+
+// Events kept per thread; once a thread records more, its oldest events are dropped.
+constexpr size_t TRACE_EVENTS_PER_THREAD = 16384;
+
+// Forwards every call to the backend it wraps and records it in the calling thread's ring.
+class TracingScmBackend : public ScmBackend
+{
+public:
+    explicit TracingScmBackend(std::shared_ptr<ScmBackend> inner);
+
+    SC_HANDLE OpenSCManagerA(LPCSTR machineName, LPCSTR databaseName, DWORD desiredAccess) override;
+    SC_HANDLE OpenServiceA(SC_HANDLE hSCManager, LPCSTR serviceName, DWORD desiredAccess) override;
+    BOOL CloseServiceHandle(SC_HANDLE handle) override;
+    BOOL QueryServiceStatusEx(SC_HANDLE hService, int infoLevel, LPBYTE buffer, DWORD bufSize,
+                              LPDWORD bytesNeeded) override;
+    BOOL EnumServicesStatusExA(SC_HANDLE hSCManager, int infoLevel, DWORD serviceType, DWORD serviceState,
+                               LPBYTE services, DWORD bufSize, LPDWORD bytesNeeded, LPDWORD servicesReturned,
+                               LPDWORD resumeHandle, LPCSTR groupName) override;
+    BOOL EnumDependentServicesA(SC_HANDLE hService, DWORD serviceState, LPENUM_SERVICE_STATUSA services,
+                                DWORD bufSize, LPDWORD bytesNeeded, LPDWORD servicesReturned) override;
+    BOOL QueryServiceConfigA(SC_HANDLE hService, LPQUERY_SERVICE_CONFIGA config, DWORD bufSize,
+                             LPDWORD bytesNeeded) override;
+    BOOL QueryServiceConfig2A(SC_HANDLE hService, DWORD infoLevel, LPBYTE buffer, DWORD bufSize,
+                              LPDWORD bytesNeeded) override;
+    BOOL ChangeServiceConfigA(SC_HANDLE hService, DWORD serviceType, DWORD startType, DWORD errorControl,
+                              LPCSTR binaryPathName, LPCSTR loadOrderGroup, LPDWORD tagId, LPCSTR dependencies,
+                              LPCSTR serviceStartName, LPCSTR password, LPCSTR displayName) override;
+    BOOL ChangeServiceConfig2A(SC_HANDLE hService, DWORD infoLevel, LPVOID info) override;
+    SC_HANDLE CreateServiceA(SC_HANDLE hSCManager, LPCSTR serviceName, LPCSTR displayName, DWORD desiredAccess,
+                             DWORD serviceType, DWORD startType, DWORD errorControl, LPCSTR binaryPathName,
+                             LPCSTR loadOrderGroup, LPDWORD tagId, LPCSTR dependencies, LPCSTR serviceStartName,
+                             LPCSTR password) override;
+    BOOL DeleteService(SC_HANDLE hService) override;
+    BOOL StartServiceA(SC_HANDLE hService, DWORD numArgs, LPCSTR *args) override;
+    BOOL ControlService(SC_HANDLE hService, DWORD control, LPSERVICE_STATUS status) override;
+    DWORD NotifyServiceStatusChangeA(SC_HANDLE hService, DWORD notifyMask, PSERVICE_NOTIFYA notify) override;
+
+private:
+    std::shared_ptr<ScmBackend> inner;
+};
+
+// Starts recording: puts a TracingScmBackend in front of the current backend. Handles
+// opened before stay valid, since the wrapper hands them to the same backend.
+void StartScmTrace();
+
+bool ScmTraceEnabled();
+
+// Writes every event recorded so far as Chrome trace JSON. Returns false with the reason
+// in error if the file cannot be written.
+bool WriteScmTrace(const std::string &path, std::string &error);
+
+// Records the time between construction and destruction as an event, for the work around
+// SCM calls (a whole command, a wait for a service state). name must outlive the trace;
+// detail is copied (and truncated).
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char *name, const char *detail = nullptr);
+    ~TraceSpan();
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+    const char *name;
+    const char *detail;
+    uint64_t beginNs = 0;
+};
+
+#endif // SCM_TRACE_H
@@ -0,0 +1,506 @@
+#include "service_filter.h"
+
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
+const char *const SERVICE_FILTER_HELP = R"(WHERE EXPRESSIONS:
+        Tests joined with && and ||, negated with ! and grouped with ( ).
+        Each test is <field> <op> <value>; quote values containing spaces.
+          name, display         text: == != ~ !~ (~ is a regex search)
+          path, group, account  text, from the service configuration
+          state                 STOPPED, START_PENDING, STOP_PENDING, RUNNING,
+                                CONTINUE_PENDING, PAUSE_PENDING, PAUSED
+          type                  KERNEL, FILESYS, ADAPT, REC, OWN, SHARE,
+                                INTERACT, DRIVER, SERVICE (== tests the bits)
+          start                 BOOT, SYSTEM, AUTO, DEMAND, DISABLED
+          error                 IGNORE, NORMAL, SEVERE, CRITICAL
+          pid, exit, flags      numbers
+        Numeric fields also take numbers (0x for hex) and < <= > >=.
+        Text comparisons ignore case. start, error, path, group and account
+        read each service's configuration, but only for services the rest
+        of the expression has not already decided.
+)";
+
+namespace
+{
+    struct Symbol
+    {
+        const char *name;
+        DWORD value;
+    };
+
+    const Symbol STATE_SYMBOLS[] = {{"stopped", SERVICE_STOPPED},
+                                    {"start_pending", SERVICE_START_PENDING},
+                                    {"stop_pending", SERVICE_STOP_PENDING},
+                                    {"running", SERVICE_RUNNING},
+                                    {"continue_pending", SERVICE_CONTINUE_PENDING},
+                                    {"pause_pending", SERVICE_PAUSE_PENDING},
+                                    {"paused", SERVICE_PAUSED}};
+
+    const Symbol TYPE_SYMBOLS[] = {{"kernel", SERVICE_KERNEL_DRIVER},
+                                   {"filesys", SERVICE_FILE_SYSTEM_DRIVER},
+                                   {"adapt", 0x00000004},
+                                   {"rec", 0x00000008},
+                                   {"own", SERVICE_WIN32_OWN_PROCESS},
+                                   {"share", SERVICE_WIN32_SHARE_PROCESS},
+                                   {"interact", SERVICE_INTERACTIVE_PROCESS},
+                                   {"driver", SERVICE_DRIVER},
+                                   {"service", SERVICE_WIN32}};
+
+    const Symbol START_SYMBOLS[] = {{"boot", SERVICE_BOOT_START},
+                                    {"system", SERVICE_SYSTEM_START},
+                                    {"auto", SERVICE_AUTO_START},
+                                    {"demand", SERVICE_DEMAND_START},
+                                    {"disabled", SERVICE_DISABLED}};
+
+    const Symbol ERROR_SYMBOLS[] = {{"ignore", SERVICE_ERROR_IGNORE},
+                                    {"normal", SERVICE_ERROR_NORMAL},
+                                    {"severe", SERVICE_ERROR_SEVERE},
+                                    {"critical", SERVICE_ERROR_CRITICAL}};
+
+    using Field = ServiceFilter::Field;
+    using Compare = ServiceFilter::Compare;
+
+    struct FieldName
+    {
+        const char *name;
+        Field field;
+    };
+
+    const FieldName FIELD_NAMES[] = {{"name", Field::Name},   {"display", Field::Display}, {"type", Field::Type},
+                                     {"state", Field::State}, {"pid", Field::Pid},         {"exit", Field::ExitCode},
+                                     {"flags", Field::Flags}, {"start", Field::Start},     {"error", Field::Error},
+                                     {"path", Field::Path},   {"group", Field::Group},     {"account", Field::Account}};
+
+    bool IsTextField(Field field)
+    {
+        return field == Field::Name || field == Field::Display || field == Field::Path || field == Field::Group ||
+               field == Field::Account;
+    }
+
+    bool IsConfigField(Field field)
+    {
+        return field >= Field::Start;
+    }
+
+    std::string ToLower(std::string s)
+    {
+        for (char &c : s)
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        return s;
+    }
+
+    // Compares text with an already lower-cased value, ignoring case.
+    bool EqualsLower(const char *text, const std::string &lower)
+    {
+        size_t i = 0;
+        for (; text[i]; i++)
+        {
+            if (i == lower.size() || std::tolower(static_cast<unsigned char>(text[i])) != lower[i])
+                return false;
+        }
+        return i == lower.size();
+    }
+
+    template <size_t N>
+    bool LookUp(const Symbol (&symbols)[N], const std::string &lower, DWORD &value)
+    {
+        for (const Symbol &symbol : symbols)
+        {
+            if (lower == symbol.name)
+            {
+                value = symbol.value;
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+// Recursive descent over the expression, emitting the program as it goes.
+class FilterCompiler
+{
+public:
+    FilterCompiler(const std::string &expression, ServiceFilter &filter) : text(expression), filter(filter) {}
+
+    void Compile()
+    {
+        ParseOr();
+        SkipSpace();
+        if (pos < text.size())
+            Fail("expected && or ||");
+        if (filter.program.empty())
+            Fail("expected a test");
+    }
+
+private:
+    void Fail(const std::string &what) const
+    {
+        throw std::invalid_argument("Error: Invalid where= expression at position " + std::to_string(pos + 1) +
+                                    ": " + what + ".");
+    }
+
+    void SkipSpace()
+    {
+        while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos])))
+            pos++;
+    }
+
+    bool Accept(const char *token)
+    {
+        SkipSpace();
+        size_t length = std::strlen(token);
+        if (text.compare(pos, length, token) != 0)
+            return false;
+        pos += length;
+        return true;
+    }
+
+    size_t Emit(ServiceFilter::Op op, uint32_t arg = 0)
+    {
+        filter.program.push_back({op, arg});
+        return filter.program.size() - 1;
+    }
+
+    // Each operand after the first is preceded by a jump past the rest of the chain, taken
+    // as soon as the result is decided.
+    template <typename Operand>
+    void ParseChain(const char *separator, ServiceFilter::Op shortCircuit, Operand operand)
+    {
+        operand();
+        std::vector<size_t> jumps;
+        while (Accept(separator))
+        {
+            jumps.push_back(Emit(shortCircuit));
+            operand();
+        }
+        for (size_t jump : jumps)
+            filter.program[jump].arg = static_cast<uint32_t>(filter.program.size());
+    }
+
+    void ParseOr()
+    {
+        ParseChain("||", ServiceFilter::Op::JumpIfTrue, [this]
+                   { ParseAnd(); });
+    }
+
+    void ParseAnd()
+    {
+        ParseChain("&&", ServiceFilter::Op::JumpIfFalse, [this]
+                   { ParseUnary(); });
+    }
+
+    void ParseUnary()
+    {
+        SkipSpace();
+        if (pos < text.size() && text[pos] == '!')
+        {
+            pos++;
+            ParseUnary();
+            Emit(ServiceFilter::Op::Not);
+            return;
+        }
+        if (Accept("("))
+        {
+            ParseOr();
+            if (!Accept(")"))
+                Fail("expected )");
+            return;
+        }
+        ParseTest();
+    }
+
+    void ParseTest()
+    {
+        SkipSpace();
+        size_t start = pos;
+        while (pos < text.size() && (std::isalnum(static_cast<unsigned char>(text[pos])) || text[pos] == '_'))
+            pos++;
+        if (pos == start)
+            Fail("expected a field name");
+        std::string name = ToLower(text.substr(start, pos - start));
+        const FieldName *field = nullptr;
+        for (const FieldName &candidate : FIELD_NAMES)
+        {
+            if (name == candidate.name)
+                field = &candidate;
+        }
+        if (!field)
+        {
+            pos = start;
+            Fail("unknown field '" + name + "'");
+        }
+
+        ServiceFilter::Test test;
+        test.field = field->field;
+        size_t opPosition = (SkipSpace(), pos);
+        if (Accept("=="))
+            test.compare = Compare::Equal;
+        else if (Accept("!="))
+            test.compare = Compare::NotEqual;
+        else if (Accept("!~"))
+            test.compare = Compare::NotSearch;
+        else if (Accept("~"))
+            test.compare = Compare::Search;
+        else if (Accept("<="))
+            test.compare = Compare::LessOrEqual;
+        else if (Accept(">="))
+            test.compare = Compare::GreaterOrEqual;
+        else if (Accept("<"))
+            test.compare = Compare::Less;
+        else if (Accept(">"))
+            test.compare = Compare::Greater;
+        else
+            Fail("expected a comparison after '" + name + "'");
+
+        bool isText = IsTextField(test.field);
+        bool search = test.compare == Compare::Search || test.compare == Compare::NotSearch;
+        bool ordered = test.compare != Compare::Equal && test.compare != Compare::NotEqual && !search;
+        if ((search || ordered) && (isText != search || test.field == Field::Type))
+        {
+            pos = opPosition;
+            Fail(std::string(search ? "~ needs a text field" : "'" + name + "' cannot be ordered"));
+        }
+
+        size_t valuePosition = (SkipSpace(), pos);
+        std::string value = ParseValue();
+        if (search)
+        {
+            try
+            {
+                test.pattern = std::regex(value, std::regex::ECMAScript | std::regex::icase | std::regex::optimize);
+            }
+            catch (const std::regex_error &)
+            {
+                pos = valuePosition;
+                Fail("invalid regular expression '" + value + "'");
+            }
+        }
+        else if (isText)
+        {
+            test.text = ToLower(value);
+        }
+        else if (!ParseNumber(test.field, value, test.number))
+        {
+            pos = valuePosition;
+            Fail("invalid value '" + value + "' for " + name);
+        }
+
+        if (IsConfigField(test.field))
+            filter.needsConfig = true;
+        filter.tests.push_back(std::move(test));
+        Emit(ServiceFilter::Op::Test, static_cast<uint32_t>(filter.tests.size() - 1));
+    }
+
+    // A quoted value, or everything up to white space, && or ||, or a ) closing a parenthesis
+    // opened before the value.
+    std::string ParseValue()
+    {
+        SkipSpace();
+        if (pos < text.size() && (text[pos] == '"' || text[pos] == '\''))
+        {
+            char quote = text[pos];
+            size_t close = text.find(quote, pos + 1);
+            if (close == std::string::npos)
+                Fail("unterminated quoted value");
+            std::string value = text.substr(pos + 1, close - pos - 1);
+            pos = close + 1;
+            return value;
+        }
+        size_t start = pos;
+        int depth = 0;
+        while (pos < text.size() && !std::isspace(static_cast<unsigned char>(text[pos])))
+        {
+            if (text.compare(pos, 2, "&&") == 0 || text.compare(pos, 2, "||") == 0)
+                break;
+            if (text[pos] == '(')
+                depth++;
+            else if (text[pos] == ')' && depth-- == 0)
+                break;
+            pos++;
+        }
+        if (pos == start)
+            Fail("expected a value");
+        return text.substr(start, pos - start);
+    }
+
+    static bool ParseNumber(Field field, const std::string &value, DWORD &number)
+    {
+        std::string lower = ToLower(value);
+        switch (field)
+        {
+        case Field::State:
+            if (LookUp(STATE_SYMBOLS, lower, number))
+                return true;
+            break;
+        case Field::Type:
+            if (LookUp(TYPE_SYMBOLS, lower, number))
+                return true;
+            break;
+        case Field::Start:
+            if (LookUp(START_SYMBOLS, lower, number))
+                return true;
+            break;
+        case Field::Error:
+            if (LookUp(ERROR_SYMBOLS, lower, number))
+                return true;
+            break;
+        default:
+            break;
+        }
+        try
+        {
+            size_t used = 0;
+            unsigned long parsed = std::stoul(value, &used, 0);
+            if (used != value.size() || parsed > 0xFFFFFFFFul)
+                return false;
+            number = static_cast<DWORD>(parsed);
+            return true;
+        }
+        catch (...)
+        {
+            return false;
+        }
+    }
+
+    const std::string &text;
+    ServiceFilter &filter;
+    size_t pos = 0;
+};
+
+std::shared_ptr<const ServiceFilter> ServiceFilter::Compile(const std::string &expression)
+{
+    auto filter = std::make_shared<ServiceFilter>();
+    FilterCompiler(expression, *filter).Compile();
+    return filter;
+}
+
+bool ServiceFilter::Evaluate(const Test &test, const char *serviceName, const char *displayName,
+                             const SERVICE_STATUS_PROCESS &status, const ServiceConfigFields *config) const
+{
+    const char *text = nullptr;
+    DWORD number = 0;
+    switch (test.field)
+    {
+    case Field::Name:
+        text = serviceName;
+        break;
+    case Field::Display:
+        text = displayName;
+        break;
+    case Field::Type:
+        // Types are bit sets: == asks for all of the value's bits.
+        return ((status.dwServiceType & test.number) == test.number) == (test.compare == Compare::Equal);
+    case Field::State:
+        number = status.dwCurrentState;
+        break;
+    case Field::Pid:
+        number = status.dwProcessId;
+        break;
+    case Field::ExitCode:
+        number = status.dwWin32ExitCode;
+        break;
+    case Field::Flags:
+        number = status.dwServiceFlags;
+        break;
+    case Field::Start:
+        number = config->startType;
+        break;
+    case Field::Error:
+        number = config->errorControl;
+        break;
+    case Field::Path:
+        text = config->binaryPath;
+        break;
+    case Field::Group:
+        text = config->loadOrderGroup;
+        break;
+    case Field::Account:
+        text = config->serviceStartName;
+        break;
+    }
+
+    if (IsTextField(test.field))
+    {
+        if (!text)
+            text = "";
+        switch (test.compare)
+        {
+        case Compare::Equal:
+            return EqualsLower(text, test.text);
+        case Compare::NotEqual:
+            return !EqualsLower(text, test.text);
+        case Compare::Search:
+            return std::regex_search(text, test.pattern);
+        case Compare::NotSearch:
+            return !std::regex_search(text, test.pattern);
+        default:
+            return false;
+        }
+    }
+
+    switch (test.compare)
+    {
+    case Compare::Equal:
+        return number == test.number;
+    case Compare::NotEqual:
+        return number != test.number;
+    case Compare::Less:
+        return number < test.number;
+    case Compare::LessOrEqual:
+        return number <= test.number;
+    case Compare::Greater:
+        return number > test.number;
+    case Compare::GreaterOrEqual:
+        return number >= test.number;
+    default:
+        return false;
+    }
+}
+
+bool ServiceFilter::Matches(const char *serviceName, const char *displayName, const SERVICE_STATUS_PROCESS &status,
+                            const ServiceConfigReader &readConfig) const
+{
+    ServiceConfigFields config;
+    bool configRead = false, haveConfig = false;
+    bool result = false;
+    for (size_t pc = 0; pc < program.size();)
+    {
+        const Instruction &instruction = program[pc++];
+        switch (instruction.op)
+        {
+        case Op::Test:
+        {
+            const Test &test = tests[instruction.arg];
+            if (IsConfigField(test.field))
+            {
+                if (!configRead)
+                {
+                    configRead = true;
+                    haveConfig = readConfig && readConfig(serviceName, config);
+                }
+                if (!haveConfig)
+                {
+                    result = false;
+                    break;
+                }
+            }
+            result = Evaluate(test, serviceName, displayName ? displayName : "", status, &config);
+            break;
+        }
+        case Op::Not:
+            result = !result;
+            break;
+        case Op::JumpIfFalse:
+            if (!result)
+                pc = instruction.arg;
+            break;
+        case Op::JumpIfTrue:
+            if (result)
+                pc = instruction.arg;
+            break;
+        }
+    }
+    return result;
+}
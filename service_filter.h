@@ -0,0 +1,117 @@
+#ifndef SERVICE_FILTER_H
+#define SERVICE_FILTER_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "win32_compat.h"
+
+// The configuration fields a filter can test. The strings may be null.
+struct ServiceConfigFields
+{
+    DWORD startType = 0;
+    DWORD errorControl = 0;
+    const char *binaryPath = nullptr;
+    const char *loadOrderGroup = nullptr;
+    const char *serviceStartName = nullptr;
+};
+
+// Reads the configuration of a service when a filter needs it. Returns false if it cannot be
+// read; the configuration tests of that service then fail.
+using ServiceConfigReader = std::function<bool(const char *serviceName, ServiceConfigFields &config)>;
+
+// A where= expression compiled into a flat program: one instruction per test, negation or
+// short-circuit jump, evaluated with a single result register. The status tests read the
+// enumerated record in place; the configuration is read at most once per service and only
+// when the evaluation reaches a configuration test.
+//
+//   expr       := and-expr { "||" and-expr }
+//   and-expr   := unary { "&&" unary }
+//   unary      := "!" unary | "(" expr ")" | field op value
+//   op         := "==" | "!=" | "~" | "!~" (text), "==" | "!=" | "<" | "<=" | ">" | ">=" (numbers)
+//
+// Text comparisons ignore case; ~ is a regular expression search. type== tests for type bits,
+// so type==share also matches an interactive share process.
+class ServiceFilter
+{
+public:
+    // Throws std::invalid_argument describing the first error in expression.
+    static std::shared_ptr<const ServiceFilter> Compile(const std::string &expression);
+
+    // Whether any test needs the configuration, so callers without a reader can say so up front.
+    bool NeedsConfig() const { return needsConfig; }
+
+    bool Matches(const char *serviceName, const char *displayName, const SERVICE_STATUS_PROCESS &status,
+                 const ServiceConfigReader &readConfig) const;
+
+    enum class Field : uint8_t
+    {
+        Name,
+        Display,
+        Type,
+        State,
+        Pid,
+        ExitCode,
+        Flags,
+        // Configuration fields from here on.
+        Start,
+        Error,
+        Path,
+        Group,
+        Account,
+    };
+
+    enum class Compare : uint8_t
+    {
+        Equal,
+        NotEqual,
+        Less,
+        LessOrEqual,
+        Greater,
+        GreaterOrEqual,
+        Search,
+        NotSearch,
+    };
+
+    enum class Op : uint8_t
+    {
+        Test,        // result = tests[arg]
+        Not,         // result = !result
+        JumpIfFalse, // if (!result) go to arg
+        JumpIfTrue,  // if (result) go to arg
+    };
+
+    struct Test
+    {
+        Field field;
+        Compare compare;
+        DWORD number = 0;   // Numeric fields.
+        std::string text;   // Text fields, lower-cased for == and !=.
+        std::regex pattern; // ~ and !~.
+    };
+
+    struct Instruction
+    {
+        Op op;
+        uint32_t arg;
+    };
+
+private:
+    friend class FilterCompiler;
+
+    bool Evaluate(const Test &test, const char *serviceName, const char *displayName,
+                  const SERVICE_STATUS_PROCESS &status, const ServiceConfigFields *config) const;
+
+    std::vector<Test> tests;
+    std::vector<Instruction> program;
+    bool needsConfig = false;
+};
+
+// Help text describing the fields and values for the commands that take where=.
+extern const char *const SERVICE_FILTER_HELP;
+
+#endif // SERVICE_FILTER_H
@@ -0,0 +1,201 @@
+#include "service_graph.h"
+#include "scm_buffers.h"
+#include "scm_handles.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <deque>
+
+namespace
+{
+    std::string ToLower(std::string s)
+    {
+        std::transform(s.begin(), s.end(), s.begin(),
+                       [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+        return s;
+    }
+
+    // Reads the services a service depends on, skipping load order groups.
+    DWORD ReadDependencies(const ScHandle &scm, const std::string &name, std::vector<std::string> &dependencies)
+    {
+        ScHandle service = OpenServiceShared(scm, name, SERVICE_QUERY_CONFIG);
+        if (!service)
+            return GetLastError();
+        const BYTE *result = ScmQuery(ScmCall::QueryServiceConfig, service.serverKey(), [&service](BYTE *data, DWORD size, DWORD *needed)
+                                      { return Scm()->QueryServiceConfigA(service.get(), reinterpret_cast<LPQUERY_SERVICE_CONFIGA>(data),
+                                                                         size, needed); });
+        if (!result)
+            return GetLastError();
+
+        const QUERY_SERVICE_CONFIGA *config = reinterpret_cast<const QUERY_SERVICE_CONFIGA *>(result);
+        dependencies.clear();
+        for (const char *p = config->lpDependencies; p && *p; p += std::strlen(p) + 1)
+        {
+            if (*p != SC_GROUP_IDENTIFIERA)
+                dependencies.push_back(p);
+        }
+        return ERROR_SUCCESS;
+    }
+
+    // Reads every service that depends on a service, directly or not.
+    DWORD ReadDependents(const ScHandle &scm, const std::string &name, std::vector<std::string> &dependents)
+    {
+        ScHandle service = OpenServiceShared(scm, name, SERVICE_ENUMERATE_DEPENDENTS);
+        if (!service)
+            return GetLastError();
+        DWORD returned = 0;
+        const BYTE *result = ScmQuery(ScmCall::EnumDependentServices, service.serverKey(), [&service, &returned](BYTE *data, DWORD size, DWORD *needed)
+                                      { return Scm()->EnumDependentServicesA(service.get(), SERVICE_STATE_ALL,
+                                                                            reinterpret_cast<LPENUM_SERVICE_STATUSA>(data),
+                                                                            size, needed, &returned); });
+        if (!result)
+            return GetLastError();
+
+        const ENUM_SERVICE_STATUSA *entries = reinterpret_cast<const ENUM_SERVICE_STATUSA *>(result);
+        dependents.clear();
+        for (DWORD i = 0; i < returned; i++)
+            dependents.push_back(entries[i].lpServiceName);
+        return ERROR_SUCCESS;
+    }
+}
+
+size_t ServiceGraph::Add(const std::string &name)
+{
+    auto inserted = indexByName.emplace(ToLower(name), nodes.size());
+    if (inserted.second)
+    {
+        nodes.emplace_back();
+        nodes.back().name = name;
+    }
+    return inserted.first->second;
+}
+
+bool ServiceGraph::Find(const std::string &name, size_t &index) const
+{
+    auto it = indexByName.find(ToLower(name));
+    if (it == indexByName.end())
+        return false;
+    index = it->second;
+    return true;
+}
+
+void ServiceGraph::AddDependency(size_t service, size_t dependency)
+{
+    std::vector<size_t> &dependsOn = nodes[service].dependsOn;
+    if (std::find(dependsOn.begin(), dependsOn.end(), dependency) != dependsOn.end())
+        return;
+    dependsOn.push_back(dependency);
+    nodes[dependency].dependents.push_back(service);
+}
+
+bool ServiceGraph::FindCycle(std::vector<std::string> &cycle) const
+{
+    // Iterative depth-first search; a dependency that is still on the stack closes a cycle.
+    enum Mark : char { Unvisited, OnStack, Finished };
+    std::vector<Mark> marks(nodes.size(), Unvisited);
+    std::vector<std::pair<size_t, size_t>> stack; // Node and the next dependency to visit.
+    for (size_t root = 0; root < nodes.size(); root++)
+    {
+        if (marks[root] != Unvisited)
+            continue;
+        stack.emplace_back(root, 0);
+        marks[root] = OnStack;
+        while (!stack.empty())
+        {
+            size_t node = stack.back().first;
+            size_t &next = stack.back().second;
+            if (next == nodes[node].dependsOn.size())
+            {
+                marks[node] = Finished;
+                stack.pop_back();
+                continue;
+            }
+            size_t dependency = nodes[node].dependsOn[next++];
+            if (marks[dependency] == Unvisited)
+            {
+                marks[dependency] = OnStack;
+                stack.emplace_back(dependency, 0);
+            }
+            else if (marks[dependency] == OnStack)
+            {
+                cycle.clear();
+                auto start = std::find_if(stack.begin(), stack.end(),
+                                          [dependency](const std::pair<size_t, size_t> &entry)
+                                          { return entry.first == dependency; });
+                for (auto it = start; it != stack.end(); ++it)
+                    cycle.push_back(nodes[it->first].name);
+                cycle.push_back(nodes[dependency].name);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+DWORD LoadServiceGraph(const std::string &serverName, const std::vector<std::string> &roots,
+                       GraphDirection direction, ServiceGraph &graph, std::string &failedService)
+{
+    ScHandle scm = OpenSCManagerShared(serverName, SC_MANAGER_CONNECT);
+    if (!scm)
+    {
+        failedService.clear();
+        return GetLastError();
+    }
+
+    std::deque<std::string> pending(roots.begin(), roots.end());
+    for (const std::string &root : roots)
+        graph.Add(root);
+
+    if (direction == GraphDirection::Dependents)
+    {
+        // The dependents of each root form the whole set; edges are read for them below.
+        std::vector<std::string> dependents;
+        for (const std::string &root : roots)
+        {
+            if (DWORD error = ReadDependents(scm, root, dependents))
+            {
+                failedService = root;
+                return error;
+            }
+            for (const std::string &dependent : dependents)
+            {
+                size_t before = graph.Nodes().size();
+                if (graph.Add(dependent) == before)
+                    pending.push_back(dependent);
+            }
+        }
+    }
+
+    // Read each service's dependencies. Going down, unseen dependencies join the graph;
+    // going up, only edges within the set matter.
+    std::vector<std::string> dependencies;
+    while (!pending.empty())
+    {
+        std::string name = pending.front();
+        pending.pop_front();
+        if (DWORD error = ReadDependencies(scm, name, dependencies))
+        {
+            failedService = name;
+            return error;
+        }
+        size_t service;
+        graph.Find(name, service);
+        for (const std::string &dependency : dependencies)
+        {
+            size_t index;
+            if (graph.Find(dependency, index))
+            {
+                graph.AddDependency(service, index);
+            }
+            else if (direction == GraphDirection::Dependencies)
+            {
+                index = graph.Add(dependency);
+                graph.AddDependency(service, index);
+                pending.push_back(dependency);
+            }
+        }
+    }
+    return ERROR_SUCCESS;
+}
@@ -0,0 +1,57 @@
+#ifndef SERVICE_GRAPH_H
+#define SERVICE_GRAPH_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "win32_compat.h"
+
+// Which way LoadServiceGraph follows dependencies from the root services.
+enum class GraphDirection
+{
+    Dependencies, // Services the roots need running: the set to start.
+    Dependents    // Services that need the roots running: the set to stop.
+};
+
+// One service in a ServiceGraph.
+struct ServiceGraphNode
+{
+    std::string name;
+    std::vector<size_t> dependsOn;  // Services that must be running before this one starts.
+    std::vector<size_t> dependents; // Services that must be stopped before this one stops.
+};
+
+// A set of services and the dependencies among them. Names are case-insensitive, as in the SCM.
+class ServiceGraph
+{
+public:
+    // Adds a service (or finds it if already present) and returns its index.
+    size_t Add(const std::string &name);
+
+    // Looks a service up by name.
+    bool Find(const std::string &name, size_t &index) const;
+
+    // Records that service needs dependency running first.
+    void AddDependency(size_t service, size_t dependency);
+
+    const std::vector<ServiceGraphNode> &Nodes() const { return nodes; }
+
+    // Returns true if the dependencies are circular, with the services on one cycle in
+    // cycle (the first one repeated at the end).
+    bool FindCycle(std::vector<std::string> &cycle) const;
+
+private:
+    std::vector<ServiceGraphNode> nodes;
+    std::unordered_map<std::string, size_t> indexByName; // Lower-case name to node index.
+};
+
+// Loads roots plus, transitively, everything they depend on (Dependencies) or everything
+// that depends on them (Dependents), with the dependency edges among the loaded services.
+// Dependencies come from QueryServiceConfigA, dependents from EnumDependentServicesA.
+// Load order group dependencies ("+group") are not followed.
+// Returns ERROR_SUCCESS, or the Win32 error and, in failedService, the service it occurred on.
+DWORD LoadServiceGraph(const std::string &serverName, const std::vector<std::string> &roots,
+                       GraphDirection direction, ServiceGraph &graph, std::string &failedService);
+
+#endif // SERVICE_GRAPH_H
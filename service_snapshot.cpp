@@ -0,0 +1,557 @@
+#include "service_snapshot.h"
+#include "console.h"
+#include "query.h"
+#include "scm_buffers.h"
+#include "scm_handles.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+void printSnapshotHelp()
+{
+    ScOut() << R"(DESCRIPTION:
+        Writes the status, configuration, description and failure actions
+        of every service to one binary file. query, qc and qdescription
+        read it back with snapshot= <file>; diff compares two of them.
+USAGE:
+        sc <server> snapshot out= <file>
+
+OPTIONS:
+        out=      File to write.
+EXAMPLE:
+        sc \\web01 snapshot out= web01.scsnap
+        sc query state= all snapshot= web01.scsnap
+)";
+}
+
+// ParseSnapshotOptions: key= value pairs; out= is required.
+void ParseSnapshotOptions(const std::vector<std::string> &args, SnapshotOptions &opts)
+{
+    size_t i = 0;
+    while (i < args.size())
+    {
+        const std::string &token = args[i];
+        if (token.size() < 2 || token.back() != '=')
+        {
+            throw std::invalid_argument("Error: Invalid option format '" + token + "'. Expected key= followed by a value.");
+        }
+        std::string key = token.substr(0, token.size() - 1);
+        i++;
+        if (i >= args.size())
+        {
+            throw std::invalid_argument("Error: Missing value for option '" + key + "='.");
+        }
+        if (key == "out")
+        {
+            opts.out = args[i];
+        }
+        else
+        {
+            throw std::invalid_argument("Error: Unknown option '" + key + "='.");
+        }
+        i++;
+    }
+    if (opts.out.empty())
+    {
+        printSnapshotHelp();
+        throw std::invalid_argument("Error: snapshot requires out= <file>.");
+    }
+}
+
+int CompareServiceNames(std::string_view a, std::string_view b)
+{
+    size_t length = std::min(a.size(), b.size());
+    for (size_t i = 0; i < length; i++)
+    {
+        unsigned char x = static_cast<unsigned char>(a[i]);
+        unsigned char y = static_cast<unsigned char>(b[i]);
+        if (x >= 'A' && x <= 'Z')
+            x += 'a' - 'A';
+        if (y >= 'A' && y <= 'Z')
+            y += 'a' - 'A';
+        if (x != y)
+            return x < y ? -1 : 1;
+    }
+    return a.size() == b.size() ? 0 : (a.size() < b.size() ? -1 : 1);
+}
+
+#ifdef _WIN32
+
+struct ServiceSnapshot::Mapping
+{
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE section = nullptr;
+    const void *view = nullptr;
+    size_t size = 0;
+
+    ~Mapping()
+    {
+        if (view)
+            UnmapViewOfFile(view);
+        if (section)
+            CloseHandle(section);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+    }
+
+    bool Map(const std::string &path, std::string &error)
+    {
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL, nullptr);
+        LARGE_INTEGER fileSize;
+        if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize))
+        {
+            error = "cannot open the file, error: " + std::to_string(GetLastError());
+            return false;
+        }
+        size = static_cast<size_t>(fileSize.QuadPart);
+        if (size == 0)
+            return true;
+        section = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        view = section ? MapViewOfFile(section, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (!view)
+        {
+            error = "cannot map the file, error: " + std::to_string(GetLastError());
+            return false;
+        }
+        return true;
+    }
+};
+
+#else
+
+struct ServiceSnapshot::Mapping
+{
+    const void *view = nullptr;
+    size_t size = 0;
+
+    ~Mapping()
+    {
+        if (view)
+            munmap(const_cast<void *>(view), size);
+    }
+
+    bool Map(const std::string &path, std::string &error)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0)
+        {
+            error = std::string("cannot open the file: ") + std::strerror(errno);
+            if (fd >= 0)
+                close(fd);
+            return false;
+        }
+        size = static_cast<size_t>(info.st_size);
+        if (size > 0)
+        {
+            void *mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+            if (mapped == MAP_FAILED)
+            {
+                error = std::string("cannot map the file: ") + std::strerror(errno);
+                close(fd);
+                return false;
+            }
+            view = mapped;
+        }
+        close(fd);
+        return true;
+    }
+};
+
+#endif
+
+ServiceSnapshot::ServiceSnapshot() = default;
+ServiceSnapshot::~ServiceSnapshot() = default;
+
+bool ServiceSnapshot::Open(const std::string &path, std::string &error)
+{
+    mapping.reset(new Mapping());
+    if (!mapping->Map(path, error))
+        return false;
+
+    // Everything a reader later dereferences is checked here, so a truncated or damaged
+    // file is rejected up front instead of being read out of bounds.
+    const size_t size = mapping->size;
+    const char *base = static_cast<const char *>(mapping->view);
+    header = reinterpret_cast<const SnapshotHeader *>(base);
+    if (size < sizeof(SnapshotHeader) || std::memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+    {
+        error = "not a service snapshot";
+        return false;
+    }
+    if (header->byteOrder == 0x04030201u)
+    {
+        error = "snapshot was written on a machine with the other byte order";
+        return false;
+    }
+    if (header->byteOrder != SNAPSHOT_BYTE_ORDER)
+    {
+        // Version 1 files had no byte-order marker; their version sits where it is now.
+        error = "unsupported snapshot version " + std::to_string(header->byteOrder);
+        return false;
+    }
+    if (header->version != SNAPSHOT_VERSION || header->headerSize != sizeof(SnapshotHeader) ||
+        header->serviceSize != sizeof(SnapshotService))
+    {
+        error = "unsupported snapshot version " + std::to_string(header->version);
+        return false;
+    }
+    auto sectionFits = [size](uint64_t offset, uint64_t count, uint64_t elementSize)
+    {
+        return offset % 8 == 0 && offset <= size && count <= (size - offset) / elementSize;
+    };
+    if (header->fileSize != size ||
+        !sectionFits(header->servicesOffset, header->serviceCount, sizeof(SnapshotService)) ||
+        !sectionFits(header->actionsOffset, header->actionCount, sizeof(SnapshotAction)) ||
+        !sectionFits(header->stringsOffset, header->stringsSize, 1) || header->stringsSize < 2 ||
+        header->stringsSize >= SNAPSHOT_NO_STRING)
+    {
+        error = "the file is truncated or damaged";
+        return false;
+    }
+    services = reinterpret_cast<const SnapshotService *>(base + header->servicesOffset);
+    actions = reinterpret_cast<const SnapshotAction *>(base + header->actionsOffset);
+    strings = base + header->stringsOffset;
+
+    // Two trailing NULs end every string and dependency list that starts inside the table.
+    uint32_t stringsSize = static_cast<uint32_t>(header->stringsSize);
+    if (strings[stringsSize - 1] != '\0' || strings[stringsSize - 2] != '\0')
+    {
+        error = "the string table is damaged";
+        return false;
+    }
+    auto validString = [stringsSize](uint32_t ref)
+    {
+        return ref == SNAPSHOT_NO_STRING || ref < stringsSize;
+    };
+    for (size_t i = 0; i < header->serviceCount; i++)
+    {
+        const SnapshotService &service = services[i];
+        // Readers print name and displayName as they are, so neither may be missing.
+        bool valid = service.name != SNAPSHOT_NO_STRING && validString(service.name) &&
+                     service.displayName != SNAPSHOT_NO_STRING && validString(service.displayName) &&
+                     validString(service.binaryPath) && validString(service.loadOrderGroup) &&
+                     validString(service.dependencies) && validString(service.serviceStartName) &&
+                     validString(service.description) && validString(service.rebootMessage) &&
+                     validString(service.failureCommand) &&
+                     service.firstAction <= header->actionCount &&
+                     service.actionCount <= header->actionCount - service.firstAction;
+        if (valid && i > 0)
+            valid = CompareServiceNames(strings + services[i - 1].name, strings + service.name) < 0;
+        if (!valid)
+        {
+            error = "service record " + std::to_string(i) + " is damaged";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ServiceSnapshot::Find(std::string_view name, size_t &index) const
+{
+    size_t low = 0, high = Count();
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        int order = CompareServiceNames(strings + services[middle].name, name);
+        if (order == 0)
+        {
+            index = middle;
+            return true;
+        }
+        if (order < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return false;
+}
+
+SERVICE_STATUS_PROCESS ServiceSnapshot::Status(const SnapshotService &service)
+{
+    SERVICE_STATUS_PROCESS ssp;
+    ssp.dwServiceType = service.serviceType;
+    ssp.dwCurrentState = service.currentState;
+    ssp.dwControlsAccepted = service.controlsAccepted;
+    ssp.dwWin32ExitCode = service.win32ExitCode;
+    ssp.dwServiceSpecificExitCode = service.serviceExitCode;
+    ssp.dwCheckPoint = service.checkPoint;
+    ssp.dwWaitHint = service.waitHint;
+    ssp.dwProcessId = service.processId;
+    ssp.dwServiceFlags = service.serviceFlags;
+    return ssp;
+}
+
+sc_service_config ServiceSnapshot::Config(const SnapshotService &service) const
+{
+    sc_service_config config;
+    config.service_type = service.serviceType;
+    config.start_type = service.startType;
+    config.error_control = service.errorControl;
+    config.tag_id = service.tagId;
+    config.binary_path = String(service.binaryPath);
+    config.load_order_group = String(service.loadOrderGroup);
+    config.dependencies = String(service.dependencies);
+    config.service_start_name = String(service.serviceStartName);
+    config.display_name = String(service.displayName);
+    return config;
+}
+
+namespace
+{
+    // Builds the string table, storing each distinct string once.
+    class StringTable
+    {
+    public:
+        uint32_t Add(const char *value)
+        {
+            return value ? Add(std::string_view(value)) : SNAPSHOT_NO_STRING;
+        }
+
+        // A NUL-separated list ending with an empty name; stored without its final NUL.
+        uint32_t AddList(const char *list)
+        {
+            if (!list)
+                return SNAPSHOT_NO_STRING;
+            const char *end = list;
+            while (*end)
+                end += std::strlen(end) + 1;
+            return Add(std::string_view(list, static_cast<size_t>(end - list)));
+        }
+
+        uint32_t Add(std::string_view value)
+        {
+            auto found = offsets.find(std::string(value));
+            if (found != offsets.end())
+                return found->second;
+            uint32_t offset = static_cast<uint32_t>(table.size());
+            table.append(value.data(), value.size());
+            table += '\0';
+            offsets.emplace(std::string(value), offset);
+            return offset;
+        }
+
+        // The table with the extra NUL that ends a list starting at its last string.
+        const std::string &Finish()
+        {
+            table += '\0';
+            return table;
+        }
+
+    private:
+        std::string table;
+        std::unordered_map<std::string, uint32_t> offsets;
+    };
+
+    // Counts of the parts that could not be read.
+    struct HarvestErrors
+    {
+        size_t open = 0;
+        size_t config = 0;
+        size_t description = 0;
+        size_t failureActions = 0;
+    };
+
+    // Fills everything but the status of one service record.
+    void HarvestService(const ScHandle &scm, const std::string &name, SnapshotService &record,
+                        StringTable &strings, std::vector<SnapshotAction> &actions, HarvestErrors &errors)
+    {
+        ScHandle service = OpenServiceShared(scm, name, SERVICE_QUERY_CONFIG);
+        if (!service)
+        {
+            errors.open++;
+            return;
+        }
+
+        if (const BYTE *result = ScmQuery(ScmCall::QueryServiceConfig, service.serverKey(), [&service](BYTE *data, DWORD size, DWORD *needed)
+                                          { return Scm()->QueryServiceConfigA(service.get(), reinterpret_cast<LPQUERY_SERVICE_CONFIGA>(data),
+                                                                             size, needed); }))
+        {
+            const QUERY_SERVICE_CONFIGA *config = reinterpret_cast<const QUERY_SERVICE_CONFIGA *>(result);
+            record.startType = config->dwStartType;
+            record.errorControl = config->dwErrorControl;
+            record.tagId = config->dwTagId;
+            record.binaryPath = strings.Add(config->lpBinaryPathName);
+            record.loadOrderGroup = strings.Add(config->lpLoadOrderGroup);
+            record.dependencies = strings.AddList(config->lpDependencies);
+            record.serviceStartName = strings.Add(config->lpServiceStartName);
+            record.flags |= SNAPSHOT_HAS_CONFIG;
+        }
+        else
+        {
+            errors.config++;
+        }
+
+        auto queryConfig2 = [&service](DWORD level)
+        {
+            return ScmQuery(ScmCallForConfig2(level), service.serverKey(), [&service, level](BYTE *data, DWORD size, DWORD *needed)
+                            { return Scm()->QueryServiceConfig2A(service.get(), level, data, size, needed); });
+        };
+        if (const BYTE *result = queryConfig2(SERVICE_CONFIG_DESCRIPTION))
+        {
+            record.description = strings.Add(reinterpret_cast<const SERVICE_DESCRIPTIONA *>(result)->lpDescription);
+            record.flags |= SNAPSHOT_HAS_DESCRIPTION;
+        }
+        else
+        {
+            errors.description++;
+        }
+        if (const BYTE *result = queryConfig2(SERVICE_CONFIG_FAILURE_ACTIONS))
+        {
+            const SERVICE_FAILURE_ACTIONSA *sfa = reinterpret_cast<const SERVICE_FAILURE_ACTIONSA *>(result);
+            record.resetPeriod = sfa->dwResetPeriod;
+            record.rebootMessage = strings.Add(sfa->lpRebootMsg);
+            record.failureCommand = strings.Add(sfa->lpCommand);
+            record.firstAction = static_cast<uint32_t>(actions.size());
+            record.actionCount = sfa->cActions;
+            for (DWORD i = 0; i < sfa->cActions; i++)
+                actions.push_back({static_cast<uint32_t>(sfa->lpsaActions[i].Type), sfa->lpsaActions[i].Delay});
+            record.flags |= SNAPSHOT_HAS_FAILURE_ACTIONS;
+        }
+        else
+        {
+            errors.failureActions++;
+        }
+        // Only services that can auto-start have the flag; a failure here just leaves it clear.
+        const BYTE *delayed = queryConfig2(SERVICE_CONFIG_DELAYED_AUTO_START_INFO);
+        if (delayed && reinterpret_cast<const SERVICE_DELAYED_AUTO_START_INFO *>(delayed)->fDelayedAutostart)
+            record.flags |= SNAPSHOT_DELAYED_AUTO_START;
+    }
+
+    uint64_t AlignTo8(uint64_t offset)
+    {
+        return (offset + 7) & ~uint64_t(7);
+    }
+}
+
+bool snapshot(const SnapshotOptions &opts)
+{
+    auto started = std::chrono::steady_clock::now();
+    ScHandle scm = OpenSCManagerShared(opts.serverName, SC_MANAGER_ENUMERATE_SERVICE);
+    if (!scm)
+    {
+        ScErr() << "OpenSCManager failed, error: " << GetLastError() << "\n";
+        return false;
+    }
+
+    // Enumeration gives names and status; every record starts with no strings.
+    SnapshotService empty;
+    std::memset(&empty, 0, sizeof(empty));
+    empty.displayName = empty.binaryPath = empty.loadOrderGroup = empty.dependencies = SNAPSHOT_NO_STRING;
+    empty.serviceStartName = empty.description = empty.rebootMessage = empty.failureCommand = SNAPSHOT_NO_STRING;
+
+    StringTable strings;
+    std::vector<SnapshotService> records;
+    std::vector<std::string> names;
+    bool success = EnumerateServicePages(
+        scm, SERVICE_DRIVER | SERVICE_WIN32, SERVICE_STATE_ALL, nullptr, 0, 0,
+        [&](const ENUM_SERVICE_STATUS_PROCESSA *services, DWORD count)
+        {
+            for (DWORD i = 0; i < count; i++)
+            {
+                const SERVICE_STATUS_PROCESS &ssp = services[i].ServiceStatusProcess;
+                SnapshotService record = empty;
+                record.name = strings.Add(services[i].lpServiceName);
+                record.displayName = strings.Add(services[i].lpDisplayName ? services[i].lpDisplayName : "");
+                record.serviceType = ssp.dwServiceType;
+                record.currentState = ssp.dwCurrentState;
+                record.controlsAccepted = ssp.dwControlsAccepted;
+                record.win32ExitCode = ssp.dwWin32ExitCode;
+                record.serviceExitCode = ssp.dwServiceSpecificExitCode;
+                record.checkPoint = ssp.dwCheckPoint;
+                record.waitHint = ssp.dwWaitHint;
+                record.processId = ssp.dwProcessId;
+                record.serviceFlags = ssp.dwServiceFlags;
+                records.push_back(record);
+                names.push_back(services[i].lpServiceName);
+            }
+            return true;
+        });
+    if (!success)
+    {
+        ScErr() << "EnumServicesStatusEx failed, error: " << GetLastError() << "\n";
+        return false;
+    }
+
+    HarvestErrors errors;
+    std::vector<SnapshotAction> actions;
+    for (size_t i = 0; i < records.size(); i++)
+        HarvestService(scm, names[i], records[i], strings, actions, errors);
+
+    // The SCM enumerates in name order already; sorting makes the order part of the format.
+    std::vector<size_t> order(records.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&names](size_t a, size_t b)
+              { return CompareServiceNames(names[a], names[b]) < 0; });
+
+    SnapshotHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.version = SNAPSHOT_VERSION;
+    header.headerSize = sizeof(SnapshotHeader);
+    header.serviceSize = sizeof(SnapshotService);
+    header.createdUnixMs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                     std::chrono::system_clock::now().time_since_epoch())
+                                                     .count());
+    header.host = strings.Add(ScmServerKey(opts.serverName).empty() ? std::string_view() : opts.serverName);
+    header.serviceCount = static_cast<uint32_t>(records.size());
+    header.actionCount = static_cast<uint32_t>(actions.size());
+    const std::string &table = strings.Finish();
+    header.servicesOffset = AlignTo8(sizeof(SnapshotHeader));
+    header.actionsOffset = AlignTo8(header.servicesOffset + records.size() * sizeof(SnapshotService));
+    header.stringsOffset = AlignTo8(header.actionsOffset + actions.size() * sizeof(SnapshotAction));
+    header.stringsSize = table.size();
+    header.fileSize = header.stringsOffset + header.stringsSize;
+
+    std::ofstream out(opts.out, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        ScErr() << "Error: Cannot create '" << opts.out << "'.\n";
+        return false;
+    }
+    static const char padding[8] = {};
+    auto pad = [&out](uint64_t to)
+    {
+        out.write(padding, static_cast<std::streamsize>(to - static_cast<uint64_t>(out.tellp())));
+    };
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    pad(header.servicesOffset);
+    for (size_t index : order)
+        out.write(reinterpret_cast<const char *>(&records[index]), sizeof(SnapshotService));
+    pad(header.actionsOffset);
+    out.write(reinterpret_cast<const char *>(actions.data()),
+              static_cast<std::streamsize>(actions.size() * sizeof(SnapshotAction)));
+    pad(header.stringsOffset);
+    out.write(table.data(), static_cast<std::streamsize>(table.size()));
+    out.close();
+    if (!out)
+    {
+        ScErr() << "Error: Cannot write '" << opts.out << "'.\n";
+        return false;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+    ScOut() << "[SC] Snapshot of " << records.size() << " services written to " << opts.out << " ("
+            << header.fileSize << " bytes, " << elapsed.count() << " ms)\n";
+    if (errors.open || errors.config || errors.description || errors.failureActions)
+    {
+        ScOut() << "[SC] Not readable: " << errors.open << " services, " << errors.config << " configurations, "
+                << errors.description << " descriptions, " << errors.failureActions << " failure action sets\n";
+    }
+    return true;
+}
@@ -0,0 +1,165 @@
+#ifndef SERVICE_SNAPSHOT_H
+#define SERVICE_SNAPSHOT_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "sc_api.h"
+#include "win32_compat.h"
+
+// A service snapshot is one file holding the status, configuration, description and failure
+// actions of every service on a host, laid out so it can be mapped and read in place:
+//
+//   SnapshotHeader
+//   SnapshotService[serviceCount]   sorted by name, case-insensitively
+//   SnapshotAction[actionCount]     failure actions; each service owns a contiguous run
+//   string table                    NUL-terminated strings, each stored once
+//
+// Sections start on 8-byte boundaries. Strings are referenced by their byte offset in the
+// string table; a dependency list is one entry holding NUL-separated names followed by an
+// empty name, as in QUERY_SERVICE_CONFIGA. Integers are in the writer's byte order;
+// byteOrder, which reads as SNAPSHOT_BYTE_ORDER only in that order, tells a reader with
+// the other byte order that it cannot use the file.
+
+constexpr char SNAPSHOT_MAGIC[8] = {'S', 'C', 'S', 'N', 'A', 'P', '\r', '\n'};
+constexpr uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304u;
+constexpr uint32_t SNAPSHOT_VERSION = 2;
+constexpr uint32_t SNAPSHOT_NO_STRING = 0xFFFFFFFFu; // A string the SCM returned as null.
+
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t byteOrder;      // SNAPSHOT_BYTE_ORDER.
+    uint32_t version;
+    uint32_t headerSize;     // sizeof(SnapshotHeader) when written.
+    uint32_t reserved;       // Zero; keeps the 64-bit fields 8-byte aligned.
+    uint64_t fileSize;
+    uint64_t createdUnixMs;
+    uint32_t host;           // String: the server name given to "sc snapshot", "" for the local machine.
+    uint32_t serviceCount;
+    uint32_t serviceSize;    // sizeof(SnapshotService) when written.
+    uint32_t actionCount;
+    uint64_t servicesOffset;
+    uint64_t actionsOffset;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+};
+
+// SnapshotService::flags: which parts could be read when the snapshot was taken.
+enum SnapshotServiceFlags : uint32_t
+{
+    SNAPSHOT_HAS_CONFIG = 0x1,          // QueryServiceConfigA succeeded.
+    SNAPSHOT_HAS_DESCRIPTION = 0x2,     // QueryServiceConfig2A(SERVICE_CONFIG_DESCRIPTION) succeeded.
+    SNAPSHOT_HAS_FAILURE_ACTIONS = 0x4, // QueryServiceConfig2A(SERVICE_CONFIG_FAILURE_ACTIONS) succeeded.
+    SNAPSHOT_DELAYED_AUTO_START = 0x8   // The delayed auto-start flag is set.
+};
+
+struct SnapshotService
+{
+    // Strings. name and displayName are always present.
+    uint32_t name;
+    uint32_t displayName;
+    uint32_t binaryPath;
+    uint32_t loadOrderGroup;
+    uint32_t dependencies;
+    uint32_t serviceStartName;
+    uint32_t description;
+    uint32_t rebootMessage;
+    uint32_t failureCommand;
+    // SERVICE_STATUS_PROCESS.
+    uint32_t serviceType;
+    uint32_t currentState;
+    uint32_t controlsAccepted;
+    uint32_t win32ExitCode;
+    uint32_t serviceExitCode;
+    uint32_t checkPoint;
+    uint32_t waitHint;
+    uint32_t processId;
+    uint32_t serviceFlags;
+    // QUERY_SERVICE_CONFIGA.
+    uint32_t startType;
+    uint32_t errorControl;
+    uint32_t tagId;
+    // SERVICE_FAILURE_ACTIONSA.
+    uint32_t resetPeriod;
+    uint32_t firstAction; // Index into the action array.
+    uint32_t actionCount;
+    uint32_t flags;       // SnapshotServiceFlags.
+};
+
+struct SnapshotAction
+{
+    uint32_t type; // SC_ACTION_TYPE.
+    uint32_t delay;
+};
+
+static_assert(sizeof(SnapshotHeader) == 88, "SnapshotHeader layout is part of the file format");
+static_assert(sizeof(SnapshotService) == 100, "SnapshotService layout is part of the file format");
+static_assert(sizeof(SnapshotAction) == 8, "SnapshotAction layout is part of the file format");
+
+// A snapshot file mapped read-only. Everything returned points into the mapping and stays
+// valid until the object is destroyed; reading records allocates nothing.
+class ServiceSnapshot
+{
+public:
+    ServiceSnapshot();
+    ~ServiceSnapshot();
+    ServiceSnapshot(const ServiceSnapshot &) = delete;
+    ServiceSnapshot &operator=(const ServiceSnapshot &) = delete;
+
+    // Maps and validates a snapshot. On failure error says why.
+    bool Open(const std::string &path, std::string &error);
+
+    const SnapshotHeader &Header() const { return *header; }
+    size_t Count() const { return header->serviceCount; }
+    const SnapshotService &Service(size_t index) const { return services[index]; }
+
+    // A string from the table, or nullptr for SNAPSHOT_NO_STRING.
+    const char *String(uint32_t ref) const { return ref == SNAPSHOT_NO_STRING ? nullptr : strings + ref; }
+
+    // The failure actions of a service (service.actionCount of them).
+    const SnapshotAction *Actions(const SnapshotService &service) const { return actions + service.firstAction; }
+
+    // Looks a service up by name (case-insensitive) with a binary search.
+    bool Find(std::string_view name, size_t &index) const;
+
+    // The status fields of a service, as the SCM returns them.
+    static SERVICE_STATUS_PROCESS Status(const SnapshotService &service);
+
+    // The configuration of a service; its strings point into the snapshot.
+    sc_service_config Config(const SnapshotService &service) const;
+
+private:
+    struct Mapping;
+    std::unique_ptr<Mapping> mapping;
+    const SnapshotHeader *header = nullptr;
+    const SnapshotService *services = nullptr;
+    const SnapshotAction *actions = nullptr;
+    const char *strings = nullptr;
+};
+
+// Compares service names the way the SCM orders them: byte-wise, ignoring ASCII case.
+int CompareServiceNames(std::string_view a, std::string_view b);
+
+// Structure for the "snapshot" subcommand options.
+// Command-line syntax:
+//   sc.exe [<servername>] snapshot out= <file>
+struct SnapshotOptions
+{
+    std::string serverName; // If empty, the local machine is used.
+    std::string out;        // File to write.
+};
+
+// Parse function for "snapshot" options. Throws std::invalid_argument on bad input.
+void ParseSnapshotOptions(const std::vector<std::string> &args, SnapshotOptions &opts);
+
+// snapshot function: reads every service's status, configuration, description and failure
+// actions and writes them to opts.out. Parts that cannot be read for a service (for example
+// for lack of access) are left out of its record and counted.
+// Returns true if the file was written.
+bool snapshot(const SnapshotOptions &opts);
+
+#endif // SERVICE_SNAPSHOT_H
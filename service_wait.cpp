@@ -0,0 +1,240 @@
+// NotifyServiceStatusChangeA requires Vista or later; without it (or off Windows) waits poll.
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600
+#endif
+#if defined(_WIN32) && _WIN32_WINNT >= 0x0600
+#define SERVICE_WAIT_NOTIFICATIONS 1
+#else
+#define SERVICE_WAIT_NOTIFICATIONS 0
+#endif
+
+#include "service_wait.h"
+#include "scm_backend.h"
+#include "scm_trace.h"
+
+#include <algorithm>
+#include <chrono>
+
+// Notification bookkeeping for Win32ServiceStatusSource.
+// The SCM writes into 'notify' and queues OnNotify as an APC on the waiting thread.
+struct Win32ServiceStatusSource::NotifyState
+{
+#if SERVICE_WAIT_NOTIFICATIONS
+    SERVICE_NOTIFYA notify = {};
+#endif
+    bool armed = false;
+    bool unsupported = false;
+    volatile bool fired = false;
+};
+
+#if SERVICE_WAIT_NOTIFICATIONS
+// APC callback: runs on the waiting thread during an alertable SleepEx.
+static void CALLBACK OnServiceNotify(PVOID parameter)
+{
+    SERVICE_NOTIFYA *notify = static_cast<SERVICE_NOTIFYA *>(parameter);
+    static_cast<bool *>(notify->pContext)[0] = true;
+}
+#endif
+
+Win32ServiceStatusSource::Win32ServiceStatusSource(SC_HANDLE hService)
+    : hService(hService), notifyState(new NotifyState())
+{
+}
+
+Win32ServiceStatusSource::~Win32ServiceStatusSource()
+{
+    // A registration that has not fired cannot be cancelled without closing the service
+    // handle, and an APC already queued may still run after that. Leak the small state
+    // block in that case rather than let the callback write into freed memory.
+    if (!notifyState->armed)
+        delete notifyState;
+}
+
+bool Win32ServiceStatusSource::QueryStatus(SERVICE_STATUS_PROCESS &ssp, DWORD &error)
+{
+    DWORD bytesNeeded = 0;
+    if (!Scm()->QueryServiceStatusEx(hService, SC_STATUS_PROCESS_INFO, reinterpret_cast<LPBYTE>(&ssp),
+                                    sizeof(ssp), &bytesNeeded))
+    {
+        error = GetLastError();
+        return false;
+    }
+    return true;
+}
+
+StatusChangeSignal Win32ServiceStatusSource::WaitForChange(DWORD notifyMask, DWORD timeoutMs)
+{
+#if SERVICE_WAIT_NOTIFICATIONS
+    NotifyState &state = *notifyState;
+    if (state.unsupported)
+        return StatusChangeSignal::Unsupported;
+
+    if (!state.armed)
+    {
+        state.fired = false;
+        state.notify = {};
+        state.notify.dwVersion = SERVICE_NOTIFY_STATUS_CHANGE;
+        state.notify.pfnNotifyCallback = OnServiceNotify;
+        state.notify.pContext = const_cast<bool *>(&state.fired);
+        if (Scm()->NotifyServiceStatusChangeA(hService, notifyMask, &state.notify) != ERROR_SUCCESS)
+        {
+            // Older or remote SCMs may refuse the registration; fall back to polling for good.
+            state.unsupported = true;
+            return StatusChangeSignal::Unsupported;
+        }
+        state.armed = true;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (!state.fired)
+    {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0)
+            break;
+        SleepEx(static_cast<DWORD>(remaining.count()), TRUE);
+    }
+
+    if (!state.fired)
+        return StatusChangeSignal::TimedOut;
+    state.armed = false;
+    return StatusChangeSignal::Notified;
+#else
+    (void)notifyMask;
+    (void)timeoutMs;
+    return StatusChangeSignal::Unsupported;
+#endif
+}
+
+void Win32ServiceStatusSource::Sleep(DWORD ms)
+{
+    ::Sleep(ms);
+}
+
+namespace
+{
+    // Map a service state to the matching SERVICE_NOTIFY_* flag.
+    DWORD NotifyMaskForState(DWORD state)
+    {
+        switch (state)
+        {
+        case SERVICE_STOPPED:
+            return SERVICE_NOTIFY_STOPPED;
+        case SERVICE_START_PENDING:
+            return SERVICE_NOTIFY_START_PENDING;
+        case SERVICE_STOP_PENDING:
+            return SERVICE_NOTIFY_STOP_PENDING;
+        case SERVICE_RUNNING:
+            return SERVICE_NOTIFY_RUNNING;
+        case SERVICE_CONTINUE_PENDING:
+            return SERVICE_NOTIFY_CONTINUE_PENDING;
+        case SERVICE_PAUSE_PENDING:
+            return SERVICE_NOTIFY_PAUSE_PENDING;
+        case SERVICE_PAUSED:
+            return SERVICE_NOTIFY_PAUSED;
+        default:
+            return 0;
+        }
+    }
+
+    // Poll interval: one tenth of the wait hint, or an exponential backoff from minPollMs
+    // when the service does not publish a hint.
+    DWORD PollInterval(DWORD waitHint, DWORD attempt, const ServiceWaitOptions &opts)
+    {
+        DWORD interval = waitHint ? waitHint / 10 : opts.minPollMs << std::min<DWORD>(attempt, 6);
+        return std::max(opts.minPollMs, std::min(interval, opts.maxPollMs));
+    }
+
+    DWORD ElapsedMs(std::chrono::steady_clock::time_point since)
+    {
+        auto elapsed = std::chrono::steady_clock::now() - since;
+        return static_cast<DWORD>(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+    }
+} // end anonymous namespace
+
+ServiceWaitResult WaitForServiceState(ServiceStatusSource &source, DWORD desiredState, DWORD pendingState,
+                                      const ServiceWaitOptions &opts)
+{
+    TraceSpan span("WaitForServiceState");
+    ServiceWaitResult result;
+    auto startTime = std::chrono::steady_clock::now();
+
+    // Wake on the desired state and on any settled state the transition could end in.
+    const DWORD notifyMask = NotifyMaskForState(desiredState) | SERVICE_NOTIFY_STOPPED |
+                             SERVICE_NOTIFY_RUNNING | SERVICE_NOTIFY_PAUSED;
+    bool useNotifications = opts.useNotifications;
+
+    ++result.queries;
+    if (!source.QueryStatus(result.status, result.error))
+    {
+        result.elapsedMs = ElapsedMs(startTime);
+        return result;
+    }
+
+    DWORD lastCheckPoint = result.status.dwCheckPoint;
+    auto lastProgress = startTime;
+    DWORD attempt = 0;
+    bool leftPriorState = opts.priorState == 0 || result.status.dwCurrentState != opts.priorState;
+    auto inTransition = [&]()
+    {
+        return result.status.dwCurrentState == pendingState ||
+               (!leftPriorState && ElapsedMs(startTime) < opts.priorStateGraceMs);
+    };
+
+    while (inTransition())
+    {
+        DWORD elapsed = ElapsedMs(startTime);
+        if (elapsed >= opts.timeoutMs)
+        {
+            result.timedOut = true;
+            break;
+        }
+        DWORD remaining = opts.timeoutMs - elapsed;
+
+        if (result.status.dwCurrentState != pendingState)
+        {
+            // Still reported in the prior state. A notification for a state the service is
+            // already in would fire at once, so poll at the shortest interval.
+            source.Sleep(std::min(opts.minPollMs, remaining));
+        }
+        else
+        {
+            if (useNotifications)
+            {
+                // With notifications we only wake early to check dwCheckPoint progress.
+                DWORD slice = std::max(opts.minPollMs, std::min(result.status.dwWaitHint, opts.maxPollMs));
+                StatusChangeSignal signal = source.WaitForChange(notifyMask, std::min(slice, remaining));
+                if (signal == StatusChangeSignal::Notified)
+                    result.usedNotifications = true;
+                else if (signal == StatusChangeSignal::Unsupported)
+                    useNotifications = false;
+            }
+            if (!useNotifications)
+            {
+                source.Sleep(std::min(PollInterval(result.status.dwWaitHint, attempt++, opts), remaining));
+            }
+        }
+
+        ++result.queries;
+        if (!source.QueryStatus(result.status, result.error))
+            break;
+        if (result.status.dwCurrentState != opts.priorState)
+            leftPriorState = true;
+
+        if (result.status.dwCheckPoint != lastCheckPoint)
+        {
+            lastCheckPoint = result.status.dwCheckPoint;
+            lastProgress = std::chrono::steady_clock::now();
+        }
+        else if (opts.honorWaitHint && result.status.dwWaitHint != 0 &&
+                 result.status.dwCurrentState == pendingState &&
+                 ElapsedMs(lastProgress) > result.status.dwWaitHint)
+        {
+            result.stalled = true;
+            break;
+        }
+    }
+
+    result.reached = (result.error == ERROR_SUCCESS && result.status.dwCurrentState == desiredState);
+    result.elapsedMs = ElapsedMs(startTime);
+    return result;
+}
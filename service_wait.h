@@ -0,0 +1,89 @@
+#ifndef SERVICE_WAIT_H
+#define SERVICE_WAIT_H
+
+#include "win32_compat.h"
+
+// Outcome of a single WaitForChange call on a ServiceStatusSource.
+enum class StatusChangeSignal
+{
+    Notified,   // A status-change notification arrived.
+    TimedOut,   // No notification arrived within the timeout.
+    Unsupported // The source cannot deliver notifications; the caller must poll.
+};
+
+// Supplies status updates for a single service to WaitForServiceState.
+// Win32ServiceStatusSource talks to the real SCM; a stand-in SCM can implement this
+// interface to simulate pending states without a Windows host.
+class ServiceStatusSource
+{
+public:
+    virtual ~ServiceStatusSource() = default;
+
+    // Fills ssp with the current status. Returns false and sets error on failure.
+    virtual bool QueryStatus(SERVICE_STATUS_PROCESS &ssp, DWORD &error) = 0;
+
+    // Blocks for up to timeoutMs waiting for the service to enter one of the states in
+    // notifyMask (SERVICE_NOTIFY_* flags).
+    virtual StatusChangeSignal WaitForChange(DWORD notifyMask, DWORD timeoutMs) = 0;
+
+    // Sleeps between polls when notifications are unavailable.
+    virtual void Sleep(DWORD ms) = 0;
+};
+
+// ServiceStatusSource backed by a service handle opened with SERVICE_QUERY_STATUS.
+// Uses NotifyServiceStatusChangeA when the SDK and target SCM support it.
+class Win32ServiceStatusSource : public ServiceStatusSource
+{
+public:
+    explicit Win32ServiceStatusSource(SC_HANDLE hService);
+    ~Win32ServiceStatusSource() override;
+    Win32ServiceStatusSource(const Win32ServiceStatusSource &) = delete;
+    Win32ServiceStatusSource &operator=(const Win32ServiceStatusSource &) = delete;
+
+    bool QueryStatus(SERVICE_STATUS_PROCESS &ssp, DWORD &error) override;
+    StatusChangeSignal WaitForChange(DWORD notifyMask, DWORD timeoutMs) override;
+    void Sleep(DWORD ms) override;
+
+private:
+    struct NotifyState; // Defined in service_wait.cpp so the layout does not depend on _WIN32_WINNT.
+
+    SC_HANDLE hService;
+    NotifyState *notifyState = nullptr;
+};
+
+// Tuning knobs for WaitForServiceState.
+struct ServiceWaitOptions
+{
+    DWORD timeoutMs = 30000;      // Overall limit for the transition.
+    DWORD minPollMs = 25;         // Lower bound on the poll interval derived from dwWaitHint.
+    DWORD maxPollMs = 10000;      // Upper bound on the poll interval derived from dwWaitHint.
+    bool useNotifications = true; // Try status-change notifications before polling.
+    bool honorWaitHint = true;    // Give up when dwCheckPoint does not advance within dwWaitHint.
+    // The state the service was in before the request, or 0. Right after StartService or
+    // ControlService the SCM can still report it, so it only ends the wait once the service
+    // has been seen in another state or priorStateGraceMs has passed.
+    DWORD priorState = 0;
+    DWORD priorStateGraceMs = 3000;
+};
+
+// Result of WaitForServiceState.
+struct ServiceWaitResult
+{
+    bool reached = false;            // The service entered the desired state.
+    bool timedOut = false;           // timeoutMs elapsed before the transition completed.
+    bool stalled = false;            // dwCheckPoint did not advance within dwWaitHint.
+    DWORD error = ERROR_SUCCESS;     // Error from QueryStatus, if any.
+    SERVICE_STATUS_PROCESS status{}; // Last status observed.
+    DWORD elapsedMs = 0;             // Time spent waiting for the transition.
+    DWORD queries = 0;               // Number of QueryStatus calls made.
+    bool usedNotifications = false;  // At least one notification was received.
+};
+
+// Waits until the service leaves pendingState. The wait succeeds when the service reaches
+// desiredState and fails when it settles in any other state, times out, or stalls.
+// Notifications are used when available; otherwise the status is polled at an interval of
+// one tenth of dwWaitHint, clamped to [minPollMs, maxPollMs], as the SCM documentation advises.
+ServiceWaitResult WaitForServiceState(ServiceStatusSource &source, DWORD desiredState, DWORD pendingState,
+                                      const ServiceWaitOptions &opts);
+
+#endif // SERVICE_WAIT_H
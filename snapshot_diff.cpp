@@ -0,0 +1,330 @@
+#include "snapshot_diff.h"
+#include "console.h"
+#include "service_snapshot.h"
+#include "status_format.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+void printDiffHelp()
+{
+    ScOut() << R"(DESCRIPTION:
+        Compares two files written by "sc snapshot" and reports services
+        that were added or removed, and changes to the state, start type,
+        binary path, account, dependencies and failure actions of the rest.
+USAGE:
+        sc diff <before> <after> [format= {text | json | ndjson | csv}]
+EXAMPLE:
+        sc diff monday.scsnap tuesday.scsnap
+)";
+}
+
+// ParseDiffOptions: the two snapshot files, then an optional format= pair.
+void ParseDiffOptions(const std::vector<std::string> &args, DiffOptions &opts)
+{
+    auto isOption = [](const std::string &token)
+    {
+        return !token.empty() && token.back() == '=';
+    };
+    if (args.size() < 2 || isOption(args[0]) || isOption(args[1]))
+    {
+        printDiffHelp();
+        throw std::invalid_argument("Error: diff requires two snapshot files.");
+    }
+    opts.before = args[0];
+    opts.after = args[1];
+    if (args.size() == 2)
+        return;
+    if (args.size() != 4 || args[2] != "format=")
+    {
+        throw std::invalid_argument("Error: diff accepts only format= after the snapshot files.");
+    }
+    if (!ParseOutputFormat(args[3], opts.format))
+    {
+        throw std::invalid_argument("Error: Invalid value for format=. Allowed: text, json, ndjson, csv.");
+    }
+}
+
+namespace
+{
+    bool SameString(const char *a, const char *b)
+    {
+        return a == b || (a && b && std::strcmp(a, b) == 0);
+    }
+
+    // Dependency lists are NUL-separated names ending with an empty name.
+    bool SameList(const char *a, const char *b)
+    {
+        if (!a || !b)
+            return a == b;
+        for (;;)
+        {
+            size_t length = std::strlen(a);
+            if (length != std::strlen(b) || std::memcmp(a, b, length) != 0)
+                return false;
+            if (length == 0)
+                return true;
+            a += length + 1;
+            b += length + 1;
+        }
+    }
+
+    const char *ActionName(uint32_t type)
+    {
+        switch (type)
+        {
+        case SC_ACTION_RESTART:
+            return "restart";
+        case SC_ACTION_REBOOT:
+            return "reboot";
+        case SC_ACTION_RUN_COMMAND:
+            return "run";
+        default:
+            return "none";
+        }
+    }
+
+    // Reports the differences between two snapshots, rendering values only for the fields
+    // that differ. The text line and the rendered values live in buffers reused across records.
+    class DiffWriter
+    {
+    public:
+        DiffWriter(const ServiceSnapshot &before, const ServiceSnapshot &after, OutputFormat format)
+            : before(before), after(after), format(format), records(ScOut(), format)
+        {
+        }
+
+        void Added(const SnapshotService &service)
+        {
+            added++;
+            Emit(after.String(service.name), "added", "", "", "");
+        }
+
+        void Removed(const SnapshotService &service)
+        {
+            removed++;
+            Emit(before.String(service.name), "removed", "", "", "");
+        }
+
+        // Compares one service present in both snapshots.
+        void Compare(const SnapshotService &a, const SnapshotService &b)
+        {
+            const char *name = after.String(b.name);
+            size_t changesBefore = changes;
+            if (a.currentState != b.currentState)
+                Emit(name, "changed", "STATE", StateToString(a.currentState), StateToString(b.currentState));
+
+            if ((a.flags & SNAPSHOT_HAS_CONFIG) && (b.flags & SNAPSHOT_HAS_CONFIG))
+            {
+                bool delayedA = (a.flags & SNAPSHOT_DELAYED_AUTO_START) != 0;
+                bool delayedB = (b.flags & SNAPSHOT_DELAYED_AUTO_START) != 0;
+                if (a.startType != b.startType || delayedA != delayedB)
+                {
+                    StartType(a.startType, delayedA, valueBefore);
+                    StartType(b.startType, delayedB, valueAfter);
+                    Emit(name, "changed", "START_TYPE", valueBefore, valueAfter);
+                }
+                CompareString(name, "BINARY_PATH_NAME", before.String(a.binaryPath), after.String(b.binaryPath));
+                CompareString(name, "SERVICE_START_NAME", before.String(a.serviceStartName),
+                              after.String(b.serviceStartName));
+                if (!SameList(before.String(a.dependencies), after.String(b.dependencies)))
+                {
+                    JoinList(before.String(a.dependencies), valueBefore);
+                    JoinList(after.String(b.dependencies), valueAfter);
+                    Emit(name, "changed", "DEPENDENCIES", valueBefore, valueAfter);
+                }
+            }
+
+            if ((a.flags & SNAPSHOT_HAS_FAILURE_ACTIONS) && (b.flags & SNAPSHOT_HAS_FAILURE_ACTIONS) &&
+                !SameFailureActions(a, b))
+            {
+                FailureActions(before, a, valueBefore);
+                FailureActions(after, b, valueAfter);
+                Emit(name, "changed", "FAILURE_ACTIONS", valueBefore, valueAfter);
+            }
+            if (changes != changesBefore)
+                changed++;
+        }
+
+        void Finish(size_t servicesBefore, size_t servicesAfter, std::chrono::microseconds elapsed)
+        {
+            records.Finish();
+            if (format == OutputFormat::Text)
+            {
+                ScOut() << "[SC] DIFF " << added << " added, " << removed << " removed, " << changed
+                        << " changed (" << servicesBefore << " -> " << servicesAfter << " services, "
+                        << elapsed.count() / 1000.0 << " ms)\n";
+            }
+        }
+
+    private:
+        void Emit(const char *name, const char *change, const char *field, const std::string &from,
+                  const std::string &to)
+        {
+            Emit(name, change, field, from.c_str(), to.c_str());
+        }
+
+        void Emit(const char *name, const char *change, const char *field, const char *from, const char *to)
+        {
+            if (*field)
+                changes++;
+            if (format != OutputFormat::Text)
+            {
+                records.WriteChange(name, change, field, from, to);
+                return;
+            }
+            // [SC] ADDED name, [SC] REMOVED name, [SC] CHANGED name: FIELD before -> after
+            line = "[SC] ";
+            line += *change == 'a' ? "ADDED " : *change == 'r' ? "REMOVED " : "CHANGED ";
+            line += name;
+            if (*field)
+            {
+                line += ": ";
+                line += field;
+                line += ' ';
+                line += from;
+                line += " -> ";
+                line += to;
+            }
+            line += '\n';
+            ScOut().write(line.data(), static_cast<std::streamsize>(line.size()));
+        }
+
+        void CompareString(const char *name, const char *field, const char *a, const char *b)
+        {
+            if (SameString(a, b))
+                return;
+            Quote(a, valueBefore);
+            Quote(b, valueAfter);
+            Emit(name, "changed", field, valueBefore, valueAfter);
+        }
+
+        bool SameFailureActions(const SnapshotService &a, const SnapshotService &b) const
+        {
+            return a.resetPeriod == b.resetPeriod && a.actionCount == b.actionCount &&
+                   std::memcmp(before.Actions(a), after.Actions(b), a.actionCount * sizeof(SnapshotAction)) == 0 &&
+                   SameString(before.String(a.rebootMessage), after.String(b.rebootMessage)) &&
+                   SameString(before.String(a.failureCommand), after.String(b.failureCommand));
+        }
+
+        // Text output quotes strings so empty values and spaces stay visible.
+        void Quote(const char *value, std::string &out) const
+        {
+            out.clear();
+            if (format != OutputFormat::Text)
+            {
+                out = value ? value : "";
+                return;
+            }
+            if (!value)
+            {
+                out = "(none)";
+                return;
+            }
+            out += '"';
+            out += value;
+            out += '"';
+        }
+
+        static void StartType(DWORD startType, bool delayed, std::string &out)
+        {
+            out = StartTypeToString(startType);
+            if (delayed)
+                out += " (DELAYED)";
+        }
+
+        // Names joined with '/', as config depend= takes them.
+        static void JoinList(const char *list, std::string &out)
+        {
+            out.clear();
+            for (const char *p = list; p && *p; p += std::strlen(p) + 1)
+            {
+                if (!out.empty())
+                    out += '/';
+                out += p;
+            }
+        }
+
+        // In the syntax of the failure command: reset= ... actions= restart/60000/...
+        static void FailureActions(const ServiceSnapshot &snapshot, const SnapshotService &service, std::string &out)
+        {
+            out = "reset= " + std::to_string(service.resetPeriod) + " actions= ";
+            const SnapshotAction *actions = snapshot.Actions(service);
+            for (uint32_t i = 0; i < service.actionCount; i++)
+            {
+                if (i > 0)
+                    out += '/';
+                out += ActionName(actions[i].type);
+                out += '/';
+                out += std::to_string(actions[i].delay);
+            }
+            if (const char *reboot = snapshot.String(service.rebootMessage))
+            {
+                out += " reboot= \"";
+                out += reboot;
+                out += '"';
+            }
+            if (const char *command = snapshot.String(service.failureCommand))
+            {
+                out += " command= \"";
+                out += command;
+                out += '"';
+            }
+        }
+
+        const ServiceSnapshot &before;
+        const ServiceSnapshot &after;
+        OutputFormat format;
+        RecordWriter records;
+        std::string line;
+        std::string valueBefore;
+        std::string valueAfter;
+        size_t added = 0;
+        size_t removed = 0;
+        size_t changed = 0; // Services with at least one changed field.
+        size_t changes = 0; // Changed fields.
+    };
+}
+
+bool diff(const DiffOptions &opts)
+{
+    auto started = std::chrono::steady_clock::now();
+    ServiceSnapshot before, after;
+    std::string error;
+    if (!before.Open(opts.before, error))
+    {
+        ScErr() << "Error: Cannot read snapshot '" << opts.before << "': " << error << ".\n";
+        return false;
+    }
+    if (!after.Open(opts.after, error))
+    {
+        ScErr() << "Error: Cannot read snapshot '" << opts.after << "': " << error << ".\n";
+        return false;
+    }
+
+    // Both snapshots are sorted by name, so a single merge pass pairs the services up.
+    DiffWriter writer(before, after, opts.format);
+    size_t i = 0, j = 0;
+    while (i < before.Count() || j < after.Count())
+    {
+        int order;
+        if (i == before.Count())
+            order = 1;
+        else if (j == after.Count())
+            order = -1;
+        else
+            order = CompareServiceNames(before.String(before.Service(i).name), after.String(after.Service(j).name));
+
+        if (order < 0)
+            writer.Removed(before.Service(i++));
+        else if (order > 0)
+            writer.Added(after.Service(j++));
+        else
+            writer.Compare(before.Service(i++), after.Service(j++));
+    }
+    writer.Finish(before.Count(), after.Count(),
+                  std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started));
+    return true;
+}
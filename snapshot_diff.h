@@ -0,0 +1,29 @@
+#ifndef SNAPSHOT_DIFF_H
+#define SNAPSHOT_DIFF_H
+
+#include <string>
+#include <vector>
+
+#include "output_format.h"
+
+// Structure for the "diff" subcommand options.
+// Command-line syntax:
+//   sc.exe diff <before> <after> [format= {text | json | ndjson | csv}]
+struct DiffOptions
+{
+    std::string before; // Snapshot taken first.
+    std::string after;  // Snapshot taken later.
+    OutputFormat format = OutputFormat::Text;
+};
+
+// Parse function for "diff" options. Throws std::invalid_argument on bad input.
+void ParseDiffOptions(const std::vector<std::string> &args, DiffOptions &opts);
+
+// diff function: reports the services added to or removed from the host between two
+// snapshots, and changes to the state, start type, binary path, account, dependencies and
+// failure actions of the others. Both snapshots are sorted by name, so one merge pass over
+// them finds every difference; each one is written as soon as it is found.
+// Returns true if both snapshots could be read.
+bool diff(const DiffOptions &opts);
+
+#endif // SNAPSHOT_DIFF_H
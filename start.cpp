@@ -1,29 +1,46 @@
 #include "start.h"
+#include "console.h"
+#include "name_selector.h"
+#include "sc_api.h"
+#include "service_graph.h"
+#include "task_pool.h"
 
-#include <windows.h>
-#include <iostream>
+#include "win32_compat.h"
 #include <chrono>
-#include <thread>
+#include <iostream>
+#include <stdexcept>
 
 // Wait constants.
-static const int WAIT_INTERVAL_MS = 500; // 500 milliseconds between polls.
-static const int MAX_WAIT_MS = 30000;    // Wait up to 30 seconds.
+static const DWORD MAX_WAIT_MS = 30000; // Wait up to 30 seconds.
 
-// Helper: Determines the machine name to pass to OpenSCManagerA.
-// If opts.serverName is empty or equals "\\\\local" (case-insensitive), returns NULL.
-static const char *getMachineName(const std::string &serverName)
+// Helper: Reports why a wait for a state transition did not succeed.
+static void reportWait(const sc_transition &transition, uint32_t error, const char *verb)
 {
-    if (serverName.empty() || serverName == "\\\\local" || serverName == "\\local")
-        return NULL;
-    return serverName.c_str();
+    if (error == ERROR_SUCCESS)
+        return;
+    if (sc_last_failed_step() == SC_STEP_QUERY_STATUS)
+        ScErr() << "QueryServiceStatusEx failed, error: " << error << "\n";
+    else if (transition.timed_out)
+        ScErr() << "Timeout waiting for service to " << verb << ".\n";
+    else if (transition.stalled)
+        ScErr() << "Service stopped reporting progress (wait hint of " << transition.status.wait_hint << " ms exceeded).\n";
 }
 
 void printStartHelp()
 {
-    std::cout << R"(DESCRIPTION:
+    ScOut() << R"(DESCRIPTION:
         Starts a service running.
 USAGE:
         sc <server> start [service name] <arg1> <arg2> ...
+        sc <server> start [service name] tree= yes [parallel= <n>]
+
+        tree= yes also starts every service it depends on, dependencies
+        first. Services whose dependencies are running are started
+        concurrently, up to parallel= at a time (default = 8).
+
+        A name pattern such as MyApp_* or re:<regex> starts every matching
+        service, up to parallel= at a time; with tree= yes the matching
+        services are the roots of the tree.
 PS C:\Users\kotori\Documents\DFOR740 Midterm> sc.exe stop
 )";
 }
@@ -31,10 +48,19 @@ PS C:\Users\kotori\Documents\DFOR740 Midterm> sc.exe stop
 
 void printStopHelp()
 {
-    std::cout << R"(DESCRIPTION:
+    ScOut() << R"(DESCRIPTION:
         Sends a STOP control request to a service.
 USAGE:
         sc <server> stop [service name] <reason> <comment>
+        sc <server> stop [service name] tree= yes [parallel= <n>]
+
+        tree= yes first stops every service that depends on it, dependents
+        first, up to parallel= at a time (default = 8).
+
+        A name pattern such as MyApp_* or re:<regex> stops every matching
+        service, up to parallel= at a time; with tree= yes the matching
+        services are the roots of the tree.
+
         <reason> = Optional reason code number for service stop 
                    formed with the following elements in the format:
 
@@ -81,184 +107,208 @@ USAGE:
 )";
 }
 
-// Starts the specified service.
-// Opens the SCM and service handle, calls StartServiceA, then waits until the service is RUNNING.
-bool startService(const StartStopOptions &opts)
+// ParseStartStopOptions: the service name, then optional tree= and parallel= pairs.
+void ParseStartStopOptions(const std::vector<std::string> &args, StartStopOptions &opts)
 {
-
-
-    const char *machineName = getMachineName(opts.serverName);
-
-    SC_HANDLE hSCManager = OpenSCManagerA(machineName, nullptr, SC_MANAGER_CONNECT);
-    if (!hSCManager)
+    if (args.empty())
     {
-        printStartHelp();
-        std::cerr << "OpenSCManager failed, error: " << GetLastError() << "\n";
-        return false;
+        throw std::invalid_argument("Error: A service name is required.");
     }
-
-    SC_HANDLE hService = OpenServiceA(hSCManager, opts.serviceName.c_str(), SERVICE_START | SERVICE_QUERY_STATUS);
-    if (!hService)
+    opts.serviceName = args[0];
+    for (size_t i = 1; i < args.size(); i++)
     {
-        printStartHelp();
-        std::cerr << "OpenService failed, error: " << GetLastError() << "\n";
-        CloseServiceHandle(hSCManager);
-        return false;
-    }
-
-    // Check current service status.
-    SERVICE_STATUS_PROCESS ssStatus;
-    DWORD bytesNeeded = 0;
-    if (!QueryServiceStatusEx(hService, SC_STATUS_PROCESS_INFO, reinterpret_cast<LPBYTE>(&ssStatus),
-                              sizeof(ssStatus), &bytesNeeded))
-    {
-        printStartHelp();
-        std::cerr << "QueryServiceStatusEx failed, error: " << GetLastError() << "\n";
-        CloseServiceHandle(hService);
-        CloseServiceHandle(hSCManager);
-        return false;
-    }
-
-    if (ssStatus.dwCurrentState == SERVICE_RUNNING)
-    {
-        std::cout << "Service is already running.\n";
-        CloseServiceHandle(hService);
-        CloseServiceHandle(hSCManager);
-        return true;
-    }
-
-    // Attempt to start the service.
-    if (!StartServiceA(hService, 0, nullptr))
-    {
-        DWORD err = GetLastError();
-        if (err != ERROR_SERVICE_ALREADY_RUNNING)
+        if (args[i] != "tree=" && args[i] != "parallel=")
+            continue; // Start arguments and stop reasons are not used.
+        if (i + 1 >= args.size())
         {
-            printStartHelp();
-            std::cerr << "StartService failed, error: " << err << "\n";
-            CloseServiceHandle(hService);
-            CloseServiceHandle(hSCManager);
-            return false;
+            throw std::invalid_argument("Error: Missing value for option '" + args[i] + "'.");
         }
-    }
-    else
-    {
-        std::cout << "StartService succeeded.\n";
-    }
-
-    // Wait for the service to reach the RUNNING state.
-    auto startTime = std::chrono::steady_clock::now();
-    while (ssStatus.dwCurrentState != SERVICE_RUNNING)
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds(WAIT_INTERVAL_MS));
-        if (!QueryServiceStatusEx(hService, SC_STATUS_PROCESS_INFO, reinterpret_cast<LPBYTE>(&ssStatus),
-                                  sizeof(ssStatus), &bytesNeeded))
+        const std::string &value = args[++i];
+        if (args[i - 1] == "tree=")
         {
-            std::cerr << "QueryServiceStatusEx failed, error: " << GetLastError() << "\n";
-            break;
+            if (value != "yes" && value != "no")
+                throw std::invalid_argument("Error: Invalid value for tree=. Allowed: yes, no.");
+            opts.tree = value == "yes";
         }
-        auto elapsed = std::chrono::steady_clock::now() - startTime;
-        if (std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() > MAX_WAIT_MS)
+        else
         {
-            std::cerr << "Timeout waiting for service to start.\n";
-            break;
+            try
+            {
+                size_t used = 0;
+                unsigned long parsed = std::stoul(value, &used);
+                if (used != value.size() || parsed == 0)
+                    throw std::invalid_argument(value);
+                opts.parallel = static_cast<unsigned int>(parsed);
+            }
+            catch (const std::exception &)
+            {
+                throw std::invalid_argument("Error: parallel= must be a positive integer.");
+            }
         }
     }
-
-    bool result = (ssStatus.dwCurrentState == SERVICE_RUNNING);
-    if (result)
-        std::cout << "Service started successfully.\n";
-    else
-        std::cerr << "Service failed to start.\n";
-
-    CloseServiceHandle(hService);
-    CloseServiceHandle(hSCManager);
-    return result;
 }
 
-// Stops the specified service.
-// Opens the SCM and service handle, sends a SERVICE_CONTROL_STOP command, and waits until the service is STOPPED.
-bool stopService(const StartStopOptions &opts)
+// Starts the specified service.
+// Calls sc_start_service, which starts the service and waits until it is RUNNING.
+bool startService(const StartStopOptions &opts)
 {
-    const char *machineName = getMachineName(opts.serverName);
-
-    SC_HANDLE hSCManager = OpenSCManagerA(machineName, nullptr, SC_MANAGER_CONNECT);
-    if (!hSCManager)
+    sc_transition transition;
+    uint32_t error = sc_start_service(opts.serverName.c_str(), opts.serviceName.c_str(), 0, nullptr, MAX_WAIT_MS,
+                                      &transition);
+    if (transition.already_in_state)
     {
-        printStopHelp();
-        std::cerr << "OpenSCManager failed, error: " << GetLastError() << "\n";
-        return false;
+        ScOut() << "Service is already running.\n";
+        return true;
     }
-
-    SC_HANDLE hService = OpenServiceA(hSCManager, opts.serviceName.c_str(), SERVICE_STOP | SERVICE_QUERY_STATUS);
-    if (!hService)
+    if (!transition.waited)
     {
-        printStopHelp();
-        std::cerr << "OpenService failed, error: " << GetLastError() << "\n";
-        CloseServiceHandle(hSCManager);
+        printStartHelp();
+        ScErr() << sc_step_name(sc_last_failed_step()) << " failed, error: " << error << "\n";
         return false;
     }
+    if (transition.request_sent)
+        ScOut() << "StartService succeeded.\n";
 
-    // Query current service status.
-    SERVICE_STATUS_PROCESS ssStatus;
-    DWORD bytesNeeded = 0;
-    if (!QueryServiceStatusEx(hService, SC_STATUS_PROCESS_INFO, reinterpret_cast<LPBYTE>(&ssStatus),
-                              sizeof(ssStatus), &bytesNeeded))
+    reportWait(transition, error, "start");
+    if (error != ERROR_SUCCESS)
     {
-        printStopHelp();
-        std::cerr << "QueryServiceStatusEx failed, error: " << GetLastError() << "\n";
-        CloseServiceHandle(hService);
-        CloseServiceHandle(hSCManager);
+        ScErr() << "Service failed to start.\n";
         return false;
     }
+    ScOut() << "Service started successfully in " << transition.elapsed_ms << " ms.\n";
+    return true;
+}
 
-    if (ssStatus.dwCurrentState == SERVICE_STOPPED)
+// Stops the specified service.
+// Calls sc_stop_service, which sends SERVICE_CONTROL_STOP and waits until the service is STOPPED.
+bool stopService(const StartStopOptions &opts)
+{
+    sc_transition transition;
+    uint32_t error = sc_stop_service(opts.serverName.c_str(), opts.serviceName.c_str(), MAX_WAIT_MS, &transition);
+    if (transition.already_in_state)
     {
-        std::cout << "Service is already stopped.\n";
-        CloseServiceHandle(hService);
-        CloseServiceHandle(hSCManager);
+        ScOut() << "Service is already stopped.\n";
         return true;
     }
-
-    // Issue a stop command.
-    if (!ControlService(hService, SERVICE_CONTROL_STOP, reinterpret_cast<LPSERVICE_STATUS>(&ssStatus)))
+    if (!transition.waited)
     {
         printStopHelp();
-        std::cerr << "ControlService failed, error: " << GetLastError() << "\n";
-        CloseServiceHandle(hService);
-        CloseServiceHandle(hSCManager);
+        ScErr() << sc_step_name(sc_last_failed_step()) << " failed, error: " << error << "\n";
         return false;
     }
-    else
+    ScOut() << "Stop command sent.\n";
+
+    reportWait(transition, error, "stop");
+    if (error != ERROR_SUCCESS)
     {
-        std::cout << "Stop command sent.\n";
+        ScErr() << "Service failed to stop.\n";
+        return false;
     }
+    ScOut() << "Service stopped successfully in " << transition.elapsed_ms << " ms.\n";
+    return true;
+}
 
-    // Wait for the service to reach the STOPPED state.
-    auto startTime = std::chrono::steady_clock::now();
-    while (ssStatus.dwCurrentState != SERVICE_STOPPED)
+// Loads the dependency graph around opts.serviceName and starts it dependencies first, or
+// stops it dependents first, on a bounded pool. Each service's output is printed as one
+// block when it finishes.
+bool startStopServiceTree(const StartStopOptions &opts, bool start)
+{
+    const char *verb = start ? "START" : "STOP";
+    std::vector<std::string> roots = {opts.serviceName};
+    if (std::shared_ptr<const NameSelector> selector = ParseServiceSelector(opts.serverName, opts.serviceName))
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds(WAIT_INTERVAL_MS));
-        if (!QueryServiceStatusEx(hService, SC_STATUS_PROCESS_INFO, reinterpret_cast<LPBYTE>(&ssStatus),
-                                  sizeof(ssStatus), &bytesNeeded))
+        roots.clear();
+        if (!SelectServices(opts.serverName, *selector, roots))
         {
-            std::cerr << "QueryServiceStatusEx failed, error: " << GetLastError() << "\n";
-            break;
+            ScErr() << "EnumServicesStatusEx failed, error: " << GetLastError() << "\n";
+            return false;
         }
-        auto elapsed = std::chrono::steady_clock::now() - startTime;
-        if (std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() > MAX_WAIT_MS)
+        if (roots.empty())
         {
-            std::cerr << "Timeout waiting for service to stop.\n";
-            break;
+            ScErr() << "[SC] No service matches \"" << selector->Text() << "\".\n";
+            return false;
         }
     }
+    ServiceGraph graph;
+    std::string failedService;
+    DWORD error = LoadServiceGraph(opts.serverName, roots,
+                                   start ? GraphDirection::Dependencies : GraphDirection::Dependents, graph,
+                                   failedService);
+    if (error != ERROR_SUCCESS)
+    {
+        if (failedService.empty())
+            ScErr() << "OpenSCManager failed, error: " << error << "\n";
+        else
+            ScErr() << "Reading dependencies of \"" << failedService << "\" failed, error: " << error << "\n";
+        return false;
+    }
+
+    std::vector<std::string> cycle;
+    if (graph.FindCycle(cycle))
+    {
+        ScErr() << "Error: Circular dependency: ";
+        for (size_t i = 0; i < cycle.size(); i++)
+            ScErr() << (i ? " -> " : "") << cycle[i];
+        ScErr() << " (error " << ERROR_CIRCULAR_DEPENDENCY << ")\n";
+        return false;
+    }
+
+    const std::vector<ServiceGraphNode> &nodes = graph.Nodes();
+    std::vector<BoundedTask> tasks;
+    std::vector<std::vector<size_t>> prerequisites;
+    for (const ServiceGraphNode &node : nodes)
+    {
+        StartStopOptions single;
+        single.serverName = opts.serverName;
+        single.serviceName = node.name;
+        tasks.push_back([single, start]()
+                        { return start ? startService(single) : stopService(single); });
+        prerequisites.push_back(start ? node.dependsOn : node.dependents);
+    }
 
-    bool result = (ssStatus.dwCurrentState == SERVICE_STOPPED);
-    if (result)
-        std::cout << "Service stopped successfully.\n";
-    else
-        std::cerr << "Service failed to stop.\n";
+    auto began = std::chrono::steady_clock::now();
+    size_t succeeded = 0, failed = 0, skipped = 0, timedOut = 0;
+    // A task only waits on its own transition, so give it the wait limit plus some slack.
+    RunDependentTasks(tasks, prerequisites, opts.parallel, std::chrono::milliseconds(MAX_WAIT_MS + 5000),
+                      [&](const TaskOutcome &outcome)
+                      {
+                          const char *status = outcome.timedOut ? "TIMEOUT"
+                                               : outcome.skipped ? "SKIPPED"
+                                               : outcome.ok      ? "SUCCESS"
+                                                                 : "FAILED";
+                          if (outcome.timedOut)
+                              ++timedOut;
+                          else if (outcome.skipped)
+                              ++skipped;
+                          else if (outcome.ok)
+                              ++succeeded;
+                          else
+                              ++failed;
 
-    CloseServiceHandle(hService);
-    CloseServiceHandle(hSCManager);
-    return result;
+                          std::ostream &out = ScOut();
+                          out << "[SC] " << verb << " " << nodes[outcome.index].name << ": " << status;
+                          if (!outcome.skipped)
+                              out << " (" << outcome.elapsedMs << " ms)";
+                          out << "\n" << outcome.output;
+                          if (!outcome.output.empty() && outcome.output.back() != '\n')
+                              out << "\n";
+                          out.flush();
+                      });
+
+    auto total = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - began);
+    ScOut() << "[SC] " << verb << " " << nodes.size() << " service(s), " << succeeded << " succeeded, " << failed
+            << " failed, " << skipped << " skipped, " << timedOut << " timed out, " << total.count() << " ms\n";
+    return failed == 0 && skipped == 0 && timedOut == 0;
+}
+
+bool startStopSelectedServices(const StartStopOptions &opts, const NameSelector &selector, bool start)
+{
+    return ForEachSelectedService(opts.serverName, selector, start ? "START" : "STOP", opts.parallel,
+                                  std::chrono::milliseconds(MAX_WAIT_MS + 5000),
+                                  [opts, start](const std::string &serviceName)
+                                  {
+                                      StartStopOptions single = opts;
+                                      single.serviceName = serviceName;
+                                      return start ? startService(single) : stopService(single);
+                                  });
 }
@@ -2,14 +2,26 @@
 #define START_H
 
 #include <string>
+#include <vector>
+
+class NameSelector;
 
 // Structure holding options for starting or stopping a service.
+// Command-line syntax:
+//   sc.exe [<servername>] {start | stop} <servicename | pattern> [tree= {yes | no}] [parallel= <n>]
 struct StartStopOptions
 {
-    std::string serverName;  // If empty or "\\\\local", local machine is used.
-    std::string serviceName; // The service name (key name)
+    std::string serverName;    // If empty or "\\\\local", local machine is used.
+    std::string serviceName;   // The service name (key name)
+    bool tree = false;         // Also start what the service depends on / stop what depends on it.
+    unsigned int parallel = 8; // With tree=, how many services are started or stopped at once.
 };
 
+// Parse function for "start" and "stop" options. Tokens other than tree= and parallel=
+// (start arguments, stop reasons) are accepted and ignored, as before.
+// Throws std::invalid_argument on bad input.
+void ParseStartStopOptions(const std::vector<std::string> &args, StartStopOptions &opts);
+
 // Starts the specified service.
 // Returns true on success, false on failure.
 bool startService(const StartStopOptions &opts);
@@ -18,4 +30,15 @@ bool startService(const StartStopOptions &opts);
 // Returns true on success, false on failure.
 bool stopService(const StartStopOptions &opts);
 
+// Starts a service after everything it depends on, or stops it after everything that
+// depends on it, following the dependency graph. Services whose prerequisites are done
+// are handled concurrently, up to opts.parallel at a time.
+// Returns true if every service in the graph reached the requested state.
+bool startStopServiceTree(const StartStopOptions &opts, bool start);
+
+// Starts or stops every service selector matches (opts.serviceName holds its text), up to
+// opts.parallel at a time. Each service's output is printed as one block when it finishes.
+// Returns true if something matched and every service reached the requested state.
+bool startStopSelectedServices(const StartStopOptions &opts, const NameSelector &selector, bool start);
+
 #endif // START_H
\ No newline at end of file
@@ -0,0 +1,172 @@
+#include "stats.h"
+#include "console.h"
+#include "metrics.h"
+#include "option_schema.h"
+
+#include <cstdio>
+#include <iomanip>
+#include <stdexcept>
+
+void printStatsHelp()
+{
+    ScOut() << R"(DESCRIPTION:
+        Prints how long each subcommand and each Service Control Manager
+        call took (50th, 90th and 99th percentile and maximum), the error
+        codes the calls returned and the bytes service enumerations moved,
+        added up over every sc run since the last reset. The totals are
+        kept in the file named by SC_METRICS (off keeps none), or else in
+        sc-metrics under %LOCALAPPDATA% ($XDG_CACHE_HOME or $HOME elsewhere).
+USAGE:
+        sc stats [format= {text | prometheus}] [reset= yes]
+EXAMPLE:
+        sc stats
+        sc stats format= prometheus > sc.prom
+)";
+}
+
+// ParseStatsOptions: format= and reset= pairs.
+void ParseStatsOptions(const std::vector<std::string> &args, StatsOptions &opts)
+{
+    size_t i = 0;
+    while (i < args.size())
+    {
+        const std::string &token = args[i];
+        if (token.size() < 2 || token.back() != '=')
+        {
+            printStatsHelp();
+            throw std::invalid_argument("Error: Invalid option format '" + token + "'. Expected key= followed by a value.");
+        }
+        std::string key = token.substr(0, token.size() - 1);
+        i++;
+        if (i >= args.size())
+        {
+            throw std::invalid_argument("Error: Missing value for option '" + key + "='.");
+        }
+        const std::string &value = args[i];
+        i++;
+
+        if (key == "format")
+        {
+            if (value != "text" && value != "prometheus")
+            {
+                throw std::invalid_argument("Error: Invalid value for format=. Allowed: text, prometheus.");
+            }
+            opts.prometheus = value == "prometheus";
+        }
+        else if (key == "reset")
+        {
+            const bool *reset = YES_NO_VALUES.Find(value);
+            if (!reset)
+            {
+                throw std::invalid_argument("Error: Invalid reset value. Allowed: " + YES_NO_VALUES.Names() + ".");
+            }
+            opts.reset = *reset;
+        }
+        else
+        {
+            throw std::invalid_argument("Error: Unknown option '" + key + "='.");
+        }
+    }
+}
+
+namespace
+{
+    // Three significant digits in the largest unit that keeps the value at 1 or more.
+    std::string FormatDuration(uint64_t ns)
+    {
+        static const struct
+        {
+            double scale;
+            const char *unit;
+        } UNITS[] = {{1e9, "s"}, {1e6, "ms"}, {1e3, "us"}};
+        char text[32];
+        for (const auto &unit : UNITS)
+        {
+            if (static_cast<double>(ns) >= unit.scale)
+            {
+                std::snprintf(text, sizeof(text), "%.3g %s", static_cast<double>(ns) / unit.scale, unit.unit);
+                return text;
+            }
+        }
+        return std::to_string(ns) + " ns";
+    }
+
+    void PrintLatencyTable(const char *title, const char *failuresTitle, const std::map<std::string, LatencyData> &rows,
+                           const std::map<std::string, uint64_t> &failures)
+    {
+        ScOut() << std::left << std::setw(28) << title << std::right << std::setw(10) << "COUNT" << std::setw(9)
+                << failuresTitle << std::setw(11) << "P50" << std::setw(11) << "P90" << std::setw(11) << "P99"
+                << std::setw(11) << "MAX" << "\n";
+        for (const auto &row : rows)
+        {
+            auto failed = failures.find(row.first);
+            const LatencyData &data = row.second;
+            ScOut() << std::left << std::setw(28) << row.first << std::right << std::setw(10) << data.count
+                    << std::setw(9) << (failed == failures.end() ? 0 : failed->second) << std::setw(11)
+                    << FormatDuration(data.Percentile(0.5)) << std::setw(11) << FormatDuration(data.Percentile(0.9))
+                    << std::setw(11) << FormatDuration(data.Percentile(0.99)) << std::setw(11)
+                    << FormatDuration(data.maxNs) << "\n";
+        }
+        ScOut() << "\n";
+    }
+
+    void PrintStats(const MetricsData &data)
+    {
+        // Calls fail with many codes, so the table shows their total and the list below the codes.
+        // ERROR_MORE_DATA and ERROR_INSUFFICIENT_BUFFER count too: they cost a round trip.
+        std::map<std::string, uint64_t> callErrors;
+        for (const auto &entry : data.errors)
+            callErrors[entry.first.first] += entry.second;
+
+        PrintLatencyTable("SUBCOMMAND", "FAILED", data.commands, data.commandFailures);
+        PrintLatencyTable("SCM CALL", "ERRORS", data.scmCalls, callErrors);
+        if (!data.errors.empty())
+        {
+            ScOut() << std::left << std::setw(28) << "SCM CALL" << std::setw(40) << "ERROR" << std::right
+                    << std::setw(10) << "COUNT" << "\n";
+            for (const auto &entry : data.errors)
+            {
+                const char *name = ErrorCodeName(entry.first.second);
+                std::string error = std::to_string(entry.first.second) + (name ? std::string(" ") + name : "");
+                ScOut() << std::left << std::setw(28) << entry.first.first << std::setw(40) << error << std::right
+                        << std::setw(10) << entry.second << "\n";
+            }
+            ScOut() << "\n";
+        }
+        ScOut() << "EnumServicesStatusExA returned " << data.enumBytes << " bytes in " << data.enumCalls
+                << " pages.\n";
+    }
+} // end anonymous namespace
+
+bool stats(const StatsOptions &opts)
+{
+    std::string path = DefaultMetricsPath();
+    if (opts.reset)
+    {
+        if (!ResetScmMetrics())
+        {
+            ScErr() << "Error: Cannot write metrics file '" << path << "'.\n";
+            return false;
+        }
+        ScOut() << "[SC] stats reset" << (path.empty() ? "" : " (" + path + ")") << "\n";
+        return true;
+    }
+
+    MetricsData data;
+    if (path.empty())
+    {
+        ScOut() << "[SC] Metrics are not saved between runs (SC_METRICS=off, or no profile directory).\n";
+    }
+    else if (!LoadMetricsFile(path, data))
+    {
+        ScErr() << "Error: '" << path << "' is not an sc metrics file.\n";
+        return false;
+    }
+    data.Merge(CurrentMetrics());
+
+    if (opts.prometheus)
+        ScOut() << FormatPrometheusMetrics(data);
+    else
+        PrintStats(data);
+    return true;
+}
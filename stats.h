@@ -0,0 +1,24 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <string>
+#include <vector>
+
+// Structure for the "stats" subcommand options.
+// Command-line syntax:
+//   sc.exe stats [format= {text | prometheus}] [reset= yes]
+struct StatsOptions
+{
+    bool prometheus = false; // Prometheus text exposition format instead of tables.
+    bool reset = false;      // Clear the saved totals instead of printing them.
+};
+
+// Parse function for "stats" options. Throws std::invalid_argument on bad input.
+void ParseStatsOptions(const std::vector<std::string> &args, StatsOptions &opts);
+
+// stats function: prints the latency percentiles of every subcommand and SCM call, the error
+// codes the SCM returned and the bytes enumerations moved, totalled over the runs saved in
+// DefaultMetricsPath(). Returns true on success.
+bool stats(const StatsOptions &opts);
+
+#endif // STATS_H
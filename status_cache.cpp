@@ -0,0 +1,853 @@
+// The cache subscribes to status changes with NotifyServiceStatusChangeA where it can
+// (Vista or later); elsewhere, and when the SCM refuses, it polls.
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600
+#endif
+#if defined(_WIN32) && _WIN32_WINNT >= 0x0600
+#define STATUS_CACHE_NOTIFICATIONS 1
+#else
+#define STATUS_CACHE_NOTIFICATIONS 0
+#endif
+
+#include "status_cache.h"
+#include "console.h"
+#include "local_ipc.h"
+#include "metrics.h"
+#include "process_index.h"
+#include "query.h"
+#include "scm_backend.h"
+#include "scm_buffers.h"
+#include "scm_handles.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+void printCacheHelp()
+{
+    ScOut() << R"(DESCRIPTION:
+        Keeps the status of every service in memory and answers
+        "query ... cache= yes" from that table over a local pipe or
+        socket, so repeated queries do not go to the SCM. The table is
+        kept current by service status notifications where available,
+        otherwise by polling.
+USAGE:
+        sc <server> cache serve [poll= <ms>] [maxage= <ms>] [endpoint= <path>]
+                                [metrics= <port>]
+        sc cache stats [endpoint= <path>]
+        sc cache stop [endpoint= <path>]
+
+OPTIONS:
+        serve     Runs the cache in the foreground until "sc cache stop".
+        stats     Prints the cache's hit rate, staleness and refresh counters.
+        stop      Stops a running cache.
+        poll=     Refresh interval in milliseconds when the cache polls
+                  (default = 1000). With notifications the cache refreshes
+                  on each change, and every 5 minutes as a safety net.
+        maxage=   Oldest table, in milliseconds, served without refreshing
+                  it first when the cache polls (default = twice poll=)
+        endpoint= Pipe or socket to use (default = \\.\pipe\sc-cache on
+                  Windows, a socket in $XDG_RUNTIME_DIR or /tmp elsewhere;
+                  SC_CACHE_ENDPOINT overrides it)
+        metrics=  Also serves the SCM call latencies and error counts in
+                  Prometheus text format at
+                  http://127.0.0.1:<port>/metrics (default = none)
+EXAMPLE:
+        sc cache serve poll= 500
+        sc query state= all cache= yes
+        sc cache serve endpoint= \\.\pipe\ops-cache
+        sc query state= all endpoint= \\.\pipe\ops-cache
+)";
+}
+
+// ParseCacheOptions: the action, then key= value pairs.
+void ParseCacheOptions(const std::vector<std::string> &args, CacheOptions &opts)
+{
+    if (args.empty() || (args[0] != "serve" && args[0] != "stats" && args[0] != "stop"))
+    {
+        printCacheHelp();
+        throw std::invalid_argument("Error: cache requires an action: serve, stats or stop.");
+    }
+    opts.action = args[0];
+
+    size_t i = 1;
+    while (i < args.size())
+    {
+        const std::string &token = args[i];
+        if (token.size() < 2 || token.back() != '=')
+        {
+            throw std::invalid_argument("Error: Invalid option format '" + token + "'. Expected key= followed by a value.");
+        }
+        std::string key = token.substr(0, token.size() - 1);
+        i++;
+        if (i >= args.size())
+        {
+            throw std::invalid_argument("Error: Missing value for option '" + key + "='.");
+        }
+        const std::string &value = args[i];
+        i++;
+
+        if (key == "endpoint")
+        {
+            opts.endpoint = value;
+        }
+        else if (key == "poll" || key == "maxage")
+        {
+            unsigned long parsed = 0;
+            try
+            {
+                size_t used = 0;
+                parsed = std::stoul(value, &used);
+                if (used != value.size() || parsed == 0 || parsed > 0xFFFFFFFFul)
+                    throw std::invalid_argument(value);
+            }
+            catch (const std::exception &)
+            {
+                throw std::invalid_argument("Error: " + key + "= must be a positive number of milliseconds.");
+            }
+            (key == "poll" ? opts.pollMs : opts.maxAgeMs) = static_cast<unsigned int>(parsed);
+        }
+        else if (key == "metrics")
+        {
+            unsigned long parsed = 0;
+            try
+            {
+                size_t used = 0;
+                parsed = std::stoul(value, &used);
+                if (used != value.size() || parsed == 0 || parsed > 65535)
+                    throw std::invalid_argument(value);
+            }
+            catch (const std::exception &)
+            {
+                throw std::invalid_argument("Error: metrics= must be a TCP port from 1 to 65535.");
+            }
+            opts.metricsPort = static_cast<unsigned short>(parsed);
+        }
+        else
+        {
+            throw std::invalid_argument("Error: Unknown option '" + key + "='.");
+        }
+    }
+}
+
+namespace
+{
+    // Requests are one tab-separated line starting with the protocol version:
+    //   1 ENUM <server> <type> <state>   services matching type and state
+    //   1 STATUS <server> <name>         one service
+    //   1 PID <server> <pid>             services running in one process
+    //   1 STATS                          counters, as text
+    //   1 STOP                           shut the cache down
+    // Services come back as "OK\t<age ms>\t<count>\n" followed by count records, each the
+    // name and display name (32-bit length, then the bytes) and a SERVICE_STATUS_PROCESS.
+    // "MISS\n" tells the client to ask the SCM itself; "ERR\t<reason>\n" reports a bad request.
+    const char CACHE_PROTOCOL_VERSION[] = "1";
+
+    // With notifications the table changes only when a notification says so; it is still
+    // re-enumerated this often in case one was lost. Wait slices keep Stop() prompt.
+    constexpr DWORD CACHE_NOTIFY_RESYNC_MS = 5 * 60 * 1000;
+    constexpr DWORD CACHE_NOTIFY_SLICE_MS = 1000;
+
+    // Connections answered at once; further clients wait in the listen backlog.
+    constexpr size_t CACHE_MAX_CONNECTIONS = 64;
+
+    using Clock = std::chrono::steady_clock;
+
+    std::string ToLower(std::string s)
+    {
+        std::transform(s.begin(), s.end(), s.begin(),
+                       [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+        return s;
+    }
+
+    // "\\local" and "" both mean this machine.
+    std::string ServerKey(const std::string &serverName)
+    {
+        return serverName == "\\\\local" ? std::string() : ToLower(serverName);
+    }
+
+    std::vector<std::string> SplitFields(const std::string &line)
+    {
+        std::vector<std::string> fields;
+        size_t start = 0;
+        for (;;)
+        {
+            size_t tab = line.find('\t', start);
+            fields.push_back(line.substr(start, tab - start));
+            if (tab == std::string::npos)
+                return fields;
+            start = tab + 1;
+        }
+    }
+
+    bool MatchesFilter(const SERVICE_STATUS_PROCESS &status, DWORD serviceType, DWORD serviceState)
+    {
+        if ((status.dwServiceType & serviceType) == 0)
+            return false;
+        bool stopped = status.dwCurrentState == SERVICE_STOPPED;
+        return !((serviceState == SERVICE_ACTIVE && stopped) || (serviceState == SERVICE_INACTIVE && !stopped));
+    }
+
+    void AppendString(std::string &out, const std::string &value)
+    {
+        uint32_t length = static_cast<uint32_t>(value.size());
+        out.append(reinterpret_cast<const char *>(&length), sizeof(length));
+        out.append(value);
+    }
+
+    void AppendService(std::string &out, const CachedServiceStatus &service)
+    {
+        AppendString(out, service.serviceName);
+        AppendString(out, service.displayName);
+        out.append(reinterpret_cast<const char *>(&service.status), sizeof(service.status));
+    }
+
+    // Reads the records that follow an OK header. Returns false if the response is truncated.
+    bool ReadServices(const std::string &response, size_t offset, size_t count, std::vector<CachedServiceStatus> &services)
+    {
+        auto readString = [&response, &offset](std::string &value)
+        {
+            uint32_t length;
+            if (response.size() - offset < sizeof(length))
+                return false;
+            std::memcpy(&length, response.data() + offset, sizeof(length));
+            offset += sizeof(length);
+            if (response.size() - offset < length)
+                return false;
+            value.assign(response, offset, length);
+            offset += length;
+            return true;
+        };
+        if (count > response.size() - offset)
+            return false;
+        services.resize(count);
+        for (CachedServiceStatus &service : services)
+        {
+            if (!readString(service.serviceName) || !readString(service.displayName) ||
+                response.size() - offset < sizeof(service.status))
+                return false;
+            std::memcpy(&service.status, response.data() + offset, sizeof(service.status));
+            offset += sizeof(service.status);
+        }
+        return offset == response.size();
+    }
+
+    // Sends a request and returns the records of an OK response.
+    bool RequestServices(const std::string &endpoint, const std::string &request,
+                         std::vector<CachedServiceStatus> &services, unsigned int &ageMs)
+    {
+        std::string response;
+        if (!LocalRequest(endpoint.empty() ? DefaultCacheEndpoint() : endpoint, request, response))
+            return false;
+        size_t newline = response.find('\n');
+        if (newline == std::string::npos)
+            return false;
+        std::vector<std::string> header = SplitFields(response.substr(0, newline));
+        if (header.size() != 3 || header[0] != "OK")
+            return false;
+        try
+        {
+            ageMs = static_cast<unsigned int>(std::stoul(header[1]));
+            return ReadServices(response, newline + 1, std::stoul(header[2]), services);
+        }
+        catch (const std::exception &)
+        {
+            return false;
+        }
+    }
+
+    // The cached service table. A refresh builds a new one and swaps it in, so requests
+    // read a consistent table without holding a lock while they serialize it.
+    struct CacheTable
+    {
+        std::vector<CachedServiceStatus> services;           // Enumeration order.
+        std::unordered_map<std::string, size_t> indexByName; // Lower-case name to position.
+        ProcessIndex byProcess;
+        Clock::time_point refreshedAt;
+    };
+
+    struct CacheCounters
+    {
+        std::atomic<uint64_t> requests{0};
+        std::atomic<uint64_t> hits{0};          // Answered from the table as it was.
+        std::atomic<uint64_t> misses{0};        // Needed a refresh or the SCM first.
+        std::atomic<uint64_t> refreshes{0};
+        std::atomic<uint64_t> failedRefreshes{0};
+        std::atomic<uint64_t> notifications{0};
+        std::atomic<uint64_t> lastRefreshUs{0};
+        std::atomic<uint64_t> maxAgeServedMs{0};
+    };
+
+    class StatusCache
+    {
+    public:
+        explicit StatusCache(const CacheOptions &opts)
+            : opts(opts), maxAge(std::chrono::milliseconds(opts.maxAgeMs ? opts.maxAgeMs : 2ull * opts.pollMs))
+        {
+        }
+
+        // Enumerates every service and swaps the result in. Returns the Win32 error. Given the
+        // stale table the caller found, returns at once if another refresh already replaced it.
+        DWORD Refresh(const std::shared_ptr<const CacheTable> &stale = nullptr)
+        {
+            std::lock_guard<std::mutex> lock(refreshMutex);
+            // Requests that found the same stale table queue here; one enumerates, the rest take its table.
+            if (stale && Current() != stale)
+                return ERROR_SUCCESS;
+            auto started = Clock::now();
+            ScHandle scm = OpenSCManagerShared(opts.serverName, SC_MANAGER_ENUMERATE_SERVICE);
+            if (!scm)
+            {
+                counters.failedRefreshes++;
+                return GetLastError();
+            }
+            std::shared_ptr<CacheTable> table = std::make_shared<CacheTable>();
+            const std::shared_ptr<const CacheTable> previous = Current();
+            if (previous)
+                table->services.reserve(previous->services.size());
+            bool success = EnumerateServicePages(
+                scm, SERVICE_DRIVER | SERVICE_WIN32, SERVICE_STATE_ALL, nullptr, 0, 0,
+                [&table](const ENUM_SERVICE_STATUS_PROCESSA *services, DWORD count)
+                {
+                    for (DWORD i = 0; i < count; i++)
+                        table->services.push_back({services[i].lpServiceName, services[i].lpDisplayName,
+                                                   services[i].ServiceStatusProcess});
+                    return true;
+                });
+            if (!success)
+            {
+                counters.failedRefreshes++;
+                return GetLastError();
+            }
+            table->indexByName.reserve(table->services.size());
+            for (size_t i = 0; i < table->services.size(); i++)
+                table->indexByName.emplace(ToLower(table->services[i].serviceName), i);
+            table->byProcess.Build(table->services);
+            table->refreshedAt = Clock::now();
+            std::atomic_store(&current, std::shared_ptr<const CacheTable>(std::move(table)));
+            counters.refreshes++;
+            counters.lastRefreshUs = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - started).count());
+            // The cache runs for days; keep a grown enumeration hint without waiting for it to stop.
+            SaveScmSizeHints();
+            return ERROR_SUCCESS;
+        }
+
+        std::shared_ptr<const CacheTable> Current() const
+        {
+            return std::atomic_load(&current);
+        }
+
+        // Handles one request line and returns the response.
+        std::string Answer(const std::string &request)
+        {
+            std::vector<std::string> fields = SplitFields(request);
+            if (fields.size() < 2 || fields[0] != CACHE_PROTOCOL_VERSION)
+                return "ERR\tunsupported protocol version\n";
+            const std::string &verb = fields[1];
+            if (verb == "STATS")
+                return "OK\n" + Stats();
+            if (verb == "STOP")
+            {
+                Stop();
+                return "OK\n";
+            }
+            if ((verb != "ENUM" || fields.size() != 5) && ((verb != "STATUS" && verb != "PID") || fields.size() != 4))
+                return "ERR\tbad request\n";
+            if (ServerKey(fields[2]) != ServerKey(opts.serverName))
+                return "MISS\n";
+
+            counters.requests++;
+            std::shared_ptr<const CacheTable> table = Current();
+            // With notifications a table is current however old it is.
+            bool hit = table && (notifying || Clock::now() - table->refreshedAt <= maxAge);
+            if (!hit && Refresh(table) == ERROR_SUCCESS)
+                table = Current();
+            if (!table)
+            {
+                counters.misses++;
+                return "MISS\n";
+            }
+
+            std::string response;
+            if (verb == "STATUS")
+            {
+                auto found = table->indexByName.find(ToLower(fields[3]));
+                if (found == table->indexByName.end())
+                {
+                    // Possibly created since the last refresh; the client asks the SCM.
+                    counters.misses++;
+                    return "MISS\n";
+                }
+                AppendService(response, table->services[found->second]);
+                response.insert(0, Header(*table, 1));
+            }
+            else if (verb == "PID")
+            {
+                DWORD processId;
+                try
+                {
+                    processId = static_cast<DWORD>(std::stoul(fields[3]));
+                }
+                catch (const std::exception &)
+                {
+                    return "ERR\tbad request\n";
+                }
+                // A process the table does not know may have started since the last refresh.
+                const std::vector<size_t> *positions = table->byProcess.Find(processId);
+                if (!positions)
+                {
+                    counters.misses++;
+                    return "MISS\n";
+                }
+                for (size_t position : *positions)
+                    AppendService(response, table->services[position]);
+                response.insert(0, Header(*table, positions->size()));
+            }
+            else
+            {
+                DWORD serviceType, serviceState;
+                try
+                {
+                    serviceType = static_cast<DWORD>(std::stoul(fields[3]));
+                    serviceState = static_cast<DWORD>(std::stoul(fields[4]));
+                }
+                catch (const std::exception &)
+                {
+                    return "ERR\tbad request\n";
+                }
+                size_t count = 0;
+                for (const CachedServiceStatus &service : table->services)
+                {
+                    if (!MatchesFilter(service.status, serviceType, serviceState))
+                        continue;
+                    AppendService(response, service);
+                    count++;
+                }
+                response.insert(0, Header(*table, count));
+            }
+            (hit ? counters.hits : counters.misses)++;
+            return response;
+        }
+
+        // Keeps the table current until Stop(): refreshes on each notified change (and every
+        // CACHE_NOTIFY_RESYNC_MS), or when notifications are unavailable, every poll interval.
+        void RunRefresher();
+
+        void Stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(stopMutex);
+                stopping = true;
+            }
+            stopChanged.notify_all();
+        }
+
+        bool Stopping() const { return stopping; }
+
+        std::string Stats() const
+        {
+            std::shared_ptr<const CacheTable> table = Current();
+            uint64_t hits = counters.hits, misses = counters.misses;
+            ScmBufferStats buffers = GetScmBufferStats();
+            std::ostringstream out;
+            out << "[SC] Status cache for " << (opts.serverName.empty() ? "\\\\local" : opts.serverName) << "\n"
+                << "        MODE               : "
+                << (notifying ? "notify (resync every " + std::to_string(CACHE_NOTIFY_RESYNC_MS)
+                              : "poll (poll every " + std::to_string(opts.pollMs))
+                << " ms)\n"
+                << "        SERVICES           : " << (table ? table->services.size() : 0) << "\n"
+                << "        AGE                : " << (table ? AgeMs(*table) : 0) << " ms\n"
+                << "        REFRESHES          : " << counters.refreshes << " (" << counters.failedRefreshes
+                << " failed, last " << std::fixed << std::setprecision(3) << counters.lastRefreshUs / 1000.0 << " ms)\n"
+                << "        NOTIFICATIONS      : " << counters.notifications << "\n"
+                << "        REQUESTS           : " << counters.requests << "\n"
+                << "        HIT RATE           : " << std::setprecision(1)
+                << (hits + misses ? 100.0 * hits / (hits + misses) : 0.0) << "% (" << hits << " hits, " << misses
+                << " misses)\n"
+                << "        MAX AGE SERVED     : " << counters.maxAgeServedMs << " ms\n"
+                << "        SIZE HINTS         : " << buffers.hintHits << " hit(s), " << buffers.hintMisses
+                << " miss(es)\n";
+            return out.str();
+        }
+
+        std::atomic<bool> notifying{false}; // Set by the refresher once notifications are registered.
+
+    private:
+        static uint64_t AgeMs(const CacheTable &table)
+        {
+            return static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - table.refreshedAt).count());
+        }
+
+        std::string Header(const CacheTable &table, size_t count)
+        {
+            uint64_t age = AgeMs(table);
+            uint64_t seen = counters.maxAgeServedMs;
+            while (age > seen && !counters.maxAgeServedMs.compare_exchange_weak(seen, age))
+            {
+            }
+            return "OK\t" + std::to_string(age) + "\t" + std::to_string(count) + "\n";
+        }
+
+        const CacheOptions opts;
+        const Clock::duration maxAge;
+        std::shared_ptr<const CacheTable> current;
+        std::mutex refreshMutex;
+        CacheCounters counters;
+        std::mutex stopMutex;
+        std::condition_variable stopChanged;
+        std::atomic<bool> stopping{false};
+
+        friend class ChangeWatcher;
+    };
+
+#if STATUS_CACHE_NOTIFICATIONS
+    // Status change subscriptions for every cached service, plus creation and deletion on the SCM.
+    // The SCM queues the callbacks as APCs on the registering thread, so everything here runs on
+    // the refresher thread and needs no locking. A callback may already be queued when its
+    // registration is dropped, so dropped registrations are kept until the watcher goes away.
+    class ChangeWatcher
+    {
+    public:
+        explicit ChangeWatcher(StatusCache &cache) : cache(cache) {}
+
+        ~ChangeWatcher()
+        {
+            Clear();
+        }
+
+        // Registers for changes to every service in the table. Returns false if the SCM does
+        // not support notifications, in which case the cache polls.
+        bool Start(const CacheTable &table)
+        {
+            scm = Scm()->OpenSCManagerA(cache.opts.serverName.empty() ? nullptr : cache.opts.serverName.c_str(),
+                                       nullptr, SC_MANAGER_ENUMERATE_SERVICE);
+            if (!scm)
+                return false;
+            scmWatch.reset(new Watch());
+            scmWatch->watcher = this;
+            if (!Arm(scm, *scmWatch, SERVICE_NOTIFY_CREATED | SERVICE_NOTIFY_DELETED))
+            {
+                Clear();
+                return false;
+            }
+            for (const CachedServiceStatus &service : table.services)
+                AddService(service.serviceName);
+            return true;
+        }
+
+        // Waits up to timeoutMs for a change. Returns true if one was notified.
+        bool Wait(DWORD timeoutMs)
+        {
+            auto deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+            while (!changed && !cache.Stopping())
+            {
+                auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now());
+                if (remaining.count() <= 0)
+                    break;
+                // Short slices so Stop() is noticed promptly.
+                SleepEx(static_cast<DWORD>(std::min<long long>(remaining.count(), 100)), TRUE);
+            }
+            bool result = changed;
+            changed = false;
+            return result;
+        }
+
+        // Re-arms the registrations that fired. Creation or deletion rebuilds the service set.
+        void Rearm(const CacheTable &table)
+        {
+            if (scmWatch->fired)
+            {
+                scmWatch->fired = false;
+                for (auto &watch : services)
+                    Retire(std::move(watch));
+                services.clear();
+                Arm(scm, *scmWatch, SERVICE_NOTIFY_CREATED | SERVICE_NOTIFY_DELETED);
+                for (const CachedServiceStatus &service : table.services)
+                    AddService(service.serviceName);
+                return;
+            }
+            for (auto it = services.begin(); it != services.end();)
+            {
+                Watch &watch = **it;
+                if (watch.fired)
+                {
+                    watch.fired = false;
+                    if (!Arm(watch.handle, watch, SERVICE_STATUS_MASK))
+                    {
+                        // Deleted, or marked for deletion.
+                        Retire(std::move(*it));
+                        it = services.erase(it);
+                        continue;
+                    }
+                }
+                ++it;
+            }
+        }
+
+    private:
+        static constexpr DWORD SERVICE_STATUS_MASK =
+            SERVICE_NOTIFY_STOPPED | SERVICE_NOTIFY_START_PENDING | SERVICE_NOTIFY_STOP_PENDING |
+            SERVICE_NOTIFY_RUNNING | SERVICE_NOTIFY_CONTINUE_PENDING | SERVICE_NOTIFY_PAUSE_PENDING |
+            SERVICE_NOTIFY_PAUSED | SERVICE_NOTIFY_DELETE_PENDING;
+
+        struct Watch
+        {
+            SERVICE_NOTIFYA notify = {};
+            SC_HANDLE handle = nullptr;
+            ChangeWatcher *watcher = nullptr;
+            bool fired = false;
+        };
+
+        static void CALLBACK OnNotify(PVOID parameter)
+        {
+            SERVICE_NOTIFYA *notify = static_cast<SERVICE_NOTIFYA *>(parameter);
+            Watch *watch = static_cast<Watch *>(notify->pContext);
+            watch->fired = true;
+            watch->watcher->changed = true;
+            watch->watcher->cache.counters.notifications++;
+        }
+
+        bool Arm(SC_HANDLE handle, Watch &watch, DWORD mask)
+        {
+            if (watch.notify.pszServiceNames)
+            {
+                LocalFree(watch.notify.pszServiceNames);
+            }
+            watch.notify = {};
+            watch.notify.dwVersion = SERVICE_NOTIFY_STATUS_CHANGE;
+            watch.notify.pfnNotifyCallback = OnNotify;
+            watch.notify.pContext = &watch;
+            return Scm()->NotifyServiceStatusChangeA(handle, mask, &watch.notify) == ERROR_SUCCESS;
+        }
+
+        void AddService(const std::string &name)
+        {
+            std::unique_ptr<Watch> watch(new Watch());
+            watch->watcher = this;
+            watch->handle = Scm()->OpenServiceA(scm, name.c_str(), SERVICE_QUERY_STATUS);
+            if (!watch->handle)
+                return; // Still refreshed by the poll.
+            if (!Arm(watch->handle, *watch, SERVICE_STATUS_MASK))
+            {
+                Scm()->CloseServiceHandle(watch->handle);
+                return;
+            }
+            services.push_back(std::move(watch));
+        }
+
+        void Retire(std::unique_ptr<Watch> watch)
+        {
+            Scm()->CloseServiceHandle(watch->handle);
+            watch->handle = nullptr;
+            retired.push_back(std::move(watch));
+        }
+
+        void Clear()
+        {
+            for (auto &watch : services)
+                Scm()->CloseServiceHandle(watch->handle);
+            services.clear();
+            retired.clear();
+            if (scm)
+            {
+                Scm()->CloseServiceHandle(scm);
+                scm = nullptr;
+            }
+        }
+
+        StatusCache &cache;
+        SC_HANDLE scm = nullptr;
+        std::unique_ptr<Watch> scmWatch;
+        std::vector<std::unique_ptr<Watch>> services;
+        std::vector<std::unique_ptr<Watch>> retired;
+        bool changed = false;
+    };
+#else
+    // Notifications need Vista or later; the cache polls instead.
+    class ChangeWatcher
+    {
+    public:
+        explicit ChangeWatcher(StatusCache &) {}
+        bool Start(const CacheTable &) { return false; }
+        bool Wait(DWORD) { return false; }
+        void Rearm(const CacheTable &) {}
+    };
+#endif
+
+    void StatusCache::RunRefresher()
+    {
+        ChangeWatcher watcher(*this);
+        std::shared_ptr<const CacheTable> table = Current();
+        notifying = table && watcher.Start(*table);
+        while (!stopping)
+        {
+            if (notifying)
+            {
+                // Refresh on a change, or when the safety-net interval passes without one.
+                auto deadline = Clock::now() + std::chrono::milliseconds(CACHE_NOTIFY_RESYNC_MS);
+                while (!stopping && !watcher.Wait(CACHE_NOTIFY_SLICE_MS) && Clock::now() < deadline)
+                {
+                }
+            }
+            else
+            {
+                std::unique_lock<std::mutex> lock(stopMutex);
+                stopChanged.wait_for(lock, std::chrono::milliseconds(opts.pollMs), [this]
+                                     { return stopping.load(); });
+            }
+            if (stopping)
+                break;
+            Refresh();
+            if (notifying && (table = Current()))
+                watcher.Rearm(*table);
+        }
+    }
+
+    bool ServeCache(const CacheOptions &opts, const std::string &endpoint)
+    {
+        StatusCache cache(opts);
+        if (DWORD error = cache.Refresh())
+        {
+            ScErr() << "EnumServicesStatusEx failed, error: " << error << "\n";
+            return false;
+        }
+
+        LocalServer server;
+        std::string listenError;
+        if (!server.Listen(endpoint, listenError))
+        {
+            ScErr() << "Error: " << listenError << "\n";
+            return false;
+        }
+        MetricsEndpoint metrics;
+        if (opts.metricsPort && !metrics.Start(opts.metricsPort, listenError))
+        {
+            ScErr() << "Error: " << listenError << "\n";
+            return false;
+        }
+
+        std::thread refresher([&cache]
+                              { cache.RunRefresher(); });
+        ScOut() << "[SC] Status cache serving " << cache.Current()->services.size() << " services on " << endpoint
+                << "\n";
+        if (opts.metricsPort)
+            ScOut() << "[SC] Metrics on http://127.0.0.1:" << opts.metricsPort << "/metrics\n";
+        ScOut().flush();
+
+        // Each connection is answered on a thread of its own, so a client that connects and
+        // sends nothing holds up only itself until ReadRequest gives up on it.
+        std::mutex connectionsMutex;
+        std::condition_variable connectionDone;
+        size_t activeConnections = 0;
+        while (!cache.Stopping())
+        {
+            std::unique_ptr<LocalConnection> connection = server.Accept();
+            if (!connection || cache.Stopping())
+                break;
+            {
+                std::unique_lock<std::mutex> lock(connectionsMutex);
+                connectionDone.wait(lock, [&activeConnections]
+                                    { return activeConnections < CACHE_MAX_CONNECTIONS; });
+                activeConnections++;
+            }
+            std::thread(
+                [&, connection = std::move(connection)]() mutable
+                {
+                    std::string request;
+                    if (connection->ReadRequest(request))
+                        connection->WriteResponse(cache.Answer(request));
+                    connection.reset();
+                    if (cache.Stopping())
+                    {
+                        // Wake the accept loop so it sees the STOP this or another connection handled.
+                        std::string ignored;
+                        LocalRequest(endpoint, "", ignored);
+                    }
+                    std::lock_guard<std::mutex> lock(connectionsMutex);
+                    activeConnections--;
+                    connectionDone.notify_all();
+                })
+                .detach();
+        }
+        cache.Stop();
+        refresher.join();
+        // Closing the server also fails the wake-up requests nobody accepted.
+        server.Close();
+        {
+            std::unique_lock<std::mutex> lock(connectionsMutex);
+            connectionDone.wait(lock, [&activeConnections]
+                                { return activeConnections == 0; });
+        }
+        metrics.Stop();
+        ScOut() << cache.Stats();
+        return true;
+    }
+}
+
+bool cacheCommand(const CacheOptions &opts)
+{
+    std::string endpoint = opts.endpoint.empty() ? DefaultCacheEndpoint() : opts.endpoint;
+    if (opts.action == "serve")
+        return ServeCache(opts, endpoint);
+
+    std::string response;
+    if (!LocalRequest(endpoint, std::string(CACHE_PROTOCOL_VERSION) + (opts.action == "stats" ? "\tSTATS" : "\tSTOP"),
+                      response))
+    {
+        ScErr() << "Error: No status cache is running on " << endpoint << ".\n";
+        return false;
+    }
+    if (response.compare(0, 3, "OK\n") != 0)
+    {
+        ScErr() << "Error: The status cache refused the request: " << response;
+        return false;
+    }
+    if (opts.action == "stats")
+        ScOut() << response.substr(3);
+    else
+        ScOut() << "[SC] Status cache on " << endpoint << " stopped.\n";
+    return true;
+}
+
+bool QueryCachedServices(const std::string &endpoint, const std::string &serverName, DWORD serviceType,
+                         DWORD serviceState, std::vector<CachedServiceStatus> &services, unsigned int &ageMs)
+{
+    return RequestServices(endpoint, std::string(CACHE_PROTOCOL_VERSION) + "\tENUM\t" + serverName + "\t" +
+                               std::to_string(serviceType) + "\t" + std::to_string(serviceState),
+                           services, ageMs);
+}
+
+bool QueryCachedStatus(const std::string &endpoint, const std::string &serverName, const std::string &serviceName,
+                       CachedServiceStatus &service, unsigned int &ageMs)
+{
+    std::vector<CachedServiceStatus> services;
+    if (serviceName.find_first_of("\t\n") != std::string::npos ||
+        !RequestServices(endpoint,
+                         std::string(CACHE_PROTOCOL_VERSION) + "\tSTATUS\t" + serverName + "\t" + serviceName,
+                         services, ageMs) ||
+        services.size() != 1)
+        return false;
+    service = std::move(services[0]);
+    return true;
+}
+
+bool QueryCachedProcess(const std::string &endpoint, const std::string &serverName, DWORD processId,
+                        std::vector<CachedServiceStatus> &services, unsigned int &ageMs)
+{
+    return RequestServices(endpoint, std::string(CACHE_PROTOCOL_VERSION) + "\tPID\t" + serverName + "\t" +
+                               std::to_string(processId),
+                           services, ageMs);
+}
@@ -0,0 +1,55 @@
+#ifndef STATUS_CACHE_H
+#define STATUS_CACHE_H
+
+#include <string>
+#include <vector>
+
+#include "win32_compat.h"
+
+// Structure for the "cache" subcommand options.
+// Command-line syntax:
+//   sc.exe [<servername>] cache {serve | stats | stop} [poll= <ms>] [maxage= <ms>] [endpoint= <path>]
+//                                [metrics= <port>]
+struct CacheOptions
+{
+    std::string serverName;         // Server whose services are cached; empty for the local machine.
+    std::string action = "serve";   // serve runs the cache in the foreground; stats and stop talk to it.
+    std::string endpoint;           // Pipe or socket path; empty means DefaultCacheEndpoint().
+    unsigned int pollMs = 1000;     // Refresh interval when polling; notifications refresh on change.
+    unsigned int maxAgeMs = 0;      // Oldest polled table served without refreshing; 0 means 2 * pollMs.
+    unsigned short metricsPort = 0; // Loopback port for the Prometheus endpoint; 0 means none.
+};
+
+// Parse function for "cache" options. Throws std::invalid_argument on bad input.
+void ParseCacheOptions(const std::vector<std::string> &args, CacheOptions &opts);
+
+// cache function: runs the cache until "sc cache stop", or prints its counters, or stops it.
+// Returns true on success.
+bool cacheCommand(const CacheOptions &opts);
+
+// One service as held by the cache.
+struct CachedServiceStatus
+{
+    std::string serviceName;
+    std::string displayName;
+    SERVICE_STATUS_PROCESS status;
+};
+
+// Client side, used by "query ... cache= yes". Each asks the cache listening on endpoint
+// (empty for DefaultCacheEndpoint()) and returns false when it is not serving serverName,
+// so the caller can go to the SCM instead.
+
+// Services matching serviceType and serviceState (as for EnumServicesStatusExA), in enumeration order.
+// ageMs receives how old the cached table is.
+bool QueryCachedServices(const std::string &endpoint, const std::string &serverName, DWORD serviceType,
+                         DWORD serviceState, std::vector<CachedServiceStatus> &services, unsigned int &ageMs);
+
+// One service by name. Services the cache does not know about are left to the SCM.
+bool QueryCachedStatus(const std::string &endpoint, const std::string &serverName, const std::string &serviceName,
+                       CachedServiceStatus &service, unsigned int &ageMs);
+
+// The services running in one process. Processes the cache does not know about are left to the SCM.
+bool QueryCachedProcess(const std::string &endpoint, const std::string &serverName, DWORD processId,
+                        std::vector<CachedServiceStatus> &services, unsigned int &ageMs);
+
+#endif // STATUS_CACHE_H
@@ -0,0 +1,216 @@
+#include "status_format.h"
+
+#include <charconv>
+
+// Define our bit masks for convenience.
+constexpr DWORD OWN_BIT = SERVICE_WIN32_OWN_PROCESS;           // 0x10
+constexpr DWORD SHARE_BIT = SERVICE_WIN32_SHARE_PROCESS;       // 0x20
+constexpr DWORD USER_BIT = 0x40;                               // SERVICE_USER_SERVICE
+constexpr DWORD INSTANCE_BIT = 0x80;                           // SERVICE_USERSERVICE_INSTANCE
+constexpr DWORD INTERACTIVE_BIT = SERVICE_INTERACTIVE_PROCESS; // 0x100
+
+// Helper: Convert a numeric service state into a string.
+const char *StateToString(DWORD state)
+{
+    switch (state)
+    {
+    case SERVICE_STOPPED:
+        return "STOPPED";
+    case SERVICE_START_PENDING:
+        return "START_PENDING";
+    case SERVICE_STOP_PENDING:
+        return "STOP_PENDING";
+    case SERVICE_RUNNING:
+        return "RUNNING";
+    case SERVICE_CONTINUE_PENDING:
+        return "CONTINUE_PENDING";
+    case SERVICE_PAUSE_PENDING:
+        return "PAUSE_PENDING";
+    case SERVICE_PAUSED:
+        return "PAUSED";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+const char *StartTypeToString(DWORD startType)
+{
+    switch (startType)
+    {
+    case SERVICE_BOOT_START:
+        return "BOOT_START";
+    case SERVICE_SYSTEM_START:
+        return "SYSTEM_START";
+    case SERVICE_AUTO_START:
+        return "AUTO_START";
+    case SERVICE_DEMAND_START:
+        return "DEMAND_START";
+    case SERVICE_DISABLED:
+        return "DISABLED";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+const char *ErrorControlToString(DWORD errorControl)
+{
+    switch (errorControl)
+    {
+    case SERVICE_ERROR_IGNORE:
+        return "IGNORE";
+    case SERVICE_ERROR_NORMAL:
+        return "NORMAL";
+    case SERVICE_ERROR_SEVERE:
+        return "SEVERE";
+    case SERVICE_ERROR_CRITICAL:
+        return "CRITICAL";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+// Helper: Decode the dwServiceType field into a human–readable string.
+// This function distinguishes among:
+//   - Driver types: KERNEL_DRIVER, FILE_SYSTEM_DRIVER, RECOGNIZER_DRIVER
+//   - Win32 service types:
+//       • If both OWN and SHARE bits are set with no extra bits, return "WIN32" (as sc.exe does for WinHttpAutoProxySvc, type 0x30).
+//       • If OWN is set (and SHARE is not) return "WIN32_OWN_PROCESS" (plus " INTERACTIVE" if applicable).
+//       • If SHARE is set (and OWN is not) return either "WIN32_SHARE_PROCESS" or "USER_SHARE_PROCESS" (if bit 0x40 is set)
+//         and append " INSTANCE" if bit 0x80 is set.
+//       • If both OWN and SHARE are set but extra bits are present (as with 0xF0 for WpnUserService_a35a6), return "ERROR".
+// Every combination is a string literal so callers never allocate.
+const char *DecodeServiceType(DWORD type)
+{
+    // Check for driver types.
+    if (type & SERVICE_KERNEL_DRIVER)
+        return "KERNEL_DRIVER";
+    if (type & SERVICE_FILE_SYSTEM_DRIVER)
+        return "FILE_SYSTEM_DRIVER";
+    if (type & SERVICE_RECOGNIZER_DRIVER)
+        return "RECOGNIZER_DRIVER";
+
+    bool own = (type & OWN_BIT) != 0;
+    bool share = (type & SHARE_BIT) != 0;
+    bool interactive = (type & INTERACTIVE_BIT) != 0;
+
+    // If both OWN and SHARE are set...
+    if (own && share)
+    {
+        // If the only bits set are OWN and SHARE (ignoring interactive), return "WIN32".
+        if (((type & ~(INTERACTIVE_BIT)) == (OWN_BIT | SHARE_BIT)))
+            return interactive ? "WIN32 INTERACTIVE" : "WIN32";
+        // Otherwise (if extras are present) return "ERROR" to match sc.exe for WpnUserService_a35a6.
+        return "ERROR";
+    }
+    // If only OWN is set:
+    if (own)
+        return interactive ? "WIN32_OWN_PROCESS INTERACTIVE" : "WIN32_OWN_PROCESS";
+    // If only SHARE is set, index by the user, instance and interactive bits.
+    if (share)
+    {
+        static const char *const shareTypes[8] = {
+            "WIN32_SHARE_PROCESS",
+            "WIN32_SHARE_PROCESS INTERACTIVE",
+            "WIN32_SHARE_PROCESS INSTANCE",
+            "WIN32_SHARE_PROCESS INSTANCE INTERACTIVE",
+            "USER_SHARE_PROCESS",
+            "USER_SHARE_PROCESS INTERACTIVE",
+            "USER_SHARE_PROCESS INSTANCE",
+            "USER_SHARE_PROCESS INSTANCE INTERACTIVE",
+        };
+        size_t index = ((type & USER_BIT) ? 4 : 0) | ((type & INSTANCE_BIT) ? 2 : 0) | (interactive ? 1 : 0);
+        return shareTypes[index];
+    }
+    return "ERROR";
+}
+
+void ServiceStatusFormatter::appendDecimal(DWORD value)
+{
+    char digits[16];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    buffer.append(digits, result.ptr);
+}
+
+void ServiceStatusFormatter::appendHex(DWORD value)
+{
+    char digits[16];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value, 16);
+    buffer.append(digits, result.ptr);
+}
+
+std::string_view ServiceStatusFormatter::Format(std::string_view serviceName, std::string_view displayName,
+                                                const SERVICE_STATUS_PROCESS &ssp, bool showDisplayName,
+                                                bool extended)
+{
+    // clear() keeps the capacity, so after the first few records this never allocates.
+    buffer.clear();
+
+    buffer += "\nSERVICE_NAME: ";
+    buffer += serviceName;
+    buffer += '\n';
+    if (showDisplayName)
+    {
+        buffer += "DISPLAY_NAME: ";
+        buffer += displayName;
+        buffer += '\n';
+    }
+
+    buffer += "        TYPE               : ";
+    appendHex(ssp.dwServiceType);
+    buffer += "   ";
+    buffer += DecodeServiceType(ssp.dwServiceType);
+    buffer += '\n';
+
+    buffer += "        STATE              : ";
+    appendDecimal(ssp.dwCurrentState);
+    buffer += "  ";
+    buffer += StateToString(ssp.dwCurrentState);
+    buffer += '\n';
+
+    // Print control flags only if the service is not stopped.
+    if (ssp.dwCurrentState != SERVICE_STOPPED)
+    {
+        buffer += "                                (";
+        buffer += (ssp.dwControlsAccepted & SERVICE_ACCEPT_STOP) ? "STOPPABLE" : "NOT_STOPPABLE";
+        buffer += (ssp.dwControlsAccepted & SERVICE_ACCEPT_PAUSE_CONTINUE) ? ", PAUSABLE" : ", NOT_PAUSABLE";
+        if (ssp.dwControlsAccepted & SERVICE_ACCEPT_PRESHUTDOWN)
+            buffer += ", ACCEPTS_PRESHUTDOWN";
+        else if (ssp.dwControlsAccepted & SERVICE_ACCEPT_SHUTDOWN)
+            buffer += ", ACCEPTS_SHUTDOWN";
+        else
+            buffer += ", IGNORES_SHUTDOWN";
+        buffer += ")\n";
+    }
+
+    buffer += "        WIN32_EXIT_CODE    : ";
+    appendDecimal(ssp.dwWin32ExitCode);
+    buffer += "  (0x";
+    appendHex(ssp.dwWin32ExitCode);
+    buffer += ")\n";
+
+    buffer += "        SERVICE_EXIT_CODE  : ";
+    appendDecimal(ssp.dwServiceSpecificExitCode);
+    buffer += "  (0x";
+    appendHex(ssp.dwServiceSpecificExitCode);
+    buffer += ")\n";
+
+    buffer += "        CHECKPOINT         : 0x";
+    appendHex(ssp.dwCheckPoint);
+    buffer += '\n';
+
+    buffer += "        WAIT_HINT          : 0x";
+    appendHex(ssp.dwWaitHint);
+    buffer += '\n';
+
+    if (extended)
+    {
+        buffer += "        PID                : ";
+        appendDecimal(ssp.dwProcessId);
+        buffer += "\n        FLAGS              : ";
+        if (ssp.dwServiceFlags & SERVICE_RUNS_IN_SYSTEM_PROCESS)
+            buffer += "RUNS_IN_SYSTEM_PROCESS";
+        buffer += '\n';
+    }
+
+    return buffer;
+}
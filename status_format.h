@@ -0,0 +1,38 @@
+#ifndef STATUS_FORMAT_H
+#define STATUS_FORMAT_H
+
+#include <string>
+#include <string_view>
+#include "win32_compat.h"
+
+// Converts a numeric service state into its sc.exe name ("RUNNING", "STOP_PENDING", ...).
+const char *StateToString(DWORD state);
+
+// Decodes the dwServiceType field into the sc.exe description ("WIN32_OWN_PROCESS", ...).
+const char *DecodeServiceType(DWORD type);
+
+// Converts a start type into its sc.exe qc name ("AUTO_START", "DISABLED", ...).
+const char *StartTypeToString(DWORD startType);
+
+// Converts an error control value into its sc.exe qc name ("NORMAL", "CRITICAL", ...).
+const char *ErrorControlToString(DWORD errorControl);
+
+// Renders the query output block for one service into a buffer that is reused between
+// records, so enumerating a host costs one write per record and no allocations once the
+// buffer has grown to fit the longest record.
+class ServiceStatusFormatter
+{
+public:
+    // Formats one record exactly as sc.exe prints it; extended adds the PID and FLAGS lines
+    // of queryex. The returned view stays valid until the next call.
+    std::string_view Format(std::string_view serviceName, std::string_view displayName,
+                            const SERVICE_STATUS_PROCESS &ssp, bool showDisplayName, bool extended = false);
+
+private:
+    void appendDecimal(DWORD value);
+    void appendHex(DWORD value);
+
+    std::string buffer;
+};
+
+#endif // STATUS_FORMAT_H
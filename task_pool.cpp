@@ -0,0 +1,231 @@
+#include "task_pool.h"
+#include "console.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct TaskSlot
+    {
+        bool running = false;
+        bool done = false;
+        bool skipped = false;
+        bool abandoned = false;
+        size_t worker = 0;
+        Clock::time_point started;
+        TaskOutcome outcome;
+    };
+
+    // Shared with the workers through a shared_ptr so abandoned workers can outlive
+    // the RunBoundedTasks call that started them.
+    struct TaskPoolState
+    {
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::vector<BoundedTask> tasks;
+        std::vector<TaskSlot> slots;
+        std::vector<std::vector<size_t>> dependents; // Tasks waiting on each task.
+        std::vector<size_t> waitingOn;               // Unfinished prerequisites of each task.
+        std::deque<size_t> ready;                    // Tasks whose prerequisites all succeeded.
+        std::deque<size_t> completed;
+        size_t unscheduled = 0;                      // Tasks neither started nor skipped.
+    };
+
+    unsigned long MillisecondsSince(Clock::time_point since)
+    {
+        return static_cast<unsigned long>(
+            std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - since).count());
+    }
+
+    // Marks a task and everything downstream of it as skipped. Called with the mutex held.
+    void SkipTask(TaskPoolState &state, size_t index)
+    {
+        TaskSlot &slot = state.slots[index];
+        if (slot.skipped)
+            return;
+        slot.skipped = true;
+        slot.done = true;
+        slot.outcome.skipped = true;
+        --state.unscheduled;
+        state.completed.push_back(index);
+        for (size_t dependent : state.dependents[index])
+            SkipTask(state, dependent);
+    }
+
+    // Releases the dependents of a finished task. Called with the mutex held.
+    void FinishTask(TaskPoolState &state, size_t index, bool ok)
+    {
+        for (size_t dependent : state.dependents[index])
+        {
+            if (!ok)
+                SkipTask(state, dependent);
+            else if (--state.waitingOn[dependent] == 0 && !state.slots[dependent].skipped)
+                state.ready.push_back(dependent);
+        }
+    }
+
+    void WorkerLoop(std::shared_ptr<TaskPoolState> state, size_t worker)
+    {
+        for (;;)
+        {
+            size_t index;
+            {
+                std::unique_lock<std::mutex> lock(state->mutex);
+                state->changed.wait(lock, [&state]
+                                    { return !state->ready.empty() || state->unscheduled == 0; });
+                if (state->ready.empty())
+                    return;
+                index = state->ready.front();
+                state->ready.pop_front();
+                --state->unscheduled;
+                TaskSlot &slot = state->slots[index];
+                slot.running = true;
+                slot.worker = worker;
+                slot.started = Clock::now();
+            }
+            // The caller may be waiting with no deadline; wake it to arm this task's.
+            state->changed.notify_all();
+
+            std::ostringstream output;
+            bool ok = false;
+            {
+                ConsoleCapture capture(output, output);
+                try
+                {
+                    ok = state->tasks[index]();
+                }
+                catch (const std::exception &e)
+                {
+                    output << e.what() << "\n";
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(state->mutex);
+            TaskSlot &slot = state->slots[index];
+            if (slot.abandoned)
+                return; // Already reported as timed out and replaced by another worker.
+            slot.done = true;
+            slot.outcome.ok = ok;
+            slot.outcome.output = output.str();
+            slot.outcome.elapsedMs = MillisecondsSince(slot.started);
+            state->completed.push_back(index);
+            FinishTask(*state, index, ok);
+            state->changed.notify_all();
+        }
+    }
+} // end anonymous namespace
+
+void RunBoundedTasks(const std::vector<BoundedTask> &tasks, size_t parallelism,
+                     std::chrono::milliseconds timeout,
+                     const std::function<void(const TaskOutcome &)> &onComplete)
+{
+    RunDependentTasks(tasks, {}, parallelism, timeout, onComplete);
+}
+
+void RunDependentTasks(const std::vector<BoundedTask> &tasks,
+                       const std::vector<std::vector<size_t>> &prerequisites, size_t parallelism,
+                       std::chrono::milliseconds timeout,
+                       const std::function<void(const TaskOutcome &)> &onComplete)
+{
+    auto state = std::make_shared<TaskPoolState>();
+    state->tasks = tasks;
+    state->slots.resize(tasks.size());
+    state->dependents.resize(tasks.size());
+    state->waitingOn.resize(tasks.size());
+    state->unscheduled = tasks.size();
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        state->slots[i].outcome.index = i;
+        if (i < prerequisites.size())
+        {
+            for (size_t prerequisite : prerequisites[i])
+                state->dependents[prerequisite].push_back(i);
+            state->waitingOn[i] = prerequisites[i].size();
+        }
+        if (state->waitingOn[i] == 0)
+            state->ready.push_back(i);
+    }
+
+    std::vector<std::thread> workers;
+    std::vector<bool> abandonedWorkers;
+    size_t initial = std::min(std::max<size_t>(parallelism, 1), tasks.size());
+    for (size_t i = 0; i < initial; ++i)
+    {
+        workers.emplace_back(WorkerLoop, state, workers.size());
+        abandonedWorkers.push_back(false);
+    }
+
+    size_t reported = 0;
+    std::unique_lock<std::mutex> lock(state->mutex);
+    while (reported < tasks.size())
+    {
+        // Sleep until a task completes or the oldest running task reaches its deadline.
+        Clock::time_point deadline = Clock::time_point::max();
+        for (const TaskSlot &slot : state->slots)
+        {
+            if (slot.running && !slot.done && !slot.abandoned)
+                deadline = std::min(deadline, slot.started + timeout);
+        }
+        if (state->completed.empty())
+        {
+            if (deadline == Clock::time_point::max())
+                state->changed.wait(lock);
+            else
+                state->changed.wait_until(lock, deadline);
+        }
+
+        std::vector<TaskOutcome> ready;
+        while (!state->completed.empty())
+        {
+            ready.push_back(state->slots[state->completed.front()].outcome);
+            state->completed.pop_front();
+        }
+
+        Clock::time_point now = Clock::now();
+        for (TaskSlot &slot : state->slots)
+        {
+            if (slot.running && !slot.done && !slot.abandoned && now - slot.started >= timeout)
+            {
+                slot.abandoned = true;
+                slot.outcome.timedOut = true;
+                slot.outcome.elapsedMs = MillisecondsSince(slot.started);
+                ready.push_back(slot.outcome);
+                abandonedWorkers[slot.worker] = true;
+                FinishTask(*state, slot.outcome.index, false);
+                if (state->unscheduled > 0)
+                {
+                    workers.emplace_back(WorkerLoop, state, workers.size());
+                    abandonedWorkers.push_back(false);
+                }
+                // Wake idle workers: skipping may have left nothing to schedule.
+                state->changed.notify_all();
+            }
+        }
+
+        lock.unlock();
+        for (const TaskOutcome &outcome : ready)
+        {
+            onComplete(outcome);
+            ++reported;
+        }
+        lock.lock();
+    }
+    lock.unlock();
+
+    for (size_t i = 0; i < workers.size(); ++i)
+    {
+        if (abandonedWorkers[i])
+            workers[i].detach();
+        else
+            workers[i].join();
+    }
+}
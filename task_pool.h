@@ -0,0 +1,44 @@
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+// A unit of work for RunBoundedTasks. Returns true on success.
+using BoundedTask = std::function<bool()>;
+
+// Result of one task run by RunBoundedTasks.
+struct TaskOutcome
+{
+    size_t index = 0;        // Position of the task in the input vector.
+    bool ok = false;         // The task returned true.
+    bool timedOut = false;   // The task exceeded the timeout and was abandoned.
+    bool skipped = false;    // Not run because a prerequisite failed or timed out.
+    std::string output;      // Everything the task wrote to ScOut()/ScErr().
+    unsigned long elapsedMs = 0;
+};
+
+// Runs tasks on at most 'parallelism' worker threads and captures each task's console
+// output. onComplete is called on the calling thread, in completion order, once per task.
+// A task still running after 'timeout' is reported as timed out and abandoned: its worker
+// is left to finish on its own (its output is discarded) and a replacement worker is
+// started, so one stuck task cannot stall the rest. Exceptions thrown by a task count as
+// failures and their message is added to its output.
+void RunBoundedTasks(const std::vector<BoundedTask> &tasks, size_t parallelism,
+                     std::chrono::milliseconds timeout,
+                     const std::function<void(const TaskOutcome &)> &onComplete);
+
+// Like RunBoundedTasks, but task i only starts once every task in prerequisites[i] has
+// succeeded. Tasks whose prerequisites are all done run concurrently, so independent
+// chains proceed side by side. When a task fails or times out, every task that depends on
+// it, directly or not, is reported as skipped without being run. prerequisites must be
+// empty or hold one entry per task, and must not contain cycles.
+void RunDependentTasks(const std::vector<BoundedTask> &tasks,
+                       const std::vector<std::vector<size_t>> &prerequisites, size_t parallelism,
+                       std::chrono::milliseconds timeout,
+                       const std::function<void(const TaskOutcome &)> &onComplete);
+
+#endif // TASK_POOL_H
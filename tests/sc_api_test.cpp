@@ -0,0 +1,82 @@
+// sc_api_test: checks of the libsc C API against the in-memory SCM emulator (scm_emulator.h).
+//
+// Usage:
+//     sc_api_test
+//
+// Prints each failed check and exits non-zero if any failed.
+
+#include <cstdio>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "../sc_api.h"
+#include "../scm_backend.h"
+#include "../scm_emulator.h"
+#include "../win32_compat.h"
+
+namespace
+{
+    int failures = 0;
+
+    void Expect(bool condition, const std::string &what)
+    {
+        if (condition)
+            return;
+        std::fprintf(stderr, "FAILED: %s\n", what.c_str());
+        failures++;
+    }
+
+    // Pages through an enumeration 'capacity' entries at a time and checks every matching
+    // service comes back exactly once. The filter skips services between the ones it
+    // returns, so the resume handle must be a database position, not a running count.
+    void PageEnumeration(uint32_t state, size_t capacity, size_t expected)
+    {
+        std::string label = "state " + std::to_string(state) + ", capacity " + std::to_string(capacity);
+        std::vector<sc_service_entry> entries(capacity);
+        std::set<std::string> seen;
+        size_t total = 0;
+        uint32_t resume = 0;
+        for (size_t page = 0; page <= expected + 1; page++)
+        {
+            size_t returned = 0;
+            uint32_t error = sc_enum_services(nullptr, SERVICE_WIN32, state, nullptr, entries.data(), capacity,
+                                              &returned, &resume);
+            Expect(error == ERROR_SUCCESS || error == ERROR_MORE_DATA,
+                   label + ": error " + std::to_string(error));
+            Expect(returned <= capacity, label + ": returned more than the capacity");
+            for (size_t i = 0; i < returned; i++)
+            {
+                std::string name = entries[i].service_name;
+                Expect(seen.insert(name).second, label + ": " + name + " returned twice");
+                total++;
+            }
+            if (error != ERROR_MORE_DATA)
+                break;
+            Expect(resume != 0, label + ": ERROR_MORE_DATA with no resume handle");
+        }
+        Expect(resume == 0, label + ": enumeration did not finish");
+        Expect(total == expected, label + ": " + std::to_string(total) + " services, expected " +
+                                      std::to_string(expected));
+    }
+}
+
+int main()
+{
+    // Every third of the synthetic services runs: 67 of 200.
+    ScmEmulatorOptions options;
+    options.services = 200;
+    SetScmBackend(std::make_shared<ScmEmulator>(options));
+
+    for (size_t capacity : {1, 3, 4, 7, 64, 500})
+    {
+        PageEnumeration(SERVICE_ACTIVE, capacity, 67);
+        PageEnumeration(SERVICE_INACTIVE, capacity, 133);
+        PageEnumeration(SERVICE_STATE_ALL, capacity, 200);
+    }
+
+    if (failures)
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+    return failures ? 1 : 0;
+}